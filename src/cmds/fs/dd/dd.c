@@ -17,6 +17,8 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <stddef.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include <util/array.h>
 
@@ -25,6 +27,8 @@
 #define DD_FORMAT_RAW        "raw"
 #define DD_FORMAT_HEX_C      "hex_c"
 
+#define DD_CONV_FSYNC        "fsync"
+
 struct dd_param {
 	size_t bs;
 	size_t count;
@@ -35,6 +39,7 @@ struct dd_param {
 	const char *ofile;
 
 	const char *format;
+	const char *conv;
 };
 
 struct dd_param_ent;
@@ -106,7 +111,8 @@ static const struct dd_param_ent dd_param_list[] = {
 	DD_PARAM(count, dd_param_type_int),
 	DD_PARAM(skip, dd_param_type_int),
 	DD_PARAM(seek, dd_param_type_int),
-	DD_PARAM(format, dd_param_type_str)
+	DD_PARAM(format, dd_param_type_str),
+	DD_PARAM(conv, dd_param_type_str)
 };
 
 static const struct dd_param_ent *dd_param_ent_find(const char *name) {
@@ -148,6 +154,21 @@ static int dd_param_fill(int argc, char **argv, struct dd_param *dp) {
 	return 0;
 }
 
+static void dd_report(unsigned long long bytes, struct timespec *start) {
+	struct timespec now, elapsed;
+	unsigned long long us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespecsub(&now, start, &elapsed);
+
+	us = (unsigned long long) elapsed.tv_sec * 1000000
+			+ elapsed.tv_nsec / 1000;
+
+	fprintf(stderr, "%llu bytes copied, %d.%06d s, %llu KiB/s\n", bytes,
+			(int) elapsed.tv_sec, (int) (elapsed.tv_nsec / 1000),
+			us ? bytes * 1000000 / 1024 / us : 0);
+}
+
 static int dd_cond_open(const char *path, int mode, int def_fd) {
 	int fd;
 
@@ -169,6 +190,8 @@ int main(int argc, char **argv) {
 	int n_read, n_write, err;
 	int format = 0;
 	unsigned int addr = 0;
+	unsigned long long copied = 0;
+	struct timespec start;
 
 	err = dd_param_fill(argc, argv, &dp);
 	if (err) {
@@ -211,6 +234,8 @@ int main(int argc, char **argv) {
 		format = 1;
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
 	while (dp.skip != 0 ) {
 		n_read = read(ifd, tbuf, dp.bs);
 		if (n_read < 0) {
@@ -242,9 +267,20 @@ int main(int argc, char **argv) {
 			break;
 		}
 		addr += n_read;
+		copied += n_write;
 		dp.count --;
 	} while (dp.count != 0);
 
+	if ((NULL != dp.conv) && (0 == strcmp(dp.conv, DD_CONV_FSYNC))) {
+		if (0 > fsync(ofd)) {
+			err = -errno;
+		}
+	}
+
+	if (!format) {
+		dd_report(copied, &start);
+	}
+
 out_cmd:
 	free(tbuf);
 out_ofd_close:
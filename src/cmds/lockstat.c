@@ -0,0 +1,54 @@
+/**
+ * @file
+ * @brief Reports mutex contention statistics
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <kernel/thread/sync/mutex.h>
+
+static void print_usage(void) {
+	printf("Usage: lockstat [-r]\n");
+}
+
+int main(int argc, char **argv) {
+	struct mutex_contention mc;
+	unsigned int idx;
+	int opt, ret;
+
+	while (-1 != (opt = getopt(argc, argv, "rh"))) {
+		switch (opt) {
+		case 'r':
+			mutex_contention_reset();
+			return ENOERR;
+		case '?':
+			printf("Invalid command line option\n");
+			/* FALLTHROUGH */
+		case 'h':
+			print_usage();
+			return ENOERR;
+		}
+	}
+
+	printf("%10s %10s %12s %12s %6s\n",
+			"mutex", "contended", "wait(us)", "max(us)", "holder");
+
+	for (idx = 0; (ret = mutex_contention_get(idx, &mc)) != -EINVAL; idx++) {
+		if (ret != 0) {
+			continue;
+		}
+
+		printf("%10p %10lu %12llu %12llu %6d\n", mc.mutex, mc.contended,
+				mc.wait_ns / 1000, mc.max_wait_ns / 1000, mc.holder_id);
+	}
+
+	if (idx == 0) {
+		printf("Statistics are disabled\n");
+	}
+
+	return ENOERR;
+}
@@ -14,6 +14,7 @@
 
 #include <hal/cpu.h>
 #include <kernel/cpu/cpu.h>
+#include <kernel/sched.h>
 
 static void print_usage(void) {
 	printf("Usage: mpstat -P ALL\n");
@@ -23,6 +24,9 @@ int main(int argc, char **argv) {
 	int opt;
 	clock_t atotal = 0;
 	clock_t aidle = 0;
+	unsigned long amigr = 0;
+	unsigned long asteal = 0;
+	struct sched_cpu_stats stats;
 
 	if (argc <= 1) {
 		print_usage();
@@ -39,24 +43,30 @@ int main(int argc, char **argv) {
 			print_usage();
 			return ENOERR;
 		case 'P':
-			printf("CPU  time  %%idle\n");
+			printf("CPU  time  %%idle  runq  migrations    steals\n");
 
 			for (int i = 0; i < NCPU; i++) {
 				clock_t idle = cpu_get_idle_time(i);
 				clock_t total = cpu_get_total_time(i);
 
-				printf("%3d  %3ds    %2d%%\n",
+				sched_get_cpu_stats(i, &stats);
+
+				printf("%3d  %3ds    %2d%%  %4u  %10lu %9lu\n",
 						i,
 						(int) (total / CLOCKS_PER_SEC),
-						(int) (idle * 100 / total));
+						(int) (idle * 100 / total),
+						stats.nr_ready, stats.migrations, stats.steals);
 
 				atotal += total;
 				aidle  += idle;
+				amigr  += stats.migrations;
+				asteal += stats.steals;
 			}
 
-			printf("ALL  %3ds    %2d%%\n",
+			printf("ALL  %3ds    %2d%%        %10lu %9lu\n",
 					(int) (atotal / CLOCKS_PER_SEC),
-					(int) (aidle * 100 / atotal));
+					(int) (aidle * 100 / atotal),
+					amigr, asteal);
 
 			return ENOERR;
 		default:
@@ -14,6 +14,8 @@
 #include <net/netfilter.h>
 #include <string.h>
 
+static int verbose;
+
 static int clear_rules(int chain) {
 	int ret;
 
@@ -42,11 +44,17 @@ static int clear_rules(int chain) {
 static void print_header(int chain) {
 	printf("Chain %s (policy %s)\n", nf_chain_to_str(chain),
 			nf_target_to_str(nf_get_chain_target(chain)));
+	if (verbose) {
+		printf("%10s ", "pkts");
+	}
 	printf("target    prot opt  source           destination\n");
 }
 
 static void print_rule(const struct nf_rule *r) {
 	const char *target_str;
+	if (verbose) {
+		printf("%10lu ", r->hits);
+	}
 	target_str = nf_target_to_str(r->target);
 	printf("%-8s ", target_str != NULL ? target_str : "");
 	printf("%c%-4s ", r->not_proto ? '!' : ' ',
@@ -127,6 +135,7 @@ int main(int argc, char **argv) {
 	struct nf_rule rule;
 
 	oper = rule_num = -1;
+	verbose = 0;
 	chain = NF_CHAIN_UNKNOWN;
 	not_flag = 0;
 	nf_rule_init(&rule);
@@ -140,10 +149,14 @@ int main(int argc, char **argv) {
 			printf("  iptables -R chain rulenum rule-specification\n");
 			printf("  iptables -D chain rulenum\n");
 			printf("  iptables -F [chain]\n");
-			printf("  iptables -L [chain [rulenum]]\n");
+			printf("  iptables -L [chain [rulenum]] [-v]\n");
 			printf("  iptables -P chain target\n");
 			return 0;
 		}
+		else if (!strcmp(argv[ind], "-v")
+				|| !strcmp(argv[ind], "--verbose")) {
+			verbose = 1;
+		}
 		else if (oper == -1) {
 			if ((0 == strcmp(argv[ind], "-A"))
 					|| (0 == strcmp(argv[ind], "--append"))) {
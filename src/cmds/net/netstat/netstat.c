@@ -16,10 +16,12 @@
 #include <net/sock.h>
 #include <net/l4/udp.h>
 #include <net/l4/tcp.h>
+#include <net/l3/ipv4/ip_fragment.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
 #define NETSTAT_CONT			0x0100
+#define NETSTAT_STATS			0x0200
 
 #define NETSTAT_LISTENING		0x0001
 #define NETSTAT_NONLISTENING	0x0002
@@ -128,12 +130,27 @@ void print_info(const char *title,
 	}
 }
 
+static void print_stats(void) {
+	struct ip_frag_stats st;
+
+	ip_frag_get_stats(&st);
+
+	printf("Ip:\n");
+	printf("    %lu fragments received\n", st.reasm_reqds);
+	printf("    %lu packets reassembled ok\n", st.reasm_oks);
+	printf("    %lu packet reassembles failed\n", st.reasm_fails);
+	printf("    %lu reassembles timed out\n", st.reasm_timeouts);
+	printf("    %lu reassembles evicted by memory limit\n", st.reasm_evicted);
+	printf("    %u packets being reassembled, %zu bytes queued\n",
+			st.queues, st.mem);
+}
+
 int main(int argc, char **argv) {
 	int c;
 
 	netstat_flags = 0;
 
-	while ((c = getopt(argc, argv, "cl")) != -1) {
+	while ((c = getopt(argc, argv, "cls")) != -1) {
 		switch (c) {
 			case 'c':
 				netstat_flags |= NETSTAT_CONT;
@@ -141,6 +158,9 @@ int main(int argc, char **argv) {
 			case 'l':
 				netstat_flags |= NETSTAT_LISTENING;
 				break;
+			case 's':
+				netstat_flags |= NETSTAT_STATS;
+				break;
 			case 'a':
 				netstat_flags |= NETSTAT_LISTENING | NETSTAT_NONLISTENING;
 				break;
@@ -150,6 +170,14 @@ int main(int argc, char **argv) {
 	}
 
 	do {
+		if (netstat_flags & NETSTAT_STATS) {
+			print_stats();
+			if (netstat_flags & NETSTAT_CONT) {
+				sleep(1);
+			}
+			continue;
+		}
+
 		print_info(
 				"Active Internet connections\n"
 				"Proto   Local Address   Foreign Address   State\n",
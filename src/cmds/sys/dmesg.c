@@ -0,0 +1,68 @@
+/**
+ * @file
+ * @brief Prints kernel log history
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <hal/cpu.h>
+#include <kernel/klog.h>
+
+static void print_usage(void) {
+	printf("Usage: dmesg [-c] [-C] [-s]\n");
+}
+
+static void print_stats(void) {
+	struct klog_stats stats;
+	unsigned int cpu;
+
+	printf("%4s %10s %10s %10s\n", "cpu", "logged", "dropped", "truncated");
+	for (cpu = 0; 0 == klog_get_stats(cpu, &stats); cpu++) {
+		printf("%4u %10lu %10lu %10lu\n", cpu, stats.written,
+				stats.dropped, stats.truncated);
+	}
+}
+
+int main(int argc, char **argv) {
+	char buf[128];
+	unsigned long pos;
+	size_t len;
+	int opt, clear = 0;
+
+	while (-1 != (opt = getopt(argc, argv, "cCsh"))) {
+		switch (opt) {
+		case 'c':
+			clear = 1;
+			break;
+		case 'C':
+			klog_clear();
+			return ENOERR;
+		case 's':
+			print_stats();
+			return ENOERR;
+		case '?':
+			printf("Invalid command line option\n");
+			/* FALLTHROUGH */
+		case 'h':
+			print_usage();
+			return ENOERR;
+		}
+	}
+
+	klog_flush();
+
+	pos = 0;
+	while (0 != (len = klog_read(buf, sizeof buf, &pos))) {
+		fwrite(buf, 1, len, stdout);
+	}
+
+	if (clear) {
+		klog_clear();
+	}
+
+	return ENOERR;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file
+ * @brief Measures packets per second handled by network queues of each CPU
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <framework/mod/options.h>
+#include <hal/cpu.h>
+#include <kernel/time/ktime.h>
+#include <net/l0/net_entry.h>
+
+#define MAX_FLOWS OPTION_GET(NUMBER, max_flows)
+#define BASE_PORT OPTION_GET(NUMBER, base_port)
+#define MAX_SIZE  1024
+
+struct bench_flow {
+	int tx;
+	int rx;
+	struct sockaddr_in addr;
+};
+
+static struct bench_flow bench_flows[MAX_FLOWS];
+static char bench_buf[MAX_SIZE];
+static struct netif_cpu_stats stats_start[NCPU];
+
+static void print_help(char **argv) {
+	printf("Usage: %s [-h] [-f FLOWS] [-t SECONDS] [-s SIZE]\n", argv[0]);
+	printf("\t-f FLOWS Number of flows (default 8, max %d)\n", MAX_FLOWS);
+	printf("\t-t SECONDS Duration of the test (default 5)\n");
+	printf("\t-s SIZE Size of datagram payload (default 64, max %d)\n",
+			MAX_SIZE);
+}
+
+static void flows_close(int cnt) {
+	while (cnt-- > 0) {
+		close(bench_flows[cnt].tx);
+		close(bench_flows[cnt].rx);
+	}
+}
+
+static int flows_open(int cnt) {
+	struct bench_flow *fl;
+	int i, err;
+
+	for (i = 0; i < cnt; i++) {
+		fl = &bench_flows[i];
+
+		memset(&fl->addr, 0, sizeof fl->addr);
+		fl->addr.sin_family = AF_INET;
+		fl->addr.sin_port = htons(BASE_PORT + i);
+		fl->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		fl->rx = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (fl->rx == -1) {
+			err = -errno;
+			goto out_close;
+		}
+
+		fl->tx = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (fl->tx == -1) {
+			err = -errno;
+			close(fl->rx);
+			goto out_close;
+		}
+
+		if (-1 == bind(fl->rx, (struct sockaddr *)&fl->addr,
+					sizeof fl->addr)) {
+			err = -errno;
+			close(fl->tx);
+			close(fl->rx);
+			goto out_close;
+		}
+	}
+
+	return 0;
+
+out_close:
+	flows_close(i);
+	return err;
+}
+
+static void flows_drain(int cnt) {
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		while (0 < recv(bench_flows[i].rx, bench_buf, sizeof bench_buf,
+					MSG_DONTWAIT)) {
+		}
+	}
+}
+
+static void stats_print(time64_t ns) {
+	struct netif_cpu_stats st;
+	unsigned long rx, tx, rx_total, tx_total;
+	unsigned int cpu;
+
+	printf("%4s %14s %14s\n", "cpu", "rx pps", "tx pps");
+
+	rx_total = tx_total = 0;
+	for (cpu = 0; cpu < NCPU; cpu++) {
+		netif_get_cpu_stats(cpu, &st);
+		rx = st.rx_packets - stats_start[cpu].rx_packets;
+		tx = st.tx_packets - stats_start[cpu].tx_packets;
+		rx_total += rx;
+		tx_total += tx;
+
+		printf("%4u %14lld %14lld\n", cpu,
+				(long long)rx * 1000000000 / ns,
+				(long long)tx * 1000000000 / ns);
+	}
+
+	printf("%4s %14lld %14lld\n", "all",
+			(long long)rx_total * 1000000000 / ns,
+			(long long)tx_total * 1000000000 / ns);
+}
+
+int main(int argc, char **argv) {
+	int opt, ret, i, flows, seconds;
+	size_t size;
+	unsigned int cpu;
+	time64_t start, end, now;
+	unsigned long sent, failed;
+
+	flows = 8;
+	seconds = 5;
+	size = 64;
+
+	while (-1 != (opt = getopt(argc, argv, "hf:t:s:"))) {
+		switch (opt) {
+		case 'f':
+			flows = strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_help(argv);
+			return 0;
+		default:
+			print_help(argv);
+			return -EINVAL;
+		}
+	}
+
+	if ((flows <= 0) || (flows > MAX_FLOWS) || (seconds <= 0)
+			|| (size > MAX_SIZE)) {
+		print_help(argv);
+		return -EINVAL;
+	}
+
+	ret = flows_open(flows);
+	if (ret != 0) {
+		printf("Failed to open sockets: %s\n", strerror(-ret));
+		return ret;
+	}
+
+	for (cpu = 0; cpu < NCPU; cpu++) {
+		netif_get_cpu_stats(cpu, &stats_start[cpu]);
+	}
+
+	sent = failed = 0;
+	start = now = ktime_get_ns();
+	end = start + (time64_t)seconds * 1000000000;
+	while (now < end) {
+		for (i = 0; i < flows; i++) {
+			if ((ssize_t)size == sendto(bench_flows[i].tx, bench_buf, size,
+						0, (struct sockaddr *)&bench_flows[i].addr,
+						sizeof bench_flows[i].addr)) {
+				sent++;
+			} else {
+				failed++;
+			}
+		}
+		/* receivers are drained by the sender, so queues never overflow */
+		flows_drain(flows);
+		now = ktime_get_ns();
+	}
+
+	printf("%d flows, %lu datagrams sent, %lu failed\n", flows, sent, failed);
+	stats_print(now - start);
+
+	flows_close(flows);
+
+	return 0;
+}
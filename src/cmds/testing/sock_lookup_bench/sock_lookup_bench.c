@@ -0,0 +1,156 @@
+/**
+ * @file
+ * @brief Compares linear and hashed socket lookup latency
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <framework/mod/options.h>
+#include <kernel/time/ktime.h>
+#include <net/sock.h>
+#include <net/l4/udp.h>
+
+#define MAX_SOCKETS    OPTION_GET(NUMBER, max_sockets)
+#define BENCH_BASE_PORT 20000
+
+static int socks[MAX_SOCKETS];
+static in_port_t target_port;
+
+static void print_help(char **argv) {
+	printf("Usage: %s [-h] [-n COUNT] [-r REPEAT]\n", argv[0]);
+	printf("\t-n COUNT Maximum number of sockets (default 1000)\n");
+	printf("\t-r REPEAT Number of lookups per measurement (default 10000)\n");
+}
+
+static int bench_tester(const struct sock *sk, const struct sk_buff *skb) {
+	(void)skb;
+	return (sk->opt.so_domain == AF_INET)
+			&& (sock_inet_get_src_port(sk) == target_port);
+}
+
+static int bench_bind(int i) {
+	struct sockaddr_in addr;
+
+	socks[i] = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (socks[i] == -1) {
+		return -errno;
+	}
+
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(BENCH_BASE_PORT + i);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (-1 == bind(socks[i], (struct sockaddr *)&addr, sizeof addr)) {
+		close(socks[i]);
+		return -errno;
+	}
+
+	return 0;
+}
+
+/* Returns average time of a single lookup in nanoseconds */
+static time64_t bench_lookup(int count, int repeat, int hashed) {
+	time64_t start;
+	int i, found;
+
+	found = 0;
+	start = ktime_get_ns();
+	for (i = 0; i < repeat; i++) {
+		/* The last bound socket is the worst case for the linear scan */
+		target_port = htons(BENCH_BASE_PORT + count - 1 - (i % count));
+		if (hashed) {
+			found += NULL != sock_lookup_listener(udp_sock_ops, bench_tester,
+					NULL, target_port);
+		} else {
+			found += NULL != sock_lookup(NULL, udp_sock_ops, bench_tester,
+					NULL);
+		}
+	}
+
+	if (found != repeat) {
+		printf("warning: %d of %d lookups failed\n", repeat - found, repeat);
+	}
+
+	return (ktime_get_ns() - start) / repeat;
+}
+
+int main(int argc, char **argv) {
+	int opt, ret, count, bound, step, repeat;
+
+	count = 1000;
+	repeat = 10000;
+
+	while (-1 != (opt = getopt(argc, argv, "hn:r:"))) {
+		switch (opt) {
+		case 'n':
+			count = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeat = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_help(argv);
+			return 0;
+		default:
+			print_help(argv);
+			return -EINVAL;
+		}
+	}
+
+	if ((count <= 0) || (repeat <= 0)) {
+		print_help(argv);
+		return -EINVAL;
+	}
+
+	if (count > MAX_SOCKETS) {
+		printf("Socket count is limited to %d\n", MAX_SOCKETS);
+		count = MAX_SOCKETS;
+	}
+
+	printf("%10s %14s %14s\n", "sockets", "linear(ns)", "hashed(ns)");
+
+	ret = 0;
+	bound = 0;
+	for (step = 1; bound < count; step *= 10) {
+		if (step > count) {
+			step = count;
+		}
+
+		while (bound < step) {
+			ret = bench_bind(bound);
+			if (ret != 0) {
+				printf("Failed to bind socket #%d: %s\n", bound, strerror(-ret));
+				break;
+			}
+			bound++;
+		}
+
+		if (bound == 0) {
+			break;
+		}
+
+		printf("%10d %14lld %14lld\n", bound,
+				(long long)bench_lookup(bound, repeat, 0),
+				(long long)bench_lookup(bound, repeat, 1));
+
+		if (ret != 0) {
+			break;
+		}
+	}
+
+	while (bound > 0) {
+		close(socks[--bound]);
+	}
+
+	return ret;
+}
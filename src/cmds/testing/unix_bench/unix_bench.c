@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @brief Compares AF_UNIX and loopback TCP latency and throughput
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <framework/mod/options.h>
+#include <kernel/time/ktime.h>
+
+#define MAX_CHUNK OPTION_GET(NUMBER, max_chunk)
+#define TCP_PORT  OPTION_GET(NUMBER, tcp_port)
+
+static char bench_buf[MAX_CHUNK];
+
+static void print_help(char **argv) {
+	printf("Usage: %s [-h] [-n COUNT] [-s SIZE] [-b CHUNK]\n", argv[0]);
+	printf("\t-n COUNT Number of round trips (default 10000)\n");
+	printf("\t-s SIZE Total bytes of bulk transfer (default 4194304)\n");
+	printf("\t-b CHUNK Bytes sent by one call (default 1024, max %d)\n",
+			MAX_CHUNK);
+}
+
+static int tcp_pair(int sv[2]) {
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	int l, err;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(TCP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (l == -1) {
+		return -errno;
+	}
+
+	sv[0] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (sv[0] == -1) {
+		err = -errno;
+		goto out_close_l;
+	}
+
+	if ((-1 == bind(l, (struct sockaddr *)&addr, sizeof addr))
+			|| (-1 == listen(l, 1))
+			|| (-1 == connect(sv[0], (struct sockaddr *)&addr, sizeof addr))) {
+		err = -errno;
+		goto out_close;
+	}
+
+	addrlen = sizeof addr;
+	sv[1] = accept(l, (struct sockaddr *)&addr, &addrlen);
+	if (sv[1] == -1) {
+		err = -errno;
+		goto out_close;
+	}
+
+	close(l);
+	return 0;
+
+out_close:
+	close(sv[0]);
+out_close_l:
+	close(l);
+	return err;
+}
+
+static int recv_all(int fd, char *buf, size_t len) {
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = recv(fd, buf, len, 0);
+		if (ret <= 0) {
+			return ret == 0 ? -ECONNRESET : -errno;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/* Returns average round trip time in nanoseconds or minus errno */
+static long long bench_latency(int sv[2], int count) {
+	time64_t start;
+	char c = 'x';
+	int i, err;
+
+	start = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		if (1 != send(sv[0], &c, 1, 0)) {
+			return -errno;
+		}
+		if (0 != (err = recv_all(sv[1], &c, 1))) {
+			return err;
+		}
+		if (1 != send(sv[1], &c, 1, 0)) {
+			return -errno;
+		}
+		if (0 != (err = recv_all(sv[0], &c, 1))) {
+			return err;
+		}
+	}
+
+	return (ktime_get_ns() - start) / count;
+}
+
+/* Returns throughput in KiB/s or minus errno */
+static long long bench_throughput(int sv[2], size_t size, size_t chunk) {
+	time64_t start, ns;
+	size_t done;
+	int err;
+
+	start = ktime_get_ns();
+	for (done = 0; done < size; done += chunk) {
+		if ((ssize_t)chunk != send(sv[0], bench_buf, chunk, 0)) {
+			return -errno;
+		}
+		err = recv_all(sv[1], bench_buf, chunk);
+		if (err != 0) {
+			return err;
+		}
+	}
+	ns = ktime_get_ns() - start;
+
+	return ns ? (long long)(done / 1024) * 1000000000 / ns : 0;
+}
+
+static void bench_run(const char *name, int sv[2], int count, size_t size,
+		size_t chunk) {
+	long long lat, thr;
+
+	lat = bench_latency(sv, count);
+	thr = bench_throughput(sv, size, chunk);
+
+	printf("%10s ", name);
+	if (lat < 0) {
+		printf("%14s ", strerror(-lat));
+	} else {
+		printf("%14lld ", lat);
+	}
+	if (thr < 0) {
+		printf("%14s\n", strerror(-thr));
+	} else {
+		printf("%14lld\n", thr);
+	}
+
+	close(sv[0]);
+	close(sv[1]);
+}
+
+int main(int argc, char **argv) {
+	int opt, ret, count, sv[2];
+	size_t size, chunk;
+
+	count = 10000;
+	size = 4 * 1024 * 1024;
+	chunk = 1024;
+
+	while (-1 != (opt = getopt(argc, argv, "hn:s:b:"))) {
+		switch (opt) {
+		case 'n':
+			count = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			chunk = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_help(argv);
+			return 0;
+		default:
+			print_help(argv);
+			return -EINVAL;
+		}
+	}
+
+	if ((count <= 0) || (chunk == 0) || (chunk > MAX_CHUNK)) {
+		print_help(argv);
+		return -EINVAL;
+	}
+
+	printf("%10s %14s %14s\n", "socket", "rtt(ns)", "KiB/s");
+
+	if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		printf("Failed to create AF_UNIX pair: %s\n", strerror(errno));
+		return -errno;
+	}
+	bench_run("unix", sv, count, size, chunk);
+
+	ret = tcp_pair(sv);
+	if (ret != 0) {
+		printf("Failed to connect TCP pair: %s\n", strerror(-ret));
+		return ret;
+	}
+	bench_run("tcp", sv, count, size, chunk);
+
+	return 0;
+}
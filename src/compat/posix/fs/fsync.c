@@ -6,7 +6,33 @@
  */
 
 #include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
 
+#include <fs/bcache.h>
+#include <kernel/task/resource/idesc.h>
+#include <kernel/task/resource/index_descriptor.h>
+#include <kernel/task/resource/idesc_table.h>
+
+/* Buffer cache doesn't know which file a block belongs to, so dirty blocks
+ * of all devices are written */
 int fsync(int fd) {
+	if (!idesc_index_valid(fd)
+			|| (NULL == index_descriptor_get(fd))) {
+		return SET_ERRNO(EBADF);
+	}
+
+	if (0 > bcache_sync(NULL)) {
+		return SET_ERRNO(EIO);
+	}
+
 	return 0;
 }
+
+int fdatasync(int fd) {
+	return fsync(fd);
+}
+
+void sync(void) {
+	bcache_sync(NULL);
+}
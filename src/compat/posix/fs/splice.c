@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief sendfile() and splice()
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+
+#include <kernel/task/resource/index_descriptor.h>
+#include <kernel/task/resource/idesc.h>
+#include <kernel/task/resource/idesc_table.h>
+
+static struct idesc *splice_idesc_get(int fd, int forbidden_mode) {
+	struct idesc *idesc;
+
+	if (!idesc_index_valid(fd)
+			|| (NULL == (idesc = index_descriptor_get(fd)))
+			|| ((idesc->idesc_flags & O_ACCESS_MASK) == forbidden_mode)) {
+		return NULL;
+	}
+
+	assert(idesc->idesc_ops);
+
+	return idesc;
+}
+
+/* Move file position to @a off, old position is returned */
+static off_t splice_seek(int fd, off_t off) {
+	off_t old;
+
+	old = lseek(fd, 0, SEEK_CUR);
+	if (old == (off_t) -1) {
+		return -1;
+	}
+
+	if (lseek(fd, off, SEEK_SET) == (off_t) -1) {
+		return -1;
+	}
+
+	return old;
+}
+
+/* Whether the next chunk can be moved without waiting */
+static int splice_ready(struct idesc *in, struct idesc *out) {
+	return (!in->idesc_ops->status || in->idesc_ops->status(in, POLLIN))
+		&& (!out->idesc_ops->status || out->idesc_ops->status(out, POLLOUT));
+}
+
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out,
+		loff_t *off_out, size_t len, unsigned int flags) {
+	struct idesc *in, *out;
+	off_t in_pos, out_pos;
+	ssize_t ret;
+	size_t done;
+
+	(void) flags;
+
+	in = splice_idesc_get(fd_in, O_WRONLY);
+	out = splice_idesc_get(fd_out, O_RDONLY);
+	if ((in == NULL) || (out == NULL)) {
+		return SET_ERRNO(EBADF);
+	}
+
+	in_pos = out_pos = 0;
+	done = 0;
+	if (off_in && (-1 == (in_pos = splice_seek(fd_in, *off_in)))) {
+		return -1;
+	}
+	if (off_out && (-1 == (out_pos = splice_seek(fd_out, *off_out)))) {
+		ret = -errno;
+		goto out_restore;
+	}
+
+	ret = 0;
+	for (done = 0; done < len; done += ret) {
+		/* Block only until something is moved, as read() does */
+		if (done && !splice_ready(in, out)) {
+			break;
+		}
+		ret = idesc_splice(out, in, len - done);
+		if (ret <= 0) {
+			break;
+		}
+	}
+
+	if (off_out) {
+		*off_out += done;
+		lseek(fd_out, out_pos, SEEK_SET);
+	}
+
+out_restore:
+	if (off_in) {
+		*off_in += done;
+		lseek(fd_in, in_pos, SEEK_SET);
+	}
+
+	if ((done == 0) && (ret < 0)) {
+		return SET_ERRNO(-ret);
+	}
+
+	return done;
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+	struct idesc *in, *out;
+	off_t in_pos;
+	ssize_t ret;
+	size_t done;
+
+	in = splice_idesc_get(in_fd, O_WRONLY);
+	out = splice_idesc_get(out_fd, O_RDONLY);
+	if ((in == NULL) || (out == NULL)) {
+		return SET_ERRNO(EBADF);
+	}
+
+	in_pos = 0;
+	if (offset && (-1 == (in_pos = splice_seek(in_fd, *offset)))) {
+		return -1;
+	}
+
+	ret = 0;
+	for (done = 0; done < count; done += ret) {
+		ret = idesc_splice(out, in, count - done);
+		if (ret <= 0) {
+			break;
+		}
+	}
+
+	if (offset) {
+		*offset += done;
+		lseek(in_fd, in_pos, SEEK_SET);
+	}
+
+	if ((done == 0) && (ret < 0)) {
+		return SET_ERRNO(-ret);
+	}
+
+	return done;
+}
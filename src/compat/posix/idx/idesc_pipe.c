@@ -116,18 +116,19 @@ static int pipe_wait(struct idesc *idesc, struct pipe *pipe, int flags) {
 static ssize_t pipe_read(struct idesc *idesc, const struct iovec *iov, int cnt) {
 	struct pipe *pipe;
 	ssize_t res;
-	void *buf;
 	size_t nbyte;
+	int i, len;
 
-	assert(iov);
-	buf = iov->iov_base;
-	assert(cnt == 1);
-	nbyte = iov->iov_len;
-	assert(buf);
+	assert(iov || !cnt);
 	assert(idesc);
 	assert(idesc->idesc_ops == &idesc_pipe_ops);
 	assert((idesc->idesc_flags & O_ACCESS_MASK) != O_WRONLY);
 
+	nbyte = 0;
+	for (i = 0; i < cnt; i++) {
+		nbyte += iov[i].iov_len;
+	}
+
 	if (!nbyte) {
 		return 0;
 	}
@@ -135,7 +136,15 @@ static ssize_t pipe_read(struct idesc *idesc, const struct iovec *iov, int cnt)
 	pipe = idesc_to_pipe(idesc);
 	mutex_lock(&pipe->mutex);
 	do {
-		res = ring_buff_dequeue(pipe->buff, buf, nbyte);
+		res = 0;
+		for (i = 0; i < cnt; i++) {
+			len = ring_buff_dequeue(pipe->buff, iov[i].iov_base,
+					iov[i].iov_len);
+			res += len;
+			if (len < iov[i].iov_len) {
+				break;
+			}
+		}
 
 		if (idesc_pipe_isclosed(&pipe->write_desc)) {
 			/* Nothing to do, what's read, that's read */
@@ -160,19 +169,19 @@ static ssize_t pipe_write(struct idesc *idesc, const struct iovec *iov, int cnt)
 	size_t nbyte;
 	struct pipe *pipe;
 	const void *cbuf;
-	int len;
-	ssize_t res;
+	int len, i;
+	ssize_t res, written;
 
-	assert(iov);
-	assert(iov->iov_base);
-	assert(cnt == 1);
+	assert(iov || !cnt);
 	assert(idesc);
 	assert(idesc->idesc_ops == &idesc_pipe_ops);
 	assert((idesc->idesc_flags & O_ACCESS_MASK) != O_RDONLY);
 
-	cbuf = iov->iov_base;
-	nbyte = iov->iov_len;
 	/* nbyte == 0 is ok to passthrough */
+	i = 0;
+	cbuf = cnt ? iov[0].iov_base : NULL;
+	nbyte = cnt ? iov[0].iov_len : 0;
+	written = 0;
 
 	pipe = idesc_to_pipe(idesc);
 	mutex_lock(&pipe->mutex);
@@ -190,13 +199,22 @@ static ssize_t pipe_write(struct idesc *idesc, const struct iovec *iov, int cnt)
  			 * (read end can't be closed) */
 			cbuf += len;
 			nbyte -= len;
+			written += len;
 
 			idesc_notify(&pipe->read_desc.idesc, POLLIN);
 		}
 
+		if (!nbyte && (++i < cnt)) {
+			/* Go to the next buffer without waiting */
+			cbuf = iov[i].iov_base;
+			nbyte = iov[i].iov_len;
+			res = 0;
+			continue;
+		}
+
 		/* Have nothing to write, exit*/
 		if (!nbyte) {
-			res = cbuf - iov->iov_base;
+			res = written;
 			break;
 		}
 
@@ -269,7 +287,7 @@ static const struct idesc_ops idesc_pipe_ops = {
 		.id_writev = pipe_write,
 		.close = pipe_close,
 		.ioctl = pipe_fcntl,
-		.status = idesc_pipe_status
+		.status = idesc_pipe_status,
 		/*.fcntl = pipe_fcntl,*/
 };
 
@@ -29,6 +29,17 @@ extern int creat(const char *pathname, mode_t mode);
 
 extern int fcntl(int fd, int cmd, ...);
 
+/* Move data between descriptors without copying it through user buffer,
+ * not POSIX */
+extern ssize_t splice(int fd_in, loff_t *off_in, int fd_out,
+		loff_t *off_out, size_t len, unsigned int flags);
+
+/* splice flags, accepted but ignored */
+#define SPLICE_F_MOVE      0x01
+#define SPLICE_F_NONBLOCK  0x02
+#define SPLICE_F_MORE      0x04
+#define SPLICE_F_GIFT      0x08
+
 /* fcntl commands */
 #define F_GETFD            0
 #define F_SETFD            1
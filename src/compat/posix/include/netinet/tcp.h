@@ -12,6 +12,14 @@
 #define NETINET_TCP_H_
 
 /* Options specific for tcp socket */
-#define TCP_NODELAY 0
+#define TCP_NODELAY        0  /* Disable Nagle algorithm */
+#define TCP_QUICKACK      12  /* Disable delayed acknowledgments */
+#define TCP_CONGESTION    13  /* Name of congestion control algorithm */
+
+/* Embox specific options, take effect on the next connection setup */
+#define TCP_WINDOW_SCALING 0x1001 /* Offer window scale option (RFC 7323) */
+#define TCP_SACK           0x1002 /* Offer SACK permission option (RFC 2018) */
+
+#define TCP_CA_NAME_MAX   16
 
 #endif /* NETINET_TCP_H_ */
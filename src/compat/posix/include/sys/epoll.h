@@ -0,0 +1,55 @@
+/**
+ * @file
+ * @brief I/O event notification facility
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef SYS_EPOLL_H_
+#define SYS_EPOLL_H_
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <sys/cdefs.h>
+
+#define EPOLLIN      POLLIN
+#define EPOLLPRI     POLLPRI
+#define EPOLLOUT     POLLOUT
+#define EPOLLERR     POLLERR
+#define EPOLLHUP     POLLHUP
+#define EPOLLRDNORM  POLLRDNORM
+#define EPOLLWRNORM  POLLWRNORM
+#define EPOLLONESHOT (1u << 30)
+#define EPOLLET      (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+typedef union epoll_data {
+	void *ptr;
+	int fd;
+	uint32_t u32;
+	uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+	uint32_t events;    /* Epoll events */
+	epoll_data_t data;  /* User data variable */
+};
+
+__BEGIN_DECLS
+
+extern int epoll_create(int size);
+extern int epoll_create1(int flags);
+extern int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+extern int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		int timeout);
+
+__END_DECLS
+
+#endif /* SYS_EPOLL_H_ */
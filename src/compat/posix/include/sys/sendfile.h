@@ -0,0 +1,25 @@
+/**
+ * @file
+ * @brief Transfer data between file descriptors
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef SYS_SENDFILE_H_
+#define SYS_SENDFILE_H_
+
+#include <sys/types.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/**
+ * Copy @a count bytes from @a in_fd to @a out_fd. If @a offset isn't NULL
+ * reading starts at *offset which is updated on return and the file
+ * position of @a in_fd is left unchanged.
+ */
+extern ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+__END_DECLS
+
+#endif /* SYS_SENDFILE_H_ */
@@ -316,6 +316,13 @@ __BEGIN_DECLS
  */
 extern int socket(int domain, int type, int protocol);
 
+/**
+ * create a pair of connected sockets.
+ * @param sv descriptors of created sockets
+ * @return 0 on success. -1 on failure with errno indicating error.
+ */
+extern int socketpair(int domain, int type, int protocol, int sv[2]);
+
 /**
  * bind a socket to an address.
  * @param sockfd socket file descriptor
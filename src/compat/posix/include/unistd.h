@@ -168,6 +168,10 @@ extern int close(int fd);
 
 extern int fsync(int);
 
+extern int fdatasync(int);
+
+extern void sync(void);
+
 extern pid_t fork(void);
 extern pid_t vfork(void);
 
@@ -297,9 +301,6 @@ extern int chown(const char *path, uid_t owner, gid_t group);
 /*******************************************
  * stubs
  *******************************************/
-static inline void sync(void) {
-}
-
 
 extern unsigned alarm(unsigned seconds);
 
@@ -13,6 +13,7 @@
 #include <stddef.h>
 #include <sys/uio.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 #include <net/socket/ksocket.h>
 #include <net/sock.h>
@@ -70,6 +71,40 @@ int socket(int domain, int type, int protocol) {
 #endif
 	return sockfd;
 }
+/* create */
+int socketpair(int domain, int type, int protocol, int sv[2]) {
+	struct sock *sk[2];
+	int ret;
+
+	if (sv == NULL) {
+		return SET_ERRNO(EFAULT);
+	}
+
+	ret = ksocketpair(domain, type, protocol, sk);
+	if (ret < 0) {
+		return SET_ERRNO(-ret);
+	}
+
+	sv[0] = get_index(sk[0]);
+	if (sv[0] < 0) {
+		ksocket_close(sk[0]);
+		ksocket_close(sk[1]);
+		return SET_ERRNO(EMFILE);
+	}
+
+	sv[1] = get_index(sk[1]);
+	if (sv[1] < 0) {
+		close(sv[0]);
+		ksocket_close(sk[1]);
+		return SET_ERRNO(EMFILE);
+	}
+#if defined(NET_NAMESPACE_ENABLED) && (NET_NAMESPACE_ENABLED == 1)
+	assign_net_ns(sk[0]->net_ns, get_net_ns());
+	assign_net_ns(sk[1]->net_ns, get_net_ns());
+#endif
+	return 0;
+}
+
 /* fcntl */
 int bind(int sockfd, const struct sockaddr *addr,
 		socklen_t addrlen) {
@@ -370,6 +405,7 @@ ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
 
 	msg->msg_name = msg_.msg_name;
 	msg->msg_namelen = msg_.msg_namelen;
+	msg->msg_controllen = msg_.msg_controllen;
 	msg->msg_flags = msg_.msg_flags;
 
 	return ret;
@@ -84,6 +84,19 @@ static ssize_t socket_write(struct idesc *desc, const struct iovec *iov, int cnt
 	return ret_size;
 }
 
+static ssize_t socket_splice_write(struct idesc *desc, struct idesc *in,
+		size_t len) {
+	struct sock *sk = (struct sock *)desc;
+
+	assert(desc);
+	assert(desc->idesc_ops == &task_idx_ops_socket);
+
+	if (sk->shutdown_flag & (SHUT_WR + 1))
+		return -EPIPE;
+
+	return ksplice_write(sk, in, len);
+}
+
 static int socket_ioctl(struct idesc *idesc, int request, void *data) {
 	struct sock *sk = (struct sock *) idesc;
 
@@ -152,5 +165,6 @@ const struct idesc_ops task_idx_ops_socket = {
 	.ioctl  = socket_ioctl,
 	.status = socket_status,
 	.close  = socket_close,
+	.id_splice_write = socket_splice_write,
 };
 
@@ -0,0 +1,599 @@
+/**
+ * @file
+ * @brief I/O event notification facility
+ *
+ * @details Each epoll instance keeps an interest set hashed by descriptor
+ *   number and a ready list. Watched descriptors get a persistent
+ *   idesc_watch, so idesc_notify() called by driver or socket pushes the
+ *   item to the ready list. epoll_wait() only looks at the ready list, hence
+ *   its cost depends on amount of ready descriptors, not on the size of
+ *   interest set. Level-triggered items which are still ready are put back
+ *   to the ready list and checked again on the next call.
+ *
+ * @date 18.10.2026
+ */
+
+#include <sys/epoll.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+
+#include <framework/mod/options.h>
+#include <hal/clock.h>
+#include <kernel/spinlock.h>
+#include <kernel/task.h>
+#include <kernel/task/resource/idesc.h>
+#include <kernel/task/resource/idesc_event.h>
+#include <kernel/task/resource/idesc_table.h>
+#include <kernel/task/resource/index_descriptor.h>
+#include <kernel/thread/sync/mutex.h>
+#include <kernel/thread/waitq.h>
+#include <kernel/time/time.h>
+#include <mem/misc/pool.h>
+#include <util/dlist.h>
+#include <util/member.h>
+
+#define EPOLL_MAX_INSTANCES OPTION_GET(NUMBER, max_instances)
+#define EPOLL_MAX_ITEMS     OPTION_GET(NUMBER, max_items)
+#define EPOLL_HASH_SIZE     OPTION_GET(NUMBER, hash_size)
+
+#define EPOLL_PRIVATE_BITS  (EPOLLONESHOT | EPOLLET)
+
+#define EPOLL_MAX_NESTS     4 /* Length of epoll chains, as in Linux */
+
+struct eventpoll {
+	struct idesc idesc;
+	struct mutex mutex;            /* Serializes ctl, wait and close */
+	spinlock_t lock;               /* Protects lists below, taken from notify */
+	struct idesc_notify_defer wake; /* POLLIN for watchers of this epoll */
+	struct dlist_head rdy_list;
+	struct dlist_head dead_list;   /* Items of closed descriptors */
+	struct dlist_head hash[EPOLL_HASH_SIZE];
+};
+
+struct epitem {
+	struct idesc_watch watch;
+	struct dlist_head hash_lnk;
+	struct dlist_head rdy_lnk;     /* Link for rdy_list, dead_list or scan list */
+	struct eventpoll *ep;
+	struct idesc *idesc;
+	int fd;
+	uint32_t events;
+	epoll_data_t data;
+	int revents;                   /* Result of the last scan, -1 if skipped */
+	unsigned int notified : 1;     /* Notify arrived during the scan */
+	unsigned int scanning : 1;
+	unsigned int dead : 1;
+};
+
+POOL_DEF(eventpoll_pool, struct eventpoll, EPOLL_MAX_INSTANCES);
+POOL_DEF(epitem_pool, struct epitem, EPOLL_MAX_ITEMS);
+
+static spinlock_t epoll_pool_lock = SPIN_STATIC_UNLOCKED;
+
+/* Serializes adding of epoll descriptors, so no loop appears meanwhile */
+static struct mutex epoll_nest_mutex = MUTEX_INIT_STATIC;
+
+static const struct idesc_ops idesc_epoll_ops;
+
+static void *epoll_pool_alloc(struct pool *pl) {
+	void *obj;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&epoll_pool_lock);
+	obj = pool_alloc(pl);
+	spin_unlock_ipl(&epoll_pool_lock, ipl);
+
+	return obj;
+}
+
+static void epoll_pool_free(struct pool *pl, void *obj) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&epoll_pool_lock);
+	pool_free(pl, obj);
+	spin_unlock_ipl(&epoll_pool_lock, ipl);
+}
+
+static inline struct dlist_head *ep_bucket(struct eventpoll *ep, int fd) {
+	return &ep->hash[(unsigned int) fd % EPOLL_HASH_SIZE];
+}
+
+static struct epitem *ep_find(struct eventpoll *ep, int fd,
+		struct idesc *idesc) {
+	struct epitem *item;
+
+	dlist_foreach_entry(item, ep_bucket(ep, fd), hash_lnk) {
+		if (item->fd == fd && item->idesc == idesc) {
+			return item;
+		}
+	}
+
+	return NULL;
+}
+
+/* Must be called with ep->lock held */
+static int ep_queue(struct eventpoll *ep, struct epitem *item) {
+	if (item->scanning) {
+		item->notified = 1;
+		return 0;
+	}
+
+	if (!dlist_empty(&item->rdy_lnk)
+			|| !(item->events & ~EPOLL_PRIVATE_BITS)) {
+		return 0;
+	}
+
+	dlist_add_prev(&item->rdy_lnk, &ep->rdy_list);
+	return 1;
+}
+
+/* Must be called with ep->lock held */
+static void ep_unlink(struct eventpoll *ep, struct epitem *item) {
+	item->dead = 1;
+	dlist_del_init(&item->hash_lnk);
+	if (!item->scanning) {
+		dlist_del_init(&item->rdy_lnk);
+	}
+}
+
+/* Free items of closed descriptors. Must be called with ep->mutex held */
+static void ep_reap(struct eventpoll *ep) {
+	struct epitem *item;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	dlist_foreach_entry(item, &ep->dead_list, rdy_lnk) {
+		dlist_del_init(&item->rdy_lnk);
+		epoll_pool_free(&epitem_pool, item);
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+}
+
+/* Called from idesc_notify() with watched idesc lock held */
+static void ep_watch_notify(struct idesc_watch *watch, int mask,
+		struct dlist_head *defer) {
+	struct epitem *item;
+	struct eventpoll *ep;
+	int wake = 0;
+	ipl_t ipl;
+
+	item = member_cast_out(watch, struct epitem, watch);
+	ep = item->ep;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	if (item->dead) {
+		/* Removed by epoll_ctl(), it will free the item itself */
+	} else if (mask == POLLNVAL) {
+		/* Descriptor is closed, watch is already unlinked */
+		ep_unlink(ep, item);
+		if (!item->scanning) {
+			dlist_add_prev(&item->rdy_lnk, &ep->dead_list);
+		}
+	} else if (!mask || (mask & (item->events | EPOLLERR | EPOLLHUP))) {
+		wake = ep_queue(ep, item);
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	if (wake) {
+		/* Watchers of this epoll take their own locks */
+		idesc_notify_defer(&ep->wake, defer);
+	}
+}
+
+static int ep_item_poll(struct epitem *item) {
+	struct idesc *idesc = item->idesc;
+	int revents = 0;
+
+	assert(idesc->idesc_ops->status);
+
+	if ((item->events & EPOLLIN)
+			&& (idesc->idesc_flags & O_ACCESS_MASK) != O_WRONLY
+			&& idesc->idesc_ops->status(idesc, POLLIN)) {
+		revents |= EPOLLIN;
+	}
+	if ((item->events & EPOLLOUT)
+			&& (idesc->idesc_flags & O_ACCESS_MASK) != O_RDONLY
+			&& idesc->idesc_ops->status(idesc, POLLOUT)) {
+		revents |= EPOLLOUT;
+	}
+	/* Errors are reported even if they were not asked for */
+	if (idesc->idesc_ops->status(idesc, POLLERR)) {
+		revents |= EPOLLERR;
+	}
+
+	return revents;
+}
+
+/* Must be called with ep->mutex held */
+static int ep_scan(struct eventpoll *ep, struct epoll_event *events,
+		int maxevents) {
+	DLIST_DEFINE(scan_list);
+	struct epitem *item;
+	int cnt = 0;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	dlist_foreach_entry(item, &ep->rdy_list, rdy_lnk) {
+		dlist_del_init(&item->rdy_lnk);
+		dlist_add_prev(&item->rdy_lnk, &scan_list);
+		item->scanning = 1;
+		item->notified = 0;
+		item->revents = -1;
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	dlist_foreach_entry(item, &scan_list, rdy_lnk) {
+		if (cnt == maxevents) {
+			break;
+		}
+		if (item->dead) {
+			continue;
+		}
+
+		item->revents = ep_item_poll(item);
+		if (item->revents) {
+			events[cnt].events = item->revents;
+			events[cnt].data = item->data;
+			cnt++;
+
+			if (item->events & EPOLLONESHOT) {
+				item->events &= EPOLL_PRIVATE_BITS;
+			}
+		}
+	}
+
+	ipl = spin_lock_ipl(&ep->lock);
+	dlist_foreach_entry(item, &scan_list, rdy_lnk) {
+		dlist_del_init(&item->rdy_lnk);
+		item->scanning = 0;
+
+		if (item->dead) {
+			dlist_add_prev(&item->rdy_lnk, &ep->dead_list);
+			continue;
+		}
+
+		if (item->notified || item->revents == -1
+				|| (item->revents && !(item->events & EPOLLET))) {
+			ep_queue(ep, item);
+		}
+	}
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	return cnt;
+}
+
+static struct eventpoll *epoll_get(int epfd) {
+	struct idesc *idesc;
+
+	if (!idesc_index_valid(epfd)) {
+		return NULL;
+	}
+
+	idesc = index_descriptor_get(epfd);
+	if (idesc == NULL || idesc->idesc_ops != &idesc_epoll_ops) {
+		return NULL;
+	}
+
+	return (struct eventpoll *) idesc;
+}
+
+static int epoll_status(struct idesc *idesc, int mask) {
+	struct eventpoll *ep = (struct eventpoll *) idesc;
+
+	assert(idesc->idesc_ops == &idesc_epoll_ops);
+
+	if (mask & POLLIN) {
+		return !dlist_empty(&ep->rdy_list);
+	}
+
+	return 0;
+}
+
+static void epoll_close(struct idesc *idesc) {
+	struct eventpoll *ep = (struct eventpoll *) idesc;
+	struct epitem *item;
+	ipl_t ipl;
+	int i;
+
+	assert(idesc->idesc_ops == &idesc_epoll_ops);
+
+	mutex_lock(&ep->mutex);
+	for (i = 0; i < EPOLL_HASH_SIZE; i++) {
+		dlist_foreach_entry(item, &ep->hash[i], hash_lnk) {
+			ipl = spin_lock_ipl(&ep->lock);
+			ep_unlink(ep, item);
+			spin_unlock_ipl(&ep->lock, ipl);
+
+			idesc_watch_del(item->idesc, &item->watch);
+			epoll_pool_free(&epitem_pool, item);
+		}
+	}
+	ep_reap(ep);
+	mutex_unlock(&ep->mutex);
+
+	/* Watched descriptor may be sending our deferred notify */
+	idesc_notify_defer_wait(&ep->wake);
+
+	epoll_pool_free(&eventpoll_pool, ep);
+}
+
+static const struct idesc_ops idesc_epoll_ops = {
+	.close  = epoll_close,
+	.status = epoll_status,
+};
+
+int epoll_create1(int flags) {
+	struct idesc_table *it;
+	struct eventpoll *ep;
+	int fd;
+	int i;
+
+	if (flags & ~EPOLL_CLOEXEC) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	it = task_resource_idesc_table(task_self());
+	assert(it);
+
+	ep = epoll_pool_alloc(&eventpoll_pool);
+	if (ep == NULL) {
+		return SET_ERRNO(ENOMEM);
+	}
+
+	idesc_init(&ep->idesc, &idesc_epoll_ops, O_RDONLY);
+	mutex_init(&ep->mutex);
+	ep->lock = SPIN_UNLOCKED;
+	idesc_notify_defer_init(&ep->wake, &ep->idesc, POLLIN);
+	dlist_init(&ep->rdy_list);
+	dlist_init(&ep->dead_list);
+	for (i = 0; i < EPOLL_HASH_SIZE; i++) {
+		dlist_init(&ep->hash[i]);
+	}
+
+	fd = idesc_table_add(it, &ep->idesc, flags & EPOLL_CLOEXEC);
+	if (fd < 0) {
+		epoll_pool_free(&eventpoll_pool, ep);
+		return SET_ERRNO(EMFILE);
+	}
+
+	return fd;
+}
+
+int epoll_create(int size) {
+	if (size <= 0) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	return epoll_create1(0);
+}
+
+/*
+ * Checks that @a ep isn't reachable from epoll @a target and chains are not
+ * too long. Must be called with epoll_nest_mutex held.
+ */
+static int ep_check_loop(struct eventpoll *ep, struct eventpoll *target,
+		int depth) {
+	struct epitem *item;
+	int res = 0;
+	ipl_t ipl;
+	int i;
+
+	if (target == ep || depth >= EPOLL_MAX_NESTS) {
+		return -ELOOP;
+	}
+
+	ipl = spin_lock_ipl(&target->lock);
+	for (i = 0; i < EPOLL_HASH_SIZE && !res; i++) {
+		dlist_foreach_entry(item, &target->hash[i], hash_lnk) {
+			if (item->idesc->idesc_ops != &idesc_epoll_ops) {
+				continue;
+			}
+			res = ep_check_loop(ep, (struct eventpoll *) item->idesc,
+					depth + 1);
+			if (res) {
+				break;
+			}
+		}
+	}
+	spin_unlock_ipl(&target->lock, ipl);
+
+	return res;
+}
+
+static int ep_insert(struct eventpoll *ep, int fd, struct idesc *idesc,
+		struct epoll_event *event) {
+	struct epitem *item;
+	int wake;
+	ipl_t ipl;
+
+	item = epoll_pool_alloc(&epitem_pool);
+	if (item == NULL) {
+		return -ENOMEM;
+	}
+
+	idesc_watch_init(&item->watch, ep_watch_notify);
+	dlist_head_init(&item->hash_lnk);
+	dlist_head_init(&item->rdy_lnk);
+	item->ep = ep;
+	item->idesc = idesc;
+	item->fd = fd;
+	item->events = event->events;
+	item->data = event->data;
+	item->notified = 0;
+	item->scanning = 0;
+	item->dead = 0;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	dlist_add_prev(&item->hash_lnk, ep_bucket(ep, fd));
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	idesc_watch_add(idesc, &item->watch);
+
+	/* Descriptor may be ready already, let the scan check it */
+	ipl = spin_lock_ipl(&ep->lock);
+	wake = ep_queue(ep, item);
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	if (wake) {
+		idesc_notify(&ep->idesc, POLLIN);
+	}
+
+	return 0;
+}
+
+static int ep_modify(struct eventpoll *ep, struct epitem *item,
+		struct epoll_event *event) {
+	int wake;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	item->events = event->events;
+	item->data = event->data;
+	wake = ep_queue(ep, item);
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	if (wake) {
+		idesc_notify(&ep->idesc, POLLIN);
+	}
+
+	return 0;
+}
+
+static int ep_remove(struct eventpoll *ep, struct epitem *item) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&ep->lock);
+	ep_unlink(ep, item);
+	spin_unlock_ipl(&ep->lock, ipl);
+
+	idesc_watch_del(item->idesc, &item->watch);
+	epoll_pool_free(&epitem_pool, item);
+
+	return 0;
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+	struct eventpoll *ep;
+	struct idesc *idesc;
+	struct epitem *item;
+	int nest;
+	int res;
+
+	if (NULL == (ep = epoll_get(epfd))) {
+		return SET_ERRNO(idesc_index_valid(epfd)
+				&& index_descriptor_get(epfd) ? EINVAL : EBADF);
+	}
+
+	if (!idesc_index_valid(fd)
+			|| NULL == (idesc = index_descriptor_get(fd))) {
+		return SET_ERRNO(EBADF);
+	}
+
+	if (idesc == &ep->idesc) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	if (!idesc->idesc_ops->status) {
+		return SET_ERRNO(EPERM);
+	}
+
+	if (op != EPOLL_CTL_DEL && event == NULL) {
+		return SET_ERRNO(EFAULT);
+	}
+
+	nest = (op == EPOLL_CTL_ADD && idesc->idesc_ops == &idesc_epoll_ops);
+	if (nest) {
+		mutex_lock(&epoll_nest_mutex);
+		res = ep_check_loop(ep, (struct eventpoll *) idesc, 0);
+		if (res) {
+			mutex_unlock(&epoll_nest_mutex);
+			return SET_ERRNO(-res);
+		}
+	}
+
+	mutex_lock(&ep->mutex);
+
+	ep_reap(ep);
+	item = ep_find(ep, fd, idesc);
+
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		res = item ? -EEXIST : ep_insert(ep, fd, idesc, event);
+		break;
+	case EPOLL_CTL_MOD:
+		res = item ? ep_modify(ep, item, event) : -ENOENT;
+		break;
+	case EPOLL_CTL_DEL:
+		res = item ? ep_remove(ep, item) : -ENOENT;
+		break;
+	default:
+		res = -EINVAL;
+		break;
+	}
+
+	mutex_unlock(&ep->mutex);
+
+	if (nest) {
+		mutex_unlock(&epoll_nest_mutex);
+	}
+
+	if (res < 0) {
+		return SET_ERRNO(-res);
+	}
+
+	return 0;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		int timeout) {
+	struct eventpoll *ep;
+	clock_t deadline;
+	int cnt;
+	int res;
+
+	if (NULL == (ep = epoll_get(epfd))) {
+		return SET_ERRNO(idesc_index_valid(epfd)
+				&& index_descriptor_get(epfd) ? EINVAL : EBADF);
+	}
+
+	if (maxevents <= 0 || events == NULL) {
+		return SET_ERRNO(EINVAL);
+	}
+
+	deadline = clock_sys_ticks() + ms2jiffies(timeout > 0 ? timeout : 0);
+
+	while (1) {
+		mutex_lock(&ep->mutex);
+		cnt = ep_scan(ep, events, maxevents);
+		ep_reap(ep);
+		mutex_unlock(&ep->mutex);
+
+		if (cnt || timeout == 0) {
+			return cnt;
+		}
+
+		if (timeout > 0) {
+			long remain = (long) (deadline - clock_sys_ticks());
+
+			if (remain <= 0) {
+				return 0;
+			}
+			timeout = jiffies2ms(remain);
+			if (timeout == 0) {
+				timeout = 1;
+			}
+		}
+
+		res = WAITQ_WAIT_TIMEOUT(&ep->idesc.idesc_waitq,
+				!dlist_empty(&ep->rdy_list),
+				timeout < 0 ? SCHED_TIMEOUT_INFINITE : timeout);
+		if (res == -ETIMEDOUT) {
+			return 0;
+		} else if (res) {
+			return SET_ERRNO(-res);
+		}
+	}
+}
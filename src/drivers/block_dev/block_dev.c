@@ -22,8 +22,11 @@
 #include <util/math.h>
 
 extern struct idesc_ops idesc_bdev_ops;
+extern void block_dev_queue_init(struct block_dev *bdev);
+extern void block_dev_queue_fini(struct block_dev *bdev);
 
 #define DEFAULT_BDEV_BLOCK_SIZE OPTION_GET(NUMBER, default_block_size)
+#define BDEV_READ_BATCH         OPTION_GET(NUMBER, read_batch)
 
 ARRAY_SPREAD_DEF(const struct block_dev_module, __block_dev_registry);
 POOL_DEF(cache_pool, struct block_dev_cache, MAX_BDEV_QUANTITY);
@@ -125,38 +128,74 @@ struct block_dev *block_dev(void *dev) {
 }
 
 int block_dev_read_buffered(struct block_dev *bdev, char *buffer, size_t count, size_t offset) {
-	size_t blksize;
-	int blkno, cplen, cursor, res, i;
-	struct buffer_head *bh;
+	struct buffer_head *bhs[BDEV_READ_BATCH];
+	struct bio bios[BDEV_READ_BATCH];
+	size_t blksize, off, cplen;
+	int blkno, last, cursor, res, i, n, nbios, batch;
 
 	assert(bdev);
 	assert(bdev->driver);
 
-	if (NULL == bdev->driver->read) {
+	if (NULL == bdev->driver->read && NULL == bdev->driver->request) {
 		return -ENOSYS;
 	}
 	if (offset + count > bdev->size) {
 		return -EIO;
 	}
+	if (count == 0) {
+		return 0;
+	}
 	blksize = block_dev_block_size(bdev);
-	blkno = offset / blksize;
-	cplen = min(count, blksize - offset % blksize);
+	last = (offset + count - 1) / blksize;
+	cursor = 0;
+	/* All buffers of a batch are locked together */
+	batch = min(BDEV_READ_BATCH, bcache_lock_max());
+
+	/* Missed blocks of a batch are read by adjacent bios which are merged
+	 * into a few requests instead of a driver call per block */
+	for (blkno = offset / blksize; blkno <= last; blkno += n) {
+		n = min(last - blkno + 1, batch);
+
+		for (i = 0, nbios = 0; i < n; i++) {
+			bhs[i] = bcache_getblk_locked(bdev, blkno + i, blksize);
+			if (buffer_new(bhs[i])) {
+				bios[nbios++] = (struct bio) {
+					.bdev = bdev,
+					.dir = BIO_READ,
+					.blkno = blkno + i,
+					.buf = bhs[i]->data,
+					.count = blksize,
+				};
+			}
+		}
 
-	for (cursor = 0, i = 0; count != 0;
-			i++, count -= cplen, cursor += cplen, cplen = min(count, blksize)) {
-		bh = bcache_getblk_locked(bdev, blkno + i, blksize);
-		{
-			if (buffer_new(bh)) {
-				if (blksize != (res = bdev->driver->read(bdev, bh->data, blksize, blkno + i))
-						|| 0 != (res = buffer_decrypt(bh))) {
-					bcache_buffer_unlock(bh);
-					return res;
+		res = block_dev_submit_wait(bios, nbios);
+
+		for (i = 0; i < n && res == 0; i++) {
+			if (buffer_new(bhs[i])) {
+				if (0 != (res = buffer_decrypt(bhs[i]))) {
+					break;
 				}
-				buffer_clear_flag(bh, BH_NEW);
+				buffer_clear_flag(bhs[i], BH_NEW);
 			}
-			memcpy(buffer + cursor, bh->data + (i == 0 ? offset % blksize : 0), cplen);
+
+			off = (cursor == 0) ? offset % blksize : 0;
+			cplen = min(count - cursor, blksize - off);
+			memcpy(buffer + cursor, bhs[i]->data + off, cplen);
+			cursor += cplen;
+		}
+
+		for (i = 0; i < n; i++) {
+			bcache_buffer_unlock(bhs[i]);
+		}
+
+		if (res != 0) {
+			return res;
+		}
+
+		if (nbios != 0) {
+			bcache_readahead(bdev, blkno + n - 1, blksize);
 		}
-		bcache_buffer_unlock(bh);
 	}
 
 	return cursor;
@@ -169,7 +208,7 @@ int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t
 
 	assert(bdev);
 
-	if (NULL == bdev->driver->write) {
+	if (NULL == bdev->driver->write && NULL == bdev->driver->request) {
 		return -ENOSYS;
 	}
 	if (offset + count > bdev->size) {
@@ -186,7 +225,7 @@ int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t
 		{
 			if (buffer_new(bh)) {
 				if (cplen < blksize) {
-					if (blksize != (res = bdev->driver->read(bdev, bh->data, blksize, blkno + i))
+					if (blksize != (res = block_dev_rw(bdev, BIO_READ, bh->data, blksize, blkno + i))
 							|| 0 != (res = buffer_decrypt(bh))) {
 						bcache_buffer_unlock(bh);
 						return res;
@@ -195,18 +234,10 @@ int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t
 				buffer_clear_flag(bh, BH_NEW);
 			}
 			memcpy(bh->data + (i == 0 ? offset % blksize : 0), buffer + cursor, cplen);
-			/**
-			 * Blocks are stored in the buffer cache in a decrypted state.
-			 * Therefore first we encrypt block, then write it onto disk and then decrypt block.
-			 */
-			buffer_encrypt(bh);
-			if (blksize != (res = bdev->driver->write(bdev, bh->data,
-					blksize, blkno + i))) {
-				buffer_decrypt(bh);
+			if (0 != (res = bcache_mark_dirty(bh))) {
 				bcache_buffer_unlock(bh);
 				return res;
 			}
-			buffer_decrypt(bh);
 		}
 		bcache_buffer_unlock(bh);
 	}
@@ -237,6 +268,30 @@ int block_dev_read(void *dev, char *buffer, size_t count, blkno_t blkno) {
 	return block_dev_read_buffered(bdev, buffer, count, blkno * blksize);
 }
 
+void block_dev_readahead(void *dev, size_t count, blkno_t blkno) {
+	struct block_dev *bdev;
+	size_t blksize;
+
+	if (NULL == dev) {
+		return;
+	}
+	bdev = block_dev(dev);
+
+	if (blkno >= bdev->size / bdev->block_size) {
+		return;
+	}
+	count = min(count, bdev->size - blkno * bdev->block_size);
+
+	if (bdev->parent_bdev != NULL) {
+		blkno += bdev->start_offset;
+		bdev = bdev->parent_bdev;
+	}
+
+	blksize = block_dev_block_size(bdev);
+
+	bcache_prefetch(bdev, blkno, (count + blksize - 1) / blksize, blksize);
+}
+
 int block_dev_write(void *dev, const char *buffer, size_t count, blkno_t blkno) {
 	struct block_dev *bdev;
 	size_t blksize;
@@ -416,6 +471,7 @@ struct block_dev *block_dev_create(const char *path, const struct block_dev_ops
 		.driver = driver,
 		.block_size = DEFAULT_BDEV_BLOCK_SIZE,
 	};
+	block_dev_queue_init(bdev);
 
 	devmod = dev_module_init(&bdev->dev_module, basename((char *)path), NULL, NULL, &idesc_bdev_ops, privdata);
 	devmod->dev_id = DEVID_BDEV | bdev_id;
@@ -430,6 +486,9 @@ int block_dev_destroy(struct block_dev *dev) {
 		}
 	}
 
+	bcache_invalidate(dev);
+	block_dev_queue_fini(dev);
+
 	dev_module_deinit(&dev->dev_module);
 
 	block_dev_free(dev);
@@ -12,9 +12,12 @@
 #include <limits.h>
 #include <sys/types.h>
 
+#include <util/dlist.h>
 #include <util/member.h>
 
 #include <drivers/device.h>
+#include <kernel/spinlock.h>
+#include <kernel/time/timer.h>
 
 #include <framework/mod/options.h>
 #include <config/embox/driver/block_dev.h>
@@ -27,6 +30,67 @@
 #define IOCTL_GETGEOMETRY       3
 #define IOCTL_REVALIDATE        4
 
+#define BIO_READ  0
+#define BIO_WRITE 1
+
+struct bio;
+typedef void (*bio_end_io_t)(struct bio *bio);
+
+/**
+ * Block I/O: transfer of contiguous blocks of a device to or from a buffer
+ */
+struct bio {
+	struct block_dev *bdev;
+	int dir;              /* BIO_READ or BIO_WRITE */
+	blkno_t blkno;        /* First block */
+	char *buf;
+	size_t count;         /* Bytes, multiple of block size */
+
+	int error;            /* Result, set before end_io is called */
+	bio_end_io_t end_io;  /* Called on completion, maybe in interrupt */
+	void *private;
+
+	struct bio *next;     /* Next bio of the same request */
+};
+
+/**
+ * Adjacent bios of one direction merged to be passed to a driver at once
+ */
+struct block_dev_request {
+	struct dlist_head sort_lnk; /* In queue sorted by block */
+	struct dlist_head fifo_lnk; /* In queue of the same direction by age */
+	int dir;
+	blkno_t blkno;
+	size_t count;
+	clock_t deadline;
+	struct bio *bio;
+	struct bio *bio_tail;
+};
+
+struct block_dev_queue_stats {
+	unsigned long bios;       /* bios submitted */
+	unsigned long merges;     /* bios merged into existing requests */
+	unsigned long dispatched; /* requests passed to the driver */
+	unsigned long expired;    /* requests dispatched by deadline */
+};
+
+/**
+ * Pending requests of a device. Requests are dispatched in the order of
+ * blocks (one-way elevator) unless the oldest one has expired
+ */
+struct block_dev_queue {
+	spinlock_t lock;
+	struct dlist_head sorted;
+	struct dlist_head fifo[2];
+	blkno_t head_pos;         /* Block next to the last dispatched one */
+	unsigned int nr_queued;
+	unsigned int in_flight;
+	int plugged;
+	int dispatching;
+	struct sys_timer retry_timer; /* Re-runs queue refused by idle driver */
+	struct block_dev_queue_stats stats;
+};
+
 struct block_dev {
 	struct dev_module dev_module;
 
@@ -35,7 +99,7 @@ struct block_dev {
 	uint64_t size;
 	size_t block_size;
 	struct block_dev_cache *cache;
-
+	struct block_dev_queue queue;
 
 	/* partitions */
 	uint64_t start_offset;
@@ -50,6 +114,12 @@ struct block_dev_ops {
 	int (*write)(struct block_dev *bdev, char *buffer, size_t count, blkno_t blkno);
 
 	int (*probe)(void *args);
+
+	/* Optional. Starts @a req and returns 0, the driver completes it with
+	 * block_dev_request_end() later. -EBUSY means the driver can't take
+	 * the request now, it calls block_dev_queue_run() when it's ready.
+	 * Without it requests go to read/write one by one */
+	int (*request)(struct block_dev *bdev, struct block_dev_request *req);
 };
 
 struct block_dev_module {
@@ -78,6 +148,8 @@ extern struct block_dev *block_dev(void *bdev);
 extern struct block_dev_cache *block_dev_cache_init(void *bdev, int blocks);
 extern struct block_dev_cache *block_dev_cached_read(void *bdev, blkno_t blkno);
 extern int block_dev_read(void *bdev, char *buffer, size_t count, blkno_t blkno);
+/* Reads blocks which are going to be accessed soon into the buffer cache */
+extern void block_dev_readahead(void *bdev, size_t count, blkno_t blkno);
 extern int block_dev_read_buffered(struct block_dev *bdev, char *buffer, size_t count, size_t offset);
 extern int block_dev_write_buffered(struct block_dev *bdev, const char *buffer, size_t count, size_t offset);
 extern int block_dev_write(void *bdev, const char *buffer, size_t count, blkno_t blkno);
@@ -89,6 +161,44 @@ extern struct block_dev_module *block_dev_lookup(const char *name);
 extern void block_dev_free(struct block_dev *dev);
 extern struct block_dev *block_dev_find(const char *bd_name);
 
+/**
+ * Queues @a bio to its device. Adjacent bios are merged into a single
+ * request while the queue is plugged. bio->end_io is called on completion.
+ */
+extern int block_dev_submit_bio(struct bio *bio);
+
+/**
+ * Submits @a cnt bios at once and waits until all of them are done.
+ *
+ * @return 0 or the first error of bios
+ */
+extern int block_dev_submit_wait(struct bio *bios, int cnt);
+
+/**
+ * Transfers @a count bytes starting at block @a blkno through the request
+ * queue and waits for completion.
+ *
+ * @return @a count or negative error code
+ */
+extern int block_dev_rw(struct block_dev *bdev, int dir, char *buf,
+		size_t count, blkno_t blkno);
+
+/**
+ * Holds requests in the queue, so following bios can be merged with them.
+ * Calls may be nested.
+ */
+extern void block_dev_plug(struct block_dev *bdev);
+extern void block_dev_unplug(struct block_dev *bdev);
+
+/** Dispatches queued requests to the driver */
+extern void block_dev_queue_run(struct block_dev *bdev);
+
+/** Completes all bios of @a req, called by drivers with request() */
+extern void block_dev_request_end(struct block_dev_request *req, int err);
+
+extern void block_dev_queue_get_stats(struct block_dev *bdev,
+		struct block_dev_queue_stats *stats);
+
 extern int block_dev_max_id(void);
 extern struct block_dev *block_dev_by_id(int id);
 
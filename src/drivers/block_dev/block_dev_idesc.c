@@ -18,10 +18,16 @@
 
 #include <drivers/block_dev.h>
 #include <drivers/device.h>
+#include <fs/bcache.h>
 #include <fs/file_desc.h>
 
 extern const struct idesc_ops idesc_file_ops;
 static void bdev_idesc_close(struct idesc *desc) {
+	struct block_dev *bdev;
+
+	bdev = dev_module_to_bdev(file_get_inode_data((struct file_desc *) desc));
+	bcache_sync(bdev->parent_bdev ? bdev->parent_bdev : bdev);
+
 	/* It's assumed that block device may be accesed
 	 * via idesc ops only if they were opened from /dev/,
 	 * so we need to close bdev idesc as it as a file */
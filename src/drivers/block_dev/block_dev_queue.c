@@ -0,0 +1,513 @@
+/**
+ * @file
+ * @brief Request queue of block devices
+ *
+ * @details bios submitted while the queue is plugged are merged with
+ *   adjacent requests of the same direction. Requests are dispatched in
+ *   ascending order of blocks starting from the position of the last one
+ *   (one-way elevator). A request which has been waiting for longer than
+ *   @a read_expire or @a write_expire ms is dispatched first, so
+ *   sequential stream can't starve others.
+ *
+ * @date 18.10.2026
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/block_dev.h>
+#include <framework/mod/options.h>
+#include <hal/clock.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread/waitq.h>
+#include <kernel/time/time.h>
+#include <kernel/time/ktime.h>
+#include <mem/misc/pool.h>
+#include <mem/sysmalloc.h>
+#include <util/math.h>
+
+#define BDQ_REQUEST_QUANTITY OPTION_GET(NUMBER, request_quantity)
+#define BDQ_MAX_REQUEST      OPTION_GET(NUMBER, max_request_size)
+#define BDQ_NR_REQUESTS      OPTION_GET(NUMBER, nr_requests)
+#define BDQ_READ_EXPIRE      OPTION_GET(NUMBER, read_expire)
+#define BDQ_WRITE_EXPIRE     OPTION_GET(NUMBER, write_expire)
+
+/* bios waited by block_dev_rw() at once */
+#define BDQ_RW_BIOS          8
+
+/* Delay (ms) before the queue refused by idle driver is dispatched again */
+#define BDQ_RETRY_DELAY      1
+
+POOL_DEF(bdq_request_pool, struct block_dev_request, BDQ_REQUEST_QUANTITY);
+
+static spinlock_t bdq_pool_lock = SPIN_STATIC_UNLOCKED;
+
+struct bdq_wait {
+	struct waitq wq;
+	int pending;
+	int error;
+};
+
+static void bdq_retry_handler(struct sys_timer *tmr, void *param) {
+	block_dev_queue_run(param);
+}
+
+void block_dev_queue_init(struct block_dev *bdev) {
+	struct block_dev_queue *q = &bdev->queue;
+
+	spin_init(&q->lock, __SPIN_UNLOCKED);
+	dlist_init(&q->sorted);
+	dlist_init(&q->fifo[BIO_READ]);
+	dlist_init(&q->fifo[BIO_WRITE]);
+	q->head_pos = 0;
+	q->nr_queued = q->in_flight = 0;
+	q->plugged = q->dispatching = 0;
+	memset(&q->stats, 0, sizeof q->stats);
+	timer_init(&q->retry_timer, TIMER_ONESHOT, bdq_retry_handler, bdev);
+}
+
+void block_dev_queue_fini(struct block_dev *bdev) {
+	timer_stop(&bdev->queue.retry_timer);
+}
+
+static inline blkno_t bdq_end(struct block_dev *bdev, blkno_t blkno,
+		size_t count) {
+	return blkno + count / bdev->block_size;
+}
+
+static struct block_dev_request *bdq_request_alloc(void) {
+	struct block_dev_request *req;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bdq_pool_lock);
+	{
+		req = pool_alloc(&bdq_request_pool);
+	}
+	spin_unlock_ipl(&bdq_pool_lock, ipl);
+
+	return req;
+}
+
+static void bdq_request_free(struct block_dev_request *req) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bdq_pool_lock);
+	{
+		pool_free(&bdq_request_pool, req);
+	}
+	spin_unlock_ipl(&bdq_pool_lock, ipl);
+}
+
+/* Must be called with the queue lock held */
+static int bdq_merge(struct block_dev *bdev, struct bio *bio) {
+	struct block_dev_queue *q = &bdev->queue;
+	struct block_dev_request *req;
+
+	dlist_foreach_entry(req, &q->sorted, sort_lnk) {
+		if ((req->dir != bio->dir)
+				|| (req->count + bio->count > BDQ_MAX_REQUEST)) {
+			continue;
+		}
+
+		if (bdq_end(bdev, req->blkno, req->count) == bio->blkno) {
+			req->bio_tail->next = bio;
+			req->bio_tail = bio;
+		} else if (bdq_end(bdev, bio->blkno, bio->count) == req->blkno) {
+			bio->next = req->bio;
+			req->bio = bio;
+			req->blkno = bio->blkno;
+		} else {
+			continue;
+		}
+
+		req->count += bio->count;
+		q->stats.merges++;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Must be called with the queue lock held */
+static void bdq_insert(struct block_dev_queue *q,
+		struct block_dev_request *req, int front) {
+	struct block_dev_request *next;
+	struct dlist_head *pos;
+
+	pos = &q->sorted;
+	dlist_foreach_entry(next, &q->sorted, sort_lnk) {
+		if (next->blkno > req->blkno) {
+			pos = &next->sort_lnk;
+			break;
+		}
+	}
+	dlist_add_prev(&req->sort_lnk, pos);
+
+	if (front) {
+		dlist_add_next(&req->fifo_lnk, &q->fifo[req->dir]);
+	} else {
+		dlist_add_prev(&req->fifo_lnk, &q->fifo[req->dir]);
+	}
+
+	q->nr_queued++;
+}
+
+/* Must be called with the queue lock held */
+static struct block_dev_request *bdq_next(struct block_dev_queue *q) {
+	struct block_dev_request *req;
+	clock_t now;
+	int dir;
+
+	if (dlist_empty(&q->sorted)) {
+		return NULL;
+	}
+
+	/* reads go first, somebody usually waits for them */
+	now = clock_sys_ticks();
+	for (dir = BIO_READ; dir <= BIO_WRITE; dir++) {
+		if (dlist_empty(&q->fifo[dir])) {
+			continue;
+		}
+		req = dlist_first_entry(&q->fifo[dir], struct block_dev_request,
+				fifo_lnk);
+		if ((long)(now - req->deadline) >= 0) {
+			q->stats.expired++;
+			return req;
+		}
+	}
+
+	dlist_foreach_entry(req, &q->sorted, sort_lnk) {
+		if (req->blkno >= q->head_pos) {
+			return req;
+		}
+	}
+
+	/* wrap around to the lowest block */
+	return dlist_first_entry(&q->sorted, struct block_dev_request, sort_lnk);
+}
+
+/* Request without driver's request() is passed to read/write at once */
+static int bdq_rw(struct block_dev *bdev, struct block_dev_request *req) {
+	int (*rw)(struct block_dev *, char *, size_t, blkno_t);
+	struct bio *bio;
+	char *buf, *p;
+	int res;
+
+	rw = (req->dir == BIO_READ) ? bdev->driver->read : bdev->driver->write;
+
+	/* data of several bios is gathered in a bounce buffer */
+	buf = NULL;
+	if (req->bio != req->bio_tail) {
+		buf = sysmalloc(req->count);
+	}
+
+	if (buf == NULL) {
+		for (bio = req->bio; bio != NULL; bio = bio->next) {
+			res = rw(bdev, bio->buf, bio->count, bio->blkno);
+			if (res != bio->count) {
+				return res < 0 ? res : -EIO;
+			}
+		}
+		return 0;
+	}
+
+	if (req->dir == BIO_WRITE) {
+		for (p = buf, bio = req->bio; bio != NULL; bio = bio->next) {
+			memcpy(p, bio->buf, bio->count);
+			p += bio->count;
+		}
+	}
+
+	res = rw(bdev, buf, req->count, req->blkno);
+
+	if ((res == req->count) && (req->dir == BIO_READ)) {
+		for (p = buf, bio = req->bio; bio != NULL; bio = bio->next) {
+			memcpy(bio->buf, p, bio->count);
+			p += bio->count;
+		}
+	}
+
+	sysfree(buf);
+
+	if (res != req->count) {
+		return res < 0 ? res : -EIO;
+	}
+	return 0;
+}
+
+static int bdq_dispatch(struct block_dev *bdev, struct block_dev_request *req) {
+	int res;
+
+	if (bdev->driver->request) {
+		res = bdev->driver->request(bdev, req);
+		if (res == -EBUSY) {
+			return res;
+		}
+		if (res != 0) {
+			block_dev_request_end(req, res);
+		}
+		return 0;
+	}
+
+	block_dev_request_end(req, bdq_rw(bdev, req));
+
+	return 0;
+}
+
+void block_dev_queue_run(struct block_dev *bdev) {
+	struct block_dev_queue *q = &bdev->queue;
+	struct block_dev_request *req;
+	int retry;
+	ipl_t ipl;
+
+	retry = 0;
+	ipl = spin_lock_ipl(&q->lock);
+	if (q->dispatching) {
+		/* the current dispatcher picks up new requests itself */
+		spin_unlock_ipl(&q->lock, ipl);
+		return;
+	}
+	q->dispatching = 1;
+
+	while ((req = bdq_next(q)) != NULL) {
+		dlist_del_init(&req->sort_lnk);
+		dlist_del_init(&req->fifo_lnk);
+		q->nr_queued--;
+		q->in_flight++;
+		q->head_pos = bdq_end(bdev, req->blkno, req->count);
+		q->stats.dispatched++;
+		spin_unlock_ipl(&q->lock, ipl);
+
+		if (-EBUSY == bdq_dispatch(bdev, req)) {
+			ipl = spin_lock_ipl(&q->lock);
+			q->in_flight--;
+			q->stats.dispatched--;
+			bdq_insert(q, req, 1);
+			/* No completion is going to run the queue again */
+			retry = (q->in_flight == 0);
+			break;
+		}
+
+		ipl = spin_lock_ipl(&q->lock);
+	}
+
+	q->dispatching = 0;
+	spin_unlock_ipl(&q->lock, ipl);
+
+	if (retry) {
+		timer_start(&q->retry_timer, ms2jiffies(BDQ_RETRY_DELAY));
+	}
+}
+
+void block_dev_request_end(struct block_dev_request *req, int err) {
+	struct block_dev *bdev;
+	struct block_dev_queue *q;
+	struct bio *bio, *next;
+	int run;
+	ipl_t ipl;
+
+	bdev = req->bio->bdev;
+	q = &bdev->queue;
+
+	for (bio = req->bio; bio != NULL; bio = next) {
+		next = bio->next;
+		bio->next = NULL;
+		bio->error = err;
+		if (bio->end_io) {
+			bio->end_io(bio);
+		}
+	}
+
+	bdq_request_free(req);
+
+	ipl = spin_lock_ipl(&q->lock);
+	{
+		q->in_flight--;
+		run = !q->dispatching && !q->plugged && (q->nr_queued != 0);
+	}
+	spin_unlock_ipl(&q->lock, ipl);
+
+	if (run) {
+		block_dev_queue_run(bdev);
+	}
+}
+
+int block_dev_submit_bio(struct bio *bio) {
+	struct block_dev *bdev;
+	struct block_dev_queue *q;
+	struct block_dev_request *req;
+	int run;
+	ipl_t ipl;
+
+	assert(bio && bio->bdev);
+	bdev = bio->bdev;
+	q = &bdev->queue;
+
+	if ((bio->count == 0) || (bio->count % bdev->block_size)
+			|| (bdq_end(bdev, bio->blkno, bio->count)
+				> bdev->size / bdev->block_size)) {
+		return -EINVAL;
+	}
+	if (!bdev->driver->request && !(bio->dir == BIO_READ
+				? bdev->driver->read : bdev->driver->write)) {
+		return -ENOSYS;
+	}
+
+	bio->next = NULL;
+	bio->error = 0;
+
+	ipl = spin_lock_ipl(&q->lock);
+	q->stats.bios++;
+	if (!bdq_merge(bdev, bio)) {
+		spin_unlock_ipl(&q->lock, ipl);
+
+		while (NULL == (req = bdq_request_alloc())) {
+			/* completed requests return to the pool */
+			block_dev_queue_run(bdev);
+			ksleep(1);
+		}
+
+		req->dir = bio->dir;
+		req->blkno = bio->blkno;
+		req->count = bio->count;
+		req->bio = req->bio_tail = bio;
+		req->deadline = clock_sys_ticks() + ms2jiffies(bio->dir == BIO_READ
+				? BDQ_READ_EXPIRE : BDQ_WRITE_EXPIRE);
+		dlist_head_init(&req->sort_lnk);
+		dlist_head_init(&req->fifo_lnk);
+
+		ipl = spin_lock_ipl(&q->lock);
+		bdq_insert(q, req, 0);
+	}
+	run = !q->plugged || (q->nr_queued >= BDQ_NR_REQUESTS);
+	spin_unlock_ipl(&q->lock, ipl);
+
+	if (run) {
+		block_dev_queue_run(bdev);
+	}
+
+	return 0;
+}
+
+void block_dev_plug(struct block_dev *bdev) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bdev->queue.lock);
+	{
+		bdev->queue.plugged++;
+	}
+	spin_unlock_ipl(&bdev->queue.lock, ipl);
+}
+
+void block_dev_unplug(struct block_dev *bdev) {
+	int run;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bdev->queue.lock);
+	{
+		assert(bdev->queue.plugged > 0);
+		run = (--bdev->queue.plugged == 0);
+	}
+	spin_unlock_ipl(&bdev->queue.lock, ipl);
+
+	if (run) {
+		block_dev_queue_run(bdev);
+	}
+}
+
+/* The waiter may return as soon as @a pending is zero, so it's changed
+ * and the waiter is woken up with the waitq lock held */
+static void bdq_wait_end_io(struct bio *bio) {
+	struct bdq_wait *w = bio->private;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&w->wq.lock);
+	{
+		if (bio->error && !w->error) {
+			w->error = bio->error;
+		}
+		if (--w->pending == 0) {
+			__waitq_wakeup(&w->wq, 0);
+		}
+	}
+	spin_unlock_ipl(&w->wq.lock, ipl);
+}
+
+int block_dev_submit_wait(struct bio *bios, int cnt) {
+	struct bdq_wait w;
+	struct block_dev *bdev;
+	int i, res;
+	ipl_t ipl;
+
+	if (cnt == 0) {
+		return 0;
+	}
+
+	waitq_init(&w.wq);
+	w.pending = cnt;
+	w.error = 0;
+
+	bdev = bios[0].bdev;
+	block_dev_plug(bdev);
+	for (i = 0; i < cnt; i++) {
+		assert(bios[i].bdev == bdev);
+		bios[i].end_io = bdq_wait_end_io;
+		bios[i].private = &w;
+
+		res = block_dev_submit_bio(&bios[i]);
+		if (res != 0) {
+			bios[i].error = res;
+			bdq_wait_end_io(&bios[i]);
+		}
+	}
+	block_dev_unplug(bdev);
+
+	WAITQ_WAIT(&w.wq, *(volatile int *)&w.pending == 0);
+
+	/* Wait for the last completion to release the lock of w */
+	ipl = spin_lock_ipl(&w.wq.lock);
+	spin_unlock_ipl(&w.wq.lock, ipl);
+
+	return w.error;
+}
+
+int block_dev_rw(struct block_dev *bdev, int dir, char *buf, size_t count,
+		blkno_t blkno) {
+	struct bio bios[BDQ_RW_BIOS];
+	size_t done, len;
+	int n, res;
+
+	for (done = 0; done < count; ) {
+		for (n = 0; (n < BDQ_RW_BIOS) && (done < count); n++, done += len) {
+			len = min(count - done, (size_t)BDQ_MAX_REQUEST);
+			bios[n] = (struct bio) {
+				.bdev = bdev,
+				.dir = dir,
+				.blkno = blkno + done / bdev->block_size,
+				.buf = buf + done,
+				.count = len,
+			};
+		}
+
+		res = block_dev_submit_wait(bios, n);
+		if (res != 0) {
+			return res;
+		}
+	}
+
+	return count;
+}
+
+void block_dev_queue_get_stats(struct block_dev *bdev,
+		struct block_dev_queue_stats *stats) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bdev->queue.lock);
+	{
+		*stats = bdev->queue.stats;
+	}
+	spin_unlock_ipl(&bdev->queue.lock, ipl);
+}
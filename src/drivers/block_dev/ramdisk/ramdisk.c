@@ -60,6 +60,29 @@ int ramdisk_write_sectors(struct block_dev *bdev,
 	return count;
 }
 
+/* Copies data of all bios at once, so the request is completed right here */
+int ramdisk_request(struct block_dev *bdev, struct block_dev_request *req) {
+	struct ramdisk *ramdisk;
+	struct bio *bio;
+	char *addr;
+
+	ramdisk = block_dev_priv(bdev);
+
+	for (bio = req->bio; bio != NULL; bio = bio->next) {
+		addr = ramdisk->p_start_addr + (bio->blkno * bdev->block_size);
+
+		if (bio->dir == BIO_READ) {
+			memcpy(bio->buf, addr, bio->count);
+		} else {
+			memcpy(addr, bio->buf, bio->count);
+		}
+	}
+
+	block_dev_request_end(req, 0);
+
+	return 0;
+}
+
 int rmadisk_ioctl(struct block_dev *bdev, int cmd, void *args, size_t size) {
 
 	switch (cmd) {
@@ -76,7 +99,8 @@ static const struct block_dev_ops ramdisk_pio_driver = {
 	.name  = "ramdisk_drv",
 	.ioctl = rmadisk_ioctl,
 	.read = ramdisk_read_sectors,
-	.write = ramdisk_write_sectors
+	.write = ramdisk_write_sectors,
+	.request = ramdisk_request,
 };
 
 /* XXX not stores index if path have no index placeholder, like * or # */
@@ -22,6 +22,8 @@ extern int ramdisk_read_sectors(struct block_dev *bdev,
 		char *buffer, size_t count, blkno_t blkno);
 extern int ramdisk_write_sectors(struct block_dev *bdev,
 		char *buffer, size_t count, blkno_t blkno);
+extern int ramdisk_request(struct block_dev *bdev,
+		struct block_dev_request *req);
 extern int rmadisk_ioctl(struct block_dev *bdev, int cmd, void *args, size_t size);
 
 static struct ramdisk static_ramdisk;
@@ -51,6 +53,7 @@ static const struct block_dev_ops static_ramdisk_pio_driver = {
 		.ioctl = rmadisk_ioctl,
 		.read = ramdisk_read_sectors,
 		.write = ramdisk_write_sectors,
+		.request = ramdisk_request,
 		.probe = static_ramdisk_init
 };
 
@@ -24,7 +24,7 @@
 #include <net/skbuff.h>
 #include <net/netfilter.h>
 
-#include <net/l0/net_entry.h>
+#include <net/l0/net_poll.h>
 
 #include <hal/reg.h>
 
@@ -106,11 +106,25 @@ static volatile uint32_t *e1000_reg(struct net_device *dev, int offset) {
 	return (volatile uint32_t *) (dev->base_addr + offset);
 }
 
+static int e1000_nr_chunks(struct sk_buff *skb) {
+	size_t off, len;
+	int nr;
+
+	for (nr = 0, off = 0; off < skb->len; off += len, ++nr) {
+		skb_chunk(skb, off, &len);
+	}
+
+	return nr;
+}
+
 static int e1000_xmit(struct net_device *dev) {
 	struct e1000_priv *nic_priv = e1000_get_priv(dev);
+	struct e1000_tx_desc *desc;
 	uint16_t head;
 	uint16_t tail;
 	struct sk_buff *skb;
+	unsigned char *chunk;
+	size_t off, len;
 
 	/* Called from kernel space and IRQ. Don't want tail to be handled twice */
 	irq_lock();
@@ -118,25 +132,34 @@ static int e1000_xmit(struct net_device *dev) {
 		head = REG32_LOAD(e1000_reg(dev, E1000_REG_TDH));
 		tail = REG32_LOAD(e1000_reg(dev, E1000_REG_TDT));
 
-		if ((tail + 1 % E1000_TXDESC_NR) == head) {
+		skb = skb_queue_front(&nic_priv->tx_dev_queue);
+
+		if (skb == NULL) {
 			goto out_unlock;
 		}
 
-		skb = skb_queue_pop(&nic_priv->tx_dev_queue);
-
-		if (skb == NULL) {
+		/* One descriptor per piece of skb, one slot is always kept empty */
+		if (e1000_nr_chunks(skb)
+				> (head + E1000_TXDESC_NR - tail - 1) % E1000_TXDESC_NR) {
 			goto out_unlock;
 		}
 
-		nic_priv->tx_descs[tail].buffer_address = (uint32_t) (uintptr_t) skb->mac.raw;
-		nic_priv->tx_descs[tail].status = 0;
-		nic_priv->tx_descs[tail].cmd = E1000_TX_CMD_EOP |
-					E1000_TX_CMD_FCS |
-					E1000_TX_CMD_RS;
-		nic_priv->tx_descs[tail].length  = skb->len;
+		skb = skb_queue_pop(&nic_priv->tx_dev_queue);
+
+		for (off = 0; off < skb->len; off += len) {
+			chunk = skb_chunk(skb, off, &len);
+
+			desc = &nic_priv->tx_descs[tail];
+			desc->buffer_address = (uint32_t) (uintptr_t) chunk;
+			desc->status = 0;
+			desc->cmd = E1000_TX_CMD_FCS;
+			desc->length = len;
 
-		++tail;
-		tail %= E1000_TXDESC_NR;
+			++tail;
+			tail %= E1000_TXDESC_NR;
+		}
+		/* The last descriptor of the frame */
+		desc->cmd |= E1000_TX_CMD_EOP | E1000_TX_CMD_RS;
 
 		REG32_STORE(e1000_reg(dev, E1000_REG_TDT), tail);
 
@@ -150,6 +173,13 @@ out_unlock:
 static int xmit(struct net_device *dev, struct sk_buff *skb) {
 	struct e1000_priv *nic_priv = e1000_get_priv(dev);
 
+	/* Frame must fit the ring at once. On error skb is left to the caller,
+	 * as netif_tx_action() expects */
+	if ((e1000_nr_chunks(skb) >= E1000_TXDESC_NR)
+			&& (skb_linearize(skb) == NULL)) {
+		return -ENOMEM;
+	}
+
 	irq_lock();
 	{
 		skb_queue_push(&nic_priv->tx_dev_queue, skb);
@@ -174,64 +204,83 @@ static void txed_skb_clean(struct net_device *dev) {
 	irq_unlock();
 }
 
-static void e1000_rx(struct net_device *dev) {
+static int e1000_poll(struct net_device *dev, int budget) {
 	/*net_device_stats_t stat = get_eth_stat(dev);*/
 	struct e1000_priv *nic_priv = e1000_get_priv(dev);
+	struct e1000_rx_desc *desc;
 	struct sk_buff *skb, *new_skb;
 	uint16_t head;
 	uint16_t tail;
 	uint16_t cur;
+	int work;
 
-	/* nested irq locked to prevent already handled packets handled once more
-	 * as tail updated at exit
-	 */
-	irq_lock();
-	{
-		head = REG32_LOAD(e1000_reg(dev, E1000_REG_RDH));
-		tail = REG32_LOAD(e1000_reg(dev, E1000_REG_RDT));
-		cur = (1 + tail) % E1000_RXDESC_NR;
+	/* Only poll handler touches receive ring, so no lock is required */
+	head = REG32_LOAD(e1000_reg(dev, E1000_REG_RDH));
+	tail = REG32_LOAD(e1000_reg(dev, E1000_REG_RDT));
+	cur = (1 + tail) % E1000_RXDESC_NR;
 
-		while (cur != head) {
-			int len;
-
-			if (!(nic_priv->rx_descs[cur].status)) {
-				break;
-			}
-
-			len = nic_priv->rx_descs[cur].length - E1000_RX_CHECKSUM_LEN;
-
-			if (0 != nf_test_raw(NF_CHAIN_INPUT,
-						NF_TARGET_ACCEPT,
-						(char *) (uintptr_t) nic_priv->rx_descs[cur].buffer_address,
-						ETH_ALEN + (char *) (uintptr_t) nic_priv->rx_descs[cur].buffer_address,
-						ETH_ALEN)) {
-				goto drop_pack;
-			}
-
-			new_skb = skb_alloc(E1000_MAX_RX_LEN);
-			if (!new_skb) {
-				goto drop_pack;
-			}
-
-			skb = nic_priv->rx_skbs[cur];
-			nic_priv->rx_skbs[cur] = new_skb;
-			nic_priv->rx_descs[cur].buffer_address = (uint32_t) (uintptr_t) new_skb->mac.raw;
-			assert(skb);
-
-			skb = skb_realloc(len, skb);
-			if (!skb) {
-				goto drop_pack;
-			}
-			skb->dev = dev;
-			netif_rx(skb);
+	for (work = 0; work < budget && cur != head; ++work) {
+		int len;
+
+		desc = &nic_priv->rx_descs[cur];
+		if (!(desc->status)) {
+			break;
+		}
+
+		len = desc->length - E1000_RX_CHECKSUM_LEN;
+		skb = NULL;
+
+		if (0 != nf_test_raw(NF_CHAIN_INPUT,
+					NF_TARGET_ACCEPT,
+					(char *) (uintptr_t) desc->buffer_address,
+					ETH_ALEN + (char *) (uintptr_t) desc->buffer_address,
+					ETH_ALEN)) {
+			goto drop_pack;
+		}
+
+		new_skb = skb_alloc(E1000_MAX_RX_LEN);
+		if (!new_skb) {
+			dev->stats.rx_dropped++;
+			goto drop_pack;
+		}
+
+		skb = nic_priv->rx_skbs[cur];
+		nic_priv->rx_skbs[cur] = new_skb;
+		desc->buffer_address = (uint32_t) (uintptr_t) new_skb->mac.raw;
+		assert(skb);
+
+		skb = skb_realloc(len, skb);
 drop_pack:
-			tail = cur;
+		desc->status = 0;
+		tail = cur;
+		cur = (1 + tail) % E1000_RXDESC_NR;
 
-			cur = (1 + tail) % E1000_RXDESC_NR;
+		if (skb) {
+			skb->dev = dev;
+			netif_receive_skb(skb);
 		}
+	}
+
+	/* Give all refilled descriptors back to the card at once */
+	if (work != 0) {
 		REG32_STORE(e1000_reg(dev, E1000_REG_RDT), tail);
 	}
-	irq_unlock();
+
+	return work;
+}
+
+static int e1000_poll_irq_enable(struct net_device *dev) {
+	struct e1000_priv *nic_priv = e1000_get_priv(dev);
+	uint16_t cur;
+
+	REG32_STORE(e1000_reg(dev, E1000_REG_IMS),
+			E1000_REG_IMS_RXO | E1000_REG_IMS_RXT);
+
+	/* Packet written before unmasking doesn't raise interrupt */
+	cur = (1 + REG32_LOAD(e1000_reg(dev, E1000_REG_RDT))) % E1000_RXDESC_NR;
+
+	return (cur != REG32_LOAD(e1000_reg(dev, E1000_REG_RDH)))
+			&& ((volatile struct e1000_rx_desc *) &nic_priv->rx_descs[cur])->status;
 }
 
 static irq_return_t e1000_interrupt(unsigned int irq_num, void *dev_id) {
@@ -240,7 +289,10 @@ static irq_return_t e1000_interrupt(unsigned int irq_num, void *dev_id) {
 	irq_return_t ret = IRQ_NONE;
 
 	if (cause & (E1000_REG_ICR_RXO | E1000_REG_ICR_RXT)) {
-		e1000_rx(dev_id);
+		/* Receive is done by e1000_poll with RX interrupts masked */
+		REG32_STORE(e1000_reg(dev_id, E1000_REG_IMC),
+				E1000_REG_IMS_RXO | E1000_REG_IMS_RXT);
+		netif_poll_schedule(dev_id);
 		ret = IRQ_HANDLED;
 	}
 
@@ -395,7 +447,9 @@ static const struct net_driver _drv_ops = {
 	.xmit = xmit,
 	.start = e1000_open,
 	.stop = e1000_stop,
-	.set_macaddr = set_mac_address
+	.set_macaddr = set_mac_address,
+	.poll = e1000_poll,
+	.poll_irq_enable = e1000_poll_irq_enable,
 };
 
 static void e1000_enable_bus_mastering(struct pci_slot_dev *pci_dev) {
@@ -416,6 +470,7 @@ static int e1000_init(struct pci_slot_dev *pci_dev) {
 		return -ENOMEM;
 	}
 	nic->drv_ops = &_drv_ops;
+	nic->features |= NETIF_F_SG;
 	nic->irq = pci_dev->irq;
 	nic->base_addr = (uintptr_t) mmap_device_memory(
 			(void *) (uintptr_t) (pci_dev->bar[0] & PCI_BASE_ADDR_IO_MASK),
@@ -64,6 +64,9 @@
 /** Interrupt Mask Set/Read Register. */
 #define E1000_REG_IMS		0x000d0
 
+/** Interrupt Mask Clear Register. */
+#define E1000_REG_IMC		0x000d8
+
 /** Receive Control Register. */
 #define E1000_REG_RCTL		0x00100
 
@@ -17,8 +17,18 @@
 #include <net/skbuff.h>
 #include <net/l0/net_entry.h>
 
+#include <drivers/net/loopback.h>
+
 EMBOX_UNIT_INIT(loopback_init);
 
+static unsigned int loopback_loss_period;
+static unsigned int loopback_loss_cnt;
+
+void loopback_set_loss(unsigned int period) {
+	loopback_loss_period = period;
+	loopback_loss_cnt = 0;
+}
+
 static int loopback_xmit(struct net_device *dev,
 		struct sk_buff *skb) {
 	struct net_device_stats *lb_stats;
@@ -32,6 +42,13 @@ static int loopback_xmit(struct net_device *dev,
 
 	lb_stats = &dev->stats;
 
+	if ((loopback_loss_period != 0)
+			&& (++loopback_loss_cnt % loopback_loss_period == 0)) {
+		lb_stats->tx_dropped++;
+		skb_free(skb);
+		return 0;
+	}
+
 	if (netif_rx(skb) == NET_RX_SUCCESS) {
 		lb_stats->rx_packets++;
 		lb_stats->rx_bytes += skb_len;
@@ -0,0 +1,17 @@
+/**
+ * @file
+ * @brief Loopback interface control.
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef DRIVERS_NET_LOOPBACK_H_
+#define DRIVERS_NET_LOOPBACK_H_
+
+/**
+ * Drop every @a period-th packet transmitted over loopback interface to
+ * test recovery of protocols from losses. Zero disables dropping.
+ */
+extern void loopback_set_loss(unsigned int period);
+
+#endif /* DRIVERS_NET_LOOPBACK_H_ */
@@ -23,9 +23,12 @@
 
 #include <kernel/irq.h>
 #include <kernel/sched/sched_lock.h>
+#include <linux/compiler.h>
+#include <util/math.h>
+#include <mem/sysmalloc.h>
 
 #include <net/inetdevice.h>
-#include <net/l0/net_entry.h>
+#include <net/l0/net_poll.h>
 #include <net/l2/ethernet.h>
 #include <net/netdevice.h>
 
@@ -37,19 +40,38 @@ PCI_DRIVER("virtio", virtio_init, PCI_VENDOR_ID_VIRTIO, PCI_DEV_ID_VIRTIO_NET);
 
 #define MODOPS_PREP_BUFF_CNT OPTION_GET(NUMBER, prep_buff_cnt)
 
+/* Legacy device handles control commands synchronously on notification */
+#define VIRTIO_CTRL_SPINS 1000000
+
+struct virtio_ctrl_buf {
+	struct virtio_net_ctrl_hdr hdr;
+	uint16_t data;
+	uint8_t ack;
+};
+
 struct virtio_priv {
-	struct virtqueue rq;
-	struct virtqueue tq;
+	unsigned int nr_pairs;     /* RX/TX queue pairs in use */
+	unsigned int nr_init;      /* RX/TX queue pairs set up by driver */
+	unsigned int max_pairs;    /* RX/TX queue pairs of device */
+	struct virtqueue rq[NETDEV_QUEUES_MAX];
+	struct virtqueue tq[NETDEV_QUEUES_MAX];
+	/* packets being sent by head descriptor id */
+	struct sk_buff **tx_skbs[NETDEV_QUEUES_MAX];
+	int has_cq;
+	struct virtqueue cq;
+	struct virtio_ctrl_buf ctrl;
 };
 
 static int virtio_xmit(struct net_device *dev, struct sk_buff *skb) {
 	struct sk_buff_extra *skb_extra;
-	struct sk_buff_data *skb_data;
 	struct virtqueue *vq;
 	struct virtio_net_hdr *hdr;
 	uint32_t desc_id;
 	struct vring_desc *desc;
 	struct virtio_priv *virtio_priv;
+	unsigned char *chunk;
+	size_t off, len;
+	unsigned int qi;
 
 	assert(dev != NULL);
 	assert(skb != NULL);
@@ -61,13 +83,9 @@ static int virtio_xmit(struct net_device *dev, struct sk_buff *skb) {
 		return -ENOMEM;
 	}
 
-	skb_data = skb_data_clone(skb->data);
-	if (skb_data == NULL) {
-		skb_extra_free(skb_extra);
-		return -ENOMEM;
-	}
-
-	vq = &virtio_priv->tq;
+	/* queue is chosen by flow hash in netif_tx */
+	qi = skb->queue_mapping % virtio_priv->nr_pairs;
+	vq = &virtio_priv->tq[qi];
 
 	hdr = skb_extra_cast_in(skb_extra);
 	hdr->flags = 0;
@@ -78,31 +96,60 @@ static int virtio_xmit(struct net_device *dev, struct sk_buff *skb) {
 		desc_id = vq->next_free_desc;
 		do { desc = virtqueue_alloc_desc(vq); } while (desc == NULL);
 		vring_desc_init(desc, hdr, sizeof *hdr, VRING_DESC_F_NEXT);
-		desc->next = vq->next_free_desc;
 
-		do { desc = virtqueue_alloc_desc(vq); } while (desc == NULL);
-		vring_desc_init(desc, skb_data_cast_in(skb_data), skb->len, 0);
+		/* Device gathers the frame from all pieces of skb itself */
+		for (off = 0; off < skb->len; off += len) {
+			chunk = skb_chunk(skb, off, &len);
+			desc->next = vq->next_free_desc;
+			do { desc = virtqueue_alloc_desc(vq); } while (desc == NULL);
+			vring_desc_init(desc, chunk, len, VRING_DESC_F_NEXT);
+		}
+		desc->flags &= ~VRING_DESC_F_NEXT;
 
+		/* skb keeps all pieces until the device releases them */
+		virtio_priv->tx_skbs[qi][desc_id] = skb;
 		vring_push_desc(desc_id, &vq->ring);
 	}
 	sched_unlock();
 
-	skb_free(skb);
-
-	virtio_net_notify_queue(VIRTIO_NET_QUEUE_TX, dev);
+	virtio_net_notify_queue(vq->id, dev);
 
 	return 0;
 }
 
+static void virtio_tx_release(struct virtio_priv *virtio_priv,
+		unsigned int qi, uint32_t desc_id) {
+	struct virtqueue *vq;
+	struct vring_desc *desc;
+
+	vq = &virtio_priv->tq[qi];
+
+	desc = &vq->ring.desc[desc_id];
+	skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
+	assert(desc->flags & VRING_DESC_F_NEXT);
+
+	while (desc->flags & VRING_DESC_F_NEXT) {
+		desc->addr = 0;
+		desc = &vq->ring.desc[desc->next];
+	}
+	desc->addr = 0;
+
+	skb_free(virtio_priv->tx_skbs[qi][desc_id]);
+	virtio_priv->tx_skbs[qi][desc_id] = NULL;
+}
+
+static inline int virtio_vq_has_used(struct virtqueue *vq) {
+	return vq->last_seen_used != *(volatile uint16_t *)&vq->ring.used->idx;
+}
+
 static irq_return_t virtio_interrupt(unsigned int irq_num,
 		void *dev_id) {
 	struct net_device *dev;
 	struct virtqueue *vq;
 	struct vring_used_elem *used_elem;
-	struct sk_buff *skb;
-	struct sk_buff_data *new_data;
-	struct vring_desc *desc, *next;
 	struct virtio_priv *virtio_priv;
+	unsigned int qi;
+	int rx_pending;
 
 	dev = dev_id;
 
@@ -113,28 +160,49 @@ static irq_return_t virtio_interrupt(unsigned int irq_num,
 
 	virtio_priv = netdev_priv(dev);
 
-	/* release outgoing packets */
-	vq = &virtio_priv->tq;
-	while (vq->last_seen_used != vq->ring.used->idx) {
-		used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
+	/* legacy device has a single interrupt for all queues */
+	rx_pending = 0;
+	for (qi = 0; qi < virtio_priv->nr_pairs; ++qi) {
+		/* release outgoing packets */
+		vq = &virtio_priv->tq[qi];
+		while (virtio_vq_has_used(vq)) {
+			used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
 
-		desc = &vq->ring.desc[used_elem->id];
-		skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
-		desc->addr = 0;
-		assert(desc->flags & VRING_DESC_F_NEXT);
+			virtio_tx_release(virtio_priv, qi, used_elem->id);
 
-		next = &vq->ring.desc[desc->next];
-		skb_data_free(skb_data_cast_out((void *)(uintptr_t)next->addr));
-		next->addr = 0;
-		assert(~next->flags & VRING_DESC_F_NEXT);
+			++vq->last_seen_used;
+		}
 
-		++vq->last_seen_used;
+		rx_pending |= virtio_vq_has_used(&virtio_priv->rq[qi]);
+	}
+
+	/* incoming packets are received by virtio_poll */
+	if (rx_pending) {
+		for (qi = 0; qi < virtio_priv->nr_pairs; ++qi) {
+			vq = &virtio_priv->rq[qi];
+			vq->ring.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+		}
+		netif_poll_schedule(dev);
 	}
 
-	/* receive incoming packets */
-	vq = &virtio_priv->rq;
-	while (vq->last_seen_used != vq->ring.used->idx) {
+	return IRQ_HANDLED;
+}
+
+static int virtio_poll_queue(struct net_device *dev, struct virtqueue *vq,
+		int budget) {
+	struct vring_used_elem *used_elem;
+	struct sk_buff *skb;
+	struct sk_buff_data *new_data;
+	struct vring_desc *desc, *next;
+	int work;
+
+	for (work = 0; work < budget; ++work) {
+		if (vq->last_seen_used == vq->ring.used->idx) {
+			break;
+		}
+
 		used_elem = &vq->ring.used->ring[vq->last_seen_used % vq->ring.num];
+		++vq->last_seen_used;
 
 		desc = &vq->ring.desc[used_elem->id];
 		assert(desc->flags & VRING_DESC_F_NEXT);
@@ -142,38 +210,165 @@ static irq_return_t virtio_interrupt(unsigned int irq_num,
 		next = &vq->ring.desc[desc->next];
 		assert(~next->flags & VRING_DESC_F_NEXT);
 
-		skb = skb_wrap(used_elem->len - sizeof(struct virtio_net_hdr),
-				skb_data_cast_out((void *)(uintptr_t)next->addr));
-		if (skb == NULL) {
-			log_error("skb_wrap return NULL");
-			break;
+		/* if there is no memory the packet is dropped and its buffer
+		 * is given back to the device, so the ring never runs dry */
+		skb = NULL;
+		new_data = skb_data_alloc(skb_max_size());
+		if (new_data != NULL) {
+			skb = skb_wrap(used_elem->len - sizeof(struct virtio_net_hdr),
+					skb_data_cast_out((void *)(uintptr_t)next->addr));
+			if (skb == NULL) {
+				skb_data_free(new_data);
+			}
 		}
-		skb->dev = dev;
-		netif_rx(skb);
 
-		++vq->last_seen_used;
+		if (skb != NULL) {
+			/* desc->addr = desc->addr; -- the same */
+			next->addr = (uintptr_t)skb_data_cast_in(new_data);
+		} else {
+			log_error("no memory for incoming packet");
+			dev->stats.rx_dropped++;
+		}
 
-		new_data = skb_data_alloc(skb_max_size());
-		if (new_data == NULL) {
-			skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
-			desc->addr = next->addr = 0;
-			log_error("skb_data_alloc return NULL");
-			break;
+		vring_push_desc(used_elem->id, &vq->ring);
+
+		if (skb != NULL) {
+			skb->dev = dev;
+			netif_receive_skb(skb);
+		}
+	}
+
+	/* single doorbell for the whole batch of refilled buffers */
+	if (work != 0) {
+		virtio_net_notify_queue(vq->id, dev);
+	}
+
+	return work;
+}
+
+static int virtio_poll(struct net_device *dev, int budget) {
+	struct virtio_priv *virtio_priv;
+	unsigned int qi;
+	int work, done, n;
+
+	virtio_priv = netdev_priv(dev);
+
+	/* queues are drained in turn, netif_receive_skb spreads packets
+	 * among CPUs by their flow */
+	work = 0;
+	do {
+		done = 0;
+		for (qi = 0; (qi < virtio_priv->nr_pairs) && (work < budget); ++qi) {
+			n = virtio_poll_queue(dev, &virtio_priv->rq[qi],
+					min(budget - work, MODOPS_PREP_BUFF_CNT));
+			done += n;
+			work += n;
 		}
+	} while ((done != 0) && (work < budget));
 
-		/* desc->addr = desc->addr; -- the same */
-		next->addr = (uintptr_t)skb_data_cast_in(new_data);
+	return work;
+}
 
-		vring_push_desc(used_elem->id, &vq->ring);
-		virtio_net_notify_queue(VIRTIO_NET_QUEUE_RX, dev);
+static int virtio_poll_irq_enable(struct net_device *dev) {
+	struct virtqueue *vq;
+	struct virtio_priv *virtio_priv;
+	unsigned int qi;
+	int pending;
+
+	virtio_priv = netdev_priv(dev);
+
+	for (qi = 0; qi < virtio_priv->nr_pairs; ++qi) {
+		vq = &virtio_priv->rq[qi];
+		vq->ring.avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
 	}
+	__barrier();
 
-	return IRQ_HANDLED;
+	/* packets used before interrupt was enabled won't raise it */
+	pending = 0;
+	for (qi = 0; qi < virtio_priv->nr_pairs; ++qi) {
+		pending |= virtio_vq_has_used(&virtio_priv->rq[qi]);
+	}
+
+	return pending;
+}
+
+/* Sends command over control queue and waits until device acknowledges it */
+static int virtio_ctrl_cmd(struct net_device *dev, uint8_t class,
+		uint8_t cmd, uint16_t data) {
+	struct virtio_priv *virtio_priv;
+	struct virtio_ctrl_buf *ctrl;
+	struct virtqueue *vq;
+	struct vring_desc *desc;
+	uint32_t desc_id;
+	int spins;
+
+	virtio_priv = netdev_priv(dev);
+	if (!virtio_priv->has_cq) {
+		return -ENOTSUP;
+	}
+
+	vq = &virtio_priv->cq;
+	ctrl = &virtio_priv->ctrl;
+	ctrl->hdr.class = class;
+	ctrl->hdr.cmd = cmd;
+	ctrl->data = data;
+	ctrl->ack = VIRTIO_NET_ERR;
+
+	/* commands are sent one at a time, so descriptors are always free */
+	desc_id = vq->next_free_desc;
+	desc = virtqueue_alloc_desc(vq);
+	vring_desc_init(desc, &ctrl->hdr, sizeof ctrl->hdr, VRING_DESC_F_NEXT);
+	desc->next = vq->next_free_desc;
+	desc = virtqueue_alloc_desc(vq);
+	vring_desc_init(desc, &ctrl->data, sizeof ctrl->data, VRING_DESC_F_NEXT);
+	desc->next = vq->next_free_desc;
+	desc = virtqueue_alloc_desc(vq);
+	vring_desc_init(desc, &ctrl->ack, sizeof ctrl->ack, VRING_DESC_F_WRITE);
+
+	vring_push_desc(desc_id, &vq->ring);
+	virtio_net_notify_queue(vq->id, dev);
+
+	for (spins = 0; !virtio_vq_has_used(vq); ++spins) {
+		if (spins == VIRTIO_CTRL_SPINS) {
+			return -ETIMEDOUT;
+		}
+	}
+	++vq->last_seen_used;
+
+	desc = &vq->ring.desc[desc_id];
+	while (desc->flags & VRING_DESC_F_NEXT) {
+		desc->addr = 0;
+		desc = &vq->ring.desc[desc->next];
+	}
+	desc->addr = 0;
+
+	return *(volatile uint8_t *)&ctrl->ack == VIRTIO_NET_OK ? 0 : -EIO;
 }
 
 static int virtio_open(struct net_device *dev) {
+	struct virtio_priv *virtio_priv;
+	int ret;
+
+	virtio_priv = netdev_priv(dev);
+
 	/* device is ready */
 	virtio_net_add_status(VIRTIO_CONFIG_S_DRIVER_OK, dev);
+
+	/* device uses only the first pair until it's told otherwise */
+	virtio_priv->nr_pairs = virtio_priv->nr_init;
+	if (virtio_priv->nr_pairs > 1) {
+		ret = virtio_ctrl_cmd(dev, VIRTIO_NET_CTRL_MQ,
+				VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, virtio_priv->nr_pairs);
+		if (ret != 0) {
+			log_error("couldn't enable %u queue pairs (%d)",
+					virtio_priv->nr_pairs, ret);
+			virtio_priv->nr_pairs = 1;
+		}
+	}
+
+	/* packets sent to other queues would be lost */
+	netdev_set_num_tx_queues(dev, virtio_priv->nr_pairs);
+
 	return 0;
 }
 
@@ -198,10 +393,13 @@ static const struct net_driver virtio_drv_ops = {
 	.xmit = virtio_xmit,
 	.start = virtio_open,
 	.stop = virtio_stop,
-	.set_macaddr = virtio_set_macaddr
+	.set_macaddr = virtio_set_macaddr,
+	.poll = virtio_poll,
+	.poll_irq_enable = virtio_poll_irq_enable,
 };
 
 static void virtio_config(struct net_device *dev) {
+	struct virtio_priv *virtio_priv;
 	unsigned char i;
 	uint32_t guest_features;
 
@@ -233,35 +431,44 @@ static void virtio_config(struct net_device *dev) {
 		guest_features |= VIRTIO_NET_F_STATUS;
 	}
 
+	/* negotiate MQ bit, it requires control queue to set number of pairs */
+	virtio_priv = netdev_priv(dev);
+	virtio_priv->max_pairs = virtio_priv->nr_pairs = 1;
+	virtio_priv->has_cq = 0;
+	if (virtio_net_has_feature(VIRTIO_NET_F_MQ, dev)
+			&& virtio_net_has_feature(VIRTIO_NET_F_CTRL_VQ, dev)) {
+		virtio_priv->max_pairs = virtio_net_get_max_vq_pairs(dev);
+		virtio_priv->nr_pairs = min(virtio_priv->max_pairs,
+				(unsigned int)NETDEV_QUEUES_MAX);
+		virtio_priv->has_cq = 1;
+		guest_features |= VIRTIO_NET_F_MQ | VIRTIO_NET_F_CTRL_VQ;
+	}
+
 	/* finalize guest features bits */
 	virtio_net_set_feature(guest_features, dev);
 }
 
-static void virtio_priv_fini(struct virtio_priv *dev_priv,
+static void virtio_tq_fini(struct virtio_priv *dev_priv, unsigned int qi,
 		struct net_device *dev) {
 	struct virtqueue *vq;
-	struct vring_desc *desc;
-
-	/* free transmit queue */
-	vq = &dev_priv->tq;
-	for (desc = &vq->ring.desc[0];
-			desc < &vq->ring.desc[vq->ring.num]; ++desc) {
-		if (desc->addr != 0) {
-			skb_extra_free(skb_extra_cast_out((void *)(uintptr_t)desc->addr));
-			desc->addr = 0;
-			assert(desc->flags & VRING_DESC_F_NEXT);
+	uint32_t desc_id;
 
-			assert(desc + 1 == &vq->ring.desc[desc->next]);
-			++desc;
-			skb_data_free(skb_data_cast_out((void *)(uintptr_t)desc->addr));
-			desc->addr = 0;
-			assert(~desc->flags & VRING_DESC_F_NEXT);
+	vq = &dev_priv->tq[qi];
+	if (dev_priv->tx_skbs[qi] != NULL) {
+		for (desc_id = 0; desc_id < vq->ring.num; ++desc_id) {
+			if (dev_priv->tx_skbs[qi][desc_id] != NULL) {
+				virtio_tx_release(dev_priv, qi, desc_id);
+			}
 		}
+		sysfree(dev_priv->tx_skbs[qi]);
+		dev_priv->tx_skbs[qi] = NULL;
 	}
 	virtqueue_net_destroy(vq, dev);
+}
+
+static void virtio_rq_fini(struct virtqueue *vq, struct net_device *dev) {
+	struct vring_desc *desc;
 
-	/* free receive queue */
-	vq = &dev_priv->rq;
 	for (desc = &vq->ring.desc[0];
 			desc < &vq->ring.desc[vq->ring.num]; ++desc) {
 		if (desc->addr != 0) {
@@ -271,48 +478,52 @@ static void virtio_priv_fini(struct virtio_priv *dev_priv,
 
 			assert(desc + 1 == &vq->ring.desc[desc->next]);
 			++desc;
-			skb_data_free(skb_data_cast_out((void *)(uintptr_t)desc->addr));
-			desc->addr = 0;
+			if (desc->addr != 0) {
+				skb_data_free(skb_data_cast_out((void *)(uintptr_t)desc->addr));
+				desc->addr = 0;
+			}
 			assert(~desc->flags & VRING_DESC_F_NEXT);
 		}
 	}
 	virtqueue_net_destroy(vq, dev);
 }
 
-static int virtio_priv_init(struct virtio_priv *dev_priv,
-		struct net_device *dev) {
-	int ret, i;
+static void virtio_priv_fini(struct virtio_priv *dev_priv,
+		unsigned int nr_pairs, struct net_device *dev) {
+	unsigned int qi;
+
+	if (dev_priv->has_cq) {
+		virtqueue_net_destroy(&dev_priv->cq, dev);
+	}
+
+	for (qi = 0; qi < nr_pairs; ++qi) {
+		virtio_tq_fini(dev_priv, qi, dev);
+		virtio_rq_fini(&dev_priv->rq[qi], dev);
+	}
+}
+
+static int virtio_rq_fill(struct virtqueue *vq, struct net_device *dev) {
 	struct sk_buff_extra *skb_extra;
 	struct sk_buff_data *skb_data;
-	struct virtqueue *vq;
 	uint32_t desc_id;
 	struct vring_desc *desc;
+	int i;
 
-	/* init receive queue */
-	ret = virtqueue_net_create(&dev_priv->rq, VIRTIO_NET_QUEUE_RX, dev);
-	if (ret != 0) {
-		return ret;
-	}
-
-	/* init transmit queue */
-	ret = virtqueue_net_create(&dev_priv->tq,
-			VIRTIO_NET_QUEUE_TX, dev);
-	if (ret != 0) {
-		virtqueue_net_destroy(&dev_priv->rq, dev);
-		return ret;
+	if (MODOPS_PREP_BUFF_CNT * 2 > vq->ring.num) {
+		return -ENOMEM;
 	}
 
-	/* add receive buffer */
-	vq = &dev_priv->rq;
-	if (MODOPS_PREP_BUFF_CNT * 2 > vq->ring.num) goto out_nomem;
-
 	for (i = 0; i < MODOPS_PREP_BUFF_CNT; ++i) {
 		desc_id = vq->next_free_desc;
 		desc = virtqueue_alloc_desc(vq);
-		if (desc == NULL) goto out_nomem;
+		if (desc == NULL) {
+			return -ENOMEM;
+		}
 
 		skb_extra = skb_extra_alloc();
-		if (skb_extra == NULL) goto out_nomem;
+		if (skb_extra == NULL) {
+			return -ENOMEM;
+		}
 
 		vring_desc_init(desc, skb_extra_cast_in(skb_extra),
 				sizeof(struct virtio_net_hdr),
@@ -320,10 +531,14 @@ static int virtio_priv_init(struct virtio_priv *dev_priv,
 		desc->next = vq->next_free_desc;
 
 		desc = virtqueue_alloc_desc(vq);
-		if (desc == NULL) goto out_nomem;
+		if (desc == NULL) {
+			return -ENOMEM;
+		}
 
 		skb_data = skb_data_alloc(skb_max_size());
-		if (skb_data == NULL) goto out_nomem;
+		if (skb_data == NULL) {
+			return -ENOMEM;
+		}
 
 		vring_desc_init(desc,
 				skb_data_cast_in(skb_data), skb_max_size(),
@@ -331,13 +546,74 @@ static int virtio_priv_init(struct virtio_priv *dev_priv,
 
 		vring_push_desc(desc_id, &vq->ring);
 	}
-	virtio_net_notify_queue(VIRTIO_NET_QUEUE_RX, dev);
+	virtio_net_notify_queue(vq->id, dev);
 
 	return 0;
+}
+
+static int virtio_pair_init(struct virtio_priv *dev_priv, unsigned int qi,
+		struct net_device *dev) {
+	int ret;
+
+	/* init receive queue */
+	ret = virtqueue_net_create(&dev_priv->rq[qi],
+			VIRTIO_NET_QUEUE_RX_N(qi), dev);
+	if (ret != 0) {
+		return ret;
+	}
+
+	/* init transmit queue */
+	ret = virtqueue_net_create(&dev_priv->tq[qi],
+			VIRTIO_NET_QUEUE_TX_N(qi), dev);
+	if (ret != 0) {
+		virtqueue_net_destroy(&dev_priv->rq[qi], dev);
+		return ret;
+	}
 
-out_nomem:
-	virtio_priv_fini(dev_priv, dev);
-	return -ENOMEM;
+	dev_priv->tx_skbs[qi] = sysmalloc(dev_priv->tq[qi].ring.num
+			* sizeof *dev_priv->tx_skbs[qi]);
+	if (dev_priv->tx_skbs[qi] == NULL) {
+		virtqueue_net_destroy(&dev_priv->tq[qi], dev);
+		virtqueue_net_destroy(&dev_priv->rq[qi], dev);
+		return -ENOMEM;
+	}
+	memset(dev_priv->tx_skbs[qi], 0,
+			dev_priv->tq[qi].ring.num * sizeof *dev_priv->tx_skbs[qi]);
+
+	/* add receive buffer */
+	ret = virtio_rq_fill(&dev_priv->rq[qi], dev);
+	if (ret != 0) {
+		virtio_tq_fini(dev_priv, qi, dev);
+		virtio_rq_fini(&dev_priv->rq[qi], dev);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int virtio_priv_init(struct virtio_priv *dev_priv,
+		struct net_device *dev) {
+	unsigned int qi;
+	int ret;
+
+	if (dev_priv->has_cq) {
+		ret = virtqueue_net_create(&dev_priv->cq,
+				VIRTIO_NET_QUEUE_CTRL_N(dev_priv->max_pairs), dev);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	for (qi = 0; qi < dev_priv->nr_pairs; ++qi) {
+		ret = virtio_pair_init(dev_priv, qi, dev);
+		if (ret != 0) {
+			virtio_priv_fini(dev_priv, qi, dev);
+			return ret;
+		}
+	}
+	dev_priv->nr_init = dev_priv->nr_pairs;
+
+	return 0;
 }
 
 static int virtio_init(struct pci_slot_dev *pci_dev) {
@@ -351,6 +627,7 @@ static int virtio_init(struct pci_slot_dev *pci_dev) {
 		return -ENOMEM;
 	}
 	nic->drv_ops = &virtio_drv_ops;
+	nic->features |= NETIF_F_SG;
 	nic->irq = pci_dev->irq;
 	nic->base_addr = pci_dev->bar[0] & PCI_BASE_ADDR_IO_MASK;
 	nic_priv = netdev_priv(nic);
@@ -363,10 +640,14 @@ static int virtio_init(struct pci_slot_dev *pci_dev) {
 		return ret;
 	}
 
+	/* a TX queue of the device for each per-CPU handler, until
+	 * virtio_open() finds out how many pairs the device has enabled */
+	netdev_set_num_tx_queues(nic, nic_priv->nr_pairs);
+
 	ret = irq_attach(nic->irq, virtio_interrupt, IF_SHARESUP, nic, "virtio");
 	if (ret != 0) {
 		log_error("irq_attach returned %d", ret);
-		virtio_priv_fini(nic_priv, nic);
+		virtio_priv_fini(nic_priv, nic_priv->nr_init, nic);
 		return ret;
 	}
 
@@ -21,6 +21,7 @@
  */
 #define VIRTIO_REG_NET_MAC(i) (0x14 + i) /* MAC address (i:0..5) */
 #define VIRTIO_REG_NET_STATUS 0x1A       /* Status (2 bytes) */
+#define VIRTIO_REG_NET_MAX_VQ_PAIRS 0x1C /* Max RX/TX queue pairs (2 bytes) */
 
 /**
  * VirtIO Network Device Queues
@@ -29,6 +30,12 @@
 #define VIRTIO_NET_QUEUE_TX   1 /* Transmission queue */
 #define VIRTIO_NET_QUEUE_CTRL 2 /* Control queue (optional) */
 
+/* With VIRTIO_NET_F_MQ queue pairs go one by one and control queue is
+ * the last one */
+#define VIRTIO_NET_QUEUE_RX_N(i)        (2 * (i))
+#define VIRTIO_NET_QUEUE_TX_N(i)        (2 * (i) + 1)
+#define VIRTIO_NET_QUEUE_CTRL_N(max_qp) (2 * (max_qp))
+
 /**
  * VirtIO Network Device Feature Bits
  */
@@ -87,6 +94,20 @@ struct virtio_net_hdr {
 	uint16_t csum_offset; /* Size of this place */
 };
 
+/**
+ * VirtIO Network Control Command
+ */
+struct virtio_net_ctrl_hdr {
+	uint8_t class;        /* Class of command */
+#define VIRTIO_NET_CTRL_MQ 4
+	uint8_t cmd;          /* Command */
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET 0
+} __attribute__((packed));
+
+/* Status written by device after command data */
+#define VIRTIO_NET_OK  0
+#define VIRTIO_NET_ERR 1
+
 /**
  * VirtIO Operation Definitions For Network Module
  */
@@ -140,4 +161,9 @@ static inline uint16_t virtio_net_get_status(
 	return virtio_load16(VIRTIO_REG_NET_STATUS, dev->base_addr);
 }
 
+static inline uint16_t virtio_net_get_max_vq_pairs(
+		struct net_device *dev) {
+	return virtio_load16(VIRTIO_REG_NET_MAX_VQ_PAIRS, dev->base_addr);
+}
+
 #endif /* DRIVERS_ETHERNET_VIRTIO_NET_H_ */
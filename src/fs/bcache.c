@@ -2,30 +2,75 @@
  * @file
  * @brief Buffer cache
  *
+ * @details Buffers are kept in LRU order and evicted one at a time when
+ *   the cache is full. Modified buffers are written to disk by the flusher
+ *   thread when they become older than @a dirty_expire ms or when there
+ *   are more than @a dirty_ratio percent of dirty buffers in the cache, so
+ *   that eviction usually finds a clean buffer and doesn't wait for disk.
+ *   Blocks read ahead are requested from the device queue without waiting,
+ *   the same thread puts them into the cache when they arrive. Readers of
+ *   such a block wait for it instead of reading it once more.
+ *
  * @author  Alexander Kalmuk
  * @date    22.07.2013
  */
 
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <limits.h>
 
+#include <util/err.h>
 #include <util/hashtable.h>
+#include <util/member.h>
+#include <util/math.h>
+
+#include <hal/clock.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <kernel/thread/waitq.h>
+#include <kernel/time/ktime.h>
+#include <kernel/time/time.h>
 
 #include <mem/misc/pool.h>
 #include <mem/sysmalloc.h>
 
 #include <fs/bcache.h>
+#include <fs/procfs.h>
 
 #include <embox/unit.h>
 EMBOX_UNIT_INIT(bcache_init);
 
-#define BCACHE_SIZE   OPTION_GET(NUMBER, bcache_size)
-#define BCACHE_ALIGN  OPTION_GET(NUMBER, bcache_align)
+#define BCACHE_SIZE         OPTION_GET(NUMBER, bcache_size)
+#define BCACHE_ALIGN        OPTION_GET(NUMBER, bcache_align)
+#define BCACHE_WRITE_BACK   OPTION_GET(BOOLEAN, write_back)
+#define BCACHE_DIRTY_EXPIRE OPTION_GET(NUMBER, dirty_expire)
+#define BCACHE_DIRTY_RATIO  OPTION_GET(NUMBER, dirty_ratio)
+#define BCACHE_FLUSH_PERIOD OPTION_GET(NUMBER, flush_period)
+#define BCACHE_READAHEAD    OPTION_GET(NUMBER, readahead)
+#define BCACHE_PREFETCH_MAX 32
+#define BCACHE_RA_INFLIGHT  4
+/* Buffers locked at once by one caller, the rest are left for others */
+#define BCACHE_LOCK_MAX     ((BCACHE_SIZE / 4) ? (BCACHE_SIZE / 4) : 1)
+#define BCACHE_FLUSH_BATCH \
+	((OPTION_GET(NUMBER, flush_batch) < BCACHE_LOCK_MAX) \
+		? OPTION_GET(NUMBER, flush_batch) : BCACHE_LOCK_MAX)
+
+#define BCACHE_DIRTY_MAX    (BCACHE_SIZE * BCACHE_DIRTY_RATIO / 100)
 
 POOL_DEF(buffer_head_pool, struct buffer_head, BCACHE_SIZE);
+
+/* Most recently used buffers go first */
 static DLIST_DEFINE(bh_list);
 
+/* Buffers in order they became dirty. Protected by @a bh_dirty_lock
+ * because buffers are marked dirty while they are locked, so taking
+ * @a bcache_mutex there would break the lock order */
+static DLIST_DEFINE(bh_dirty_list);
+static spinlock_t bh_dirty_lock = SPIN_STATIC_UNLOCKED;
 
 static size_t bh_hash(void *key);
 static int bh_cmp(void *key1, void *key2);
@@ -34,79 +79,672 @@ POOL_DEF(bcach_ht_item_pool, struct hashtable_item, BCACHE_SIZE);
 
 static struct hashtable *bcache = &bcache_ht;
 static struct mutex bcache_mutex;
-static int graw_buffers(struct block_dev *bdev, int block, size_t size);
-static void free_more_memory(size_t size);
-
-struct buffer_head *bcache_getblk_locked(struct block_dev *bdev, int block, size_t size) {
+static struct bcache_stats bcache_stats;
+
+static struct waitq bcache_flush_wq;
+static struct thread *bcache_flusher;
+
+/* Readahead requests which the device hasn't completed yet */
+struct bcache_ra {
+	struct bio bio;
+	struct block_dev *bdev;     /* NULL if the slot is free */
+	int block;
+	int count;
+	size_t size;
+	int done;                   /* bio is completed, data are to be cached */
+};
+
+static struct bcache_ra bcache_ra[BCACHE_RA_INFLIGHT];
+static spinlock_t bcache_ra_lock = SPIN_STATIC_UNLOCKED;
+static struct waitq bcache_ra_wq;
+static int bcache_ra_done;
+
+static struct buffer_head *graw_buffers(struct block_dev *bdev, int block, size_t size);
+static int free_more_memory(size_t size);
+
+static struct buffer_head *__bcache_getblk_locked(struct block_dev *bdev,
+		int block, size_t size, bool readahead) {
 	struct buffer_head key = { .bdev = bdev, .block = block };
 	struct buffer_head *bh;
 
 	assert(bdev);
 
 	mutex_lock(&bcache_mutex);
-	while (1) {
-		bh = (struct buffer_head *)hashtable_get(bcache, &key);
+	bh = (struct buffer_head *)hashtable_get(bcache, &key);
 
-		if (bh) {
-			assert(size == bh->blocksize);
-			bcache_buffer_lock(bh);
+	if (bh) {
+		assert(size == bh->blocksize);
+		if (!readahead) {
+			bcache_stats.hits++;
+		}
+	} else {
+		while (NULL == (bh = graw_buffers(bdev, block, size))) {
+			if (0 == free_more_memory(size)) {
+				continue;
+			}
+
+			/* Everything is in use, let somebody release a buffer */
 			mutex_unlock(&bcache_mutex);
-			return bh;
+			ksleep(1);
+			mutex_lock(&bcache_mutex);
+
+			bh = (struct buffer_head *)hashtable_get(bcache, &key);
+			if (bh) {
+				break;
+			}
+		}
+		if (!readahead) {
+			bcache_stats.misses++;
+		}
+	}
+
+	dlist_move(&bh->bh_next, &bh_list);
+	bcache_buffer_lock(bh);
+	mutex_unlock(&bcache_mutex);
+
+	return bh;
+}
+
+/* Returns readahead slot which covers [@a block, @a block + @a count) of
+ * @a bdev partially. Must be called with bcache_ra_lock held */
+static struct bcache_ra *bcache_ra_find(struct block_dev *bdev, int block,
+		int count) {
+	struct bcache_ra *ra;
+
+	for (ra = &bcache_ra[0]; ra < &bcache_ra[BCACHE_RA_INFLIGHT]; ra++) {
+		if (ra->bdev && (!bdev || ra->bdev == bdev)
+				&& block < ra->block + ra->count
+				&& ra->block < block + count) {
+			return ra;
+		}
+	}
+
+	return NULL;
+}
+
+static int bcache_ra_busy(struct block_dev *bdev, int block, int count) {
+	struct bcache_ra *ra;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bcache_ra_lock);
+	ra = bcache_ra_find(bdev, block, count);
+	spin_unlock_ipl(&bcache_ra_lock, ipl);
+
+	return ra != NULL;
+}
+
+struct buffer_head *bcache_getblk_locked(struct block_dev *bdev, int block, size_t size) {
+	/* The block is going to be cached by readahead, don't read it twice */
+	WAITQ_WAIT(&bcache_ra_wq, !bcache_ra_busy(bdev, block, 1));
+
+	return __bcache_getblk_locked(bdev, block, size, false);
+}
+
+int bcache_lock_max(void) {
+	return BCACHE_LOCK_MAX;
+}
+
+static void bcache_dirty_add(struct buffer_head *bh) {
+	unsigned int dirty;
+
+	spin_lock(&bh_dirty_lock);
+	{
+		buffer_set_flag(bh, BH_DIRTY);
+		dlist_add_prev(&bh->bh_dirty, &bh_dirty_list);
+		dirty = ++bcache_stats.dirty;
+	}
+	spin_unlock(&bh_dirty_lock);
+
+	if (dirty > BCACHE_DIRTY_MAX) {
+		waitq_wakeup_all(&bcache_flush_wq);
+	}
+}
+
+static void bcache_dirty_del(struct buffer_head *bh) {
+	spin_lock(&bh_dirty_lock);
+	{
+		buffer_clear_flag(bh, BH_DIRTY);
+		if (!dlist_empty(&bh->bh_dirty)) {
+			dlist_del_init(&bh->bh_dirty);
+			bcache_stats.dirty--;
+		}
+	}
+	spin_unlock(&bh_dirty_lock);
+}
+
+/* Writes locked buffer @a bh to disk */
+static int bcache_write_buffer(struct buffer_head *bh) {
+	int res;
+
+	assert(bh->bdev && bh->bdev->driver);
+
+	/**
+	 * Blocks are stored in the buffer cache in a decrypted state.
+	 * Therefore first we encrypt block, then write it onto disk and then decrypt block.
+	 */
+	buffer_encrypt(bh);
+	res = block_dev_rw(bh->bdev, BIO_WRITE, bh->data, bh->blocksize, bh->block);
+	buffer_decrypt(bh);
+
+	if (res != bh->blocksize) {
+		return res < 0 ? res : -EIO;
+	}
+
+	bcache_stats.writebacks++;
+
+	return 0;
+}
+
+/* Writes dirty locked buffer @a bh to disk and marks it clean */
+static int bcache_writeback(struct buffer_head *bh) {
+	int res;
+
+	bcache_dirty_del(bh);
+
+	res = bcache_write_buffer(bh);
+	if (res != 0) {
+		bcache_dirty_add(bh);
+	}
+
+	return res;
+}
+
+int bcache_mark_dirty(struct buffer_head *bh) {
+	assert(buffer_locked(bh));
+
+	if (!BCACHE_WRITE_BACK) {
+		return bcache_write_buffer(bh);
+	}
+
+	if (!buffer_dirty(bh)) {
+		bh->dirty_time = clock_sys_ticks();
+		bcache_dirty_add(bh);
+	}
+
+	return 0;
+}
+
+/* Returns the oldest dirty buffer which has to be written now */
+static struct buffer_head *bcache_dirty_next(struct block_dev *bdev,
+		bool force) {
+	struct buffer_head *bh;
+	clock_t now;
+
+	now = clock_sys_ticks();
+
+	dlist_foreach_entry(bh, &bh_dirty_list, bh_dirty) {
+		if (!force && bcache_stats.dirty <= BCACHE_DIRTY_MAX
+				&& now - bh->dirty_time < ms2jiffies(BCACHE_DIRTY_EXPIRE)) {
+			/* The rest of buffers are younger */
+			return NULL;
+		}
+
+		if (buffer_locked(bh) || buffer_journal(bh)
+				|| (bdev && bh->bdev != bdev)) {
+			continue;
 		}
 
-		while (-1 == graw_buffers(bdev, block, size)) {
-			free_more_memory(size);
+		return bh;
+	}
+
+	return NULL;
+}
+
+/**
+ * Writes up to @a BCACHE_FLUSH_BATCH dirty buffers of one device as a single
+ * batch of bios, so the device queue merges adjacent ones.
+ *
+ * @return
+ *   Number of buffers written, 0 if nothing to write, negative error code
+ */
+static int bcache_flush_batch(struct block_dev *bdev, bool force) {
+	struct buffer_head *bhs[BCACHE_FLUSH_BATCH];
+	struct bio bios[BCACHE_FLUSH_BATCH];
+	struct buffer_head *bh;
+	int i, n, nbios, res;
+
+	mutex_lock(&bcache_mutex);
+	for (n = 0; n < BCACHE_FLUSH_BATCH; n++) {
+		spin_lock(&bh_dirty_lock);
+		bh = bcache_dirty_next(bdev, force);
+		spin_unlock(&bh_dirty_lock);
+
+		if (!bh) {
+			break;
 		}
+
+		/* Locked buffers are skipped by bcache_dirty_next() */
+		bcache_buffer_lock(bh);
+		bhs[n] = bh;
+		bdev = bh->bdev;
 	}
 	mutex_unlock(&bcache_mutex);
 
-	assert(0); /* UNREACHABLE */
+	for (i = 0, nbios = 0; i < n; i++) {
+		bh = bhs[i];
+		if (!buffer_dirty(bh)) {
+			/* Journal has already written it */
+			bcache_dirty_del(bh);
+			bcache_buffer_unlock(bh);
+			bhs[i] = NULL;
+			continue;
+		}
+
+		bcache_dirty_del(bh);
+		/* Blocks are stored in the buffer cache decrypted */
+		buffer_encrypt(bh);
+		bios[nbios++] = (struct bio) {
+			.bdev = bh->bdev,
+			.dir = BIO_WRITE,
+			.blkno = bh->block,
+			.buf = bh->data,
+			.count = bh->blocksize,
+		};
+	}
+
+	res = block_dev_submit_wait(bios, nbios);
+
+	for (i = 0; i < n; i++) {
+		bh = bhs[i];
+		if (bh == NULL) {
+			continue;
+		}
+
+		buffer_decrypt(bh);
+		if (res != 0) {
+			bcache_dirty_add(bh);
+		} else {
+			bcache_stats.writebacks++;
+		}
+		bcache_buffer_unlock(bh);
+	}
+
+	return res ? res : n;
+}
+
+static void bcache_ra_complete(void);
+
+static void *bcache_flusher_run(void *arg) {
+	while (1) {
+		WAITQ_WAIT_TIMEOUT(&bcache_flush_wq,
+				bcache_stats.dirty > BCACHE_DIRTY_MAX
+				|| *(volatile int *) &bcache_ra_done,
+				BCACHE_FLUSH_PERIOD);
+
+		bcache_ra_complete();
+
+		while (0 < bcache_flush_batch(NULL, false)) {
+		}
+	}
+
 	return NULL;
 }
 
-static void free_more_memory(size_t size) {
-	struct buffer_head *bh = NULL;
+int bcache_sync(struct block_dev *bdev) {
+	int res;
+
+	while (0 < (res = bcache_flush_batch(bdev, true))) {
+	}
+
+	return res;
+}
+
+static void bcache_free_buffer(struct buffer_head *bh) {
 	struct hashtable_item *ht_item;
 
-	/* Free everything that we can free */
+	dlist_del(&bh->bh_next);
+	ht_item = hashtable_del(bcache, bh);
+	bcache_stats.buffers--;
+
+	sysfree(bh->data);
+	pool_free(&bcach_ht_item_pool, ht_item);
+	pool_free(&buffer_head_pool, bh);
+}
+
+void bcache_invalidate(struct block_dev *bdev) {
+	struct buffer_head *bh;
+
+	/* Readahead of the device is going to add buffers */
+	WAITQ_WAIT(&bcache_ra_wq, !bcache_ra_busy(bdev, 0, INT_MAX));
+
+	bcache_sync(bdev);
+
+	/* The device is going to be freed, so buffers which are still dirty
+	 * because their writing failed are dropped too */
+	mutex_lock(&bcache_mutex);
 	dlist_foreach_entry(bh, &bh_list, bh_next) {
-		if (buffer_locked(bh)) {
+		if (bh->bdev != bdev) {
 			continue;
 		}
 
+		/* Wait for the flusher which may write it right now */
 		bcache_buffer_lock(bh);
-		{
-			if (buffer_journal(bh)) {
-				bcache_buffer_unlock(bh);
-				continue;
+		if (buffer_dirty(bh)) {
+			bcache_dirty_del(bh);
+			bcache_stats.lost++;
+		}
+		bcache_buffer_unlock(bh);
+
+		bcache_free_buffer(bh);
+	}
+	mutex_unlock(&bcache_mutex);
+}
+
+/* Reads up to @a count uncached blocks starting with @a block */
+static int bcache_prefetch_run(struct block_dev *bdev, int block, int count,
+		size_t size) {
+	struct buffer_head key = { .bdev = bdev };
+	struct buffer_head *bh;
+	int n, i;
+	char *buf;
+
+	mutex_lock(&bcache_mutex);
+	for (n = 0; n < count; n++) {
+		key.block = block + n;
+		if (hashtable_get(bcache, &key)) {
+			break;
+		}
+	}
+	mutex_unlock(&bcache_mutex);
+
+	if (n == 0) {
+		return 0;
+	}
+
+	buf = sysmemalign(BCACHE_ALIGN, n * size);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	if (n * size == block_dev_rw(bdev, BIO_READ, buf, n * size, block)) {
+		for (i = 0; i < n; i++) {
+			bh = __bcache_getblk_locked(bdev, block + i, size, true);
+			if (buffer_new(bh)) {
+				memcpy(bh->data, buf + i * size, size);
+				if (0 == buffer_decrypt(bh)) {
+					buffer_clear_flag(bh, BH_NEW);
+					bcache_stats.readahead++;
+				}
 			}
+			bcache_buffer_unlock(bh);
+		}
+	}
+
+	sysfree(buf);
+
+	return n;
+}
+
+void bcache_prefetch(struct block_dev *bdev, int block, int count,
+		size_t size) {
+	struct buffer_head key = { .bdev = bdev };
+	int nblocks, n;
+
+	if (!(bdev->driver->read || bdev->driver->request)) {
+		return;
+	}
+
+	nblocks = bdev->size / size;
+	if (block + count > nblocks) {
+		count = nblocks - block;
+	}
+
+	while (count > 0) {
+		/* cached blocks are skipped, the rest are read in runs */
+		mutex_lock(&bcache_mutex);
+		key.block = block;
+		n = (NULL != hashtable_get(bcache, &key));
+		mutex_unlock(&bcache_mutex);
+
+		if (n == 0) {
+			n = bcache_prefetch_run(bdev, block,
+					min(count, BCACHE_PREFETCH_MAX), size);
+			if (n <= 0) {
+				return;
+			}
+		}
+
+		block += n;
+		count -= n;
+	}
+}
 
-			if (buffer_dirty(bh)) {
-				assert(bh->bdev && bh->bdev->driver);
-				assert(bh->bdev->driver->write);
-				/* Write directly to disk */
-				bh->bdev->driver->write(bh->bdev, bh->data, bh->blocksize, bh->block);
+static void bcache_ra_release(struct bcache_ra *ra) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bcache_ra_lock);
+	ra->bdev = NULL;
+	spin_unlock_ipl(&bcache_ra_lock, ipl);
+
+	waitq_wakeup_all(&bcache_ra_wq);
+}
+
+/* Called by the device queue, maybe in interrupt */
+static void bcache_ra_end_io(struct bio *bio) {
+	struct bcache_ra *ra = bio->private;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bcache_ra_lock);
+	ra->done = 1;
+	bcache_ra_done = 1;
+	spin_unlock_ipl(&bcache_ra_lock, ipl);
+
+	waitq_wakeup_all(&bcache_flush_wq);
+}
+
+/* Puts a block which was read ahead into the cache unless somebody has
+ * cached it meanwhile. Buffers which are in use are never waited for */
+static void bcache_ra_install(struct bcache_ra *ra, int i) {
+	struct buffer_head key = { .bdev = ra->bdev, .block = ra->block + i };
+	struct buffer_head *bh;
+
+	mutex_lock(&bcache_mutex);
+	if (!hashtable_get(bcache, &key)) {
+		bh = graw_buffers(ra->bdev, ra->block + i, ra->size);
+		if (!bh && (0 == free_more_memory(ra->size))) {
+			bh = graw_buffers(ra->bdev, ra->block + i, ra->size);
+		}
+		if (bh) {
+			memcpy(bh->data, ra->bio.buf + i * ra->size, ra->size);
+			if (0 == buffer_decrypt(bh)) {
+				buffer_clear_flag(bh, BH_NEW);
+				bcache_stats.readahead++;
 			}
+		}
+	}
+	mutex_unlock(&bcache_mutex);
+}
+
+/* Caches data of completed readahead requests and frees their slots */
+static void bcache_ra_complete(void) {
+	struct bcache_ra *ra;
+	int i, done;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&bcache_ra_lock);
+	bcache_ra_done = 0;
+	spin_unlock_ipl(&bcache_ra_lock, ipl);
+
+	for (ra = &bcache_ra[0]; ra < &bcache_ra[BCACHE_RA_INFLIGHT]; ra++) {
+		ipl = spin_lock_ipl(&bcache_ra_lock);
+		done = (ra->bdev && ra->done);
+		spin_unlock_ipl(&bcache_ra_lock, ipl);
 
-			dlist_del(&bh->bh_next);
-			ht_item = hashtable_del(bcache, bh);
+		if (!done) {
+			continue;
 		}
-		bcache_buffer_unlock(bh);
 
-		sysfree(bh->data);
-		pool_free(&bcach_ht_item_pool, ht_item);
-		pool_free(&buffer_head_pool, bh);
+		for (i = 0; (i < ra->count) && !ra->bio.error; i++) {
+			bcache_ra_install(ra, i);
+		}
+
+		sysfree(ra->bio.buf);
+		bcache_ra_release(ra);
+	}
+}
+
+/* Requests up to @a count uncached blocks starting with @a block without
+ * waiting for them */
+static void bcache_ra_submit(struct block_dev *bdev, int block, int count,
+		size_t size) {
+	struct buffer_head key = { .bdev = bdev };
+	struct bcache_ra *ra, *slot;
+	char *buf;
+	int n;
+	ipl_t ipl;
+
+	if (!(bdev->driver->read || bdev->driver->request)) {
+		return;
+	}
+
+	count = min(count, min((int) (bdev->size / size) - block,
+				BCACHE_PREFETCH_MAX));
+	if (count <= 0) {
+		return;
+	}
+
+	/* Readers of the blocks wait for the slot from now on */
+	slot = NULL;
+	ipl = spin_lock_ipl(&bcache_ra_lock);
+	if (!bcache_ra_find(bdev, block, count)) {
+		for (ra = &bcache_ra[0]; ra < &bcache_ra[BCACHE_RA_INFLIGHT]; ra++) {
+			if (!ra->bdev) {
+				slot = ra;
+				slot->bdev = bdev;
+				slot->block = block;
+				slot->count = count;
+				slot->size = size;
+				slot->done = 0;
+				break;
+			}
+		}
+	}
+	spin_unlock_ipl(&bcache_ra_lock, ipl);
+
+	if (!slot) {
+		/* Already requested or too many requests in flight */
+		return;
+	}
+
+	mutex_lock(&bcache_mutex);
+	for (n = 0; n < count; n++) {
+		key.block = block + n;
+		if (hashtable_get(bcache, &key)) {
+			break;
+		}
+	}
+	mutex_unlock(&bcache_mutex);
+
+	buf = n ? sysmemalign(BCACHE_ALIGN, n * size) : NULL;
+	if (!buf) {
+		bcache_ra_release(slot);
+		return;
+	}
+
+	ipl = spin_lock_ipl(&bcache_ra_lock);
+	slot->count = n;
+	spin_unlock_ipl(&bcache_ra_lock, ipl);
+	if (n < count) {
+		/* Readers of the blocks which are cached already may go */
+		waitq_wakeup_all(&bcache_ra_wq);
+	}
+
+	slot->bio = (struct bio) {
+		.bdev = bdev,
+		.dir = BIO_READ,
+		.blkno = block,
+		.buf = buf,
+		.count = n * size,
+		.end_io = bcache_ra_end_io,
+		.private = slot,
+	};
+
+	if (0 != block_dev_submit_bio(&slot->bio)) {
+		sysfree(buf);
+		bcache_ra_release(slot);
+	}
+}
+
+void bcache_readahead(struct block_dev *bdev, int block, size_t size) {
+	struct buffer_head key = { .bdev = bdev, .block = block - 1 };
+	bool sequential;
+
+	if (BCACHE_READAHEAD == 0 || block == 0) {
+		return;
+	}
+
+	mutex_lock(&bcache_mutex);
+	sequential = (NULL != hashtable_get(bcache, &key));
+	mutex_unlock(&bcache_mutex);
+
+	if (sequential) {
+		bcache_ra_submit(bdev, block + 1, BCACHE_READAHEAD, size);
+	}
+}
+
+void bcache_get_stats(struct bcache_stats *stats) {
+	assert(stats);
+
+	mutex_lock(&bcache_mutex);
+	memcpy(stats, &bcache_stats, sizeof *stats);
+	mutex_unlock(&bcache_mutex);
+}
+
+/**
+ * Evicts the least recently used buffer which is not in use. Clean buffers
+ * are preferred, the oldest dirty one is written synchronously only if
+ * there are no clean buffers.
+ */
+static int free_more_memory(size_t size) {
+	struct buffer_head *bh, *victim = NULL;
+	struct dlist_head *lnk;
+
+	for (lnk = bh_list.prev; lnk != &bh_list; lnk = lnk->prev) {
+		bh = member_cast_out(lnk, struct buffer_head, bh_next);
+
+		if (buffer_locked(bh) || buffer_journal(bh)) {
+			continue;
+		}
+
+		if (!buffer_dirty(bh)) {
+			victim = bh;
+			break;
+		}
+
+		if (!victim) {
+			victim = bh;
+		}
+	}
+
+	if (!victim) {
+		return -1;
+	}
+
+	bcache_buffer_lock(victim);
+	if (buffer_dirty(victim)) {
+		waitq_wakeup_all(&bcache_flush_wq);
+
+		if (0 != bcache_writeback(victim)) {
+			bcache_buffer_unlock(victim);
+			return -1;
+		}
 	}
+	bcache_buffer_unlock(victim);
+
+	bcache_free_buffer(victim);
+	bcache_stats.evictions++;
+
+	return 0;
 }
 
-static int graw_buffers(struct block_dev *bdev, int block, size_t size) {
+static struct buffer_head *graw_buffers(struct block_dev *bdev, int block, size_t size) {
 	struct buffer_head *bh;
 	struct hashtable_item *ht_item;
 
 	bh = pool_alloc(&buffer_head_pool);
 
 	if (!bh) {
-		return -1;
+		return NULL;
 	}
 
 	memset(bh, 0, sizeof(struct buffer_head));
@@ -114,6 +752,7 @@ static int graw_buffers(struct block_dev *bdev, int block, size_t size) {
 	buffer_set_flag(bh, BH_NEW);
 	mutex_init(&bh->mutex);
 	dlist_head_init(&bh->bh_next);
+	dlist_head_init(&bh->bh_dirty);
 	bh->bdev = bdev;
 	bh->block = block;
 	bh->blocksize = size;
@@ -121,24 +760,30 @@ static int graw_buffers(struct block_dev *bdev, int block, size_t size) {
 
 	if (!bh->data) {
 		pool_free(&buffer_head_pool, bh);
-		return -1;
+		return NULL;
 	}
 	ht_item = pool_alloc(&bcach_ht_item_pool);
 	if (!ht_item) {
 		sysfree(bh->data);
 		pool_free(&buffer_head_pool, bh);
-		return -1;
+		return NULL;
 	}
 	ht_item = hashtable_item_init(ht_item, bh, bh);
 	hashtable_put(bcache, ht_item);
 
 	dlist_add_next(&bh->bh_next, &bh_list);
+	bcache_stats.buffers++;
 
-	return 0;
+	return bh;
 }
 
 static size_t bh_hash(void *key) {
-	return ((struct buffer_head *)key)->block;
+	struct buffer_head *bh = (struct buffer_head *)key;
+	uint32_t hash;
+
+	hash = ((uint32_t)(uintptr_t)bh->bdev ^ (uint32_t)bh->block) * 0x9e3779b1;
+
+	return hash ^ (hash >> 16);
 }
 
 static int bh_cmp(void *key1, void *key2) {
@@ -154,9 +799,39 @@ static int bh_cmp(void *key1, void *key2) {
 	return cmp_bdev;
 }
 
+static int bcache_proc_read(char *buf, size_t size) {
+	struct bcache_stats stats;
+
+	bcache_get_stats(&stats);
+
+	return snprintf(buf, size,
+			"buffers    %u\n"
+			"dirty      %u\n"
+			"hits       %lu\n"
+			"misses     %lu\n"
+			"readahead  %lu\n"
+			"evictions  %lu\n"
+			"writebacks %lu\n"
+			"lost       %lu\n",
+			stats.buffers, stats.dirty, stats.hits, stats.misses,
+			stats.readahead, stats.evictions, stats.writebacks, stats.lost);
+}
+
+PROCFS_ENTRY_DEF("bcache", bcache_proc_read);
+
 static int bcache_init(void) {
 
 	mutex_init(&bcache_mutex);
+	waitq_init(&bcache_flush_wq);
+	waitq_init(&bcache_ra_wq);
+
+	/* The thread caches blocks read ahead as well */
+	if (BCACHE_WRITE_BACK || BCACHE_READAHEAD) {
+		bcache_flusher = thread_create(0, bcache_flusher_run, NULL);
+		if (err(bcache_flusher)) {
+			return err(bcache_flusher);
+		}
+	}
 
 	return 0;
 }
@@ -29,6 +29,7 @@
 
 #include <util/array.h>
 #include <util/err.h>
+#include <util/math.h>
 #include <embox/unit.h>
 #include <drivers/block_dev.h>
 #include <mem/misc/pool.h>
@@ -119,6 +120,8 @@
 
 static int ext2_read_inode(struct nas *nas, uint32_t);
 static int ext2_block_map(struct nas *nas, int32_t, uint32_t *);
+static int ext2_map_run(struct nas *nas, uint32_t, uint32_t,
+		uint32_t *, uint32_t *);
 static int ext2_buf_read_file(struct nas *nas, char **, size_t *);
 static size_t ext2_write_file(struct nas *nas, char *buf_p, size_t size);
 static int ext2_new_block(struct nas *nas, long position);
@@ -135,6 +138,9 @@ POOL_DEF(ext2_fs_pool, struct ext2_fs_info,
 POOL_DEF(ext2_file_pool, struct ext2_file_info,
 		OPTION_GET(NUMBER,inode_quantity));
 
+/* maximum readahead window of a file, in filesystem blocks */
+#define EXT2_READAHEAD OPTION_GET(NUMBER,readahead)
+
 #define FS_NAME "ext2"
 
 /* TODO link counter */
@@ -486,18 +492,99 @@ static int ext2fs_close(struct file_desc *desc) {
 	return ext2_close(nas);
 }
 
+/*
+ * Read whole blocks starting at fi->f_pointer straight into @a buf. Only
+ * one run of contiguous blocks is read, @a nread_p is set to its length.
+ */
+static int ext2_read_run(struct nas *nas, char *buf, uint32_t nblocks,
+		uint32_t *nread_p) {
+	int rc;
+	uint32_t disk_block, len;
+	struct ext2_file_info *fi;
+	struct ext2_fs_info *fsi;
+
+	fi = inode_priv(nas->node);
+	fsi = nas->fs->sb_data;
+
+	rc = ext2_map_run(nas, lblkno(fsi, fi->f_pointer), nblocks,
+			&disk_block, &len);
+	if (rc != 0) {
+		return rc;
+	}
+
+	if (disk_block == 0) {
+		memset(buf, 0, len * fsi->s_block_size);
+	} else if (len != ext2_read_sector(nas->fs, buf, len, disk_block)) {
+		return EIO;
+	}
+
+	*nread_p = len;
+	return 0;
+}
+
+/*
+ * Read ahead blocks following a sequential read. The window grows twice
+ * on each sequential read up to EXT2_READAHEAD blocks, and is dropped
+ * on a random access.
+ */
+static void ext2_readahead(struct nas *nas, uint32_t first_block) {
+	uint32_t block, end, nblocks, disk_block, len;
+	struct ext2_file_info *fi;
+	struct ext2_fs_info *fsi;
+
+	fi = inode_priv(nas->node);
+	fsi = nas->fs->sb_data;
+
+	if (EXT2_READAHEAD == 0) {
+		return;
+	}
+
+	if (first_block != fi->f_ra_next) {
+		fi->f_ra_size = 0;
+		fi->f_ra_end = 0;
+	} else {
+		fi->f_ra_size = fi->f_ra_size ? min(fi->f_ra_size * 2,
+				(uint32_t) EXT2_READAHEAD) : min(4, EXT2_READAHEAD);
+	}
+	fi->f_ra_next = lblkno(fsi, fi->f_pointer);
+
+	/* Start the next window once half of the previous one is consumed */
+	if ((fi->f_ra_size == 0)
+			|| (fi->f_ra_next + fi->f_ra_size / 2 < fi->f_ra_end)) {
+		return;
+	}
+
+	nblocks = lblkno(fsi, fi->f_di.i_size + fsi->s_block_size - 1);
+	end = min(fi->f_ra_next + fi->f_ra_size, nblocks);
+
+	for (block = max(fi->f_ra_next, fi->f_ra_end); block < end; block += len) {
+		if (0 != ext2_map_run(nas, block, end - block, &disk_block, &len)) {
+			break;
+		}
+		if (disk_block != 0) {
+			block_dev_readahead(nas->fs->bdev, len * fsi->s_block_size,
+					fsbtodb(fsi, disk_block));
+		}
+	}
+	fi->f_ra_end = end;
+}
+
 static size_t ext2fs_read(struct file_desc *desc, void *buff, size_t size) {
 	int rc;
-	size_t csize;
+	size_t csize, left;
 	char *buf;
 	size_t buf_size;
 	char *addr = buff;
+	uint32_t first_block, nread;
 	struct nas *nas;
 	struct ext2_file_info *fi;
+	struct ext2_fs_info *fsi;
 
 	nas = desc->f_inode->nas;
 	fi = inode_priv(nas->node);
+	fsi = nas->fs->sb_data;
 	fi->f_pointer = file_get_pos(desc);
+	first_block = lblkno(fsi, fi->f_pointer);
 
 	while (size != 0) {
 		/* XXX should handle LARGEFILE */
@@ -505,23 +592,38 @@ static size_t ext2fs_read(struct file_desc *desc, void *buff, size_t size) {
 			break;
 		}
 
-		if (0 != (rc = ext2_buf_read_file(nas, &buf, &buf_size))) {
-			SET_ERRNO(rc);
-			return 0;
-		}
+		left = min(size, fi->f_di.i_size - fi->f_pointer);
+		if ((blkoff(fsi, fi->f_pointer) == 0)
+				&& (left >= fsi->s_block_size)) {
+			/* Whole blocks go to the user buffer without a copy */
+			if (0 != (rc = ext2_read_run(nas, addr,
+							left / fsi->s_block_size, &nread))) {
+				SET_ERRNO(rc);
+				return 0;
+			}
 
-		csize = size;
-		if (csize > buf_size) {
-			csize = buf_size;
-		}
+			csize = nread * fsi->s_block_size;
+		} else {
+			if (0 != (rc = ext2_buf_read_file(nas, &buf, &buf_size))) {
+				SET_ERRNO(rc);
+				return 0;
+			}
+
+			csize = size;
+			if (csize > buf_size) {
+				csize = buf_size;
+			}
 
-		memcpy(addr, buf, csize);
+			memcpy(addr, buf, csize);
+		}
 
 		fi->f_pointer += csize;
 		addr += csize;
 		size -= csize;
 	}
 
+	ext2_readahead(nas, first_block);
+
 	return (addr - (char *) buff);
 }
 
@@ -948,6 +1050,16 @@ static int ext2fs_umount_entry(struct inode *node) {
 
 extern void e2fs_i_bswap(struct ext2fs_dinode *old, struct ext2fs_dinode *new);
 
+/*
+ * Forget cached block mapping of a file. Must be called when blocks
+ * of the file are allocated or freed.
+ */
+static void ext2_map_cache_inval(struct ext2_file_info *fi) {
+	fi->f_ind_cache_block = ~0;
+	memset(fi->f_ext_cache, 0, sizeof fi->f_ext_cache);
+	fi->f_ext_cache_next = 0;
+}
+
 /*
  * Read a new inode into a file structure.
  */
@@ -979,8 +1091,9 @@ static int ext2_read_inode(struct nas *nas, uint32_t inumber) {
 	e2fs_iload(dip, &fi->f_di);
 
 	/* Clear out the old buffers */
-	fi->f_ind_cache_block = ~0;
 	fi->f_buf_blkno = -1;
+	ext2_map_cache_inval(fi);
+	fi->f_ra_next = fi->f_ra_end = fi->f_ra_size = 0;
 	return 0;
 }
 
@@ -1091,6 +1204,66 @@ static int ext2_block_map(struct nas *nas, int32_t file_block,
 	return 0;
 }
 
+/*
+ * Find the run of contiguous disk blocks which starts with @a file_block.
+ * The run is at most @a max_len blocks long. A hole is reported as
+ * a single block with disk block 0.
+ */
+static int ext2_map_run(struct nas *nas, uint32_t file_block, uint32_t max_len,
+		uint32_t *disk_block_p, uint32_t *len_p) {
+	int rc;
+	uint32_t disk_block, next, len, limit, i;
+	struct ext2_extent_cache *ec;
+	struct ext2_file_info *fi;
+	struct ext2_fs_info *fsi;
+
+	fi = inode_priv(nas->node);
+	fsi = nas->fs->sb_data;
+
+	for (i = 0; i < EXT_CACHE_SZ; i++) {
+		ec = &fi->f_ext_cache[i];
+		if ((file_block >= ec->ec_lblk)
+				&& (file_block - ec->ec_lblk < ec->ec_len)) {
+			*disk_block_p = ec->ec_pblk + (file_block - ec->ec_lblk);
+			*len_p = min(ec->ec_len - (file_block - ec->ec_lblk), max_len);
+			return 0;
+		}
+	}
+
+	/* ext2_block_map() reads indirect blocks into f_buf */
+	fi->f_buf_blkno = -1;
+
+	if (0 != (rc = ext2_block_map(nas, file_block, &disk_block))) {
+		return rc;
+	}
+
+	*disk_block_p = disk_block;
+	*len_p = 1;
+	if (disk_block == 0) {
+		return 0;
+	}
+
+	/* Map the run up to the end of the file, but walk at most a single
+	 * indirect block for that */
+	limit = lblkno(fsi, fi->f_di.i_size + fsi->s_block_size - 1);
+	limit = min(limit - file_block, (uint32_t) NINDIR(fsi));
+	for (len = 1; len < limit; len++) {
+		if (0 != ext2_block_map(nas, file_block + len, &next)
+				|| (next != disk_block + len)) {
+			break;
+		}
+	}
+
+	ec = &fi->f_ext_cache[fi->f_ext_cache_next];
+	fi->f_ext_cache_next = (fi->f_ext_cache_next + 1) % EXT_CACHE_SZ;
+	ec->ec_lblk = file_block;
+	ec->ec_pblk = disk_block;
+	ec->ec_len = len;
+
+	*len_p = min(len, max_len);
+	return 0;
+}
+
 /*
  * Read a portion of a file into an internal buffer.
  * Return the location in the buffer and the amount in the buffer.
@@ -1653,6 +1826,8 @@ int ext2_write_map(struct nas *nas, long position,
 	fi = inode_priv(nas->node);
 	fsi = nas->fs->sb_data;
 
+	ext2_map_cache_inval(fi);
+
 	old_block = b1 = b2 = b3 = NO_BLOCK;
 	single = triple = 0;
 	new_ind = new_dbl = new_triple = 0;
@@ -2089,6 +2264,7 @@ static void ext2_wipe_inode(struct ext2_file_info *fi,
 	for (int i = 0; i < EXT2_N_BLOCKS; i++) {
 		di->i_block[i] = NO_BLOCK;
 	}
+	ext2_map_cache_inval(fi);
 
 	di->i_mode  = dir_di->i_mode & ~S_IFMT;
 	di->i_uid   = dir_di->i_uid;
@@ -11,8 +11,10 @@
 #include <drivers/device.h>
 #include <framework/mod/options.h>
 #include <fs/dvfs.h>
+#include <fs/procfs.h>
 
 #include <util/array.h>
+#include <util/math.h>
 
 #include <module/embox/driver/block_dev.h>
 
@@ -21,6 +23,10 @@
 #include <net/net_namespace.h>
 #include <kernel/task.h>
 
+#define PROCFS_ENTRY_SIZE 512
+
+ARRAY_SPREAD_DEF(const struct procfs_entry, __procfs_entries);
+
 extern net_namespace_p net_ns_lookup(const char *name);
 extern net_namespace_p net_ns_lookup_by_inode(struct inode *inode);
 
@@ -34,14 +40,35 @@ static int is_number(const char *str) {
 		return 1;
 }
 
+static const struct procfs_entry *procfs_entry_lookup(char const *name) {
+	const struct procfs_entry *entry;
+
+	array_spread_foreach_ptr(entry, __procfs_entries) {
+		if (0 == strcmp(entry->name, name)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
 static struct inode *procfs_lookup(char const *name, struct inode const *dir) {
 	struct inode *node;
 	net_namespace_p net_ns_p;
+	const struct procfs_entry *entry;
 
 	if (NULL == (node = inode_new(dir->i_sb))) { /* where it's freed? */
 		return NULL;
 	}
 
+	/* /proc/<entry> case */
+	if (dir == dir->i_sb->sb_root
+			&& NULL != (entry = procfs_entry_lookup(name))) {
+		node->i_mode = S_IFREG;
+		node->i_data = (void *)entry;
+		return node;
+	}
+
 	/* /proc/pid/ns/net case */
 	if (is_number(name))
 		node->i_mode = S_IFDIR;
@@ -69,13 +96,31 @@ static struct inode *procfs_lookup(char const *name, struct inode const *dir) {
 
 static int procfs_iterate(struct inode *next, char *name, struct inode *parent,
 			  struct dir_ctx *ctx) {
+	const struct procfs_entry *entry;
 	struct task *tsk, *last;
-	int show_this_task = 0;
+	int show_next = 0;
 
 	last = (struct task *)ctx->fs_ctx;
 
+	if (parent == parent->i_sb->sb_root) {
+		array_spread_foreach_ptr(entry, __procfs_entries) {
+			if (show_next || last == NULL) {
+				ctx->fs_ctx = (void *)entry;
+				next->i_mode = S_IFREG;
+				next->i_data = (void *)entry;
+				strncpy(name, entry->name, NAME_MAX - 1);
+				name[NAME_MAX - 1] = '\0';
+				return 0;
+			}
+
+			if ((void *)entry == (void *)last) {
+				show_next = 1;
+			}
+		}
+	}
+
 	task_foreach(tsk) {
-		if (show_this_task || last == NULL) {
+		if (show_next || last == NULL) {
 			ctx->fs_ctx = (void *)tsk;
 			next->i_mode = S_IFDIR; 
 			snprintf(name, NAME_MAX - 1, "%d", tsk->tsk_id);
@@ -84,7 +129,7 @@ static int procfs_iterate(struct inode *next, char *name, struct inode *parent,
 		}
 
 		if (tsk == last) {
-			show_this_task = 1;
+			show_next = 1;
 		}
 	}
 
@@ -126,6 +171,23 @@ static size_t procfs_read(struct file_desc *desc, void *buf, size_t size) {
 						     netns_path);
 		}
 		return 0;
+	} else if (S_ISREG(desc->f_inode->i_mode) && desc->f_inode->i_data) {
+		const struct procfs_entry *entry = desc->f_inode->i_data;
+		char content[PROCFS_ENTRY_SIZE];
+		off_t pos;
+		int len;
+
+		len = entry->read(content, sizeof(content));
+		len = min(len, (int) sizeof(content) - 1);
+		pos = file_get_pos(desc);
+		if (len <= pos) {
+			return 0;
+		}
+
+		size = min(size, len - pos);
+		memcpy(buf, content + pos, size);
+
+		return size;
 	} else {
 		return 0;
 	}
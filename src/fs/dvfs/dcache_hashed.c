@@ -0,0 +1,254 @@
+/**
+ * @file
+ * @brief Dentry cache keyed by (parent dentry, component name)
+ *
+ * @details Entries are kept in a hash table and in LRU list; when the pool
+ *   is exhausted the least recently used entry is reused. Negative entries
+ *   remember names which were not found by FS driver. They expire after
+ *   @a negative_ttl ms because some file systems (e.g. devfs) may get new
+ *   nodes without DVFS knowing about it.
+ *
+ * @date 18.10.2026
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include <framework/mod/options.h>
+#include <fs/dvfs.h>
+#include <hal/clock.h>
+#include <kernel/time/time.h>
+#include <mem/misc/pool.h>
+#include <util/dlist.h>
+#include <util/err.h>
+
+#include <embox/unit.h>
+
+EMBOX_UNIT_INIT(dcache_init);
+
+#define DCACHE_ENTRIES      OPTION_GET(NUMBER, entries)
+#define DCACHE_HASH_SIZE    OPTION_GET(NUMBER, hash_size)
+#define DCACHE_NEGATIVE_MAX OPTION_GET(NUMBER, negative_max)
+#define DCACHE_NEGATIVE_TTL OPTION_GET(NUMBER, negative_ttl)
+
+struct dcache_entry {
+	struct dlist_head hash_lnk;
+	struct dlist_head lru_lnk;  /* Most recently used entries go first */
+	struct dlist_head neg_lnk;  /* Only for negative entries */
+	struct dentry *parent;
+	struct dentry *dentry;      /* NULL for negative entry */
+	clock_t expire;             /* Only for negative entries */
+	uint32_t hash;
+	char name[NAME_MAX];
+};
+
+POOL_DEF(dcache_entry_pool, struct dcache_entry, DCACHE_ENTRIES);
+
+static struct dlist_head dcache_ht[DCACHE_HASH_SIZE];
+static DLIST_DEFINE(dcache_lru);
+static DLIST_DEFINE(dcache_negative);
+static unsigned int dcache_negative_cnt;
+
+/* FNV-1a over the name seeded with the parent, then murmur3 finalizer */
+static uint32_t dcache_hash(const struct dentry *parent, const char *name) {
+	uint32_t hash = 2166136261u ^ (uint32_t)(uintptr_t)parent;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static inline struct dlist_head *dcache_bucket(uint32_t hash) {
+	return &dcache_ht[hash % DCACHE_HASH_SIZE];
+}
+
+static void dcache_entry_free(struct dcache_entry *entry) {
+	dlist_del(&entry->hash_lnk);
+	dlist_del(&entry->lru_lnk);
+	if (entry->dentry == NULL) {
+		dlist_del(&entry->neg_lnk);
+		dcache_negative_cnt--;
+	}
+
+	pool_free(&dcache_entry_pool, entry);
+}
+
+static struct dcache_entry *dcache_entry_find(struct dentry *parent,
+		const char *name, uint32_t hash) {
+	struct dcache_entry *entry;
+
+	dlist_foreach_entry(entry, dcache_bucket(hash), hash_lnk) {
+		if (entry->hash == hash && entry->parent == parent
+				&& !strcmp(entry->name, name)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static struct dcache_entry *dcache_entry_alloc(struct dentry *parent,
+		const char *name, uint32_t hash) {
+	struct dcache_entry *entry;
+
+	if (NULL == (entry = pool_alloc(&dcache_entry_pool))) {
+		/* Reuse the least recently used entry */
+		assert(!dlist_empty(&dcache_lru));
+		dcache_entry_free(dlist_entry(dcache_lru.prev,
+					struct dcache_entry, lru_lnk));
+		entry = pool_alloc(&dcache_entry_pool);
+		assert(entry);
+	}
+
+	dlist_head_init(&entry->hash_lnk);
+	dlist_head_init(&entry->lru_lnk);
+	dlist_head_init(&entry->neg_lnk);
+	entry->parent = parent;
+	entry->dentry = NULL;
+	entry->hash = hash;
+	strncpy(entry->name, name, sizeof(entry->name) - 1);
+	entry->name[sizeof(entry->name) - 1] = '\0';
+
+	dlist_add_next(&entry->hash_lnk, dcache_bucket(hash));
+	dlist_add_next(&entry->lru_lnk, &dcache_lru);
+
+	return entry;
+}
+
+/**
+ * @brief Try to get child of @a parent with given name from cache
+ *
+ * @return Cached dentry, err_ptr(ENOENT) for negative entry or NULL if
+ *         there is no such entry in cache
+ */
+struct dentry *dvfs_cache_lookup(struct dentry *parent, const char *name) {
+	struct dcache_entry *entry;
+
+	entry = dcache_entry_find(parent, name, dcache_hash(parent, name));
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	if (entry->dentry == NULL
+			&& (long)(clock_sys_ticks() - entry->expire) >= 0) {
+		dcache_entry_free(entry);
+		return NULL;
+	}
+
+	dlist_move(&entry->lru_lnk, &dcache_lru);
+
+	return entry->dentry ? entry->dentry : err_ptr(ENOENT);
+}
+
+/**
+ * @brief Remember that @a parent has no child with given name
+ */
+int dvfs_cache_add_negative(struct dentry *parent, const char *name) {
+	struct dcache_entry *entry;
+	uint32_t hash;
+
+	if (DCACHE_NEGATIVE_MAX == 0) {
+		return 0;
+	}
+
+	hash = dcache_hash(parent, name);
+	if (NULL != (entry = dcache_entry_find(parent, name, hash))) {
+		dcache_entry_free(entry);
+	}
+
+	if (dcache_negative_cnt >= DCACHE_NEGATIVE_MAX) {
+		dcache_entry_free(dlist_entry(dcache_negative.prev,
+					struct dcache_entry, neg_lnk));
+	}
+
+	entry = dcache_entry_alloc(parent, name, hash);
+	entry->expire = clock_sys_ticks() + ms2jiffies(DCACHE_NEGATIVE_TTL);
+	dlist_add_next(&entry->neg_lnk, &dcache_negative);
+	dcache_negative_cnt++;
+
+	return 0;
+}
+
+/**
+ * @brief Add dentry to cache replacing negative entry with the same name
+ *
+ * @param dentry
+ * @return Negative error code
+ */
+int dvfs_cache_add(struct dentry *dentry) {
+	struct dcache_entry *entry;
+	uint32_t hash;
+
+	assert(dentry);
+
+	if (dentry->parent == NULL || dentry->name[0] == '\0') {
+		return -1;
+	}
+
+	hash = dcache_hash(dentry->parent, dentry->name);
+	if (NULL != (entry = dcache_entry_find(dentry->parent, dentry->name,
+					hash))) {
+		dcache_entry_free(entry);
+	}
+
+	entry = dcache_entry_alloc(dentry->parent, dentry->name, hash);
+	entry->dentry = dentry;
+
+	return 0;
+}
+
+/**
+ * @brief Remove dentry from cache
+ * @note Should be used only on unmount and dentry destroy
+ *
+ * @param dentry
+ *
+ * @return Negative error code
+ */
+int dvfs_cache_del(struct dentry *dentry) {
+	struct dcache_entry *entry;
+
+	/* Negative entries don't hold reference to the parent, so drop them
+	 * before the dentry may be reused */
+	dlist_foreach_entry(entry, &dcache_negative, neg_lnk) {
+		if (entry->parent == dentry) {
+			dcache_entry_free(entry);
+		}
+	}
+
+	if (dentry->parent == NULL || dentry->name[0] == '\0') {
+		return -1;
+	}
+
+	entry = dcache_entry_find(dentry->parent, dentry->name,
+			dcache_hash(dentry->parent, dentry->name));
+	if (entry == NULL || entry->dentry != dentry) {
+		return -1;
+	}
+
+	dcache_entry_free(entry);
+
+	return 0;
+}
+
+static int dcache_init(void) {
+	int i;
+
+	for (i = 0; i < DCACHE_HASH_SIZE; i++) {
+		dlist_init(&dcache_ht[i]);
+	}
+
+	return 0;
+}
@@ -1,6 +1,6 @@
 /**
  * @file
- * @brief Handle cache lookup just by iterating vfs tree
+ * @brief No dentry cache, lookup is done just by iterating vfs tree
  * @author Denis Deryugin <deryugin.denis@gmail.com>
  * @version 0.1
  * @date 2015-06-09
@@ -9,23 +9,12 @@
 #include <string.h>
 #include <fs/dvfs.h>
 
-struct dentry *dvfs_cache_lookup(const char *path, struct dentry *base) {
+struct dentry *dvfs_cache_lookup(struct dentry *parent, const char *name) {
 	return NULL;
 }
 
-struct dentry *dvfs_cache_get(char *path, struct lookup *lookup) {
-	struct dentry *d;
-	struct dlist_head *l;
-	dlist_foreach(l, &lookup->parent->children) {
-		if (l == &lookup->parent->children)
-			continue;
-		d = mcast_out(l, struct dentry, children_lnk);
-
-		if (d != lookup->item && !strcmp(d->name, lookup->item->name))
-			return d;
-	}
-
-	return NULL;
+int dvfs_cache_add_negative(struct dentry *parent, const char *name) {
+	return 0;
 }
 
 int dvfs_cache_del(struct dentry *dentry) {
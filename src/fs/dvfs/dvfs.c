@@ -14,6 +14,7 @@
 
 #include <util/err.h>
 
+#include <fs/bcache.h>
 #include <fs/dvfs.h>
 #include <fs/hlpr_path.h>
 #include <kernel/task/resource/vfs.h>
@@ -109,6 +110,8 @@ int dvfs_create_new(const char *name, struct lookup *lookup, int flags) {
 	if (res) {
 		dentry_ref_dec(d);
 		dvfs_destroy_dentry(d);
+	} else {
+		dvfs_cache_add(d);
 	}
 
 	return res;
@@ -395,6 +398,7 @@ int dvfs_mount(const char *source, const char *dest, const char *fs_type, int fl
 		strcpy(d->name, lookup.item->name);
 
 		d->flags |= S_IFDIR | DVFS_MOUNT_POINT;
+		dvfs_cache_add(d);
 
 		dentry_ref_dec(lookup.item);
 	}
@@ -449,8 +453,10 @@ static int _dentry_destroy(struct dentry *parent) {
 int dvfs_umount(struct dentry *mpoint) {
 	int err;
 	struct super_block *sb;
+	struct block_dev *bdev;
 
 	sb = mpoint->d_sb;
+	bdev = sb->bdev;
 
 	if (sb->sb_ops && sb->sb_ops->umount_begin) {
 		if ((err = sb->sb_ops->umount_begin(sb)))
@@ -465,6 +471,11 @@ int dvfs_umount(struct dentry *mpoint) {
 		return err;
 	}
 
+	/* Write back what the file system left in the buffer cache */
+	if (bdev) {
+		bcache_sync(bdev);
+	}
+
 	if ((err = _dentry_destroy(mpoint))) {
 		return err;
 	}
@@ -565,7 +576,8 @@ int dvfs_iterate(struct lookup *lookup, struct dir_ctx *ctx) {
 		return 0;
 	}
 
-	if ((cached = dvfs_cache_get(next_dentry->name, lookup))) {
+	cached = dvfs_child_lookup(lookup->parent, next_dentry->name);
+	if (cached && !err(cached)) {
 		/* This node is already in the VFS tree */
 		dentry_ref_dec(next_dentry);
 		dvfs_destroy_dentry(next_dentry);
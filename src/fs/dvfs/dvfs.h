@@ -59,10 +59,11 @@ extern int dvfs_create_new(const char *name, struct lookup *lookup, int flags);
 extern int dvfs_rename(struct dentry *from, struct dentry *to);
 
 /* dcache-related stuff */
-extern struct dentry *dvfs_cache_lookup(const char *path, struct dentry *base);
-extern struct dentry *dvfs_cache_get(char *path, struct lookup *lookup);
+extern struct dentry *dvfs_cache_lookup(struct dentry *parent, const char *name);
+extern int dvfs_cache_add_negative(struct dentry *parent, const char *name);
 extern int dvfs_cache_del(struct dentry *dentry);
 extern int dvfs_cache_add(struct dentry *dentry);
+extern struct dentry *dvfs_child_lookup(struct dentry *parent, const char *name);
 
 extern struct block_dev *bdev_by_path(const char *source);
 extern int dvfs_mount(const char *dev, const char *dest, const char *fstype, int flags);
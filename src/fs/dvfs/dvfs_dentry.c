@@ -17,6 +17,7 @@
 #include <fs/dvfs.h>
 #include <fs/hlpr_path.h>
 #include <kernel/task/resource/vfs.h>
+#include <util/err.h>
 
 #define DENTRY_POOL_SIZE OPTION_GET(NUMBER, dentry_pool_size)
 
@@ -54,8 +55,6 @@ int dentry_full_path(struct dentry *dentry, char *buf) {
 	return 0;
 }
 
-extern struct dentry *local_lookup(struct dentry *parent, char *name);
-
 /**
  * @brief Get the length of next element int the path
  * @param path Pointer to the path
@@ -116,7 +115,17 @@ int dvfs_path_walk(const char *path, struct dentry *parent, struct lookup *looku
 		return -ENOTDIR;
 	}
 
-	if ((d = local_lookup(parent, buff))) {
+	d = dvfs_child_lookup(parent, buff);
+	if (err(d)) {
+		/* Negative dentry */
+		*lookup = (struct lookup) {
+			.item   = NULL,
+			.parent = parent,
+		};
+		return -ENOENT;
+	}
+
+	if (d) {
 		return dvfs_path_walk(path + strlen(buff), d, lookup);
 	}
 
@@ -128,12 +137,12 @@ int dvfs_path_walk(const char *path, struct dentry *parent, struct lookup *looku
 		return dvfs_path_walk(path + 1, parent, lookup);
 	}
 
-	/* TODO use cache instead */
 	assert(parent->d_sb);
 	assert(parent->d_sb->sb_iops);
 	assert(parent->d_sb->sb_iops->lookup);
 
 	if (!(in = parent->d_sb->sb_iops->lookup(buff, parent->d_inode))) {
+		dvfs_cache_add_negative(parent, buff);
 		*lookup = (struct lookup) {
 			.item   = NULL,
 			.parent = parent,
@@ -146,6 +155,7 @@ int dvfs_path_walk(const char *path, struct dentry *parent, struct lookup *looku
 		dentry_fill(parent->d_sb, in, d, parent);
 		strcpy(d->name, buff);
 		d->flags = in->i_mode;
+		dvfs_cache_add(d);
 	}
 
 	return dvfs_path_walk(path + strlen(buff), in->i_dentry, lookup);
@@ -166,7 +176,6 @@ int dvfs_path_walk(const char *path, struct dentry *parent, struct lookup *looku
  */
 int dvfs_lookup(const char *path, struct lookup *lookup) {
 	struct dentry *dentry;
-	struct dentry *res;
 	int errcode;
 
 	assert(path);
@@ -199,18 +208,8 @@ int dvfs_lookup(const char *path, struct lookup *lookup) {
 
 	/* TODO preprocess path ? Delete "/../" */
 
-	if ((res = dvfs_cache_lookup(path, dentry))) {
-		*lookup = (struct lookup) {
-			.item = res,
-			.parent = res->parent,
-		};
-		return 0;
-	}
-
+	/* Each path component is looked up in dentry cache by dvfs_path_walk() */
 	errcode = dvfs_path_walk(path, dentry, lookup);
-	if (!errcode) {
-		dvfs_cache_add(lookup->item);
-	}
 
 	return errcode == -ENOENT ? 0 : errcode;
 }
@@ -14,6 +14,7 @@
 #include <framework/mod/options.h>
 #include <mem/misc/pool.h>
 #include <util/dlist.h>
+#include <util/err.h>
 #include <util/log.h>
 
 #define INODE_POOL_SIZE OPTION_GET(NUMBER, inode_pool_size)
@@ -356,7 +357,7 @@ struct dentry *dvfs_root(void) {
 *
 * @return Pointer to dentry if found or NULL if not
 */
-struct dentry *local_lookup(struct dentry *parent, char *name) {
+struct dentry *local_lookup(struct dentry *parent, const char *name) {
 	struct dentry *d;
 	struct dlist_head *l;
 
@@ -373,6 +374,30 @@ struct dentry *local_lookup(struct dentry *parent, char *name) {
 	return NULL;
 }
 
+/**
+* @brief Find subelement of the folder with given name in dentry cache
+*        and then in RAM.
+*
+* @param parent
+* @param name
+*
+* @return Pointer to dentry if found, err_ptr(ENOENT) if it's known that
+*         there is no such element or NULL if FS driver should be asked
+*/
+struct dentry *dvfs_child_lookup(struct dentry *parent, const char *name) {
+	struct dentry *d;
+
+	if ((d = dvfs_cache_lookup(parent, name))) {
+		return d;
+	}
+
+	if ((d = local_lookup(parent, name))) {
+		dvfs_cache_add(d);
+	}
+
+	return d;
+}
+
 /**
  * @brief Remove dentry from file tree, but leave it
  * in dentry cache
@@ -398,6 +423,7 @@ int dentry_reconnect(struct dentry *parent, const char *name) {
 		if (dentry->parent == parent && !strcmp(dentry->name, name)) {
 			dlist_head_init(&dentry->children_lnk);
 			dlist_add_prev(&dentry->children_lnk, &parent->children);
+			dvfs_cache_add(dentry);
 		}
 	}
 	return 0;
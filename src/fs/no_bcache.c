@@ -0,0 +1,12 @@
+/**
+ * @file
+ * @brief Stub of buffer cache for builds without block devices
+ *
+ * @date 18.10.2026
+ */
+
+#include <fs/bcache.h>
+
+int bcache_sync(struct block_dev *bdev) {
+	return 0;
+}
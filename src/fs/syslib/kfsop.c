@@ -17,6 +17,7 @@
 #include <sys/file.h>
 
 #include <drivers/device.h>
+#include <fs/bcache.h>
 #include <fs/dir_context.h>
 #include <fs/file_desc.h>
 #include <fs/fs_driver.h>
@@ -636,6 +637,7 @@ static int umount_walker(struct inode *node) {
 int kumount(const char *dir) {
 	struct path dir_node, node;
 	const struct fs_driver *drv;
+	struct block_dev *bdev;
 	const char *lastpath;
 	int res;
 
@@ -673,8 +675,14 @@ int kumount(const char *dir) {
 	}
 
 	dir_node.node->i_sb->sb_root = NULL;
+	bdev = dir_node.node->i_sb->bdev;
 	super_block_free(dir_node.node->i_sb);
 
+	/* Write back what the file system left in the buffer cache */
+	if (bdev) {
+		bcache_sync(bdev);
+	}
+
 	if (dir_node.node != vfs_get_root()) {
 		node_free(dir_node.node);
 	}
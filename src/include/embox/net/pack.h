@@ -15,6 +15,7 @@
  */
 struct net_device;
 struct sk_buff;
+struct sk_buff_head;
 struct sock;
 struct sockaddr;
 
@@ -36,6 +37,9 @@ struct net_pack {
 	unsigned short type;  /* type of packet */
 	/* packet handler */
 	int (*rcv_pack)(struct sk_buff *skb,struct net_device *dev);
+	/* optional handler of a list of packets of this type, consumes
+	 * the whole list */
+	int (*rcv_list)(struct sk_buff_head *list);
 };
 
 extern const struct net_pack * net_pack_lookup(unsigned short type);
@@ -55,9 +59,20 @@ ARRAY_SPREAD_DECLARE(const struct net_pack, __net_pack_registry);
 				.rcv_pack = _rcv_pack                                    \
 			})
 
+#define EMBOX_NET_PACK_LIST(_type, _rcv_pack, _rcv_list)                \
+	static int _rcv_pack(struct sk_buff *skb, struct net_device *dev);   \
+	static int _rcv_list(struct sk_buff_head *list);                     \
+	ARRAY_SPREAD_ADD_NAMED(__net_pack_registry,                          \
+			__net_pack_##_type, {                                        \
+				.type = _type,                                           \
+				.rcv_pack = _rcv_pack,                                   \
+				.rcv_list = _rcv_list                                    \
+			})
+
 /* Help Eclipse CDT. */
 #ifdef __CDT_PARSER__
 #define EMBOX_NET_PACK(_type, _rcv_pack)
+#define EMBOX_NET_PACK_LIST(_type, _rcv_pack, _rcv_list)
 #endif
 
 
@@ -10,6 +10,7 @@
 #define EMBOX_NET_PROTO_H_
 
 struct sk_buff;
+struct sk_buff_head;
 
 /**
  * Each netproto implements this interface.
@@ -18,6 +19,8 @@ typedef struct net_proto {
 	unsigned short pack;
 	unsigned char type;
 	int (*handle)(struct sk_buff *skb);
+	/* optional handler of packets of the same flow, consumes the list */
+	int (*handle_list)(struct sk_buff_head *list);
 	void (*handle_error)(const struct sk_buff *skb, int error_info);
 } net_proto_t;
 
@@ -46,4 +49,19 @@ ARRAY_SPREAD_DECLARE(const struct net_proto, __net_proto_registry);
 				.handle_error = _handle_error                                \
 			})
 
+#define EMBOX_NET_PROTO_LIST(_pack, _type, _handle, _handle_list,          \
+		_handle_error)                                                       \
+	static int _handle(struct sk_buff *skb);                                 \
+	static int _handle_list(struct sk_buff_head *list);                      \
+	static void _handle_error(const struct sk_buff *skb, int error_info);    \
+	ARRAY_SPREAD_DECLARE(const struct net_proto, __net_proto_registry);      \
+	ARRAY_SPREAD_ADD_NAMED(__net_proto_registry,                             \
+			__net_proto_##_pack##_type, {                                    \
+				.pack = _pack,                                               \
+				.type = _type,                                               \
+				.handle = _handle,                                           \
+				.handle_list = _handle_list,                                 \
+				.handle_error = _handle_error                                \
+			})
+
 #endif /* EMBOX_NET_PROTO_H_ */
@@ -11,6 +11,17 @@
 
 #include <fs/buffer_head.h>
 
+struct bcache_stats {
+	unsigned long hits;       /* lookups satisfied from the cache */
+	unsigned long misses;     /* lookups which allocated a new buffer */
+	unsigned long readahead;  /* blocks read ahead */
+	unsigned long evictions;  /* buffers evicted to get free space */
+	unsigned long writebacks; /* dirty buffers written to disk */
+	unsigned long lost;       /* dirty buffers dropped unwritten */
+	unsigned int buffers;     /* buffers in the cache */
+	unsigned int dirty;       /* dirty buffers waiting for writeback */
+};
+
 static inline void bcache_buffer_lock(struct buffer_head *bh) {
 	mutex_lock(&bh->mutex);
 	bh->lock_count++;
@@ -28,4 +39,48 @@ static inline void bcache_buffer_unlock(struct buffer_head *bh) {
  */
 extern struct buffer_head *bcache_getblk_locked(struct block_dev *bdev, int block, size_t size);
 
+/**
+ * @return
+ *   Number of buffers which one caller may keep locked at once. Getting
+ *   more blocks before releasing some of them may never return if the
+ *   cache is small.
+ */
+extern int bcache_lock_max(void);
+
+/**
+ * Marks locked buffer @a bh as modified. The buffer is written to disk later
+ * by the flusher thread (or right now if write-back is disabled).
+ *
+ * @return
+ *   0 on success, negative error code if immediate write failed
+ */
+extern int bcache_mark_dirty(struct buffer_head *bh);
+
+/**
+ * Requests blocks following @a block in a single request if access to
+ * @a bdev looks sequential, i.e. the block before @a block is cached.
+ * Doesn't wait for the request, the blocks are cached on its completion.
+ */
+extern void bcache_readahead(struct block_dev *bdev, int block, size_t size);
+
+/**
+ * Reads blocks [@a block, @a block + @a count) which are not cached yet into
+ * the cache. Adjacent missing blocks are read with a single request.
+ */
+extern void bcache_prefetch(struct block_dev *bdev, int block, int count,
+		size_t size);
+
+/**
+ * Writes all dirty buffers of @a bdev (all devices if NULL) to disk.
+ */
+extern int bcache_sync(struct block_dev *bdev);
+
+/**
+ * Writes back and drops all buffers of @a bdev. Buffers which failed to be
+ * written are dropped as well and counted as lost.
+ */
+extern void bcache_invalidate(struct block_dev *bdev);
+
+extern void bcache_get_stats(struct bcache_stats *stats);
+
 #endif /* FS_BCACHE_H_ */
@@ -9,6 +9,8 @@
 #ifndef FS_BUFFER_HEAD_H_
 #define FS_BUFFER_HEAD_H_
 
+#include <sys/types.h>
+
 #include <util/dlist.h>
 #include <kernel/thread/sync/mutex.h>
 #include <drivers/block_dev.h>
@@ -35,7 +37,9 @@ struct buffer_head {
 	size_t blocksize;               /* size of mapping */
 	int flags;                      /* buffer state bitmap */
 	struct mutex mutex;             /* synchronizes concurrent access to block */
-	struct dlist_head bh_next;      /* link to global list of buffer_heads */
+	struct dlist_head bh_next;      /* link to LRU list of buffer_heads */
+	struct dlist_head bh_dirty;     /* link to list of dirty buffer_heads */
+	clock_t dirty_time;             /* when buffer became dirty (in jiffies) */
 	char *data;                     /* pointer to block's data */
 	int lock_count;			/* lock count to support multiplie locks */
 	/*
@@ -470,6 +470,18 @@ struct	ext2fs_direct {
 #define IND_CACHE_SZ		(1 << LN2_IND_CACHE_SZ)
 #define IND_CACHE_MASK		(IND_CACHE_SZ - 1)
 
+/*
+ * Runs of logically and physically contiguous blocks of an open file are
+ * kept in a small map, so sequential reads don't walk indirect blocks again.
+ */
+#define EXT_CACHE_SZ		8
+
+struct ext2_extent_cache {
+	uint32_t	ec_lblk;	/* first logical block of the run */
+	uint32_t	ec_pblk;	/* its disk block */
+	uint32_t	ec_len;		/* number of blocks, 0 if the entry is free */
+};
+
 union fsdata_u {
     char b__data[PAGE_SIZE()];             /* ordinary user data */
 /* indirect block */
@@ -571,6 +583,13 @@ typedef struct ext2_file_info {
 	int32_t		f_ind_cache_block;
 	int32_t		f_ind_cache[IND_CACHE_SZ];
 
+	struct ext2_extent_cache f_ext_cache[EXT_CACHE_SZ];
+	uint		f_ext_cache_next;	/* entry to be replaced next */
+
+	uint32_t	f_ra_next;	/* block expected to be read next */
+	uint32_t	f_ra_end;	/* blocks before it are already read ahead */
+	uint32_t	f_ra_size;	/* current readahead window, in blocks */
+
 	char		*f_buf;		/* buffer for data block */
 	size_t		f_buf_size;	/* size of data block */
 	int64_t		f_buf_blkno;/* block number of data block */
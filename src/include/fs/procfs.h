@@ -0,0 +1,26 @@
+/**
+ * @file
+ * @brief Files in the root of procfs
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef FS_PROCFS_H_
+#define FS_PROCFS_H_
+
+#include <stddef.h>
+
+#include <util/array.h>
+
+struct procfs_entry {
+	const char *name;
+	/* Fills @a buf with the file content, returns its length */
+	int (*read)(char *buf, size_t size);
+};
+
+/* Defines /proc/@a name. It's fine to use it even if procfs is not used */
+#define PROCFS_ENTRY_DEF(name, read) \
+	ARRAY_SPREAD_DECLARE(const struct procfs_entry, __procfs_entries); \
+	ARRAY_SPREAD_ADD(__procfs_entries, {name, read})
+
+#endif /* FS_PROCFS_H_ */
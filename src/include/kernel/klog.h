@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief Deferred kernel log: per-CPU rings of unformatted messages
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef KERNEL_KLOG_H_
+#define KERNEL_KLOG_H_
+
+#include <stddef.h>
+
+#include <sys/cdefs.h>
+
+struct klog_stats {
+	unsigned long written;   /**< messages put into the ring */
+	unsigned long dropped;   /**< messages lost because the ring was full */
+	unsigned long truncated; /**< messages with arguments cut off */
+};
+
+__BEGIN_DECLS
+
+/**
+ * Formats and outputs all messages queued so far in the caller's context.
+ */
+extern void klog_flush(void);
+
+/**
+ * Copies formatted messages kept in the log history to @a buf.
+ *
+ * @param pos Position in the history to read from, updated on return.
+ *   Start with 0, messages overwritten since then are skipped.
+ * @return Number of bytes copied, 0 if there is nothing more to read.
+ */
+extern size_t klog_read(char *buf, size_t len, unsigned long *pos);
+
+/**
+ * Forgets messages kept in the log history.
+ */
+extern void klog_clear(void);
+
+/**
+ * @return 0 on success, -EINVAL if @a cpu doesn't exist
+ */
+extern int klog_get_stats(unsigned int cpu, struct klog_stats *stats);
+
+__END_DECLS
+
+#endif /* KERNEL_KLOG_H_ */
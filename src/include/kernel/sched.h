@@ -45,7 +45,9 @@ enum schedee_type {
  *   s->lock    - used during waking up
  *   s->active  - (SMP) only current is allowed to modify it,
  *                reads are usually paired with s->waiting
- *   s->ready   - any access must be protected with rq lock and interrupts
+ *   s->cpu     - changed with the runq lock of its old CPU held (stealing),
+ *                or by the waker when the schedee isn't in any runq
+ *   s->ready   - any access must be protected with rq lock of s->cpu and interrupts
  *                off, only current can reset it to zero (during 'schedule'),
  *                others can set it to a non-zero during wake up
  *   s->waiting - current can change it from zero to a non-zero with no locks,
@@ -69,6 +71,8 @@ struct schedee {
 	 */
 	struct schedee    *(*process)(struct schedee *prev, struct schedee *next);
 
+	unsigned int cpu;     /**< CPU which runq holds the schedee (or last ran it). */
+
 	/* Fields corresponding to the state in the scheduler state machine. */
 	unsigned int active;  /**< Running on a CPU. TODO SMP-only. */
 	unsigned int ready;   /**< Managed by the scheduler. */
@@ -81,6 +85,13 @@ struct schedee {
 	struct waitq_link waitq_link; /**< Used as a link in different waitqs. */
 };
 
+/** Per-CPU scheduler statistics. */
+struct sched_cpu_stats {
+	unsigned int  nr_ready;   /**< Schedees in the CPU runq now. */
+	unsigned long migrations; /**< Schedees moved to the CPU from another one. */
+	unsigned long steals;     /**< Schedees stolen by the idle CPU. */
+};
+
 __BEGIN_DECLS
 
 static inline int schedee_is_thread(struct schedee *s) {
@@ -112,6 +123,14 @@ extern int schedee_init(struct schedee *schedee, int priority,
 
 extern void sched_set_current(struct schedee *schedee);
 
+/**
+ * Gets run queue statistics of the @p cpu.
+ *
+ * @return
+ *   0 on success, -EINVAL if @p cpu doesn't exist.
+ */
+extern int sched_get_cpu_stats(unsigned int cpu, struct sched_cpu_stats *stats);
+
 extern void sched_ticker_add(void);
 extern void sched_ticker_del(void);
 
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief Read-write lock with per-CPU reader counters
+ *
+ * @details Readers only increment the counter of their CPU while there is
+ * no writer, so they neither share cache lines nor take the scheduler lock.
+ * Writers are preferred: new readers wait once a writer has come. Readers
+ * which waited for a writer are let in when it leaves, before the next
+ * writer, so neither side starves.
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef KERNEL_THREAD_SYNC_BRLOCK_H_
+#define KERNEL_THREAD_SYNC_BRLOCK_H_
+
+#include <hal/cpu.h>
+#include <kernel/sched/waitq.h>
+#include <kernel/spinlock.h>
+
+#if NCPU > 1
+#define BRLOCK_CPU_ALIGN 64 /* keep counters of CPUs in own cache lines */
+#else
+#define BRLOCK_CPU_ALIGN sizeof(int)
+#endif
+
+struct brlock_cpu {
+	int readers;
+} __attribute__((aligned(BRLOCK_CPU_ALIGN)));
+
+struct brlock {
+	struct brlock_cpu cpu[NCPU];
+	int writer;            /* writer holds the lock or waits for readers */
+	int readers_waiting;   /* readers to let in when the writer leaves */
+	unsigned int gen;      /* number of writers which let readers in */
+	spinlock_t lock;
+	struct waitq wq;       /* for readers and writers waiting for a writer */
+	struct waitq drain_wq; /* for the writer waiting for readers */
+};
+
+typedef struct brlock brlock_t;
+
+extern void brlock_init(brlock_t *b);
+extern void brlock_read_lock(brlock_t *b);
+extern void brlock_read_unlock(brlock_t *b);
+extern void brlock_write_lock(brlock_t *b);
+extern void brlock_write_unlock(brlock_t *b);
+
+#endif /* KERNEL_THREAD_SYNC_BRLOCK_H_ */
@@ -57,6 +57,18 @@ struct timespec;
 
 #define MUTEX_INIT(m)  {.wq=WAITQ_INIT(m.wq), .holder=NULL, .lock_count=0}
 
+/**
+ * Contention of a mutex, collected if the contention_stats option of
+ * embox.kernel.thread.mutex is not zero
+ */
+struct mutex_contention {
+	const struct mutex *mutex;
+	unsigned long contended;          /**< Times a locker had to wait */
+	unsigned long long wait_ns;       /**< Total time spent waiting */
+	unsigned long long max_wait_ns;   /**< The longest wait */
+	int holder_id;                    /**< Last holder thread, -1 if lthread */
+};
+
 __BEGIN_DECLS
 
 /**
@@ -100,6 +112,21 @@ extern int mutex_unlock(struct mutex *locked_mutex);
  */
 extern int mutex_trylock(struct mutex *free_mutex);
 
+/**
+ * Gets contention statistics kept in slot @p idx.
+ *
+ * @return
+ *   0 on success, -ENOENT if the slot is empty, -EINVAL if @p idx is out of
+ *   the statistics table (or statistics are disabled).
+ */
+extern int mutex_contention_get(unsigned int idx,
+		struct mutex_contention *stat);
+
+/**
+ * Clears all contention statistics.
+ */
+extern void mutex_contention_reset(void);
+
 __END_DECLS
 
 #endif /* KERNEL_THREAD_SYNC_MUTEX_H_ */
@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @brief Sequence counters and locks for small frequently read data
+ *
+ * @details Readers never block and never write shared memory: they take
+ * a snapshot of the sequence, copy the data and retry if the sequence has
+ * changed meanwhile. Writers make the sequence odd while they update the
+ * data. It suits data of few words which is rarely changed, such as time
+ * of day or generation numbers.
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef KERNEL_THREAD_SYNC_SEQLOCK_H_
+#define KERNEL_THREAD_SYNC_SEQLOCK_H_
+
+#include <hal/ipl.h>
+#include <kernel/spinlock.h>
+
+/**
+ * Sequence counter without a lock. Writers must be serialized by
+ * the user, or use write_seqcount_trybegin().
+ */
+typedef struct seqcount {
+	unsigned int seq;
+} seqcount_t;
+
+#define SEQCOUNT_INIT { 0 }
+
+static inline void seqcount_init(seqcount_t *s) {
+	s->seq = 0;
+}
+
+/**
+ * Returns the current sequence without waiting for a writer. The odd value
+ * means the writer is in progress and such a snapshot is never valid.
+ */
+static inline unsigned int raw_read_seqcount(const seqcount_t *s) {
+	unsigned int seq;
+
+	seq = *(volatile unsigned int *)&s->seq;
+	__sync_synchronize();
+
+	return seq;
+}
+
+static inline unsigned int read_seqcount_begin(const seqcount_t *s) {
+	unsigned int seq;
+
+	while ((seq = raw_read_seqcount(s)) & 1) {
+	}
+
+	return seq;
+}
+
+/**
+ * @return Non-zero if data read after @a start may be inconsistent
+ */
+static inline int read_seqcount_retry(const seqcount_t *s,
+		unsigned int start) {
+	__sync_synchronize();
+	return (start & 1) || *(volatile unsigned int *)&s->seq != start;
+}
+
+static inline void write_seqcount_begin(seqcount_t *s) {
+	*(volatile unsigned int *)&s->seq = s->seq + 1;
+	__sync_synchronize();
+}
+
+static inline void write_seqcount_end(seqcount_t *s) {
+	__sync_synchronize();
+	*(volatile unsigned int *)&s->seq = s->seq + 1;
+}
+
+/**
+ * Starts the write if there is no other writer, for data which may be
+ * left as is when somebody else updates it, e.g. caches.
+ *
+ * @return Non-zero if the write is started
+ */
+static inline int write_seqcount_trybegin(seqcount_t *s) {
+	unsigned int seq;
+
+	seq = *(volatile unsigned int *)&s->seq;
+
+	return !(seq & 1) && __sync_bool_compare_and_swap(&s->seq, seq, seq + 1);
+}
+
+/**
+ * Sequence counter with a spinlock serializing writers. Readers spin while
+ * the write is in progress, so writers which may be interrupted by readers
+ * must use write_seqlock_ipl().
+ */
+typedef struct seqlock {
+	seqcount_t seqcount;
+	spinlock_t lock;
+} seqlock_t;
+
+#define SEQLOCK_INIT \
+	{ SEQCOUNT_INIT, SPIN_STATIC_UNLOCKED }
+
+static inline void seqlock_init(seqlock_t *sl) {
+	seqcount_init(&sl->seqcount);
+	spin_init(&sl->lock, __SPIN_UNLOCKED);
+}
+
+static inline unsigned int read_seqbegin(const seqlock_t *sl) {
+	return read_seqcount_begin(&sl->seqcount);
+}
+
+static inline int read_seqretry(const seqlock_t *sl, unsigned int start) {
+	return read_seqcount_retry(&sl->seqcount, start);
+}
+
+static inline void write_seqlock(seqlock_t *sl) {
+	spin_lock(&sl->lock);
+	write_seqcount_begin(&sl->seqcount);
+}
+
+static inline void write_sequnlock(seqlock_t *sl) {
+	write_seqcount_end(&sl->seqcount);
+	spin_unlock(&sl->lock);
+}
+
+static inline ipl_t write_seqlock_ipl(seqlock_t *sl) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&sl->lock);
+	write_seqcount_begin(&sl->seqcount);
+
+	return ipl;
+}
+
+static inline void write_sequnlock_ipl(seqlock_t *sl, ipl_t ipl) {
+	write_seqcount_end(&sl->seqcount);
+	spin_unlock_ipl(&sl->lock, ipl);
+}
+
+#endif /* KERNEL_THREAD_SYNC_SEQLOCK_H_ */
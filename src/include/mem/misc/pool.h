@@ -15,9 +15,20 @@
 #include <util/macro.h>
 #include <util/slist.h>
 #include <util/bitmap.h>
+#include <kernel/spinlock.h>
 
 #include <module/embox/mem/pool.h>
 
+#ifdef POOL_PERCPU
+#include <hal/cpu.h>
+
+/* Per-CPU stack of free objects in front of the shared free list */
+struct pool_magazine {
+	unsigned int rounds;
+	void *objs[POOL_MAGAZINE_SIZE];
+};
+#endif
+
 /** Representation of the pool*/
 struct pool {
 	/* Place in memory for allocation */
@@ -32,6 +43,11 @@ struct pool {
 	size_t pool_size;
 	/* Boundary, after which begin non-allocated memory */
 	void *bound_free;
+	/* Protects free_blocks and bound_free */
+	spinlock_t lock;
+#ifdef POOL_PERCPU
+	struct pool_magazine magazines[NCPU];
+#endif
 #ifdef POOL_DEBUG
 	BITMAP_DECL(blocks, POOL_MAX_OBJECTS);
 #endif
@@ -65,6 +81,7 @@ struct pool {
 			.free_blocks = SLIST_INIT(&name.free_blocks),\
 			.obj_size = sizeof(__pool_storage ## name[0]), \
 			.pool_size = sizeof(__pool_storage ## name), \
+			.lock = SPIN_STATIC_UNLOCKED, \
 			POOL_BLOCKS_INIT \
 	};
 
@@ -81,6 +98,7 @@ struct pool {
 			.free_blocks = SLIST_INIT(&name.free_blocks),\
 			.obj_size = sizeof(__pool_storage ## name[0]), \
 			.pool_size = sizeof(__pool_storage ## name), \
+			.lock = SPIN_STATIC_UNLOCKED, \
 			POOL_BLOCKS_INIT \
 	};
 
@@ -96,6 +114,7 @@ struct pool {
 			.free_blocks = SLIST_INIT(&name.free_blocks),\
 			.obj_size = sizeof(__pool_storage ## name[0]), \
 			.pool_size = sizeof(__pool_storage ## name), \
+			.lock = SPIN_STATIC_UNLOCKED, \
 			POOL_BLOCKS_INIT \
 	};
 #endif
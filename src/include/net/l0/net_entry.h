@@ -17,4 +17,15 @@
  */
 extern int netif_rx(void *pack);
 
+/**
+ * Packets passed through receive and transmit queues of a CPU
+ */
+struct netif_cpu_stats {
+	unsigned long rx_packets;
+	unsigned long tx_packets;
+};
+
+extern int netif_get_cpu_stats(unsigned int cpu,
+		struct netif_cpu_stats *stats);
+
 #endif /* NET_L0_NET_ENTRY_ */
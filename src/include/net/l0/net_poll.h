@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief Budgeted poll mode for network drivers
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef NET_L0_NET_POLL_
+#define NET_L0_NET_POLL_
+
+#include <net/skbuff.h>
+
+struct net_device;
+
+/**
+ * Must be called by driver from its interrupt handler after RX interrupt
+ * of the device was masked. Device's poll() is called later from the poll
+ * handler until the device has no more packets, then poll_irq_enable() is
+ * called to switch it back to interrupt mode.
+ */
+extern void netif_poll_schedule(struct net_device *dev);
+
+/**
+ * Passes received packet to the stack. Must be called only from driver's
+ * poll() routine. Packets are handled by the stack as one batch when
+ * poll() returns.
+ */
+extern int netif_receive_skb(struct sk_buff *skb);
+
+#endif /* NET_L0_NET_POLL_ */
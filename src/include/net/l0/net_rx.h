@@ -17,4 +17,11 @@
  */
 extern int net_rx(struct sk_buff *skb);
 
+/**
+ * Same as net_rx() for several packets at once. Packets are grouped by
+ * L3 type so handlers are looked up once per group, and groups are passed
+ * to L3 layer as lists if it supports that. The list is emptied.
+ */
+extern int net_rx_list(struct sk_buff_head *list);
+
 #endif /* NET_L0_NET_RX_ */
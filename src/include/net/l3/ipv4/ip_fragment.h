@@ -8,27 +8,38 @@
 #ifndef NET_L3_IPV4_IP_FRAGMENT_H
 #define NET_L3_IPV4_IP_FRAGMENT_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <net/skbuff.h>
 
-/* 1 second - Minimum Segment Lifetime. Just some suitable constant,
- * not from any document */
-#define   MSL          1
-
-
 struct sk_buff;
 
+/* Reassembly counters, named after SNMP ipReasm* objects */
+struct ip_frag_stats {
+	unsigned long reasm_reqds;    /* fragments received */
+	unsigned long reasm_oks;      /* datagrams reassembled */
+	unsigned long reasm_fails;    /* datagrams and fragments dropped */
+	unsigned long reasm_timeouts; /* datagrams dropped by timeout */
+	unsigned long reasm_evicted;  /* datagrams dropped to free memory */
+	unsigned int queues;          /* datagrams being reassembled */
+	size_t mem;                   /* bytes held by their fragments */
+};
+
 /**
- *	return sk_buff containing complete data
+ *	return sk_buff containing complete data. Payloads of fragments are
+ *	chained to its frag_list without copying
  */
 extern struct sk_buff *ip_defrag(struct sk_buff *skb);
 
 /* When skb is large then interface MTU we split it into
  * number of smaller pieces. They are linked into sk_buff_head.
  * We return NULL if we don't have enough memory.
- * During this operation we don't touch the original skb
+ * During this operation we don't touch the original skb, but fragments
+ * refer its data, so it's kept until all of them are freed
  */
 extern int ip_frag(const struct sk_buff *skb, uint32_t mtu,
 		struct sk_buff_head *tx_buf);
 
+extern void ip_frag_get_stats(struct ip_frag_stats *stats);
+
 #endif /* NET_L3_IPV4_IP_FRAGMENT_H */
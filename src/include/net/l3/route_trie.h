@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Path-compressed binary trie for longest prefix match of IPv4
+ *   addresses
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef NET_L3_ROUTE_TRIE_H_
+#define NET_L3_ROUTE_TRIE_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <util/dlist.h>
+
+struct pool;
+
+/**
+ * Trie node. Each node keeps all routes with exactly the same prefix,
+ * nodes without routes only exist as branching points.
+ */
+struct rt_trie_node {
+	struct rt_trie_node *child[2];
+	struct rt_trie_node *parent;
+	uint32_t key;  /* Prefix in host order, bits after @a plen are zeroes */
+	int plen;
+	struct dlist_head leaves;
+};
+
+/** Link embedded into the route entry */
+struct rt_trie_leaf {
+	struct dlist_head lnk;
+	struct rt_trie_node *node;
+};
+
+struct rt_trie {
+	struct rt_trie_node *root;
+	struct pool *node_pool; /* At most two nodes are used for each route */
+};
+
+#define RT_TRIE_INIT(pool) { .root = NULL, .node_pool = pool }
+
+/**
+ * @brief Add leaf for prefix @a dst / @a mask
+ *
+ * @param dst Prefix in network order
+ * @param mask Contiguous mask in network order
+ *
+ * @return 0 on success
+ * @return -ENOMEM if there are no free nodes
+ */
+extern int rt_trie_insert(struct rt_trie *trie, in_addr_t dst, in_addr_t mask,
+		struct rt_trie_leaf *leaf);
+
+extern void rt_trie_remove(struct rt_trie *trie, struct rt_trie_leaf *leaf);
+
+/**
+ * @brief Find leaf with the longest prefix matching @a addr for which
+ *   @a match returns nonzero. Takes O(32) node visits.
+ *
+ * @param addr Address in network order
+ * @param match Filter, may be NULL
+ */
+extern struct rt_trie_leaf *rt_trie_lookup(struct rt_trie *trie, in_addr_t addr,
+		int (*match)(struct rt_trie_leaf *leaf, void *arg), void *arg);
+
+#endif /* NET_L3_ROUTE_TRIE_H_ */
@@ -17,6 +17,7 @@
 
 #include <linux/types.h>
 #include <linux/list.h>
+#include <kernel/time/timer.h>
 #include <net/socket/inet_sock.h>
 #include <net/socket/inet6_sock.h>
 
@@ -84,6 +85,16 @@ struct tcp_seq_state {
 	struct tcp_wind wind;
 };
 
+/* Block of data received by the peer beyond cumulative acknowledgment */
+struct tcp_sack_block {
+	uint32_t start;
+	uint32_t end;
+};
+
+#define TCP_SACK_BLOCKS_MAX  4
+
+struct tcp_cong_ops;
+
 typedef struct tcp_sock {
 	struct proto_sock p_sk;     /* Base proto_sock class (MUST BE FIRST) */
 	enum tcp_sock_state state;  /* Socket state */
@@ -101,11 +112,31 @@ typedef struct tcp_sock {
 	unsigned int free_wait_queue_len; /* @a conn_wait length plus @a conn_free length */
 	unsigned int free_wait_queue_max; /* Maximum @a conn_wait length plus @a conn_free length */
 	unsigned int lock;          /* Tool for synchronization */
-	struct timeval syn_time;    /* The time when synchronization started */
-	struct timeval ack_time;    /* The time when message was ACKed */
-	struct timeval rcv_time;    /* The time when last message was received (ONLY FOR TCP_TIMEWAIT) */
+	struct sys_timer timer;     /* Rexmit, synchronization and TIME-WAIT timer */
+	clock_t timer_expire;       /* The time when @a timer fires (in jiffies) */
+	clock_t syn_time;           /* The time when synchronization started */
+	clock_t ack_time;           /* The time when message was ACKed or rexmitted */
+	clock_t rcv_time;           /* The time when last message was received (ONLY FOR TCP_TIMEWAIT) */
+	uint32_t srtt;              /* Smoothed round-trip time in ms (scaled by 8) */
+	uint32_t rttvar;            /* Round-trip time variation in ms (scaled by 4) */
+	uint32_t rto;               /* Retransmission timeout in ms */
+	uint32_t rtt_seq;           /* Acknowledgment of this sequence ends RTT measurement */
+	clock_t rtt_time;           /* The time when RTT measurement started */
+	unsigned int rtt_active;    /* RTT measurement is in progress */
 	unsigned int dup_ack;       /* Amount of duplicated packets */
-	unsigned int rexmit_mode;   /* Socket in rexmit mode */
+	unsigned int rexmit_mode;   /* Socket in rexmit mode (TCP_REXMIT_xxx) */
+	unsigned int flags;         /* TCP_F_xxx */
+	uint16_t mss;               /* Maximum segment size for sending */
+	uint32_t snd_nxt;           /* Sequence number of the next segment to transmit */
+	uint32_t snd_cwnd;          /* Congestion window in bytes */
+	uint32_t snd_ssthresh;      /* Slow start threshold in bytes */
+	uint32_t recover;           /* Highest sequence sent when loss was detected */
+	const struct tcp_cong_ops *cong; /* Congestion control algorithm */
+	uint32_t cong_priv[4];      /* Private data of congestion control */
+	struct tcp_sack_block sack[TCP_SACK_BLOCKS_MAX]; /* SACK blocks from the last ACK */
+	unsigned int sack_cnt;      /* Amount of @a sack blocks */
+	unsigned int ack_pending;   /* Amount of received segments not acknowledged yet */
+	clock_t delack_time;        /* The time when the first of them was received */
 } tcp_sock_t;
 
 static inline struct tcp_sock * to_tcp_sock(
@@ -114,20 +145,44 @@ static inline struct tcp_sock * to_tcp_sock(
 }
 
 enum {
+	TCP_OPT_KIND_EOL  = 0, /* End of option list */
 	TCP_OPT_KIND_NOP  = 1, /* No-Operation */
 	TCP_OPT_KIND_MSS  = 2, /* Maximum segment size */
 	TCP_OPT_KIND_WS   = 3, /* Window scale */
 	TCP_OPT_KIND_SACK = 4, /* SACK Permission */
+	TCP_OPT_KIND_SACK_BLOCKS = 5, /* SACK */
 	TCP_OPT_KIND_TS   = 8  /* Timestamp */
 };
 
+/* Socket flags */
+#define TCP_F_NODELAY      0x01 /* Nagle algorithm is disabled */
+#define TCP_F_QUICKACK     0x02 /* Delayed acknowledgments are disabled */
+#define TCP_F_WSCALE       0x04 /* Window scale option is offered */
+#define TCP_F_SACK         0x08 /* SACK permission option is offered */
+#define TCP_F_USER_MASK    0x0f /* Flags set by socket options */
+#define TCP_F_REM_WSCALE   0x10 /* Window scale option was received */
+#define TCP_F_REM_SACK     0x20 /* SACK permission option was received */
+
+/* Values of rexmit_mode */
+#define TCP_REXMIT_NONE       0 /* Normal transmission */
+#define TCP_REXMIT_FAST       1 /* Fast recovery after duplicate acks */
+#define TCP_REXMIT_RTO        2 /* Go-back-N recovery after timeout */
+
 /* Delays in milliseconds */
-#define TCP_TIMER_FREQUENCY   1000  /* Frequency for tcp_tmr_default */
 #define TCP_TIMEWAIT_DELAY    2000  /* Delay for TIME-WAIT state */
-#define TCP_REXMIT_DELAY      2000  /* Delay between rexmitting */
 #define TCP_SYNC_TIMEOUT      5000  /* Synchronization timeout */
+#define TCP_RTO_INITIAL       1000  /* Rexmit timeout before first RTT sample (RFC 6298) */
+#define TCP_RTO_MIN            200  /* Lower bound of rexmit timeout */
+#define TCP_RTO_MAX          60000  /* Upper bound of rexmit timeout */
+#define TCP_DELACK_TIMEOUT      40  /* Delay of acknowledgment for received data */
+
+#define TCP_REXMIT_DUP_ACK       3  /* Rexmit after n duplicate ack */
+#define TCP_DELACK_SEGS          2  /* Acknowledge at least every n-th segment */
 
-#define TCP_REXMIT_DUP_ACK       5  /* Rexmit after n duplicate ack */
+#define TCP_MSS_DEFAULT        536  /* Send MSS if peer doesn't set it (RFC 1122) */
+#define TCP_MSS_ADVERTISED   16396  /* MSS sent in SYN */
+#define TCP_WINDOW_FACTOR_MAX   14  /* RFC 7323 2.3 */
+#define TCP_SYN_OPTS_MAX        12  /* MSS, window scale and SACK permission */
 
 #define TCP_WINDOW_VALUE_DEFAULT  16384 /* Default size of widnow */
 #define TCP_WINDOW_FACTOR_DEFAULT     7 /* Default factor of widnow */
@@ -153,6 +208,7 @@ extern const struct sock_proto_ops *const tcp_sock_ops __attribute__((weak));
 
 /* Others functionality */
 extern void tcp_sock_release(struct tcp_sock *tcp_sk);
+extern void tcp_sock_timer_init(struct tcp_sock *tcp_sk);
 extern void tcp_sock_set_state(struct tcp_sock *tcp_sk,
 		enum tcp_sock_state new_state);
 extern void tcp_seq_state_set_wind_value(struct tcp_seq_state *tcp_seq_st,
@@ -164,6 +220,10 @@ extern void tcp_sock_unlock(struct tcp_sock *sk, unsigned int obj);
 extern int alloc_prep_skb(struct tcp_sock *tcp_sk, size_t opt_len,
 		size_t *data_len, struct sk_buff **out_skb);
 extern void send_seq_from_sock(struct tcp_sock *tcp_sk, struct sk_buff *skb);
+extern void tcp_sock_xmit(struct tcp_sock *tcp_sk);
+extern struct sk_buff *tcp_sock_unqueue_tail(struct tcp_sock *tcp_sk,
+		size_t max_len);
+extern size_t tcp_sock_syn_opts(struct tcp_sock *tcp_sk, void *opts);
 extern int tcp_sock_get_status(struct tcp_sock *tcp_sk);
 extern void debug_print(__u8 code, const char *msg, ...);
 
@@ -0,0 +1,46 @@
+/**
+ * @file
+ * @brief Pluggable TCP congestion control.
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef NET_L4_TCP_CONG_H_
+#define NET_L4_TCP_CONG_H_
+
+#include <stdint.h>
+#include <netinet/tcp.h>
+#include <util/array.h>
+
+struct tcp_sock;
+
+#define TCP_CONG_NAME_MAX TCP_CA_NAME_MAX
+
+/**
+ * Each congestion control algorithm implements this interface. Loss
+ * recovery (fast retransmit, NewReno partial acks and go-back-N after
+ * timeout) is common and is done by TCP itself, algorithm only decides
+ * how the window grows and how much it shrinks.
+ */
+struct tcp_cong_ops {
+	const char *name;
+	/* Called when algorithm is attached to socket */
+	void (*init)(struct tcp_sock *tcp_sk);
+	/* New data @a acked bytes long was acknowledged out of recovery */
+	void (*cong_avoid)(struct tcp_sock *tcp_sk, uint32_t acked);
+	/* Returns new slow start threshold when loss was detected */
+	uint32_t (*ssthresh)(struct tcp_sock *tcp_sk);
+};
+
+extern const struct tcp_cong_ops *tcp_cong_lookup(const char *name);
+extern const struct tcp_cong_ops *tcp_cong_default(void);
+
+ARRAY_SPREAD_DECLARE(const struct tcp_cong_ops *const, __tcp_cong_registry);
+
+#define tcp_cong_foreach(cong_ops) \
+	array_spread_foreach(cong_ops, __tcp_cong_registry)
+
+#define TCP_CONG_OPS_DEF(_ops) \
+	ARRAY_SPREAD_ADD(__tcp_cong_registry, &_ops)
+
+#endif /* NET_L4_TCP_CONG_H_ */
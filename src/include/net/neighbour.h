@@ -17,7 +17,8 @@
  * Neighbour entity
  */
 struct neighbour {
-	struct dlist_head lnk;             /* lnk */
+	struct neighbour *hnext;           /* next in hash chain */
+	struct dlist_head lnk;             /* aging list lnk */
 	unsigned short ptype;              /* protocol */
 	unsigned char paddr[MAX_ADDR_LEN]; /* protocol address */
 	unsigned char plen;                /* protocol address len  */
@@ -28,8 +29,7 @@ struct neighbour {
 	unsigned char hlen;                /* hw address len */
 	int flags;                         /* flags */
 	struct sk_buff_head w_queue;       /* waiting queue */
-	int expire;                        /* lifetime */
-	int resend;                        /* re-send timeout */
+	unsigned int deadline;             /* tick of next aging event */
 	int sent_times;                    /* how much times request was sent */
 };
 
@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <hal/cpu.h>
 #include <net/if.h>
 #include <net/skbuff.h>
 #include <util/dlist.h>
@@ -76,6 +77,12 @@ typedef struct net_driver {
 	int (*mdio_write)(struct net_device *dev, uint8_t reg, uint16_t data);
 	void (*set_phyid)(struct net_device *dev, uint8_t phyid);
 	int (*set_speed)(struct net_device *dev, int speed);
+
+	/* Poll mode RX (see net/l0/net_poll.h). Driver masks its RX interrupt
+	 * and calls netif_poll_schedule() instead of receiving packets in IRQ */
+	int (*poll)(struct net_device *dev, int budget);
+	/* Unmask RX interrupt. Returns non-zero if packets arrived meanwhile */
+	int (*poll_irq_enable)(struct net_device *dev);
 } net_driver_t;
 
 
@@ -105,6 +112,29 @@ typedef struct net_device_ops {
 	int (*check_mtu)(int mtu);
 } net_device_ops_t;
 
+/**
+ * net device features
+ */
+#define NETIF_F_SG 0x1 /* Device gathers non-linear sk_buff itself */
+
+/**
+ * Every device has a queue of received packets per CPU, so flows are
+ * processed by different CPUs, and the same number of transmission queues.
+ * Only first num_tx_queues of them are used, it's the number of queues of
+ * the hardware. Queue i is served by CPU i.
+ */
+#define NETDEV_QUEUES_MAX NCPU
+
+struct netdev_queue {
+	struct net_device *dev;
+	struct dlist_head rx_lnk;   /* for netif_rx list of the CPU */
+	struct dlist_head tx_lnk;   /* for netif_tx list of the CPU */
+	struct sk_buff_head rx;     /* rx skb queue */
+	struct sk_buff_head tx;     /* tx skb queue */
+	unsigned long rx_packets;
+	unsigned long tx_packets;
+};
+
 /**
  * structure of net device
  */
@@ -117,16 +147,18 @@ typedef struct net_device {
 	unsigned char hdr_len; /**< hardware header length      */
 	unsigned char addr_len; /**< hardware address length      */
 	unsigned int flags; /**< interface flags (a la BSD)   */
+	unsigned int features; /**< NETIF_F_* offload capabilities */
 	unsigned int mtu; /**< interface MTU value          */
 	uintptr_t base_addr; /**< device I/O address           */
 	unsigned int irq; /**< device IRQ number            */
 	struct net_device_stats stats;
 	const struct net_device_ops *ops; /**< Hardware description  */
 	const struct net_driver *drv_ops; /**< Management operations        */
-	struct dlist_head rx_lnk;         /* for netif_rx list */
-	struct dlist_head tx_lnk;         /* for netif_tx list */
-	struct sk_buff_head dev_queue;    /* rx skb queue */
-	struct sk_buff_head dev_queue_tx; /* tx skb queue */
+	struct dlist_head poll_lnk;       /* for netif_poll list */
+	unsigned int poll_avg;            /* average packets per poll, x16 */
+	unsigned int poll_idle;           /* empty polls in a row */
+	unsigned int num_tx_queues;       /* hardware tx queues, 1 by default */
+	struct netdev_queue queues[NETDEV_QUEUES_MAX];
 	struct net_node *pnet_node;
 #if defined(NET_NAMESPACE_ENABLED) && (NET_NAMESPACE_ENABLED == 1)
 	net_namespace_p net_ns;
@@ -169,6 +201,14 @@ extern struct net_device *veth_alloc(struct net_device **v1,
  */
 extern void netdev_free(struct net_device *dev);
 
+/**
+ * Set the number of hardware transmission queues. Packets of one flow
+ * are always passed to the same queue (see skb->queue_mapping)
+ * @param dev net_device handler
+ * @param num number of queues, from 1 to NETDEV_QUEUES_MAX
+ */
+extern int netdev_set_num_tx_queues(struct net_device *dev, unsigned int num);
+
 /**
  * Register network device
  * @param dev net_device handler
@@ -79,6 +79,7 @@ struct nf_rule {
 	NF_DECL_NOT_FIELD(dport, in_port_t);
 	nf_test_hnd test_hnd;
 	void *test_hnd_data;
+	unsigned long hits; /* packets matched the rule */
 };
 
 /**
@@ -34,6 +34,19 @@ typedef struct sk_buff_head {
 	struct sk_buff *prev;       /* Previous buffer in list */
 } sk_buff_head_t;
 
+/* Maximum number of paged fragments referenced by one sk_buff */
+#define SKB_FRAGS_MAX 2
+
+/**
+ * Piece of packet data which lives in a buffer of other sk_buff.
+ * The buffer is referenced with skb_data_clone() so it's never copied
+ */
+struct skb_frag {
+	struct sk_buff_data *data;  /* Referenced buffer */
+	unsigned char *ptr;         /* Start of the piece inside the buffer */
+	size_t len;
+};
+
 typedef struct sk_buff {        /* Socket buffer */
 	/* This member must be first. */
 	struct sk_buff_head lnk;    /* Pointers to next and previous packages */
@@ -41,6 +54,7 @@ typedef struct sk_buff {        /* Socket buffer */
 	struct net_device *dev;     /* Device we arrived on/are leaving by */
 	struct pool *pl;	/* Local net driver pool pointer. Zero if default.
 				   Probably, should be joined with *dev field */
+	unsigned short queue_mapping; /* Queue of the device (see netif_tx) */
 
 		/* Control buffer (used to store layer-specific info e.g. ip options)
 		 * Nowdays it's used only in ip options, so it's a good idea to
@@ -79,6 +93,16 @@ typedef struct sk_buff {        /* Socket buffer */
 		 */
 	struct sk_buff_data *data;
 
+		/* Packet content which doesn't fit the linear part. It follows
+		 * the linear part in order: first frags[], then len bytes from
+		 * mac.raw of each sk_buff of frag_list (they must be linear).
+		 * data_len is the length of all of them and is included in len
+		 */
+	size_t data_len;
+	unsigned int nr_frags;
+	struct skb_frag frags[SKB_FRAGS_MAX];
+	struct sk_buff_head frag_list;
+
 		/* After processing by (incoming) stack packet is used by
 		 * socket structures. Socket (== User) may consume only a part
 		 * of data. Taken data ends with p_data
@@ -159,6 +183,61 @@ extern struct sk_buff * skb_clone(const struct sk_buff *skb);
  */
 extern struct sk_buff * skb_declone(struct sk_buff *skb);
 
+static inline int skb_is_nonlinear(const struct sk_buff *skb) {
+	return skb->data_len != 0;
+}
+
+/**
+ * Length of the part of content which starts from mac.raw
+ */
+static inline size_t skb_headlen(const struct sk_buff *skb) {
+	return skb->len - skb->data_len;
+}
+
+/**
+ * Append @a len bytes at @a ptr of @a skb_data buffer to the content
+ * of @a skb without copying. Buffer is referenced until @a skb is freed
+ * @return -ENOSPC if there are no free fragment slots
+ */
+extern int skb_add_frag(struct sk_buff *skb, struct sk_buff_data *skb_data,
+		unsigned char *ptr, size_t len);
+
+/**
+ * Append @a len bytes of @a from content starting at @a offset to the
+ * content of @a to without copying.
+ * @return -ENOSPC if there are not enough free fragment slots, @a to is
+ * not changed in that case
+ */
+extern int skb_add_frag_range(struct sk_buff *to, const struct sk_buff *from,
+		size_t offset, size_t len);
+
+/**
+ * Append linear @a frag to the frag_list of @a skb. Its len bytes starting
+ * from mac.raw become the part of content, @a frag is owned by @a skb then
+ */
+extern void skb_frag_list_add(struct sk_buff *skb, struct sk_buff *frag);
+
+/**
+ * Get contiguous piece of content starting at @a offset
+ * @return pointer to the piece or NULL if @a offset is out of content,
+ * length of piece is stored to @a len
+ */
+extern unsigned char *skb_chunk(const struct sk_buff *skb, size_t offset,
+		size_t *len);
+
+/**
+ * Copy @a len bytes of content starting at @a offset to @a to
+ * @return number of copied bytes
+ */
+extern size_t skb_copy_bits(const struct sk_buff *skb, size_t offset,
+		void *to, size_t len);
+
+/**
+ * Gather all content of @a skb into its own buffer
+ * @return @a skb or NULL if there is no memory, @a skb isn't changed then
+ */
+extern struct sk_buff *skb_linearize(struct sk_buff *skb);
+
 /**
  * Write buffer from iovec
  *
@@ -217,6 +296,25 @@ extern struct sk_buff * skb_queue_pop(struct sk_buff_head *queue);
 
 extern int skb_queue_count(struct sk_buff_head *queue);
 
+/**
+ * Same as skb_queue_push() and skb_queue_pop() but without IPL protection.
+ * Used for lists which are private to the caller.
+ */
+extern void __skb_queue_push(struct sk_buff_head *queue, struct sk_buff *skb);
+extern struct sk_buff * __skb_queue_pop(struct sk_buff_head *queue);
+
+/**
+ * Move up to @a max sk_buff from the head of @a queue to the tail of @a list
+ * with IPL saved only once
+ * @return number of moved sk_buff
+ */
+extern int skb_queue_splice(struct sk_buff_head *queue,
+		struct sk_buff_head *list, int max);
+
+static inline int skb_queue_empty(struct sk_buff_head *queue) {
+	return (void *) queue->next == (void *) queue;
+}
+
 static inline struct sk_buff * skb_queue_next(struct sk_buff *skb) {
 	return skb->lnk.next;
 }
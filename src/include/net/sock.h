@@ -76,6 +76,7 @@ struct sock {
 	struct idesc idesc;
 	struct sock_xattr sock_xattr;
 	struct dlist_head lnk;
+	struct dlist_head hash_lnk;
 	enum sock_state state;
 	struct sock_opt opt;
 	struct sk_buff_head rx_queue;
@@ -129,6 +130,7 @@ struct sock_family_ops {
 	int (*setsockopt)(struct sock *sk, int level, int optname,
 			const void *optval, socklen_t optlen);
 	int (*shutdown)(struct sock *sk, int how);
+	int (*socketpair)(struct sock *sk1, struct sock *sk2);
 	struct pool *sock_pool;
 };
 
@@ -149,6 +151,7 @@ struct sock_proto_ops {
 	int (*setsockopt)(struct sock *sk, int level, int optname,
 			const void *optval, socklen_t optlen);
 	int (*shutdown)(struct sock *sk, int how);
+	ssize_t (*splice_write)(struct sock *sk, struct idesc *in, size_t len);
 	struct pool *sock_pool;
 	struct dlist_head *sock_list;
 };
@@ -174,6 +177,8 @@ extern void sock_release(struct sock *sk);
 
 extern void sock_hash(struct sock *sk);
 extern void sock_unhash(struct sock *sk);
+/* Must be called after local or remote address of hashed socket changed */
+extern void sock_rehash(struct sock *sk);
 
 
 extern void sock_rcv(struct sock *sk, struct sk_buff *skb,
@@ -206,6 +211,15 @@ extern struct sock * sock_lookup(const struct sock *sk,
 		sock_lookup_tester_ft tester,
 		const struct sk_buff *skb);
 
+extern struct sock * sock_lookup_established(
+		const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		const void *raddr, size_t raddr_len, in_port_t lport,
+		in_port_t rport);
+extern struct sock * sock_lookup_listener(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		in_port_t lport);
+
 typedef int (*sock_addr_tester_ft)(const struct sockaddr *addr1,
 		const struct sockaddr *addr2);
 
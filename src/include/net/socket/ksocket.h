@@ -16,6 +16,7 @@
 
 struct sock;
 struct msghdr;
+struct idesc;
 
 /**
  * Create socket method in kernel layer.
@@ -38,6 +39,20 @@ struct msghdr;
  */
 extern struct sock * ksocket(int family, int type, int protocol);
 
+/**
+ * Create a pair of connected sockets.
+ * Both sockets are created with ksocket() and then joined by socketpair
+ * method of the family.
+ *
+ * @param family - a protocol family (only AF_UNIX supports it)
+ * @param type - socket type
+ * @param protocol - a particular protocol to be used with the socket
+ * @param sv - created sockets
+ * @return 0 on success, minus posix errno on failure
+ */
+extern int ksocketpair(int family, int type, int protocol,
+		struct sock *sv[2]);
+
 /**
  * Close socket method in kernel layer.
  * Calls socket's native release method if present and
@@ -136,6 +151,15 @@ extern int ksendmsg(struct sock *sk, struct msghdr *msg,
 extern int krecvmsg(struct sock *sk, struct msghdr *msg,
 		int flags);
 
+/**
+ * Send up to @a len bytes read from @a in straight into the socket buffers.
+ * Call splice_write callback from proto_ops.
+ *
+ * @return number of sent bytes, -EOPNOTSUPP if the protocol can't do it
+ * or another error code
+ */
+extern ssize_t ksplice_write(struct sock *sk, struct idesc *in, size_t len);
+
 extern int kshutdown(struct sock *sk, int how);
 
 /**
@@ -0,0 +1,662 @@
+/**
+ * @file
+ * @brief Lock-free per-CPU log rings drained to the console by an lthread
+ *
+ * A message is stored as a format pointer plus its arguments copied in
+ * binary form, so logging costs a copy of a few words and never waits for
+ * the console. The lthread formats messages in the order they were logged,
+ * prints them with diag and keeps them in a history read by dmesg.
+ *
+ * @date 18.10.2026
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <drivers/diag.h>
+#include <embox/unit.h>
+#include <framework/mod/options.h>
+#include <hal/cpu.h>
+#include <kernel/klog.h>
+#include <kernel/lthread/lthread.h>
+#include <kernel/printk.h>
+#include <kernel/sched/schedee_priority.h>
+#include <kernel/spinlock.h>
+#include <util/logging.h>
+#include <util/math.h>
+
+#define KLOG_RING_SIZE    OPTION_GET(NUMBER, ring_size)
+#define KLOG_HISTORY_SIZE OPTION_GET(NUMBER, history_size)
+#define KLOG_CONSOLE      OPTION_GET(BOOLEAN, console)
+#define KLOG_HND_PRIORITY OPTION_GET(NUMBER, hnd_priority)
+
+static_assert(!(KLOG_RING_SIZE & (KLOG_RING_SIZE - 1)),
+		"ring_size must be a power of 2");
+static_assert(!(KLOG_HISTORY_SIZE & (KLOG_HISTORY_SIZE - 1)),
+		"history_size must be a power of 2");
+
+#define KLOG_REC_MAX   256 /* a message with its arguments */
+#define KLOG_STR_MAX   64  /* longer %s arguments are cut */
+#define KLOG_LINE_MAX  256 /* a formatted message */
+#define KLOG_SPEC_MAX  32  /* a single conversion specification */
+
+#define KLOG_ALIGN(x)  (((x) + 7) & ~7)
+
+/* States of a record in a ring */
+#define KLOG_REC_EMPTY 0 /* being written or already consumed */
+#define KLOG_REC_READY 1
+#define KLOG_REC_PAD   2 /* filler up to the end of the ring */
+
+/* How an argument is stored */
+#define KLOG_ARG_NONE  0 /* unknown conversion */
+#define KLOG_ARG_INT   1
+#define KLOG_ARG_UINT  2
+#define KLOG_ARG_DBL   3
+#define KLOG_ARG_PTR   4
+#define KLOG_ARG_STR   5
+#define KLOG_ARG_SKIP  6 /* %n, the argument is dropped */
+#define KLOG_ARG_PCT   7 /* %%, no argument */
+
+struct klog_rec {
+	uint16_t size;       /* of the whole record, aligned */
+	uint16_t args_len;
+	volatile uint8_t state;
+	uint8_t level;
+	uint8_t truncated;
+	uint32_t seq;        /* order of messages among all CPUs */
+	const char *fmt;
+	char args[];
+} __attribute__((aligned(8)));
+
+struct klog_ring {
+	unsigned long head;  /* bytes reserved by writers */
+	unsigned long tail;  /* bytes consumed by the drain */
+	struct klog_stats stats;
+	char buf[KLOG_RING_SIZE] __attribute__((aligned(8)));
+};
+
+struct klog_spec {
+	const char *start;   /* first character after '%' */
+	const char *end;     /* character after the conversion */
+	int cls;
+	char len;            /* length modifier, 'H' for hh and 'q' for ll */
+	int stars;           /* width and precision given as arguments */
+};
+
+static struct klog_ring klog_rings[NCPU];
+static uint32_t klog_seq;
+static int klog_ready;
+static int klog_wake_pending;
+static volatile int klog_draining;
+
+static char klog_history[KLOG_HISTORY_SIZE];
+static unsigned long klog_hist_head;  /* bytes ever written */
+static unsigned long klog_hist_start; /* first byte not cleared */
+static spinlock_t klog_hist_lock = SPIN_STATIC_UNLOCKED;
+
+static struct lthread klog_lt;
+
+EMBOX_UNIT_INIT(klog_init);
+
+static const char *klog_spec_parse(const char *p, struct klog_spec *sp) {
+	sp->start = p;
+	sp->len = 0;
+	sp->stars = 0;
+
+	while (*p && strchr("-+ #0'", *p)) {
+		p++;
+	}
+	for (; (*p >= '0' && *p <= '9') || *p == '*' || *p == '.'; p++) {
+		sp->stars += (*p == '*');
+	}
+
+	switch (*p) {
+	case 'h':
+		sp->len = (*++p == 'h') ? (p++, 'H') : 'h';
+		break;
+	case 'l':
+		sp->len = (*++p == 'l') ? (p++, 'q') : 'l';
+		break;
+	case 'j':
+	case 'z':
+	case 't':
+	case 'L':
+		sp->len = *p++;
+		break;
+	}
+
+	switch (*p) {
+	case 'd': case 'i': case 'c':
+		sp->cls = KLOG_ARG_INT;
+		break;
+	case 'u': case 'o': case 'x': case 'X':
+		sp->cls = KLOG_ARG_UINT;
+		break;
+	case 'f': case 'F': case 'e': case 'E':
+	case 'g': case 'G': case 'a': case 'A':
+		sp->cls = KLOG_ARG_DBL;
+		break;
+	case 'p':
+		sp->cls = KLOG_ARG_PTR;
+		break;
+	case 's':
+		sp->cls = KLOG_ARG_STR;
+		break;
+	case 'n':
+		sp->cls = KLOG_ARG_SKIP;
+		break;
+	case '%':
+		sp->cls = KLOG_ARG_PCT;
+		break;
+	default:
+		sp->cls = KLOG_ARG_NONE;
+		sp->end = p;
+		return p;
+	}
+
+	sp->end = ++p;
+	return p;
+}
+
+static int klog_arg_put(char *dst, size_t *off, size_t size,
+		const void *val, size_t len) {
+	if (*off + len > size) {
+		return -ENOSPC;
+	}
+	memcpy(dst + *off, val, len);
+	*off += len;
+	return 0;
+}
+
+/* Copies arguments of @a fmt to @a dst, returns number of bytes used */
+static size_t klog_pack(char *dst, size_t size, const char *fmt,
+		va_list args, uint8_t *truncated) {
+	struct klog_spec sp;
+	const char *p, *s;
+	long long ll;
+	double d;
+	void *ptr;
+	size_t off;
+	uint8_t slen;
+	int i, star;
+	va_list ap;
+
+	off = 0;
+	va_copy(ap, args);
+
+	for (p = fmt; *p; ) {
+		if (*p++ != '%') {
+			continue;
+		}
+		p = klog_spec_parse(p, &sp);
+		if (sp.cls == KLOG_ARG_PCT) {
+			continue;
+		}
+		if (sp.cls == KLOG_ARG_NONE) {
+			/* the rest of the format is printed as is */
+			break;
+		}
+
+		for (i = 0; i < sp.stars; i++) {
+			star = va_arg(ap, int);
+			if (klog_arg_put(dst, &off, size, &star, sizeof star)) {
+				goto out_truncated;
+			}
+		}
+
+		switch (sp.cls) {
+		case KLOG_ARG_INT:
+			ll = sp.len == 'l' ? va_arg(ap, long)
+				: sp.len == 'q' ? va_arg(ap, long long)
+				: sp.len == 'j' ? va_arg(ap, intmax_t)
+				: sp.len == 'z' ? va_arg(ap, ssize_t)
+				: sp.len == 't' ? va_arg(ap, ptrdiff_t)
+				: va_arg(ap, int);
+			if (klog_arg_put(dst, &off, size, &ll, sizeof ll)) {
+				goto out_truncated;
+			}
+			break;
+		case KLOG_ARG_UINT:
+			ll = sp.len == 'l' ? va_arg(ap, unsigned long)
+				: sp.len == 'q' ? va_arg(ap, unsigned long long)
+				: sp.len == 'j' ? va_arg(ap, uintmax_t)
+				: sp.len == 'z' ? va_arg(ap, size_t)
+				: sp.len == 't' ? va_arg(ap, ptrdiff_t)
+				: va_arg(ap, unsigned int);
+			if (klog_arg_put(dst, &off, size, &ll, sizeof ll)) {
+				goto out_truncated;
+			}
+			break;
+		case KLOG_ARG_DBL:
+			d = sp.len == 'L' ? va_arg(ap, long double) : va_arg(ap, double);
+			if (klog_arg_put(dst, &off, size, &d, sizeof d)) {
+				goto out_truncated;
+			}
+			break;
+		case KLOG_ARG_PTR:
+			ptr = va_arg(ap, void *);
+			if (klog_arg_put(dst, &off, size, &ptr, sizeof ptr)) {
+				goto out_truncated;
+			}
+			break;
+		case KLOG_ARG_STR:
+			/* The string may be gone when the message is printed */
+			s = va_arg(ap, const char *);
+			if (s == NULL) {
+				s = "(null)";
+			}
+			slen = strnlen(s, KLOG_STR_MAX);
+			if (klog_arg_put(dst, &off, size, &slen, sizeof slen)
+					|| klog_arg_put(dst, &off, size, s, slen)) {
+				goto out_truncated;
+			}
+			break;
+		case KLOG_ARG_SKIP:
+			(void) va_arg(ap, void *);
+			break;
+		}
+	}
+
+	va_end(ap);
+	return off;
+
+out_truncated:
+	*truncated = 1;
+	va_end(ap);
+	return off;
+}
+
+/* Formats a conversion of @a sp with arguments at @a args */
+static int klog_format_spec(char *out, size_t room, struct klog_spec *sp,
+		const char **args, const char *args_end) {
+	char spec[KLOG_SPEC_MAX];
+	char str[KLOG_STR_MAX + 1];
+	const char *p;
+	long long ll;
+	double d;
+	void *ptr;
+	uint8_t slen;
+	size_t n;
+	int star;
+
+	n = 0;
+	spec[n++] = '%';
+	for (p = sp->start; p < sp->end && n < sizeof spec - 12; p++) {
+		if (*p != '*') {
+			spec[n++] = *p;
+			continue;
+		}
+		if (*args + sizeof star > args_end) {
+			return -1;
+		}
+		memcpy(&star, *args, sizeof star);
+		*args += sizeof star;
+		n += sprintf(&spec[n], "%d", star);
+	}
+	spec[n] = '\0';
+
+	switch (sp->cls) {
+	case KLOG_ARG_INT:
+	case KLOG_ARG_UINT:
+		if (*args + sizeof ll > args_end) {
+			return -1;
+		}
+		memcpy(&ll, *args, sizeof ll);
+		*args += sizeof ll;
+
+		if (sp->cls == KLOG_ARG_INT) {
+			return sp->len == 'l' ? snprintf(out, room, spec, (long) ll)
+				: sp->len == 'q' ? snprintf(out, room, spec, ll)
+				: sp->len == 'j' ? snprintf(out, room, spec, (intmax_t) ll)
+				: sp->len == 'z' ? snprintf(out, room, spec, (ssize_t) ll)
+				: sp->len == 't' ? snprintf(out, room, spec, (ptrdiff_t) ll)
+				: snprintf(out, room, spec, (int) ll);
+		}
+		return sp->len == 'l' ? snprintf(out, room, spec, (unsigned long) ll)
+			: sp->len == 'q' ? snprintf(out, room, spec, (unsigned long long) ll)
+			: sp->len == 'j' ? snprintf(out, room, spec, (uintmax_t) ll)
+			: sp->len == 'z' ? snprintf(out, room, spec, (size_t) ll)
+			: sp->len == 't' ? snprintf(out, room, spec, (ptrdiff_t) ll)
+			: snprintf(out, room, spec, (unsigned int) ll);
+	case KLOG_ARG_DBL:
+		if (*args + sizeof d > args_end) {
+			return -1;
+		}
+		memcpy(&d, *args, sizeof d);
+		*args += sizeof d;
+		return sp->len == 'L' ? snprintf(out, room, spec, (long double) d)
+			: snprintf(out, room, spec, d);
+	case KLOG_ARG_PTR:
+		if (*args + sizeof ptr > args_end) {
+			return -1;
+		}
+		memcpy(&ptr, *args, sizeof ptr);
+		*args += sizeof ptr;
+		return snprintf(out, room, spec, ptr);
+	case KLOG_ARG_STR:
+		if (*args + sizeof slen > args_end) {
+			return -1;
+		}
+		memcpy(&slen, *args, sizeof slen);
+		if (*args + sizeof slen + slen > args_end) {
+			return -1;
+		}
+		memcpy(str, *args + sizeof slen, slen);
+		str[slen] = '\0';
+		*args += sizeof slen + slen;
+		return snprintf(out, room, spec, str);
+	default:
+		return 0;
+	}
+}
+
+static size_t klog_format(char *line, size_t size, struct klog_rec *rec) {
+	struct klog_spec sp;
+	const char *p, *args, *args_end;
+	size_t len;
+	int n;
+
+	args = rec->args;
+	args_end = rec->args + rec->args_len;
+	len = 0;
+
+	for (p = rec->fmt; *p && len < size - 1; ) {
+		if (*p != '%') {
+			line[len++] = *p++;
+			continue;
+		}
+
+		if (klog_spec_parse(p + 1, &sp), sp.cls == KLOG_ARG_NONE) {
+			n = min(strlen(p), size - len - 1);
+			memcpy(line + len, p, n);
+			len += n;
+			break;
+		}
+		p = sp.end;
+		if (sp.cls == KLOG_ARG_PCT) {
+			line[len++] = '%';
+			continue;
+		}
+
+		n = klog_format_spec(line + len, size - len, &sp, &args, args_end);
+		if (n < 0) {
+			break;
+		}
+		len += min((size_t) n, size - len - 1);
+	}
+
+	if (rec->truncated) {
+		len = min(len, size - 5);
+		memcpy(line + len, "...\n", 4);
+		len += 4;
+	}
+	line[len] = '\0';
+
+	return len;
+}
+
+static int klog_put(struct klog_rec *src, size_t size) {
+	struct klog_ring *ring;
+	struct klog_rec *rec;
+	unsigned long head, new_head, off, skip;
+
+	ring = &klog_rings[cpu_get_id()];
+
+	/* Writers of the same CPU (a thread and interrupts) reserve space
+	 * with a CAS and fill it in without any lock */
+	do {
+		head = ring->head;
+		off = head % KLOG_RING_SIZE;
+		skip = (off + size > KLOG_RING_SIZE) ? KLOG_RING_SIZE - off : 0;
+		new_head = head + skip + size;
+		if (new_head - ring->tail > KLOG_RING_SIZE) {
+			__sync_fetch_and_add(&ring->stats.dropped, 1);
+			return -ENOSPC;
+		}
+	} while (!__sync_bool_compare_and_swap(&ring->head, head, new_head));
+
+	if (skip) {
+		rec = (struct klog_rec *) &ring->buf[off];
+		rec->size = skip;
+		__sync_synchronize();
+		rec->state = KLOG_REC_PAD;
+	}
+
+	rec = (struct klog_rec *) &ring->buf[(head + skip) % KLOG_RING_SIZE];
+	src->state = KLOG_REC_EMPTY;
+	src->seq = __sync_fetch_and_add(&klog_seq, 1);
+	memcpy(rec, src, size);
+	__sync_synchronize();
+	rec->state = KLOG_REC_READY;
+
+	__sync_fetch_and_add(&ring->stats.written, 1);
+	if (src->truncated) {
+		__sync_fetch_and_add(&ring->stats.truncated, 1);
+	}
+
+	return 0;
+}
+
+/* Frees @a size bytes at the tail of @a ring. They are cleared, as a record
+ * reserved there later may start at any 8-byte slot, and its state must
+ * read as empty until the writer fills it in */
+static void klog_release(struct klog_ring *ring, uint16_t size) {
+	memset(&ring->buf[ring->tail % KLOG_RING_SIZE], KLOG_REC_EMPTY, size);
+	__sync_synchronize();
+	ring->tail += size;
+}
+
+/* Returns the oldest ready record of @a ring, NULL if there is none */
+static struct klog_rec *klog_peek(struct klog_ring *ring) {
+	struct klog_rec *rec;
+	uint16_t size;
+
+	while (ring->tail != ring->head) {
+		rec = (struct klog_rec *) &ring->buf[ring->tail % KLOG_RING_SIZE];
+		if (rec->state == KLOG_REC_PAD) {
+			__sync_synchronize();
+			size = rec->size;
+			klog_release(ring, size);
+			continue;
+		}
+		if (rec->state != KLOG_REC_READY) {
+			/* still written by somebody */
+			return NULL;
+		}
+		__sync_synchronize();
+		return rec;
+	}
+
+	return NULL;
+}
+
+static void klog_consume(struct klog_ring *ring, struct klog_rec *rec) {
+	klog_release(ring, rec->size);
+}
+
+static void klog_history_put(const char *line, size_t len) {
+	size_t off, n;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&klog_hist_lock);
+	{
+		while (len > 0) {
+			off = klog_hist_head % KLOG_HISTORY_SIZE;
+			n = min(len, KLOG_HISTORY_SIZE - off);
+			memcpy(&klog_history[off], line, n);
+			klog_hist_head += n;
+			line += n;
+			len -= n;
+		}
+	}
+	spin_unlock_ipl(&klog_hist_lock, ipl);
+}
+
+/* Whether some ring has a message which can be printed right now */
+static int klog_pending(void) {
+	struct klog_ring *ring;
+	struct klog_rec *rec;
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < NCPU; cpu++) {
+		ring = &klog_rings[cpu];
+		if (ring->tail == ring->head) {
+			continue;
+		}
+		rec = (struct klog_rec *) &ring->buf[ring->tail % KLOG_RING_SIZE];
+		if (rec->state != KLOG_REC_EMPTY) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void klog_drain_locked(void) {
+	char line[KLOG_LINE_MAX];
+	struct klog_ring *ring, *best_ring;
+	struct klog_rec *rec, *best;
+	size_t len, i;
+	unsigned int cpu;
+
+	for (;;) {
+		best = NULL;
+		best_ring = NULL;
+		for (cpu = 0; cpu < NCPU; cpu++) {
+			ring = &klog_rings[cpu];
+			rec = klog_peek(ring);
+			if (rec && (!best || (int32_t) (rec->seq - best->seq) < 0)) {
+				best = rec;
+				best_ring = ring;
+			}
+		}
+		if (!best) {
+			break;
+		}
+
+		len = klog_format(line, sizeof line, best);
+		klog_consume(best_ring, best);
+
+		klog_history_put(line, len);
+		if (KLOG_CONSOLE) {
+			for (i = 0; i < len; i++) {
+				diag_putc(line[i]);
+			}
+		}
+	}
+}
+
+static void klog_drain(void) {
+	do {
+		if (__sync_lock_test_and_set(&klog_draining, 1)) {
+			/* Somebody else prints the messages right now */
+			return;
+		}
+		klog_drain_locked();
+		__sync_lock_release(&klog_draining);
+		/* A message could be put while we were releasing the flag */
+	} while (klog_pending());
+}
+
+void logging_vprint(int level, const char *fmt, va_list args) {
+	char buf[KLOG_REC_MAX] __attribute__((aligned(8)));
+	struct klog_rec *rec = (struct klog_rec *) buf;
+
+	if (!klog_ready) {
+		/* Too early for the lthread */
+		vprintk(fmt, args);
+		return;
+	}
+
+	rec->level = level;
+	rec->fmt = fmt;
+	rec->truncated = 0;
+	rec->args_len = klog_pack(rec->args, sizeof buf - sizeof *rec, fmt,
+			args, &rec->truncated);
+	rec->size = KLOG_ALIGN(sizeof *rec + rec->args_len);
+
+	if (0 != klog_put(rec, rec->size)) {
+		return;
+	}
+
+	if (!__sync_lock_test_and_set(&klog_wake_pending, 1)) {
+		lthread_launch(&klog_lt);
+	}
+}
+
+void klog_flush(void) {
+	do {
+		/* The lthread may be printing on another CPU */
+		klog_drain();
+	} while (klog_draining || klog_pending());
+}
+
+size_t klog_read(char *buf, size_t len, unsigned long *pos) {
+	unsigned long first;
+	size_t off, n, cnt;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&klog_hist_lock);
+	{
+		first = klog_hist_head > KLOG_HISTORY_SIZE
+			? klog_hist_head - KLOG_HISTORY_SIZE : 0;
+		first = max(first, klog_hist_start);
+		if (*pos < first) {
+			*pos = first;
+		}
+
+		cnt = min(len, (size_t) (klog_hist_head - *pos));
+		for (n = 0; n < cnt; n += off) {
+			off = min(cnt - n,
+				KLOG_HISTORY_SIZE - (size_t) (*pos % KLOG_HISTORY_SIZE));
+			memcpy(buf + n, &klog_history[*pos % KLOG_HISTORY_SIZE], off);
+			*pos += off;
+		}
+	}
+	spin_unlock_ipl(&klog_hist_lock, ipl);
+
+	return cnt;
+}
+
+void klog_clear(void) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&klog_hist_lock);
+	{
+		klog_hist_start = klog_hist_head;
+	}
+	spin_unlock_ipl(&klog_hist_lock, ipl);
+}
+
+int klog_get_stats(unsigned int cpu, struct klog_stats *stats) {
+	if (cpu >= NCPU) {
+		return -EINVAL;
+	}
+
+	*stats = klog_rings[cpu].stats;
+	return 0;
+}
+
+static int klog_run(struct lthread *self) {
+	/* Messages put after this are either seen below or wake us again */
+	__sync_lock_release(&klog_wake_pending);
+	__sync_synchronize();
+
+	klog_drain();
+
+	return 0;
+}
+
+static int klog_init(void) {
+	lthread_init(&klog_lt, klog_run);
+	schedee_priority_set(&klog_lt.schedee, KLOG_HND_PRIORITY);
+
+	klog_ready = 1;
+
+	return 0;
+}
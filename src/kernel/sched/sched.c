@@ -17,6 +17,7 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
 
 #include <util/log.h>
@@ -46,8 +47,10 @@
 static void sched_preempt(void);
 CRITICAL_DISPATCHER_DEF(sched_critical, sched_preempt, CRITICAL_SCHED_LOCK);
 
-//TODO these variable for scheduler (may be create object scheduler?)
-static struct runq rq;
+/* Per-CPU run queues. A ready schedee is kept in the queue of s->cpu, the
+ * CPU which has nothing but idle to run steals from the others. */
+static struct runq rq[NCPU];
+static struct sched_cpu_stats rq_stats[NCPU];
 
 static int sched_yield_req;
 
@@ -77,15 +80,75 @@ static inline int sched_in_interrupt(void) {
 }
 
 int sched_init(struct schedee *current) {
+	int cpu;
 
-	runq_init(&rq.queue);
-	rq.lock = SPIN_UNLOCKED;
+	for (cpu = 0; cpu < NCPU; cpu++) {
+		runq_init(&rq[cpu].queue);
+		rq[cpu].lock = SPIN_UNLOCKED;
+	}
 
 	sched_set_current(current);
 
 	return 0;
 }
 
+int sched_get_cpu_stats(unsigned int cpu, struct sched_cpu_stats *stats) {
+	if ((cpu >= NCPU) || (stats == NULL)) {
+		return -EINVAL;
+	}
+
+	*stats = rq_stats[cpu];
+
+	return 0;
+}
+
+static inline int sched_cpu_allowed(struct schedee *s, unsigned int cpu) {
+	return sched_affinity_check(&s->affinity, 1 << cpu);
+}
+
+/** Locks: IPL. Returns locked queue which holds @a s. */
+static struct runq *sched_rq_lock(struct schedee *s) {
+	unsigned int cpu;
+
+	while (1) {
+		cpu = s->cpu;
+		spin_lock(&rq[cpu].lock);
+		if (cpu == s->cpu) {
+			return &rq[cpu];
+		}
+		/* @a s was stolen in the meanwhile */
+		spin_unlock(&rq[cpu].lock);
+	}
+}
+
+/** Locks: IPL, thread. Chooses a CPU to enqueue woken up @a s. */
+static unsigned int sched_select_cpu(struct schedee *s) {
+#ifdef SMP
+	unsigned int cpu, best;
+
+	/* Prefer the previous CPU (cache is likely hot) unless another
+	 * allowed one has a shorter queue. */
+	best = s->cpu;
+	if (!sched_cpu_allowed(s, best)) {
+		best = cpu_get_id();
+	}
+
+	for (cpu = 0; cpu < NCPU; cpu++) {
+		if (!sched_cpu_allowed(s, cpu)) {
+			continue;
+		}
+		if (!sched_cpu_allowed(s, best)
+				|| (rq_stats[cpu].nr_ready < rq_stats[best].nr_ready)) {
+			best = cpu;
+		}
+	}
+
+	return best;
+#else
+	return 0;
+#endif
+}
+
 int schedee_init(struct schedee *schedee, int priority,
 	struct schedee *(*process)(struct schedee *prev, struct schedee *next),
 	enum schedee_type type)
@@ -93,6 +156,7 @@ int schedee_init(struct schedee *schedee, int priority,
 	runq_item_init(&schedee->runq_link);
 
 	schedee->lock = SPIN_UNLOCKED;
+	schedee->cpu = cpu_get_id();
 
 	schedee->type = type;
 	schedee->process = process;
@@ -115,9 +179,19 @@ void sched_set_current(struct schedee *schedee) {
 	schedee->ready = true;
 	schedee->active = true;
 	schedee->waiting = false;
+	schedee->cpu = cpu_get_id();
 }
 
 static void sched_check_preempt(struct schedee *t) {
+#ifdef SMP
+	if (t->cpu != cpu_get_id()) {
+		/* Remote CPU will compare priorities itself */
+		extern void smp_send_resched(int cpu_id);
+		smp_send_resched(t->cpu);
+		return;
+	}
+#endif /* SMP */
+
 	// TODO ask runq
 	if (schedee_priority_get(schedee_get_current()) <=
 			schedee_priority_get(t)) {
@@ -131,14 +205,16 @@ static void sched_check_preempt(struct schedee *t) {
 	}
 }
 
-/** Locks: IPL, thread, runq. */
+/** Locks: IPL, thread, runq of s->cpu. */
 static void __sched_enqueue(struct schedee *s) {
-	runq_insert(&rq.queue, s);
+	runq_insert(&rq[s->cpu].queue, s);
+	rq_stats[s->cpu].nr_ready++;
 }
 
-/** Locks: IPL, thread, runq. */
+/** Locks: IPL, thread, runq of s->cpu. */
 static void __sched_dequeue(struct schedee *s) {
-	runq_remove(&rq.queue, s);
+	runq_remove(&rq[s->cpu].queue, s);
+	rq_stats[s->cpu].nr_ready--;
 }
 
 /** Locks: IPL, thread, runq. */
@@ -161,10 +237,12 @@ int sched_change_priority(struct schedee *s, int prior,
 		int (*set_priority)(struct schedee_priority *, int)) {
 	ipl_t ipl;
 	int in_rq;
+	struct runq *queue;
 
 	assert(s);
 
-	ipl = spin_lock_ipl(&rq.lock);
+	ipl = ipl_save();
+	queue = sched_rq_lock(s);
 	in_rq = s->ready && !sched_active(s);
 
 	if (in_rq)
@@ -175,17 +253,19 @@ int sched_change_priority(struct schedee *s, int prior,
 
 	sched_check_preempt(s);
 
-	spin_unlock_ipl(&rq.lock, ipl);
+	spin_unlock(&queue->lock);
+	ipl_restore(ipl);
 
 	return 0;
 }
 
 static void __sched_freeze(struct schedee *s) {
 	int in_rq;
+	struct runq *queue;
 
 	assert(s);
 
-	spin_lock(&rq.lock);
+	queue = sched_rq_lock(s);
 	{
 		in_rq = s->ready && !sched_active(s);
 
@@ -198,7 +278,7 @@ static void __sched_freeze(struct schedee *s) {
 		s->active = false;
 		s->waiting = false;
 	}
-	spin_unlock(&rq.lock);
+	spin_unlock(&queue->lock);
 }
 
 void sched_freeze(struct schedee *s) {
@@ -297,17 +377,20 @@ void sched_freeze(struct schedee *s) {
 /** Locks: IPL, thread. */
 static int __sched_wakeup_ready(struct schedee *s) {
 	int ready;
+	struct runq *queue;
 
 	/* This doesn't necessarily spin until the lock is acquired.
 	 * SMP 'schedule' could outrun us getting the lock, but it will
 	 * clear t->ready state as soon as possible thus letting us to go. */
-	spin_protected_if (&rq.lock, (ready = s->ready))
+	queue = sched_rq_lock(s);
+	if ((ready = s->ready))
 		/* Event has arrived before the thread reached 'schedule' and
 		 * went asleep (it could be even preempted after setting its
 		 * t->waiting state).
 		 * Just clear t->waiting state so that only a preemption check
 		 * is done by the thread when it finally invokes the scheduler. */
 		s->waiting = false;
+	spin_unlock(&queue->lock);
 
 	return ready;
 }
@@ -315,12 +398,21 @@ static int __sched_wakeup_ready(struct schedee *s) {
 
 /** Locks: IPL, thread. */
 static void __sched_wakeup_waiting(struct schedee *s) {
+	unsigned int cpu;
+
 	assert(s && s->waiting);
 
-	spin_lock(&rq.lock);
+	/* @a s is not in any runq now, so only waker can change s->cpu */
+	cpu = sched_select_cpu(s);
+
+	spin_lock(&rq[cpu].lock);
+	if (cpu != s->cpu) {
+		rq_stats[cpu].migrations++;
+		s->cpu = cpu;
+	}
 	__sched_enqueue_set_ready(s);
 	__sched_wokenup_clear_waiting(s);
-	spin_unlock(&rq.lock);
+	spin_unlock(&rq[cpu].lock);
 }
 
 #ifdef SMP
@@ -399,7 +491,7 @@ static void sched_ticker_update(void) {
 
 	cur = schedee_get_current();
 
-	next = runq_get_next(&rq.queue);
+	next = runq_get_next(&rq[cpu_get_id()].queue);
 
 	cur_prio = schedee_priority_get(cur);
 	next_prio = schedee_priority_get(next);
@@ -413,17 +505,74 @@ static void sched_ticker_update(void) {
 	}
 }
 
+#ifdef SMP
+/**
+ * Moves the best schedee which can run on @a cpu from the queue of another
+ * CPU, if it has higher priority than @a next. Remote queues are only
+ * try-locked, so CPUs stealing from each other do not deadlock.
+ *
+ * Locks: IPL, runq of @a cpu.
+ */
+static struct schedee *sched_steal(unsigned int cpu, struct schedee *next) {
+	struct schedee *s, *stolen;
+	unsigned int victim, i;
+
+	stolen = NULL;
+
+	for (i = 1; i < NCPU; i++) {
+		victim = (cpu + i) % NCPU;
+
+		if (rq_stats[victim].nr_ready == 0) {
+			continue;
+		}
+
+		if (!spin_trylock(&rq[victim].lock)) {
+			continue;
+		}
+
+		s = runq_get_next(&rq[victim].queue);
+		/* Schedee could be still active (in the middle of 'schedule') */
+		if (s && !sched_active(s) && sched_cpu_allowed(s, cpu)
+				&& (!next || (schedee_priority_get(s)
+						> schedee_priority_get(next)))) {
+			__sched_dequeue(s);
+			s->cpu = cpu;
+			__sched_enqueue(s);
+
+			rq_stats[cpu].steals++;
+			rq_stats[cpu].migrations++;
+
+			next = stolen = s;
+		}
+
+		spin_unlock(&rq[victim].lock);
+	}
+
+	return stolen;
+}
+#else
+static inline struct schedee *sched_steal(unsigned int cpu,
+		struct schedee *next) {
+	return NULL;
+}
+#endif /* SMP */
+
 /** locks: sched */
 static void __schedule(int preempt) {
 	ipl_t ipl;
 	struct schedee *prev;
 	struct schedee *next;
+	struct runq *queue;
+	unsigned int cpu;
 	int yield_requested;
 
 	prev = schedee_get_current();
+	cpu = cpu_get_id();
+	queue = &rq[cpu];
+	assert(prev->cpu == cpu);
 
 	assert(!sched_in_interrupt());
-	ipl = spin_lock_ipl(&rq.lock);
+	ipl = spin_lock_ipl(&queue->lock);
 
 	yield_requested = sched_yield_requested();
 
@@ -440,7 +589,14 @@ static void __schedule(int preempt) {
 	sched_timing_stop(prev);
 
 	while (1) {
-		next = runq_get_next(&rq.queue);
+		next = runq_get_next(&queue->queue);
+
+		if (!next || (schedee_priority_get(next) == SCHED_PRIORITY_MIN)) {
+			/* Nothing but idle to run, look for work on other CPUs */
+			if (sched_steal(cpu, next)) {
+				next = runq_get_next(&queue->queue);
+			}
+		}
 
 		if (schedee_is_thread(prev) && schedee_is_thread(next) &&
 			    schedee_priority_get(prev) == schedee_priority_get(next)) {
@@ -454,19 +610,20 @@ static void __schedule(int preempt) {
 
 				schedee_set_current(prev);
 
-				runq_remove(&rq.queue, prev);
+				__sched_dequeue(prev);
 
-				spin_unlock(&rq.lock);
+				spin_unlock(&queue->lock);
 
 				break;
 			}
 		}
 
-		next = runq_extract(&rq.queue);
+		next = runq_extract(&queue->queue);
+		rq_stats[cpu].nr_ready--;
 
 		/* Runq is unlocked as soon as possible, but interrupts remain disabled
 		 * during the 'sched_switch' (if any). */
-		spin_unlock(&rq.lock);
+		spin_unlock(&queue->lock);
 
 		schedee_set_current(next);
 		log_debug("prev: %#x, next: %#x", prev, next);
@@ -479,7 +636,7 @@ static void __schedule(int preempt) {
 		}
 
 		/* ipl is enabled, no need to save it. */
-		spin_lock_ipl_disable(&rq.lock);
+		spin_lock_ipl_disable(&queue->lock);
 	}
 
 	sched_ticker_update();
@@ -0,0 +1,169 @@
+/**
+ * @file
+ * @brief Run queue with priority bitmap
+ *
+ * @details Like list_array, but non-empty priority lists are marked in a
+ *   bitmap, so the highest ready priority is found with a couple of
+ *   find-last-set operations instead of scanning all lists. Schedees
+ *   restricted by affinity are kept in separate lists, hence the common
+ *   case when nobody is restricted never walks lists. Schedees of the same
+ *   priority are picked from both arrays in order of insertion.
+ *
+ * @date 18.10.2026
+ */
+
+#include <util/bit.h>
+#include <util/bitmap.h>
+#include <util/dlist.h>
+#include <util/member.h>
+
+#include <hal/cpu.h>
+#include <kernel/sched.h>
+#include <kernel/sched/sched_strategy.h>
+
+#if BITMAP_SIZE(SCHED_PRIORITY_TOTAL) > LONG_BIT
+#error "Too many priorities for the summary word"
+#endif
+
+#define runq_entry(link) \
+	member_cast_out(link, struct schedee, runq_link.lnk)
+
+static void prio_array_init(struct runq_prio_array *arr) {
+	int i;
+
+	for (i = SCHED_PRIORITY_MIN; i <= SCHED_PRIORITY_MAX; i++) {
+		dlist_init(&arr->list[i]);
+	}
+	bitmap_clear_all(arr->ready, SCHED_PRIORITY_TOTAL);
+	arr->summary = 0;
+}
+
+static void prio_array_insert(struct runq_prio_array *arr, int prio,
+		runq_item_t *item) {
+	dlist_add_prev(&item->lnk, &arr->list[prio]);
+	bitmap_set_bit(arr->ready, prio);
+	arr->summary |= 1ul << BITMAP_OFFSET(prio);
+}
+
+static void prio_array_remove(struct runq_prio_array *arr, int prio,
+		runq_item_t *item) {
+	dlist_del(&item->lnk);
+	if (dlist_empty(&arr->list[prio])) {
+		bitmap_clear_bit(arr->ready, prio);
+		if (!arr->ready[BITMAP_OFFSET(prio)]) {
+			arr->summary &= ~(1ul << BITMAP_OFFSET(prio));
+		}
+	}
+}
+
+/* Returns the highest ready priority lower than @a limit, or -1 */
+static int prio_array_find(const struct runq_prio_array *arr, int limit) {
+	unsigned long bits;
+	unsigned int word;
+
+	if (limit <= SCHED_PRIORITY_MIN) {
+		return -1;
+	}
+
+	limit--;
+	word = BITMAP_OFFSET(limit);
+	bits = arr->ready[word] & (~0ul >> (LONG_BIT - 1 - BITMAP_SHIFT(limit)));
+	if (!bits) {
+		bits = arr->summary & ((1ul << word) - 1);
+		if (!bits) {
+			return -1;
+		}
+		word = bit_fls(bits) - 1;
+		bits = arr->ready[word];
+	}
+
+	return word * LONG_BIT + bit_fls(bits) - 1;
+}
+
+static int runq_affinity_restricted(struct schedee *s) {
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < NCPU; cpu++) {
+		if (!sched_affinity_check(&s->affinity, 1 << cpu)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void runq_item_init(runq_item_t *runq_link) {
+	dlist_head_init(&runq_link->lnk);
+	runq_link->restricted = 0;
+	runq_link->prio = 0;
+	runq_link->seq = 0;
+}
+
+void runq_init(runq_t *queue) {
+	prio_array_init(&queue->any);
+	prio_array_init(&queue->restricted);
+	queue->seq = 0;
+}
+
+void runq_insert(runq_t *queue, struct schedee *schedee) {
+	schedee->runq_link.restricted = runq_affinity_restricted(schedee);
+	schedee->runq_link.prio = schedee_priority_get(schedee);
+	schedee->runq_link.seq = ++queue->seq;
+
+	prio_array_insert(schedee->runq_link.restricted ? &queue->restricted
+				: &queue->any,
+			schedee->runq_link.prio, &schedee->runq_link);
+}
+
+void runq_remove(runq_t *queue, struct schedee *schedee) {
+	prio_array_remove(schedee->runq_link.restricted ? &queue->restricted
+				: &queue->any,
+			schedee->runq_link.prio, &schedee->runq_link);
+}
+
+struct schedee *runq_get_next(runq_t *queue) {
+	const unsigned int mask = 1 << cpu_get_id();
+	struct schedee *schedee = NULL;
+	int prio, prio_any;
+
+	prio_any = prio_array_find(&queue->any, SCHED_PRIORITY_TOTAL);
+	if (prio_any >= 0) {
+		schedee = runq_entry(queue->any.list[prio_any].next);
+	}
+
+	if (!queue->restricted.summary) {
+		return schedee;
+	}
+
+	/* Only restricted schedees with the same or higher priority are
+	 * of interest. Of the same priority the one inserted earlier wins */
+	for (prio = prio_array_find(&queue->restricted, SCHED_PRIORITY_TOTAL);
+			prio >= 0 && prio >= prio_any;
+			prio = prio_array_find(&queue->restricted, prio)) {
+		struct schedee *s;
+
+		dlist_foreach_entry(s, &queue->restricted.list[prio], runq_link.lnk) {
+			if (!sched_affinity_check(&s->affinity, mask)) {
+				continue;
+			}
+			if (prio > prio_any || (long) (s->runq_link.seq
+						- schedee->runq_link.seq) < 0) {
+				return s;
+			}
+			return schedee;
+		}
+	}
+
+	return schedee;
+}
+
+struct schedee *runq_extract(runq_t *queue) {
+	struct schedee *schedee;
+
+	schedee = runq_get_next(queue);
+	if (schedee) {
+		runq_remove(queue, schedee);
+	}
+
+	return schedee;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file
+ * @brief Run queue with priority bitmap
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef KERNEL_THREAD_QUEUE_PRIO_BITMAP_H_
+#define KERNEL_THREAD_QUEUE_PRIO_BITMAP_H_
+
+#include <util/bitmap.h>
+#include <util/dlist.h>
+
+#include <kernel/sched/schedee_priority.h>
+
+struct runq_prio_array {
+	struct dlist_head list[SCHED_PRIORITY_TOTAL];
+	BITMAP_DECL(ready, SCHED_PRIORITY_TOTAL); /* non-empty lists */
+	unsigned long summary;                    /* non-zero words of ready */
+};
+
+struct runq_queue {
+	struct runq_prio_array any;        /* may run on any CPU */
+	struct runq_prio_array restricted; /* restricted by affinity */
+	unsigned long seq;                 /* of the last inserted item */
+};
+
+struct runq_item {
+	struct dlist_head lnk;
+	unsigned int restricted;
+	int prio;          /* list the item is in, priority may change meanwhile */
+	unsigned long seq; /* order of insertion among both arrays */
+};
+
+typedef struct runq_item runq_item_t;
+
+typedef struct runq_queue runq_t;
+
+#define __RUNQ_ITEM_INIT(item) \
+	{ .lnk = DLIST_INIT((item).lnk), .restricted = 0, .prio = 0, \
+	  .seq = 0 }
+
+#endif /* KERNEL_THREAD_QUEUE_PRIO_BITMAP_H_ */
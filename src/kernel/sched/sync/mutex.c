@@ -26,32 +26,59 @@ int mutex_trylock_schedee(struct schedee *self, struct mutex *m) {
 	assert(m);
 	assert(!critical_inside(__CRITICAL_HARDER(CRITICAL_SCHED_LOCK)));
 
-	if (m->holder) {
+	/* the only atomic operation if the mutex is free */
+	if (!__sync_bool_compare_and_swap(&m->holder, NULL, self)) {
 		return -EBUSY;
 	}
 
 	m->lock_count = 1;
-	m->holder = self;
 
 	return 0;
 }
 
+static inline int mutex_has_waiters(struct mutex *m) {
+	/* Statically initialized mutex has no list until someone waits */
+	return m->wq.list.next && !dlist_empty(&m->wq.list);
+}
+
 void mutex_unlock_schedee(struct schedee *self, struct mutex *m) {
 	assert(m);
 	assert(!critical_inside(__CRITICAL_HARDER(CRITICAL_SCHED_LOCK)));
 
+	m->lock_count = 0;
+	m->holder = NULL;
+
+	/* Waiter adds itself to the waitq before it tries to lock the mutex,
+	 * so either it sees the mutex free or we see it in the waitq */
+	__sync_synchronize();
+
+	/* Only after the release, so a waiter which has boosted us and seen
+	 * the mutex still held leaves no boost behind */
 	mutex_priority_uninherit(self);
 
-	m->holder = NULL;
-	m->lock_count = 0;
-	waitq_wakeup_all(&m->wq);
+	if (mutex_has_waiters(m)) {
+		waitq_wakeup_all(&m->wq);
+	}
 }
 
 void mutex_priority_inherit(struct schedee *self, struct mutex *m) {
+	struct schedee *holder;
 	int prior = schedee_priority_get(self);
 
-	if (prior != schedee_priority_inherit(m->holder, prior))
-		schedee_priority_set(m->holder, prior);
+	/* holder may release the mutex without sched_lock */
+	holder = *(struct schedee * volatile *)&m->holder;
+	if (holder == NULL)
+		return;
+
+	if (prior != schedee_priority_inherit(holder, prior))
+		schedee_priority_set(holder, prior);
+
+	/* The holder uninherits only after it has released the mutex, so if
+	 * it is gone meanwhile our boost may have come too late, undo it */
+	__sync_synchronize();
+	if (*(struct schedee * volatile *)&m->holder != holder) {
+		mutex_priority_uninherit(holder);
+	}
 }
 
 void mutex_priority_uninherit(struct schedee *self) {
@@ -77,7 +77,7 @@ void waitq_wait_cleanup(struct waitq *wq, struct waitq_link *_wql) {
 	waitq_link_delete_protected(wql);
 }
 
-static void __waitq_wakeup(struct waitq *wq, int nr) {
+void __waitq_wakeup(struct waitq *wq, int nr) {
 	struct waitq_link *wql;
 
 	assert(wq);
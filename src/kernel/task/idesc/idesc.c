@@ -8,9 +8,11 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 
 #include <util/dlist.h>
+#include <util/math.h>
 
 #include <kernel/task.h>
 #include <kernel/task/resource/idesc_table.h>
@@ -26,6 +28,7 @@ int idesc_init(struct idesc *idesc, const struct idesc_ops *ops, mode_t amode) {
 	idesc->idesc_xattrops = NULL;
 
 	waitq_init(&idesc->idesc_waitq);
+	dlist_init(&idesc->idesc_watch_list);
 
 	return 0;
 }
@@ -44,6 +47,58 @@ int idesc_close(struct idesc *idesc, int fd) {
 	return 0;
 }
 
+#define IDESC_SPLICE_BUF_SZ 512
+
+static ssize_t idesc_splice_copy(struct idesc *out, struct idesc *in,
+		size_t len) {
+	char buf[IDESC_SPLICE_BUF_SZ];
+	struct iovec iov;
+	ssize_t res, ret, done;
+
+	assert(in->idesc_ops->id_readv);
+	assert(out->idesc_ops->id_writev);
+
+	iov.iov_base = buf;
+	iov.iov_len = min(len, sizeof buf);
+	res = in->idesc_ops->id_readv(in, &iov, 1);
+	if (res <= 0) {
+		return res;
+	}
+
+	for (done = 0; done < res; done += ret) {
+		iov.iov_base = buf + done;
+		iov.iov_len = res - done;
+		ret = out->idesc_ops->id_writev(out, &iov, 1);
+		if (ret <= 0) {
+			/* Data which were read are lost, so report error only if
+			 * nothing was written at all */
+			return done ? done : (ret ? ret : -EIO);
+		}
+	}
+
+	return res;
+}
+
+ssize_t idesc_splice(struct idesc *out, struct idesc *in, size_t len) {
+	ssize_t ret;
+
+	assert(out && out->idesc_ops);
+	assert(in && in->idesc_ops);
+
+	if (len == 0) {
+		return 0;
+	}
+
+	if (out->idesc_ops->id_splice_write) {
+		ret = out->idesc_ops->id_splice_write(out, in, len);
+		if (ret != -EOPNOTSUPP) {
+			return ret;
+		}
+	}
+
+	return idesc_splice_copy(out, in, len);
+}
+
 static int idesc_xattr_check(struct idesc *idesc) {
 	if (!idesc) {
 		return -EBADF;
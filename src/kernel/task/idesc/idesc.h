@@ -17,6 +17,7 @@ struct idesc_xattrops;
 
 struct idesc {
 	struct waitq idesc_waitq;
+	struct dlist_head idesc_watch_list; /* Persistent watchers (e.g. epoll) */
 	const struct idesc_ops *idesc_ops;
 	const struct idesc_xattrops *idesc_xattrops;
 	unsigned int idesc_flags;
@@ -36,6 +37,11 @@ struct idesc_ops {
 	int (*status)(struct idesc *idesc, int mask);
 	void *(*idesc_mmap)(struct idesc *idesc, void *addr, size_t len, int prot,
 			int flags, int fd, off_t off);
+	/* Optional, used by idesc_splice(). Moves up to len bytes from in
+	 * without intermediate buffer, filling own buffers with id_readv of in.
+	 * -EOPNOTSUPP means the pair can't be handled. */
+	ssize_t (*id_splice_write)(struct idesc *idesc, struct idesc *in,
+			size_t len);
 };
 
 struct idesc_xattrops {
@@ -65,6 +71,15 @@ extern int idesc_removexattr(struct idesc *idesc, const char *name);
 
 extern int idesc_close(struct idesc *idesc, int fd);
 
+/**
+ * Move up to @a len bytes from @a in to @a out. Stream sockets fill their
+ * buffers from @a in directly, otherwise one chunk of data is copied through
+ * a small bounce buffer.
+ *
+ * @return Number of moved bytes, 0 at the end of @a in or minus errno
+ */
+extern ssize_t idesc_splice(struct idesc *out, struct idesc *in, size_t len);
+
 __END_DECLS
 
 #endif /* FS_IDESC_H_ */
@@ -13,6 +13,7 @@
 #include <kernel/task/resource/idesc.h>
 #include <fcntl.h>
 #include <kernel/sched.h>
+#include <kernel/spinlock.h>
 
 #include <kernel/task/resource/idesc_event.h>
 
@@ -27,14 +28,89 @@ int idesc_wait_prepare(struct idesc *i, struct idesc_wait_link *wl) {
 	return 0;
 }
 
+void idesc_notify_defer(struct idesc_notify_defer *d,
+		struct dlist_head *defer) {
+	if (__sync_fetch_and_add(&d->pending, 1) == 0) {
+		dlist_add_prev(&d->lnk, defer);
+	}
+}
+
+void idesc_notify_defer_wait(struct idesc_notify_defer *d) {
+	while (*(volatile int *) &d->pending) {
+		schedule();
+	}
+}
+
+static void idesc_notify_deferred(struct dlist_head *defer) {
+	struct idesc_notify_defer *d;
+	int n;
+
+	dlist_foreach_entry(d, defer, lnk) {
+		dlist_del_init(&d->lnk);
+
+		/* Requests which came while sending are served here as well, since
+		 * they didn't queue the link again. Don't touch it after that */
+		do {
+			n = *(volatile int *) &d->pending;
+			idesc_notify(d->idesc, d->mask);
+		} while (__sync_sub_and_fetch(&d->pending, n));
+	}
+}
+
 int idesc_notify(struct idesc *idesc, int mask) {
+	struct idesc_watch *watch;
+	DLIST_DEFINE(defer);
+	ipl_t ipl;
 
 	//TODO MASK
 	waitq_wakeup(&idesc->idesc_waitq, 0);
 
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	dlist_foreach_entry(watch, &idesc->idesc_watch_list, lnk) {
+		watch->notify(watch, mask, &defer);
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+
+	idesc_notify_deferred(&defer);
+
 	return 0;
 }
 
+void idesc_watch_add(struct idesc *idesc, struct idesc_watch *watch) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	if (dlist_empty(&watch->lnk)) {
+		dlist_add_prev(&watch->lnk, &idesc->idesc_watch_list);
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+}
+
+void idesc_watch_del(struct idesc *idesc, struct idesc_watch *watch) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	if (!dlist_empty(&watch->lnk)) {
+		dlist_del_init(&watch->lnk);
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+}
+
+void idesc_watch_release(struct idesc *idesc) {
+	struct idesc_watch *watch;
+	DLIST_DEFINE(defer);
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&idesc->idesc_waitq.lock);
+	dlist_foreach_entry(watch, &idesc->idesc_watch_list, lnk) {
+		dlist_del_init(&watch->lnk);
+		watch->notify(watch, POLLNVAL, &defer);
+	}
+	spin_unlock_ipl(&idesc->idesc_waitq.lock, ipl);
+
+	idesc_notify_deferred(&defer);
+}
+
 void idesc_wait_cleanup(struct idesc *i, struct idesc_wait_link *wl) {
 	waitq_wait_cleanup(&i->idesc_waitq, &wl->link);
 }
@@ -27,6 +27,75 @@ static inline void idesc_wait_init(struct idesc_wait_link *iwl, int mask) {
 	waitq_link_init(&iwl->link);
 }
 
+/**
+ * Notification of another descriptor which a watcher can't send itself,
+ * because the lock of the watched descriptor is held. It is queued to
+ * @a defer list passed to the watcher and sent once the lock is released.
+ */
+struct idesc_notify_defer {
+	struct dlist_head lnk;
+	struct idesc *idesc;
+	int mask;
+	int pending;    /* Requests not sent yet, the link is queued while set */
+};
+
+static inline void idesc_notify_defer_init(struct idesc_notify_defer *d,
+		struct idesc *idesc, int mask) {
+	dlist_head_init(&d->lnk);
+	d->idesc = idesc;
+	d->mask = mask;
+	d->pending = 0;
+}
+
+/**
+ * @brief Queue @a d to @a defer list passed to idesc_watch notify
+ */
+extern void idesc_notify_defer(struct idesc_notify_defer *d,
+		struct dlist_head *defer);
+
+/**
+ * @brief Wait until queued notification is sent, so @a d may be freed.
+ * The caller must have removed all watchers which could queue it
+ */
+extern void idesc_notify_defer_wait(struct idesc_notify_defer *d);
+
+/**
+ * Persistent watcher of idesc events. Unlike idesc_wait_link it isn't bound
+ * to a sleeping schedee: @a notify is called on every idesc_notify() until
+ * the watcher is removed. It is called with idesc wait queue lock held, so
+ * it must not sleep nor notify other descriptors, use @a defer for that.
+ *
+ * When descriptor is being closed all watchers are unlinked and notified
+ * with POLLNVAL mask.
+ */
+struct idesc_watch {
+	struct dlist_head lnk;
+	void (*notify)(struct idesc_watch *watch, int mask,
+			struct dlist_head *defer);
+};
+
+static inline void idesc_watch_init(struct idesc_watch *watch,
+		void (*notify)(struct idesc_watch *, int, struct dlist_head *)) {
+	dlist_head_init(&watch->lnk);
+	watch->notify = notify;
+}
+
+/**
+ * @brief Attach persistent watcher to idesc
+ */
+extern void idesc_watch_add(struct idesc *idesc, struct idesc_watch *watch);
+
+/**
+ * @brief Detach watcher. It's safe to call it for already released watcher
+ */
+extern void idesc_watch_del(struct idesc *idesc, struct idesc_watch *watch);
+
+/**
+ * @brief Detach all watchers notifying them with POLLNVAL. Called when
+ * the last reference to descriptor is dropped
+ */
+extern void idesc_watch_release(struct idesc *idesc);
+
 /**
  * @brief Prepare link to wait on idesc. It also checks for O_NONBLOCK of
  * descriptor, and return -EAGAIN if it set, but link still is ready to
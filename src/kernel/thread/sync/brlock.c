@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @brief Implements read-write lock with per-CPU reader counters
+ *
+ * @details A reader increments the counter of its CPU and then checks
+ * the writer flag, the writer sets the flag and then sums the counters, so
+ * one of them always sees the other. A reader may be migrated while holding
+ * the lock and decrement the counter of another CPU, only the sum matters.
+ *
+ * @date 18.10.2026
+ */
+
+#include <assert.h>
+#include <hal/cpu.h>
+#include <hal/ipl.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread/sync/brlock.h>
+#include <kernel/thread/waitq.h>
+
+void brlock_init(brlock_t *b) {
+	int i;
+
+	for (i = 0; i < NCPU; i++) {
+		b->cpu[i].readers = 0;
+	}
+	b->writer = 0;
+	b->readers_waiting = 0;
+	b->gen = 0;
+	spin_init(&b->lock, __SPIN_UNLOCKED);
+	waitq_init(&b->wq);
+	waitq_init(&b->drain_wq);
+}
+
+static int brlock_readers(brlock_t *b) {
+	int i, sum;
+
+	sum = 0;
+	for (i = 0; i < NCPU; i++) {
+		sum += *(volatile int *)&b->cpu[i].readers;
+	}
+
+	return sum;
+}
+
+static inline int brlock_writer(brlock_t *b) {
+	return *(volatile int *)&b->writer;
+}
+
+static void brlock_read_slow(brlock_t *b, int *readers) {
+	unsigned int gen;
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&b->lock);
+	{
+		if (!b->writer) {
+			/* The writer has gone meanwhile, keep our count */
+			spin_unlock_ipl(&b->lock, ipl);
+			return;
+		}
+
+		/* The writer may already wait for us, back off and wait for it */
+		__sync_fetch_and_sub(readers, 1);
+		b->readers_waiting++;
+		gen = b->gen;
+	}
+	spin_unlock_ipl(&b->lock, ipl);
+
+	waitq_wakeup_all(&b->drain_wq);
+
+	/* The writer counts us as a reader before it leaves */
+	WAITQ_WAIT(&b->wq, *(volatile unsigned int *)&b->gen != gen);
+}
+
+void brlock_read_lock(brlock_t *b) {
+	int *readers;
+
+	assert(b);
+	assert(critical_allows(CRITICAL_SCHED_LOCK));
+
+	readers = &b->cpu[cpu_get_id()].readers;
+	__sync_fetch_and_add(readers, 1);
+
+	if (brlock_writer(b)) {
+		brlock_read_slow(b, readers);
+	}
+}
+
+void brlock_read_unlock(brlock_t *b) {
+	assert(b);
+
+	__sync_fetch_and_sub(&b->cpu[cpu_get_id()].readers, 1);
+
+	if (brlock_writer(b)) {
+		waitq_wakeup_all(&b->drain_wq);
+	}
+}
+
+void brlock_write_lock(brlock_t *b) {
+	ipl_t ipl;
+
+	assert(b);
+	assert(critical_allows(CRITICAL_SCHED_LOCK));
+
+	ipl = spin_lock_ipl(&b->lock);
+	while (b->writer) {
+		spin_unlock_ipl(&b->lock, ipl);
+		WAITQ_WAIT(&b->wq, !brlock_writer(b));
+		ipl = spin_lock_ipl(&b->lock);
+	}
+	b->writer = 1;
+	spin_unlock_ipl(&b->lock, ipl);
+
+	__sync_synchronize();
+
+	WAITQ_WAIT(&b->drain_wq, brlock_readers(b) == 0);
+}
+
+void brlock_write_unlock(brlock_t *b) {
+	ipl_t ipl;
+
+	assert(b);
+	assert(b->writer);
+
+	ipl = spin_lock_ipl(&b->lock);
+	{
+		if (b->readers_waiting) {
+			/* Let waiting readers in before the next writer comes */
+			__sync_fetch_and_add(&b->cpu[cpu_get_id()].readers,
+					b->readers_waiting);
+			b->readers_waiting = 0;
+			b->gen++;
+		}
+		b->writer = 0;
+	}
+	spin_unlock_ipl(&b->lock, ipl);
+
+	waitq_wakeup_all(&b->wq);
+}
@@ -13,9 +13,130 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
 
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <kernel/thread/sync/mutex.h>
 #include <kernel/thread/waitq.h>
+#include <kernel/time/time.h>
+#include <util/member.h>
+
+#include <framework/mod/options.h>
+
+#define MUTEX_SPINS       OPTION_GET(NUMBER, adaptive_spins)
+#define MUTEX_STATS_SIZE  OPTION_GET(NUMBER, contention_stats)
+
+#if MUTEX_STATS_SIZE > 0
+static struct mutex_contention mutex_stats[MUTEX_STATS_SIZE];
+static spinlock_t mutex_stats_lock = SPIN_STATIC_UNLOCKED;
+
+static void mutex_stats_account(struct mutex *m, struct schedee *holder,
+		time64_t wait_ns) {
+	struct mutex_contention *mc;
+	unsigned int i, idx;
+	ipl_t ipl;
+
+	idx = ((uintptr_t)m >> 3) % MUTEX_STATS_SIZE;
+
+	ipl = spin_lock_ipl(&mutex_stats_lock);
+	{
+		/* open addressing, mutexes that don't fit aren't accounted */
+		for (i = 0; i < MUTEX_STATS_SIZE; i++) {
+			mc = &mutex_stats[(idx + i) % MUTEX_STATS_SIZE];
+			if ((mc->mutex == m) || (mc->mutex == NULL)) {
+				break;
+			}
+		}
+
+		if (i != MUTEX_STATS_SIZE) {
+			mc->mutex = m;
+			mc->contended++;
+			mc->wait_ns += wait_ns;
+			if (mc->max_wait_ns < wait_ns) {
+				mc->max_wait_ns = wait_ns;
+			}
+			if (holder != NULL) {
+				mc->holder_id = schedee_is_thread(holder)
+					? mcast_out(holder, struct thread, schedee)->id : -1;
+			}
+		}
+	}
+	spin_unlock_ipl(&mutex_stats_lock, ipl);
+}
+
+int mutex_contention_get(unsigned int idx, struct mutex_contention *stat) {
+	ipl_t ipl;
+
+	if (idx >= MUTEX_STATS_SIZE) {
+		return -EINVAL;
+	}
+
+	ipl = spin_lock_ipl(&mutex_stats_lock);
+	{
+		*stat = mutex_stats[idx];
+	}
+	spin_unlock_ipl(&mutex_stats_lock, ipl);
+
+	return stat->mutex ? 0 : -ENOENT;
+}
+
+void mutex_contention_reset(void) {
+	ipl_t ipl;
+
+	ipl = spin_lock_ipl(&mutex_stats_lock);
+	{
+		memset(mutex_stats, 0, sizeof mutex_stats);
+	}
+	spin_unlock_ipl(&mutex_stats_lock, ipl);
+}
+
+static inline time64_t mutex_stats_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_to_ns(&ts);
+}
+#else
+int mutex_contention_get(unsigned int idx, struct mutex_contention *stat) {
+	return -EINVAL;
+}
+
+void mutex_contention_reset(void) {
+}
+#endif /* MUTEX_STATS_SIZE > 0 */
+
+static inline struct schedee *mutex_holder(struct mutex *m) {
+	return *(struct schedee * volatile *)&m->holder;
+}
+
+#ifdef SMP
+/* Holder running on another CPU is likely to release the mutex soon, so
+ * it's cheaper to wait for it here than to go to sleep */
+static int mutex_spin_on_holder(struct mutex *m, struct schedee *self) {
+	struct schedee *holder;
+	int spins;
+
+	for (spins = 0; spins < MUTEX_SPINS; spins++) {
+		holder = mutex_holder(m);
+		if (holder == NULL) {
+			return 1;
+		}
+		if ((holder == self) || !sched_active(holder)) {
+			return 0;
+		}
+		__barrier();
+	}
+
+	return 0;
+}
+#else
+static inline int mutex_spin_on_holder(struct mutex *m, struct schedee *self) {
+	return 0;
+}
+#endif /* SMP */
 
 static inline int mutex_is_static_inited(struct mutex *m) {
 	/* Static initializer can't really init list now, so if this condition's
@@ -50,12 +171,34 @@ int mutex_lock_common(struct mutex *m,
 	int errcheck;
 	int ret, wait_ret;
 	int timeout;
+#if MUTEX_STATS_SIZE > 0
+	struct schedee *holder;
+	time64_t start;
+#endif
 
 	assert(m);
 	assert(!critical_inside(__CRITICAL_HARDER(CRITICAL_SCHED_LOCK)));
 
 	errcheck = (m->attr.type == MUTEX_ERRORCHECK);
 
+	/* Fast path, no waitq and priority inheritance if the mutex is free */
+	ret = mutex_trylock(m);
+	if ((ret == 0) || (errcheck && ret == -EDEADLK)) {
+		return ret;
+	}
+
+	while (mutex_spin_on_holder(m, current)) {
+		ret = mutex_trylock(m);
+		if (ret == 0) {
+			return 0;
+		}
+	}
+
+#if MUTEX_STATS_SIZE > 0
+	holder = mutex_holder(m);
+	start = mutex_stats_now();
+#endif
+
 	if (abstime == NULL) {
 		timeout = SCHED_TIMEOUT_INFINITE;
 	}
@@ -83,6 +226,10 @@ int mutex_lock_common(struct mutex *m,
 		ret = wait_ret;
 	}
 
+#if MUTEX_STATS_SIZE > 0
+	mutex_stats_account(m, holder, mutex_stats_now() - start);
+#endif
+
 	return ret;
 }
 
@@ -110,27 +257,25 @@ int mutex_trylock(struct mutex *m) {
 	if (mutex_is_static_inited(m))
 		mutex_complete_static_init(m);
 
-	sched_lock();
-	{
-		if (m->attr.type == MUTEX_ERRORCHECK) {
-			if (!mutex_this_owner(m)) {
-				res = mutex_trylock_schedee(current, m);
-			} else {
-				res = -EDEADLK;
-			}
-		} else if (m->attr.type == MUTEX_RECURSIVE) {
-			if (mutex_this_owner(m)) {
-				++m->lock_count;
-				res = 0;
-			} else {
-				res = mutex_trylock_schedee(current, m);
-			}
+	/* Only the current schedee can make itself a holder, so the owner
+	 * checks need no locking */
+	if (m->attr.type == MUTEX_ERRORCHECK) {
+		if (!mutex_this_owner(m)) {
+			res = mutex_trylock_schedee(current, m);
+		} else {
+			res = -EDEADLK;
+		}
+	} else if (m->attr.type == MUTEX_RECURSIVE) {
+		if (mutex_this_owner(m)) {
+			++m->lock_count;
+			res = 0;
 		} else {
 			res = mutex_trylock_schedee(current, m);
 		}
+	} else {
+		res = mutex_trylock_schedee(current, m);
 	}
-	sched_unlock();
-	assert(!critical_inside(__CRITICAL_HARDER(CRITICAL_SCHED_LOCK)));
+
 	return res;
 }
 
@@ -141,29 +286,27 @@ int mutex_unlock(struct mutex *m) {
 	assert(m);
 	assert(!critical_inside(__CRITICAL_HARDER(CRITICAL_SCHED_LOCK)));
 
+	/* Waiters are woken up only if there are any, see
+	 * mutex_unlock_schedee() */
 	res = 0;
-	sched_lock();
-	{
-		if (m->attr.type == MUTEX_ERRORCHECK) {
-			if (mutex_this_owner(m)) {
+	if (m->attr.type == MUTEX_ERRORCHECK) {
+		if (mutex_this_owner(m)) {
+			mutex_unlock_schedee(current, m);
+		} else {
+			res = -EPERM;
+		}
+	} else if (m->attr.type == MUTEX_RECURSIVE) {
+		if (mutex_this_owner(m)) {
+			assert(m->lock_count > 0);
+			if (--m->lock_count == 0) {
 				mutex_unlock_schedee(current, m);
-			} else {
-				res = -EPERM;
-			}
-		} else if (m->attr.type == MUTEX_RECURSIVE) {
-			if (mutex_this_owner(m)) {
-				assert(m->lock_count > 0);
-				if (--m->lock_count == 0) {
-					mutex_unlock_schedee(current, m);
-				}
-			} else {
-				res = -EPERM;
 			}
 		} else {
-			mutex_unlock_schedee(current, m);
+			res = -EPERM;
 		}
+	} else {
+		mutex_unlock_schedee(current, m);
 	}
-	sched_unlock();
-	assert(!critical_inside(__CRITICAL_HARDER(CRITICAL_SCHED_LOCK)));
+
 	return res;
 }
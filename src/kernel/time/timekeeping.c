@@ -7,6 +7,7 @@
  */
 #include <time.h>
 
+#include <kernel/thread/sync/seqlock.h>
 #include <kernel/time/clock_source.h>
 #include <kernel/time/itimer.h>
 
@@ -14,6 +15,7 @@
 
 static struct timespec timekeep_g_time;
 static struct itimer timekeep_g_itimer;
+static seqlock_t timekeep_g_seq = SEQLOCK_INIT;
 
 #ifndef NO_RTC_SUPPORT
 static void rtc_update(time_t time) {
@@ -32,17 +34,29 @@ static void rtc_update(time_t time) {
 #endif
 
 void setnsofday(const struct timespec *newtime, const struct timezone *tz) {
-	timekeep_g_time = *newtime;
-	itimer_init(&timekeep_g_itimer, timekeep_g_itimer.cs, 0);
+	ipl_t ipl;
+
+	ipl = write_seqlock_ipl(&timekeep_g_seq);
+	{
+		timekeep_g_time = *newtime;
+		itimer_init(&timekeep_g_itimer, timekeep_g_itimer.cs, 0);
+	}
+	write_sequnlock_ipl(&timekeep_g_seq, ipl);
 
 	rtc_update(newtime->tv_sec);
 }
 
 void getnsofday(struct timespec *t, struct timezone *tz) {
-	struct timespec ts;
+	struct timespec ts, base;
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&timekeep_g_seq);
+		itimer_read_timespec(&timekeep_g_itimer, &ts);
+		base = timekeep_g_time;
+	} while (read_seqretry(&timekeep_g_seq, seq));
 
-	itimer_read_timespec(&timekeep_g_itimer, &ts);
-	*t = timespec_add(timekeep_g_time, ts);
+	*t = timespec_add(base, ts);
 }
 
 int realtime_clock_select(void) {
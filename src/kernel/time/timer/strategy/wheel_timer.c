@@ -0,0 +1,281 @@
+/**
+ * @file
+ *
+ * @brief Hierarchical timing wheel.
+ *
+ * @details Level 0 has a slot per jiffy, each slot of level N covers
+ *   WHEEL_SIZE slots of level N - 1. A timer is put into the lowest level
+ *   which range covers its expiration time, so start and stop are O(1).
+ *   When the index of a lower level wraps around, the next slot of the upper
+ *   level is cascaded, i.e. its timers are redistributed to lower levels.
+ *   Each timer is cascaded at most WHEEL_LEVELS - 1 times, thus expiration is
+ *   amortized O(1). Empty slots are skipped using per-level bitmaps.
+ *
+ * @date 18.10.2026
+ */
+
+#include <util/bitmap.h>
+#include <util/dlist.h>
+
+#include <hal/ipl.h>
+#include <hal/clock.h>
+
+#include <kernel/time/timer.h>
+
+#include <framework/mod/options.h>
+#include <embox/unit.h>
+
+#define WHEEL_BITS      OPTION_GET(NUMBER, slot_bits)
+#define WHEEL_LEVELS    OPTION_GET(NUMBER, levels)
+#define WHEEL_SIZE      (1u << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_SLOT_NONE ((unsigned int) -1)
+
+/* Maximal distance (in jiffies) which the wheel covers */
+#define WHEEL_RANGE     ((clock_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+#define tmr_entry(link) \
+	dlist_first_entry(link, struct sys_timer, lnk.lnk)
+
+EMBOX_UNIT_INIT(wheel_timer_init);
+
+struct wheel_level {
+	struct dlist_head slot[WHEEL_SIZE];
+	BITMAP_DECL(pending, WHEEL_SIZE);
+};
+
+static struct wheel_level wheel[WHEEL_LEVELS];
+static clock_t wheel_clk;      /* The next jiffy to be processed */
+static clock_t wheel_next;     /* Nearest time when something is to be done */
+static unsigned int wheel_cnt; /* Amount of started timers */
+
+static inline unsigned int wheel_index(clock_t time, unsigned int level) {
+	return (time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+}
+
+static void wheel_add(struct sys_timer *tmr) {
+	clock_t expires, delta;
+	unsigned int level;
+
+	expires = tmr->cnt;
+	if ((long) (expires - wheel_clk) < 0) {
+		expires = wheel_clk; /* already expired, fire on the next jiffy */
+	}
+
+	delta = expires - wheel_clk;
+	if (delta >= WHEEL_RANGE) {
+		/* will be cascaded down by the top level later */
+		delta = WHEEL_RANGE - 1;
+		expires = wheel_clk + delta;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (delta < ((clock_t) 1 << (WHEEL_BITS * (level + 1)))) {
+			break;
+		}
+	}
+
+	tmr->lnk.slot = level * WHEEL_SIZE + wheel_index(expires, level);
+
+	dlist_head_init(&tmr->lnk.lnk);
+	dlist_add_prev(&tmr->lnk.lnk,
+			&wheel[level].slot[tmr->lnk.slot % WHEEL_SIZE]);
+	bitmap_set_bit(wheel[level].pending, tmr->lnk.slot % WHEEL_SIZE);
+}
+
+static void wheel_del(struct sys_timer *tmr) {
+	unsigned int level, index;
+
+	dlist_del(&tmr->lnk.lnk);
+
+	if (tmr->lnk.slot == WHEEL_SLOT_NONE) {
+		return; /* it is in the list of expired timers */
+	}
+
+	level = tmr->lnk.slot / WHEEL_SIZE;
+	index = tmr->lnk.slot % WHEEL_SIZE;
+	if (dlist_empty(&wheel[level].slot[index])) {
+		bitmap_clear_bit(wheel[level].pending, index);
+	}
+}
+
+/* Moves all timers of the slot to the @a list */
+static void wheel_slot_detach(unsigned int level, unsigned int index,
+		struct dlist_head *list) {
+	struct sys_timer *tmr;
+
+	dlist_foreach_entry(tmr, &wheel[level].slot[index], lnk.lnk) {
+		dlist_del(&tmr->lnk.lnk);
+		tmr->lnk.slot = WHEEL_SLOT_NONE;
+		dlist_head_init(&tmr->lnk.lnk);
+		dlist_add_prev(&tmr->lnk.lnk, list);
+	}
+
+	bitmap_clear_bit(wheel[level].pending, index);
+}
+
+static void wheel_cascade(void) {
+	struct dlist_head list;
+	struct sys_timer *tmr;
+	unsigned int level, index;
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		index = wheel_index(wheel_clk, level);
+
+		dlist_init(&list);
+		wheel_slot_detach(level, index, &list);
+		dlist_foreach_entry(tmr, &list, lnk.lnk) {
+			dlist_del(&tmr->lnk.lnk);
+			wheel_add(tmr);
+		}
+
+		if (index != 0) {
+			break;
+		}
+	}
+}
+
+/* Returns the nearest time when some slot is to be expired or cascaded.
+ * It may be earlier than the real expiration, but never later */
+static clock_t wheel_next_event(void) {
+	unsigned int level, index, start, found;
+	clock_t base;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		index = wheel_index(wheel_clk, level);
+		base = wheel_clk >> (WHEEL_BITS * level);
+		/* current slot of the upper level is not cascaded yet only if
+		 * wheel_clk is exactly at its beginning */
+		start = (base << (WHEEL_BITS * level)) == wheel_clk ? index
+				: index + 1;
+
+		found = bitmap_find_bit(wheel[level].pending, WHEEL_SIZE, start);
+		if (found != WHEEL_SIZE) {
+			return (base + found - index) << (WHEEL_BITS * level);
+		}
+
+		if (bitmap_find_first_bit(wheel[level].pending, WHEEL_SIZE)
+				!= WHEEL_SIZE) {
+			/* there are timers after wrap around of this level */
+			return ((base | WHEEL_MASK) + 1) << (WHEEL_BITS * level);
+		}
+	}
+
+	return wheel_clk + WHEEL_RANGE;
+}
+
+void timer_strat_start(struct sys_timer *tmr) {
+	ipl_t ipl;
+
+	tmr->cnt = clock_sys_ticks() + tmr->load;
+
+	ipl = ipl_save();
+	{
+		if (wheel_cnt++ == 0) {
+			/* the wheel is empty, so it may be simply moved forward */
+			wheel_clk = clock_sys_ticks();
+			wheel_next = tmr->cnt;
+		}
+		else if ((long) (tmr->cnt - wheel_next) < 0) {
+			wheel_next = tmr->cnt;
+		}
+
+		timer_set_started(tmr);
+		wheel_add(tmr);
+	}
+	ipl_restore(ipl);
+}
+
+void timer_strat_stop(struct sys_timer *tmr) {
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		timer_set_stopped(tmr);
+		wheel_del(tmr);
+		--wheel_cnt;
+		/* wheel_next is kept as is: spurious wake up is harmless */
+	}
+	ipl_restore(ipl);
+}
+
+int timer_strat_get_next_event(clock_t *next_event) {
+	if (wheel_cnt == 0) {
+		return -1;
+	}
+
+	*next_event = wheel_next;
+
+	return 0;
+}
+
+void timer_strat_sched(clock_t jiffies) {
+	DLIST_DEFINE(expired);
+	struct sys_timer *tmr;
+	unsigned int index;
+	clock_t next;
+	ipl_t ipl;
+
+	ipl = ipl_save();
+
+	while ((wheel_cnt != 0) && ((long) (jiffies - wheel_clk) >= 0)) {
+		index = wheel_index(wheel_clk, 0);
+		if (index == 0) {
+			wheel_cascade();
+		}
+
+		if (!bitmap_test_bit(wheel[0].pending, index)) {
+			/* skip empty slots, but not beyond the current jiffy, as
+			 * timers are placed relatively to wheel_clk */
+			next = wheel_clk + bitmap_find_bit(wheel[0].pending,
+					WHEEL_SIZE, index) - index;
+			wheel_clk = (long) (next - jiffies) > 0 ? jiffies + 1 : next;
+			continue;
+		}
+
+		wheel_slot_detach(0, index, &expired);
+		/* timers started by handlers go to the next jiffy */
+		wheel_clk++;
+
+		while (!dlist_empty(&expired)) {
+			tmr = tmr_entry(&expired);
+
+			timer_set_stopped(tmr);
+			dlist_del(&tmr->lnk.lnk);
+			--wheel_cnt;
+
+			if (timer_is_periodic(tmr)) {
+				tmr->cnt = clock_sys_ticks() + tmr->load;
+				timer_set_started(tmr);
+				++wheel_cnt;
+				wheel_add(tmr);
+			}
+
+			ipl_restore(ipl);
+			{
+				tmr->handle(tmr, tmr->param);
+			}
+			ipl = ipl_save();
+		}
+	}
+
+	if ((long) (jiffies - wheel_clk) >= 0) {
+		wheel_clk = jiffies + 1;
+	}
+	wheel_next = wheel_next_event();
+
+	ipl_restore(ipl);
+}
+
+static int wheel_timer_init(void) {
+	unsigned int level, index;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (index = 0; index < WHEEL_SIZE; index++) {
+			dlist_init(&wheel[level].slot[index]);
+		}
+		bitmap_clear_all(wheel[level].pending, WHEEL_SIZE);
+	}
+
+	return 0;
+}
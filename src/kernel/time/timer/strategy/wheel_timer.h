@@ -0,0 +1,19 @@
+/**
+ * @file
+ *
+ * @brief Hierarchical timing wheel.
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef WHEEL_TIMER_H_
+#define WHEEL_TIMER_H_
+
+#include <util/dlist.h>
+
+typedef struct wheel_timer_link {
+	struct dlist_head lnk;
+	unsigned int slot; /* level * WHEEL_SIZE + index, or WHEEL_SLOT_NONE */
+} sys_timer_queue_t;
+
+#endif /* WHEEL_TIMER_H_ */
@@ -5,6 +5,8 @@
  *     When object is being allocated it first of all try to find one in the
  *     single list or just increasing pointer to free space in the pool.
  *     When freeing object happens the object just added to the head of the list.
+ *     Both operations are protected with pool spinlock, so pool can be used
+ *     from interrupt handlers and on SMP without extra locking by the caller.
  *
  * @date	17.11.11
  * @author	Gleb Efimov
@@ -19,11 +21,9 @@
 #include <stdint.h>
 #include <util/member.h>
 
-void * pool_alloc(struct pool *pl) {
+static void *__pool_alloc(struct pool *pl) {
 	void *obj;
 
-	assert(pl != NULL);
-
 	if (!slist_empty(&pl->free_blocks)) {
 		return (void *)slist_remove_first_link(&pl->free_blocks);
 	}
@@ -38,13 +38,31 @@ void * pool_alloc(struct pool *pl) {
 	return NULL;
 }
 
+void * pool_alloc(struct pool *pl) {
+	void *obj;
+	ipl_t ipl;
+
+	assert(pl != NULL);
+
+	ipl = spin_lock_ipl(&pl->lock);
+	obj = __pool_alloc(pl);
+	spin_unlock_ipl(&pl->lock, ipl);
+
+	return obj;
+}
+
 void pool_free(struct pool *pl, void *obj) {
+	ipl_t ipl;
+
 	assert(pl != NULL);
 	assert(obj != NULL);
 	assert(pool_belong(pl, obj));
 
 	obj = slist_link_init((struct slist_link *)obj);
+
+	ipl = spin_lock_ipl(&pl->lock);
 	slist_add_first_link(obj, &pl->free_blocks);
+	spin_unlock_ipl(&pl->lock, ipl);
 }
 
 int pool_belong(const struct pool *pl, const void *obj) {
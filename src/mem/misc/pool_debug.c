@@ -18,12 +18,10 @@
 #include <stdint.h>
 #include <util/member.h>
 
-void * pool_alloc(struct pool *pl) {
+static void *__pool_alloc(struct pool *pl) {
 	void *obj;
 	size_t index;
 
-	assert(pl != NULL);
-
 	if (!slist_empty(&pl->free_blocks)) {
 		obj = (void *)slist_remove_first_link(&pl->free_blocks);
 
@@ -49,19 +47,37 @@ void * pool_alloc(struct pool *pl) {
 	return NULL;
 }
 
+void * pool_alloc(struct pool *pl) {
+	void *obj;
+	ipl_t ipl;
+
+	assert(pl != NULL);
+
+	ipl = spin_lock_ipl(&pl->lock);
+	obj = __pool_alloc(pl);
+	spin_unlock_ipl(&pl->lock, ipl);
+
+	return obj;
+}
+
 void pool_free(struct pool *pl, void *obj) {
 	size_t index;
+	ipl_t ipl;
 
 	assert(pl != NULL);
 	assert(obj != NULL);
 	assert(pool_belong(pl, obj));
 
+	ipl = spin_lock_ipl(&pl->lock);
+
 	index = (obj - pl->memory) / pl->obj_size;
 	assert(bitmap_test_bit(pl->blocks, index) == 1);
 	bitmap_clear_bit(pl->blocks, index);
 
 	obj = slist_link_init((struct slist_link *)obj);
 	slist_add_first_link(obj, &pl->free_blocks);
+
+	spin_unlock_ipl(&pl->lock, ipl);
 }
 
 int pool_belong(const struct pool *pl, const void *obj) {
@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @brief Fixed-size pool with per-CPU magazines
+ * @details Each CPU keeps a small stack (magazine) of free objects, so
+ *     the common allocation and freeing only disable local interrupts and
+ *     don't touch shared data. When magazine becomes empty it is refilled
+ *     with a half of its size objects from the shared free list at once,
+ *     when it overflows a half of it is returned back. The shared list is
+ *     protected with pool spinlock.
+ *
+ *     Objects cached in magazines of other CPUs are not available for
+ *     allocation, so small pools bypass magazines completely.
+ *
+ * @see For more information see pool.c
+ *
+ * @date 18.10.2026
+ */
+
+#include <mem/misc/pool.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <hal/cpu.h>
+#include <hal/ipl.h>
+#include <kernel/spinlock.h>
+
+#define POOL_MAGAZINE_BATCH    (POOL_MAGAZINE_SIZE / 2 ? POOL_MAGAZINE_SIZE / 2 : 1)
+/* Not more than a quarter of objects may stay in magazines */
+#define POOL_MAGAZINE_MIN_OBJS (4 * NCPU * POOL_MAGAZINE_SIZE)
+
+static inline int pool_use_magazines(struct pool *pl) {
+	return pl->pool_size >= pl->obj_size * POOL_MAGAZINE_MIN_OBJS;
+}
+
+/* Must be called with pool spinlock held */
+static void *__pool_alloc(struct pool *pl) {
+	void *obj;
+
+	if (!slist_empty(&pl->free_blocks)) {
+		return (void *)slist_remove_first_link(&pl->free_blocks);
+	}
+
+	if (pl->bound_free != pl->memory + pl->pool_size) {
+		obj = pl->bound_free;
+		pl->bound_free += pl->obj_size;
+		assert(pl->bound_free <= pl->memory + pl->pool_size);
+		return obj;
+	}
+
+	return NULL;
+}
+
+/* Must be called with pool spinlock held */
+static void __pool_free(struct pool *pl, void *obj) {
+	obj = slist_link_init((struct slist_link *)obj);
+	slist_add_first_link(obj, &pl->free_blocks);
+}
+
+static void pool_magazine_refill(struct pool *pl, struct pool_magazine *mag) {
+	void *obj;
+
+	spin_lock(&pl->lock);
+	while (mag->rounds < POOL_MAGAZINE_BATCH) {
+		if (NULL == (obj = __pool_alloc(pl))) {
+			break;
+		}
+		mag->objs[mag->rounds++] = obj;
+	}
+	spin_unlock(&pl->lock);
+}
+
+static void pool_magazine_flush(struct pool *pl, struct pool_magazine *mag) {
+	spin_lock(&pl->lock);
+	while (mag->rounds > POOL_MAGAZINE_SIZE - POOL_MAGAZINE_BATCH) {
+		__pool_free(pl, mag->objs[--mag->rounds]);
+	}
+	spin_unlock(&pl->lock);
+}
+
+void * pool_alloc(struct pool *pl) {
+	struct pool_magazine *mag;
+	void *obj;
+	ipl_t ipl;
+
+	assert(pl != NULL);
+
+	if (!pool_use_magazines(pl)) {
+		ipl = spin_lock_ipl(&pl->lock);
+		obj = __pool_alloc(pl);
+		spin_unlock_ipl(&pl->lock, ipl);
+		return obj;
+	}
+
+	ipl = ipl_save();
+	{
+		mag = &pl->magazines[cpu_get_id()];
+		if (mag->rounds == 0) {
+			pool_magazine_refill(pl, mag);
+		}
+		obj = mag->rounds ? mag->objs[--mag->rounds] : NULL;
+	}
+	ipl_restore(ipl);
+
+	return obj;
+}
+
+void pool_free(struct pool *pl, void *obj) {
+	struct pool_magazine *mag;
+	ipl_t ipl;
+
+	assert(pl != NULL);
+	assert(obj != NULL);
+	assert(pool_belong(pl, obj));
+
+	if (!pool_use_magazines(pl)) {
+		ipl = spin_lock_ipl(&pl->lock);
+		__pool_free(pl, obj);
+		spin_unlock_ipl(&pl->lock, ipl);
+		return;
+	}
+
+	ipl = ipl_save();
+	{
+		mag = &pl->magazines[cpu_get_id()];
+		if (mag->rounds == POOL_MAGAZINE_SIZE) {
+			pool_magazine_flush(pl, mag);
+		}
+		mag->objs[mag->rounds++] = obj;
+	}
+	ipl_restore(ipl);
+}
+
+int pool_belong(const struct pool *pl, const void *obj) {
+	return (pl->memory <= obj)
+			&& (obj + pl->obj_size <= pl->memory + pl->pool_size)
+			&& ((obj - pl->memory) % pl->obj_size == 0);
+}
@@ -0,0 +1,20 @@
+/**
+ * @file
+ * @brief Fixed-size pool with per-CPU magazines
+ *
+ * @see For more information see pool_percpu.c
+ *
+ * @date 18.10.2026
+ */
+
+#ifndef POOL_PERCPU_H_
+#define POOL_PERCPU_H_
+
+#include <framework/mod/options.h>
+#include <config/embox/mem/pool_percpu.h>
+
+#define POOL_PERCPU
+#define POOL_MAGAZINE_SIZE \
+	OPTION_MODULE_GET(embox__mem__pool_percpu, NUMBER, magazine_size)
+
+#endif /* POOL_PERCPU_H_ */
@@ -10,127 +10,272 @@
 #include <util/log.h>
 
 #include <assert.h>
+#include <errno.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <arpa/inet.h>
 
 #include <util/dlist.h>
+#include <util/member.h>
 
+#include <hal/cpu.h>
 #include <hal/ipl.h>
 #include <net/netdevice.h>
 #include <net/skbuff.h>
+#include <net/l0/net_entry.h>
 #include <net/l0/net_rx.h>
+#include <net/l2/ethernet.h>
+#include <net/l3/ipv4/ip.h>
+#include <kernel/spinlock.h>
+#include <kernel/cpu/cpu.h>
 #include <kernel/sched/schedee_priority.h>
 #include <kernel/lthread/lthread.h>
+#include <embox/unit.h>
 
 #define NETIF_RX_HND_PRIORITY OPTION_GET(NUMBER, hnd_priority)
+#define NETIF_RX_BATCH        OPTION_GET(NUMBER, rx_batch)
 
-static DLIST_DEFINE(netif_rx_list);
+EMBOX_UNIT_INIT(net_entry_init);
 
-static int netif_rx_action(struct lthread *self);
-static LTHREAD_DEF(netif_rx_irq_handler, netif_rx_action, NETIF_RX_HND_PRIORITY);
+/**
+ * Queues with the same index as the CPU of all devices. Transmission is
+ * done by the softirq-like handler of the CPU
+ */
+struct netif_cpu {
+	spinlock_t lock;
+	struct dlist_head rx_list;
+	struct dlist_head tx_list;
+	struct lthread tx_lt;
+	struct netif_cpu_stats stats;
+};
 
-static int netif_tx_action(struct lthread *self);
-static LTHREAD_DEF(netif_tx_handler, netif_tx_action, NETIF_RX_HND_PRIORITY);
+static struct netif_cpu netif_cpus[NCPU];
 
-static int netif_rx_action(struct lthread *self) {
-	struct net_device *dev = NULL;
+/* The protocol stack isn't SMP-safe, it relies on sched_lock which keeps
+ * out only the local CPU. So receive queues of all CPUs are served by this
+ * single handler, and it never runs on two CPUs at once */
+static struct lthread netif_rx_lt;
+
+/* Hash of addresses and ports, so packets of one flow get into one queue */
+static uint32_t netif_flow_hash(const struct sk_buff *skb) {
+	const struct iphdr *iph;
+	const uint16_t *ports;
+	uint32_t h;
+
+	if ((skb->dev->hdr_len != ETH_HEADER_SIZE)
+			|| (skb->len < ETH_HEADER_SIZE + IP_MIN_HEADER_SIZE)
+			|| (skb->mac.ethh->h_proto != htons(ETH_P_IP))) {
+		return 0;
+	}
+
+	iph = (const struct iphdr *)(skb->mac.raw + ETH_HEADER_SIZE);
+	h = iph->saddr ^ iph->daddr ^ iph->proto;
+
+	/* Fragments have no ports, the first one shouldn't use them too */
+	if (((iph->proto == IPPROTO_TCP) || (iph->proto == IPPROTO_UDP))
+			&& !(iph->frag_off & htons(IP_MF | IP_OFFSET))
+			&& (skb->len >= ETH_HEADER_SIZE + IP_HEADER_SIZE(iph) + 4)) {
+		ports = (const uint16_t *)((const char *)iph + IP_HEADER_SIZE(iph));
+		h ^= ((uint32_t)ports[0] << 16) | ports[1];
+	}
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/* Takes a batch of the first receive queue of @a nc, the queue is moved to
+ * the end so devices are served in turn */
+static int netif_rx_batch(struct netif_cpu *nc, struct sk_buff_head *batch) {
+	struct netdev_queue *q;
+	int n;
 	ipl_t ipl;
 
-	ipl= ipl_save();
+	n = 0;
+	ipl = spin_lock_ipl(&nc->lock);
 	{
-		dlist_foreach_entry_safe(dev, &netif_rx_list, rx_lnk) {
-			struct sk_buff *skb;
+		if (!dlist_empty(&nc->rx_list)) {
+			q = dlist_first_entry(&nc->rx_list, struct netdev_queue, rx_lnk);
 
-			while ((skb = skb_queue_pop(&dev->dev_queue)) != NULL) {
-				ipl_restore(ipl);
-				{
-					net_rx(skb);
-				}
-				ipl= ipl_save();
+			n = skb_queue_splice(&q->rx, batch, NETIF_RX_BATCH);
+			q->rx_packets += n;
+			nc->stats.rx_packets += n;
+
+			dlist_del_init(&q->rx_lnk);
+			if (!skb_queue_empty(&q->rx)) {
+				dlist_add_prev(&q->rx_lnk, &nc->rx_list);
 			}
-			dlist_del_init(&dev->rx_lnk);
 		}
 	}
-	ipl_restore(ipl);
+	spin_unlock_ipl(&nc->lock, ipl);
+
+	return n;
+}
+
+static int netif_rx_action(struct lthread *self) {
+	struct sk_buff_head batch;
+	unsigned int cpu;
+	int work;
+
+	skb_queue_init(&batch);
+
+	/* A batch from each CPU in turn, so a busy flow doesn't hold others.
+	 * The stack demultiplexes a burst at a time */
+	do {
+		work = 0;
+		for (cpu = 0; cpu < NCPU; ++cpu) {
+			if (netif_rx_batch(&netif_cpus[cpu], &batch)) {
+				net_rx_list(&batch);
+				work = 1;
+			}
+		}
+	} while (work);
 
 	return 0;
 }
 
 /* we can be in irq mode */
 int netif_rx(void *data) {
-	ipl_t ipl;
 	struct sk_buff *skb = data;
 	struct net_device *dev;
+	struct netdev_queue *q;
+	struct netif_cpu *nc;
+	unsigned int cpu;
+	ipl_t ipl;
 
 	assert(skb != NULL);
 	assert(skb->dev != NULL);
 
 	dev = skb->dev;
 
-	ipl = ipl_save();
+	cpu = (NCPU > 1) ? netif_flow_hash(skb) % NCPU : 0;
+	q = &dev->queues[cpu];
+	nc = &netif_cpus[cpu];
+
+	ipl = spin_lock_ipl(&nc->lock);
 	{
-		skb_queue_push(&dev->dev_queue, skb);
+		skb_queue_push(&q->rx, skb);
 
-		if (dlist_empty(&dev->rx_lnk)) {
-			dlist_add_prev(&dev->rx_lnk, &netif_rx_list);
+		if (dlist_empty(&q->rx_lnk)) {
+			dlist_add_prev(&q->rx_lnk, &nc->rx_list);
 		}
-
-		lthread_launch(&netif_rx_irq_handler);
 	}
-	ipl_restore(ipl);
+	spin_unlock_ipl(&nc->lock, ipl);
+
+	lthread_launch(&netif_rx_lt);
 
 	return NET_RX_SUCCESS;
 }
 
-static DLIST_DEFINE(netif_tx_list);
-
-static struct lthread netif_tx_handler;
-
 static int netif_tx_action(struct lthread *self) {
-	struct net_device *dev = NULL;
+	struct netif_cpu *nc;
+	struct netdev_queue *q = NULL;
+	struct net_device *dev;
+	struct sk_buff *skb;
+	int ret;
+	ipl_t ipl;
 
-	sched_lock();
+	nc = member_cast_out(self, struct netif_cpu, tx_lt);
+
+	ipl = spin_lock_ipl(&nc->lock);
 	{
-		dlist_foreach_entry_safe(dev, &netif_tx_list, tx_lnk) {
-			struct sk_buff * skb;
-			int ret;
+		dlist_foreach_entry_safe(q, &nc->tx_list, tx_lnk) {
+			dev = q->dev;
+
+			while ((skb = skb_queue_pop(&q->tx)) != NULL) {
+				spin_unlock_ipl(&nc->lock, ipl);
 
-			while ((skb = skb_queue_pop(&dev->dev_queue_tx)) != NULL) {
+				/* Only this handler uses the hardware queue, so
+				 * xmit of a device isn't called concurrently for it */
 				assert(dev->drv_ops != NULL);
 				assert(dev->drv_ops->xmit != NULL);
 				ret = dev->drv_ops->xmit(dev, skb);
 				if (ret != 0) {
 					log_debug("xmit = %d", ret);
 					skb_free(skb);
-					dev->stats.tx_err++;
-					continue;
+					__sync_fetch_and_add(&dev->stats.tx_err, 1);
+				} else {
+					q->tx_packets++;
+					nc->stats.tx_packets++;
+					__sync_fetch_and_add(&dev->stats.tx_packets, 1);
+					__sync_fetch_and_add(&dev->stats.tx_bytes, skb->len);
 				}
 
-				dev->stats.tx_packets++;
-				dev->stats.tx_bytes += skb->len;
+				ipl = spin_lock_ipl(&nc->lock);
 			}
 
-			dlist_del_init(&dev->tx_lnk);
+			dlist_del_init(&q->tx_lnk);
 		}
 	}
-	sched_unlock();
-
+	spin_unlock_ipl(&nc->lock, ipl);
 
 	return 0;
 }
 
 int netif_tx(struct net_device *dev,  struct sk_buff *skb) {
-	sched_lock();
+	struct netdev_queue *q;
+	struct netif_cpu *nc;
+	unsigned int idx;
+	ipl_t ipl;
+
+	idx = (dev->num_tx_queues > 1)
+			? netif_flow_hash(skb) % dev->num_tx_queues : 0;
+	skb->queue_mapping = idx;
+	q = &dev->queues[idx];
+	nc = &netif_cpus[idx];
+
+	ipl = spin_lock_ipl(&nc->lock);
 	{
-		skb_queue_push(&dev->dev_queue_tx, skb);
+		skb_queue_push(&q->tx, skb);
+
+		if (dlist_empty(&q->tx_lnk)) {
+			dlist_add_prev(&q->tx_lnk, &nc->tx_list);
+		}
+	}
+	spin_unlock_ipl(&nc->lock, ipl);
+
+	lthread_launch(&nc->tx_lt);
+
+	return 0;
+}
+
+int netif_get_cpu_stats(unsigned int cpu, struct netif_cpu_stats *stats) {
+	if ((cpu >= NCPU) || (stats == NULL)) {
+		return -EINVAL;
+	}
+
+	*stats = netif_cpus[cpu].stats;
+
+	return 0;
+}
+
+static int net_entry_init(void) {
+	struct netif_cpu *nc;
+	unsigned int cpu;
+
+	lthread_init(&netif_rx_lt, netif_rx_action);
+	schedee_priority_set(&netif_rx_lt.schedee, NETIF_RX_HND_PRIORITY);
+
+	for (cpu = 0; cpu < NCPU; ++cpu) {
+		nc = &netif_cpus[cpu];
+
+		spin_init(&nc->lock, __SPIN_UNLOCKED);
+		dlist_init(&nc->rx_list);
+		dlist_init(&nc->tx_list);
 
-		if (dlist_empty(&dev->tx_lnk)) {
-			dlist_add_prev(&dev->tx_lnk, &netif_tx_list);
+		lthread_init(&nc->tx_lt, netif_tx_action);
+		schedee_priority_set(&nc->tx_lt.schedee, NETIF_RX_HND_PRIORITY);
+		/* Queues of a CPU which isn't started are served by any other */
+		if ((cpu == cpu_get_id()) || (cpu_get_idle(cpu) != NULL)) {
+			sched_affinity_set(&nc->tx_lt.schedee.affinity, 1 << cpu);
 		}
-		lthread_launch(&netif_tx_handler);
 	}
-	sched_unlock();
 
 	return 0;
 }
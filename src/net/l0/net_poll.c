@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @brief Budgeted poll mode for network drivers
+ *
+ * @date 18.10.2026
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <util/dlist.h>
+
+#include <hal/cpu.h>
+#include <hal/ipl.h>
+#include <net/netdevice.h>
+#include <net/skbuff.h>
+#include <net/l0/net_entry.h>
+#include <net/l0/net_poll.h>
+#include <net/l0/net_rx.h>
+#include <kernel/lthread/lthread.h>
+
+#include <framework/mod/options.h>
+
+#define NETIF_POLL_HND_PRIORITY OPTION_GET(NUMBER, hnd_priority)
+#define NETIF_POLL_BUDGET       OPTION_GET(NUMBER, budget)
+#define NETIF_POLL_THRESHOLD    OPTION_GET(NUMBER, load_threshold)
+#define NETIF_POLL_IDLE         OPTION_GET(NUMBER, idle_polls)
+
+/* poll_avg keeps 4 fractional bits */
+#define POLL_AVG_SHIFT 4
+
+static DLIST_DEFINE(netif_poll_list);
+
+/* Packets received by current poll() call. Only poll handler touches it */
+static struct sk_buff_head netif_poll_batch = {
+	(struct sk_buff *) &netif_poll_batch,
+	(struct sk_buff *) &netif_poll_batch,
+};
+
+static int netif_poll_action(struct lthread *self);
+static LTHREAD_DEF(netif_poll_handler, netif_poll_action,
+		NETIF_POLL_HND_PRIORITY);
+
+/**
+ * Decides whether device may leave poll mode. Device stays polled while
+ * it fills the whole budget. Besides that if average load is high the
+ * device is polled a few more rounds after the queue became empty, so
+ * under steady traffic interrupts aren't unmasked just to fire again.
+ */
+static int netif_poll_done(struct net_device *dev, int work) {
+	dev->poll_avg = (dev->poll_avg * 7 + (work << POLL_AVG_SHIFT)) / 8;
+
+	if (work >= NETIF_POLL_BUDGET) {
+		dev->poll_idle = 0;
+		return 0;
+	}
+
+	if (work > 0) {
+		dev->poll_idle = 0;
+	} else {
+		dev->poll_idle++;
+	}
+
+	if ((dev->poll_avg >= (NETIF_POLL_THRESHOLD << POLL_AVG_SHIFT))
+			&& (dev->poll_idle < NETIF_POLL_IDLE)) {
+		return 0;
+	}
+
+	dev->poll_idle = 0;
+	return 1;
+}
+
+static int netif_poll_action(struct lthread *self) {
+	struct net_device *dev = NULL;
+	int work;
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		/* Each device gets at most one budget per round to be fair */
+		dlist_foreach_entry_safe(dev, &netif_poll_list, poll_lnk) {
+			assert(dev->drv_ops->poll != NULL);
+
+			ipl_restore(ipl);
+			{
+				work = dev->drv_ops->poll(dev, NETIF_POLL_BUDGET);
+				net_rx_list(&netif_poll_batch);
+			}
+			ipl = ipl_save();
+
+			if (!netif_poll_done(dev, work)) {
+				continue;
+			}
+
+			/* Interrupt raised right after unmasking is delivered only
+			 * when ipl is restored and device is already off the list */
+			assert(dev->drv_ops->poll_irq_enable != NULL);
+			if (!dev->drv_ops->poll_irq_enable(dev)) {
+				dlist_del_init(&dev->poll_lnk);
+			}
+		}
+
+		if (!dlist_empty(&netif_poll_list)) {
+			lthread_launch(self);
+		}
+	}
+	ipl_restore(ipl);
+
+	return 0;
+}
+
+/* we can be in irq mode */
+void netif_poll_schedule(struct net_device *dev) {
+	ipl_t ipl;
+
+	assert(dev != NULL);
+
+	ipl = ipl_save();
+	{
+		if (dlist_empty(&dev->poll_lnk)) {
+			dlist_add_prev(&dev->poll_lnk, &netif_poll_list);
+		}
+
+		lthread_launch(&netif_poll_handler);
+	}
+	ipl_restore(ipl);
+}
+
+int netif_receive_skb(struct sk_buff *skb) {
+	assert(skb != NULL);
+	assert(skb->dev != NULL);
+
+	if (NCPU > 1) {
+		/* Spread flows over receive queues of all CPUs */
+		return netif_rx(skb);
+	}
+
+	__skb_queue_push(&netif_poll_batch, skb);
+
+	return 0;
+}
@@ -22,27 +22,32 @@
 #include <net/skbuff.h>
 #include <net/socket/packet.h>
 
-int net_rx(struct sk_buff *skb) {
-	const struct net_pack *npack;
-	unsigned short type; /* packet type */
+/* The number of different L3 types handled by one net_rx_list() call
+ * in batches. Packets of other types are passed one by one */
+#define NET_RX_TYPES 4
 
+/**
+ * Does L2 processing of incoming packet.
+ * @return skb for L3 layer or NULL if packet was consumed
+ */
+static struct sk_buff *net_rx_l2(struct sk_buff *skb, unsigned short *type) {
 	/* check L2 header size */
 	assert(skb != NULL);
 	assert(skb->dev != NULL);
 	if (skb->len < skb->dev->hdr_len) {
 		log_error("%p invalid length %zu", skb, skb->len);
 		skb_free(skb);
-		return 0; /* error: invalid size */
+		return NULL; /* error: invalid size */
 	}
 
-	type = ntohs(eth_hdr(skb)->h_proto);
+	*type = ntohs(eth_hdr(skb)->h_proto);
 
 	/* check recipient on L2 layer */
 	switch (pkt_type(skb)) {
 	default:
 		log_debug("%p not for us", skb);
 		skb_free(skb);
-		return 0; /* ok, but: not for us */
+		return NULL; /* ok, but: not for us */
 	case PACKET_HOST:
 	case PACKET_LOOPBACK:
 	case PACKET_BROADCAST:
@@ -54,15 +59,27 @@ int net_rx(struct sk_buff *skb) {
 	assert(skb->mac.raw != NULL);
 	skb->nh.raw = skb->mac.raw + skb->dev->hdr_len;
 
-	log_debug("%p len %zu type %#.6hx", skb, skb->len, type);
+	log_debug("%p len %zu type %#.6hx", skb, skb->len, *type);
 
 	/* decrypt packet */
 	skb = net_decrypt(skb);
 	if (skb == NULL) {
-		return 0; /* error: something wrong :( */
+		return NULL; /* error: something wrong :( */
 	}
 
-	sock_packet_add(skb, type);
+	sock_packet_add(skb, *type);
+
+	return skb;
+}
+
+int net_rx(struct sk_buff *skb) {
+	const struct net_pack *npack;
+	unsigned short type; /* packet type */
+
+	skb = net_rx_l2(skb, &type);
+	if (skb == NULL) {
+		return 0;
+	}
 
 	/* lookup handler for L3 layer
 	 * We check if L3 handler exists only after sock_packet_add(), because of
@@ -78,3 +95,76 @@ int net_rx(struct sk_buff *skb) {
 	/* handling on L3 layer */
 	return npack->rcv_pack(skb, skb->dev);
 }
+
+int net_rx_list(struct sk_buff_head *list) {
+	struct {
+		unsigned short type;
+		const struct net_pack *npack;
+		struct sk_buff_head skbs;
+	} groups[NET_RX_TYPES];
+	const struct net_pack *npack;
+	struct sk_buff *skb;
+	unsigned short type;
+	int i, n;
+
+	assert(list != NULL);
+
+	/* L3 handler is looked up once per type, not once per packet */
+	n = 0;
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		skb = net_rx_l2(skb, &type);
+		if (skb == NULL) {
+			continue;
+		}
+
+		for (i = 0; i < n; ++i) {
+			if (groups[i].type == type) {
+				break;
+			}
+		}
+
+		if (i == n) {
+			npack = net_pack_lookup(type);
+			if (n == NET_RX_TYPES) {
+				if (npack == NULL) {
+					skb_free(skb);
+				} else {
+					npack->rcv_pack(skb, skb->dev);
+				}
+				continue;
+			}
+
+			groups[n].type = type;
+			groups[n].npack = npack;
+			skb_queue_init(&groups[n].skbs);
+			++n;
+		}
+
+		if (groups[i].npack == NULL) {
+			log_debug("%p unknown type %#.6hx", skb, type);
+			skb_free(skb);
+			continue;
+		}
+
+		__skb_queue_push(&groups[i].skbs, skb);
+	}
+
+	/* handling on L3 layer */
+	for (i = 0; i < n; ++i) {
+		npack = groups[i].npack;
+		if (npack == NULL) {
+			continue;
+		}
+
+		if (npack->rcv_list != NULL) {
+			npack->rcv_list(&groups[i].skbs);
+			continue;
+		}
+
+		while ((skb = __skb_queue_pop(&groups[i].skbs)) != NULL) {
+			npack->rcv_pack(skb, skb->dev);
+		}
+	}
+
+	return 0;
+}
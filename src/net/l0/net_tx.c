@@ -37,6 +37,15 @@ int net_tx_direct(struct sk_buff *skb) {
 		return -ENETDOWN;
 	}
 
+	if (skb_is_nonlinear(skb) && !(dev->features & NETIF_F_SG)) {
+		if (skb_linearize(skb) == NULL) {
+			log_error("can't linearize skb");
+			dev->stats.tx_dropped++;
+			skb_free(skb);
+			return -ENOMEM;
+		}
+	}
+
 	log_debug("%p len %zu type %#.6hx", skb, skb->len, ntohs(skb->mac.ethh->h_proto));
 
 	/*
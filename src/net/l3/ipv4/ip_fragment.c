@@ -15,10 +15,13 @@
 #include <net/skbuff.h>
 #include <net/l3/icmpv4.h>
 #include <net/l3/ipv4/ip.h>
+#include <net/lib/ipv4.h>
 
+#include <linux/list.h>
 #include <mem/objalloc.h>
+#include <kernel/lthread/lthread.h>
+#include <kernel/spinlock.h>
 #include <kernel/time/timer.h>
-#include <kernel/time/time.h>
 
 #include <util/math.h>
 #include <util/dlist.h>
@@ -28,13 +31,21 @@
 
 #define MAX_BUFS_CNT       OPTION_GET(NUMBER, max_uncomplete_cnt)
 #define IP_FRAGMENTED_SUPP OPTION_GET(NUMBER, ip_fragmented_support)
+#define IPQ_HASH_SZ        OPTION_GET(NUMBER, hash_size)
+#define IPQ_MEM_HIGH       OPTION_GET(NUMBER, mem_high)
+#define IPQ_MEM_LOW        OPTION_GET(NUMBER, mem_low)
+#define IPQ_TIMEOUT        OPTION_GET(NUMBER, frag_timeout)
+#define IPQ_GC_PRIORITY    OPTION_GET(NUMBER, gc_priority)
 
 /**
  * Datagram receive buffer
  */
 struct dgram_buf {
+	/* Sorted by offset, fragments never overlap each other */
 	struct sk_buff_head fragments;
-	struct dlist_head   next_buf; /* linked list pointers */
+	struct dgram_buf   *hnext;
+	struct dlist_head   lru_lnk;  /* in order of last update */
+	struct dlist_head   age_lnk;  /* in order of creation */
 	struct buf_id {
 		in_addr_t         saddr;
 		in_addr_t         daddr;
@@ -42,31 +53,30 @@ struct dgram_buf {
 		uint8_t           protocol;
 	} buf_id;
 	int               is_last_frag_received;
-	int               meat;
+	int               meat; /* bytes of payload received */
 	int               len; /* total length of original datagram */
-	int               buf_ttl;
-	int               is_deleted;
+	unsigned int      deadline;
+	size_t            mem;
 };
 
-static DLIST_DEFINE(__dgram_buf_list);
+static struct dgram_buf *ipq_hash[IPQ_HASH_SZ];
+static DLIST_DEFINE(ipq_lru);
+static DLIST_DEFINE(ipq_age);
+static spinlock_t ipq_lock = SPIN_STATIC_UNLOCKED;
+static struct ip_frag_stats ipq_stats;
+
 static struct sys_timer ip_frag_timer;
+static unsigned int ipq_now; /* seconds */
 
 OBJALLOC_DEF(__dgram_bufs, struct dgram_buf, MAX_BUFS_CNT);
 
+static int ipq_gc_action(struct lthread *self);
+static LTHREAD_DEF(ipq_gc_lt, ipq_gc_action, IPQ_GC_PRIORITY);
+
 #define df_flag(skb) (ntohs(skb->nh.iph->frag_off) & IP_DF)
 
 #define TIMER_TICK 1000
 
-static struct dgram_buf *ip_buf_create(struct iphdr *iph);
-static void buf_delete(struct dgram_buf *buf);
-static void ip_buf_add_skb(struct dgram_buf *buf, struct sk_buff *skb);
-static struct sk_buff *build_packet(struct dgram_buf *buf);
-
-static inline void buf_set_deleted(struct dgram_buf *buf) {
-	buf->is_deleted = 1;
-	skb_queue_purge(&buf->fragments);
-}
-
 static inline int ip_offset(struct sk_buff *skb) {
 	int offset;
 
@@ -77,135 +87,143 @@ static inline int ip_offset(struct sk_buff *skb) {
 	return offset;
 }
 
-static void ttl_handler(struct sys_timer *timer, void *param) {
-	struct dgram_buf *buf = NULL;
-	int i;
+static inline int ip_frag_end(struct sk_buff *skb) {
+	/* Don't count link layer padding of short frames */
+	return ip_offset(skb) + ip_data_length(ip_hdr(skb));
+}
 
-	i = 0;
+static inline struct dgram_buf **ipq_bucket(in_addr_t saddr, in_addr_t daddr,
+		uint16_t id, uint8_t proto) {
+	uint32_t h;
 
-	dlist_foreach_entry(buf, &__dgram_buf_list, next_buf) {
-		i ++;
-		if (buf->is_deleted) {
-			continue;
-		}
+	h = saddr ^ daddr ^ ((uint32_t) id << 8) ^ proto;
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
 
-		if (buf->buf_ttl == 0) {
-			/*icmp_send(buf->next_skbuff, ICMP_TIME_EXCEEDED, ICMP_EXC_FRAGTIME, 0);*/
-			buf_set_deleted(buf);
-		} else {
-			buf->buf_ttl -= 1;
-		}
-	}
-
-	if (i == 0) {
-		timer_stop(timer);
-	}
+	return &ipq_hash[h % IPQ_HASH_SZ];
 }
 
-static inline struct dgram_buf *ip_find(struct iphdr *iph) {
-	struct dgram_buf *buf = NULL;
-
-	assert(iph);
+static void ipq_timer_handler(struct sys_timer *timer, void *param) {
+	++ipq_now;
+	lthread_launch(&ipq_gc_lt);
+}
 
-	dlist_foreach_entry(buf, &__dgram_buf_list, next_buf) {
-		if (buf->is_deleted) {
-			buf_delete(buf);
-			continue;
+static void ipq_timer_update(void) {
+	if (dlist_empty(&ipq_age)) {
+		if (timer_is_started(&ip_frag_timer)) {
+			timer_stop(&ip_frag_timer);
 		}
-		if (buf->buf_id.daddr == iph->daddr
-			&& buf->buf_id.saddr == iph->saddr
-			&& buf->buf_id.protocol == iph->proto
-			&& buf->buf_id.id == iph->id) {
-			return buf;
+	} else {
+		if (!timer_is_started(&ip_frag_timer)) {
+			timer_init_start_msec(&ip_frag_timer, TIMER_PERIODIC,
+					TIMER_TICK, ipq_timer_handler, NULL);
 		}
 	}
-
-	return NULL;
 }
 
-static void ip_buf_add_skb(struct dgram_buf *buf, struct sk_buff *skb) {
-	int offset, data_len, end;
+static void buf_delete(struct dgram_buf *buf) {
+	struct dgram_buf **prev;
 
-	assert(buf && skb);
+	prev = ipq_bucket(buf->buf_id.saddr, buf->buf_id.daddr, buf->buf_id.id,
+			buf->buf_id.protocol);
+	while (*prev != buf) {
+		prev = &(*prev)->hnext;
+	}
+	*prev = buf->hnext;
 
-	/* We use ttl >> 4 just to make sure time to wait is not very big.
-	 * Usually, ttl is 64, so ttl >> 4 = 4 seconds */
-	buf->buf_ttl = max(buf->buf_ttl, skb->nh.iph->ttl >> 4);
+	dlist_del(&buf->lru_lnk);
+	dlist_del(&buf->age_lnk);
 
-	offset = ip_offset(skb);
+	skb_queue_purge(&buf->fragments);
+	ipq_stats.mem -= buf->mem;
+	ipq_stats.queues--;
 
-	data_len = skb->len - (skb->h.raw - skb->mac.raw);
-	end = offset + data_len;
+	objfree(&__dgram_bufs, buf);
+}
 
-	skb_queue_push(&buf->fragments, skb);
+/* Drops the least recently updated datagrams until memory is below the low
+ * watermark */
+static void ipq_evict(size_t limit) {
+	struct dgram_buf *buf;
 
-	buf->meat += data_len;
-	if (end > buf->len) {
-		buf->len = end;
+	dlist_foreach_entry(buf, &ipq_lru, lru_lnk) {
+		if (ipq_stats.mem <= limit) {
+			break;
+		}
+		ipq_stats.reasm_evicted++;
+		ipq_stats.reasm_fails++;
+		buf_delete(buf);
 	}
 }
 
-static struct sk_buff *build_packet(struct dgram_buf *buf) {
-	struct sk_buff *skb, *skb_iter;
-	int offset = 0;
-	int ihlen;
+/* Expiration is checked only for the oldest datagrams */
+static int ipq_gc_action(struct lthread *self) {
+	struct dgram_buf *buf;
 
-	assert(buf);
+	spin_lock(&ipq_lock);
+	{
+		dlist_foreach_entry(buf, &ipq_age, age_lnk) {
+			if ((int)(buf->deadline - ipq_now) > 0) {
+				break;
+			}
+			/*icmp_send(buf->next_skbuff, ICMP_TIME_EXCEEDED, ICMP_EXC_FRAGTIME, 0);*/
+			ipq_stats.reasm_timeouts++;
+			ipq_stats.reasm_fails++;
+			buf_delete(buf);
+		}
 
-	skb_iter = skb_queue_front(&buf->fragments);
-	assert(skb_iter);
+		ipq_timer_update();
+	}
+	spin_unlock(&ipq_lock);
 
-	ihlen = (skb_iter->h.raw - skb_iter->mac.raw);
-	skb = skb_alloc(buf->len + ihlen);
-	/* Strange:
-	 *	- it might return NULL, because length is too big now.
-	 *	- ihlen has upper limit. So it's more wise to has such
-	 *	amount of extra space in the pool (NOT shared with ICMP)
-	 */
-	assert(skb);
+	return 0;
+}
 
-	/* copy and concatenate dat. Queue is NOT sorted by offset! */
-	while((skb_iter = skb_queue_pop(&buf->fragments))) {
-		offset = ip_offset(skb_iter);
-		if (offset == 0) {
-			memcpy(skb->mac.raw, skb_iter->mac.raw, skb_iter->len);
-			/* Terrible. Some pointers might be NULL here. sk pointer is omitted */
-			skb->nh.raw = skb->mac.raw + (skb_iter->nh.raw - skb_iter->mac.raw);
-			skb->h.raw = skb->nh.raw + IP_HEADER_SIZE(ip_hdr(skb_iter));
-			skb->nh.iph->tot_len = htons(buf->len + IP_HEADER_SIZE(ip_hdr(skb_iter)));
-			skb->dev = skb_iter->dev;
+static struct dgram_buf *ip_find(const struct iphdr *iph) {
+	struct dgram_buf *buf;
+
+	assert(iph);
+
+	for (buf = *ipq_bucket(iph->saddr, iph->daddr, iph->id, iph->proto);
+			buf != NULL; buf = buf->hnext) {
+		if (buf->buf_id.daddr == iph->daddr
+			&& buf->buf_id.saddr == iph->saddr
+			&& buf->buf_id.protocol == iph->proto
+			&& buf->buf_id.id == iph->id) {
+			return buf;
 		}
-		memcpy(skb->mac.raw + ihlen + offset, skb_iter->mac.raw + ihlen,
-				skb_iter->len - ihlen);
-		skb_free(skb_iter);
 	}
 
-	/* recalculate length */
-	skb->len = buf->len + ihlen;
-	buf_set_deleted(buf);
-
-	return skb;
+	return NULL;
 }
 
-static struct dgram_buf *ip_buf_create(struct iphdr *iph) {
-	struct dgram_buf *buf;
+static struct dgram_buf *ip_buf_create(const struct iphdr *iph) {
+	struct dgram_buf *buf, **bucket;
 
 	assert(iph);
 
-	buf = (struct dgram_buf*) objalloc(&__dgram_bufs);
+	buf = objalloc(&__dgram_bufs);
+	if (!buf && !dlist_empty(&ipq_lru)) {
+		/* Reuse the place of the most stale datagram */
+		ipq_stats.reasm_evicted++;
+		ipq_stats.reasm_fails++;
+		buf_delete(dlist_first_entry(&ipq_lru, struct dgram_buf, lru_lnk));
+		buf = objalloc(&__dgram_bufs);
+	}
 	if (!buf) {
 		return NULL;
 	}
 
-	if (!timer_is_inited(&ip_frag_timer)) {
-		timer_init(&ip_frag_timer, TIMER_PERIODIC, ttl_handler, NULL);
-		log_debug("timer init");
-	}
-	timer_start(&ip_frag_timer, ms2jiffies(TIMER_TICK));
-
 	skb_queue_init(&buf->fragments);
-	dlist_head_init(&buf->next_buf);
-	dlist_add_prev(&buf->next_buf, &__dgram_buf_list);
+	dlist_head_init(&buf->lru_lnk);
+	dlist_head_init(&buf->age_lnk);
+	dlist_add_prev(&buf->lru_lnk, &ipq_lru);
+	dlist_add_prev(&buf->age_lnk, &ipq_age);
+
+	bucket = ipq_bucket(iph->saddr, iph->daddr, iph->id, iph->proto);
+	buf->hnext = *bucket;
+	*bucket = buf;
 
 	buf->buf_id.protocol = iph->proto;
 	buf->buf_id.id = iph->id;
@@ -214,15 +232,106 @@ static struct dgram_buf *ip_buf_create(struct iphdr *iph) {
 	buf->len = 0;
 	buf->is_last_frag_received = 0;
 	buf->meat = 0;
-	buf->buf_ttl = MSL;
-	buf->is_deleted = 0;
+	buf->deadline = ipq_now + IPQ_TIMEOUT;
+	buf->mem = 0;
+
+	ipq_stats.queues++;
+	ipq_timer_update();
 
 	return buf;
 }
 
-static void buf_delete(struct dgram_buf *buf) {
-	dlist_del(&buf->next_buf);
-	objfree(&__dgram_bufs, (void*)buf);
+/**
+ * Returns 0 if fragment is queued, 1 if it's a duplicate and has to be
+ * dropped, and -EINVAL if it overlaps other fragments or contradicts the
+ * length of datagram. The whole datagram is dropped in the latter case,
+ * as Linux does, since overlapping fragments are used only by attacks.
+ */
+static int ip_buf_add_skb(struct dgram_buf *buf, struct sk_buff *skb) {
+	struct sk_buff *prev, *next;
+	int offset, end;
+
+	assert(buf && skb);
+
+	offset = ip_offset(skb);
+	end = ip_frag_end(skb);
+
+	if (end == offset) {
+		return 1;
+	}
+
+	if (!(ntohs(skb->nh.iph->frag_off) & IP_MF)) {
+		/* Last fragment fixes the length of datagram */
+		if ((end < buf->len)
+				|| (buf->is_last_frag_received && (end != buf->len))) {
+			return -EINVAL;
+		}
+		buf->is_last_frag_received = 1;
+		buf->len = end;
+	} else {
+		if ((end & 7) || (buf->is_last_frag_received && (end > buf->len))) {
+			return -EINVAL;
+		}
+		buf->len = max(buf->len, end);
+	}
+
+	/* Look for the place from the tail, since fragments usually come
+	 * in order and the new one is just appended */
+	next = (struct sk_buff *) &buf->fragments;
+	for (prev = buf->fragments.prev; !skb_queue_end(prev, &buf->fragments);
+			prev = prev->lnk.prev) {
+		if (ip_offset(prev) <= offset) {
+			break;
+		}
+		next = prev;
+	}
+
+	if (!skb_queue_end(prev, &buf->fragments) && (ip_frag_end(prev) > offset)) {
+		if ((ip_offset(prev) == offset) && (ip_frag_end(prev) == end)) {
+			return 1;
+		}
+		return -EINVAL;
+	}
+	if (!skb_queue_end(next, &buf->fragments) && (ip_offset(next) < end)) {
+		return -EINVAL;
+	}
+
+	list_move_tail((struct list_head *) skb, (struct list_head *) next);
+
+	buf->meat += end - offset;
+	buf->mem += skb->len;
+	ipq_stats.mem += skb->len;
+
+	return 0;
+}
+
+/* Fragments are not copied: the first one becomes the head of the datagram
+ * and payloads of the rest ones are chained to its frag_list */
+static struct sk_buff *build_packet(struct dgram_buf *buf) {
+	struct sk_buff *skb, *frag;
+	struct iphdr *iph;
+
+	assert(buf);
+
+	skb = __skb_queue_pop(&buf->fragments);
+	assert(skb && (ip_offset(skb) == 0));
+
+	skb->len = (skb->h.raw - skb->mac.raw) + ip_data_length(ip_hdr(skb));
+
+	while ((frag = __skb_queue_pop(&buf->fragments))) {
+		frag->len = ip_data_length(ip_hdr(frag));
+		frag->mac.raw = frag->h.raw;
+		skb_frag_list_add(skb, frag);
+	}
+
+	iph = ip_hdr(skb);
+	iph->tot_len = htons(IP_HEADER_SIZE(iph) + buf->len);
+	iph->frag_off = 0;
+	ip_set_check_field(iph);
+
+	buf_delete(buf);
+
+	return skb;
 }
 
 static struct sk_buff *ip_frag_build(const struct sk_buff *big_skb, int frag_offset,
@@ -236,8 +345,12 @@ static struct sk_buff *ip_frag_build(const struct sk_buff *big_skb, int frag_off
 
 	/* Copy IP and MAC headers */
 	memcpy(frag->mac.raw, big_skb->mac.raw, len);
-	/* Copy IP content */
-	memcpy(frag->mac.raw + len, big_skb->mac.raw + frag_offset, frag_size - len);
+	frag->len = len;
+	/* Refer IP content of big_skb. Copy it only if it's scattered too much */
+	if (0 != skb_add_frag_range(frag, big_skb, frag_offset, frag_size - len)) {
+		skb_copy_bits(big_skb, frag_offset, frag->mac.raw + len, frag_size - len);
+		frag->len = frag_size;
+	}
 	frag->nh.raw = frag->mac.raw + big_skb->dev->hdr_len;
 	frag->nh.iph->frag_off = htons(
 				(((frag_offset - len) >> 3) /* data offset / 8 */) | mf_flag);
@@ -248,7 +361,8 @@ static struct sk_buff *ip_frag_build(const struct sk_buff *big_skb, int frag_off
 
 struct sk_buff *ip_defrag(struct sk_buff *skb) {
 	struct dgram_buf *buf;
-	int mf_flag;
+	struct sk_buff *complete;
+	int ret;
 
 	assert(skb);
 
@@ -260,22 +374,54 @@ struct sk_buff *ip_defrag(struct sk_buff *skb) {
 		return skb;
 	}
 
-	buf = ip_find(skb->nh.iph);
-	if (!buf) {
-		buf = ip_buf_create(skb->nh.iph);
-	}
-	assert(buf);
+	complete = NULL;
+
+	spin_lock(&ipq_lock);
+	{
+		ipq_stats.reasm_reqds++;
+
+		if (ipq_stats.mem + skb->len > IPQ_MEM_HIGH) {
+			ipq_evict(IPQ_MEM_LOW);
+		}
 
-	ip_buf_add_skb(buf, skb);
+		buf = ip_find(skb->nh.iph);
+		if (!buf) {
+			buf = ip_buf_create(skb->nh.iph);
+		}
+
+		if (!buf) {
+			ipq_stats.reasm_fails++;
+			ret = 1;
+		} else if ((ret = ip_buf_add_skb(buf, skb)) < 0) {
+			ipq_stats.reasm_fails++;
+			buf_delete(buf);
+		} else if (ret == 0) {
+			dlist_del(&buf->lru_lnk);
+			dlist_add_prev(&buf->lru_lnk, &ipq_lru);
+
+			if (buf->is_last_frag_received && (buf->meat == buf->len)) {
+				ipq_stats.reasm_oks++;
+				complete = build_packet(buf);
+			}
+		}
 
-	mf_flag = ntohs(skb->nh.iph->frag_off) & IP_MF;
-	buf->is_last_frag_received = !mf_flag;
+		ipq_timer_update();
+	}
+	spin_unlock(&ipq_lock);
 
-	if (buf->is_last_frag_received && buf->meat == buf->len) {
-		return build_packet(buf);
+	if (ret != 0) {
+		skb_free(skb);
 	}
 
-	return NULL;
+	return complete;
+}
+
+void ip_frag_get_stats(struct ip_frag_stats *stats) {
+	assert(stats);
+
+	spin_lock(&ipq_lock);
+	memcpy(stats, &ipq_stats, sizeof *stats);
+	spin_unlock(&ipq_lock);
 }
 
 int ip_frag(const struct sk_buff *skb, uint32_t mtu,
@@ -30,11 +30,18 @@
 #include <embox/net/proto.h>
 #include <embox/net/pack.h>
 
-EMBOX_NET_PACK(ETH_P_IP, ip_rcv);
+EMBOX_NET_PACK_LIST(ETH_P_IP, ip_rcv, ip_rcv_list);
 
-static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
+/* The number of flows collected by one ip_rcv_list() call. Packets of
+ * other flows are passed to L4 layer one by one */
+#define IP_RCV_FLOWS 8
+
+/**
+ * Validates IPv4 packet, handles forwarding, options and defragmentation.
+ * @return skb for L4 layer or NULL if packet was consumed
+ */
+static struct sk_buff *ip_rcv_l3(struct sk_buff *skb, struct net_device *dev) {
 	net_device_stats_t *stats = &dev->stats;
-	const struct net_proto *nproto;
 	iphdr_t *iph = ip_hdr(skb);
 	__u16 old_check;
 	size_t ip_len;
@@ -55,7 +62,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: invalid IPv4 header length");
 		stats->rx_length_errors++;
 		skb_free(skb);
-		return 0; /* error: invalid header length */
+		return NULL; /* error: invalid header length */
 	}
 
 
@@ -63,7 +70,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: invalid IPv4 version");
 		stats->rx_err++;
 		skb_free(skb);
-		return 0; /* error: not ipv4 */
+		return NULL; /* error: not ipv4 */
 	}
 
 	old_check = iph->check;
@@ -73,7 +80,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 				ntohs(old_check), ntohs(iph->check));
 		stats->rx_crc_errors++;
 		skb_free(skb);
-		return 0; /* error: invalid crc */
+		return NULL; /* error: invalid crc */
 	}
 
 	ip_len = ntohs(iph->tot_len);
@@ -82,7 +89,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: invalid IPv4 length");
 		stats->rx_length_errors++;
 		skb_free(skb);
-		return 0; /* error: invalid length */
+		return NULL; /* error: invalid length */
 	}
 
 	/* Setup transport layer (L4) header */
@@ -93,7 +100,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 		log_debug("ip_rcv: dropped by input netfilter");
 		stats->rx_dropped++;
 		skb_free(skb);
-		return 0; /* error: dropped */
+		return NULL; /* error: dropped */
 	}
 
 	/* Forwarding */
@@ -101,7 +108,7 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 	if (!inetdev_get_by_dev(skb->dev)) {
 		log_debug("ip_rcv: dropped by input  because inet_dev is not set");
 		skb_free(skb);
-		return 0; /* didn't set inet dev yet */
+		return NULL; /* didn't set inet dev yet */
 	}
 
 	if (inetdev_get_by_dev(skb->dev)->ifa_address != 0) {
@@ -124,9 +131,10 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 				log_debug("ip_rcv: dropped by forward netfilter");
 				stats->rx_dropped++;
 				skb_free(skb);
-				return 0; /* error: dropped */
+				return NULL; /* error: dropped */
 			}
-			return ip_forward(skb);
+			ip_forward(skb);
+			return NULL;
 		}
 	}
 
@@ -146,13 +154,13 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 			log_debug("ip_rcv: invalid options");
 			stats->rx_err++;
 			skb_free(skb);
-			return 0; /* error: bad ops */
+			return NULL; /* error: bad ops */
 		}
 		if (ip_options_handle_srr(skb)) {
 			log_debug("ip_rcv: can't handle options");
 			stats->tx_err++;
 			skb_free(skb);
-			return 0; /* error: can't handle ops */
+			return NULL; /* error: can't handle ops */
 		}
 	}
 
@@ -164,23 +172,137 @@ static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
 	 */
 	if (ntohs(skb->nh.iph->frag_off) & (IP_MF | IP_OFFSET)) {
 		if ((complete_skb = ip_defrag(skb)) == NULL) {
-			return 0;
+			return NULL;
 		} else {
 			skb = complete_skb;
 			iph = ip_hdr(complete_skb);
 		}
+
+		/* UDP takes chained fragments as is, others want flat data */
+		if ((iph->proto != IPPROTO_UDP) && (skb_linearize(skb) == NULL)) {
+			log_debug("ip_rcv: can't linearize datagram");
+			stats->rx_dropped++;
+			skb_free(skb);
+			return NULL;
+		}
 	}
 
 	/* When a packet is received, it is passed to any raw sockets
 	 * which have been bound to its protocol or to socket with concrete protocol */
 	raw_rcv(skb);
 
-	nproto = net_proto_lookup(ETH_P_IP, iph->proto);
+	return skb;
+}
+
+static int ip_rcv(struct sk_buff *skb, struct net_device *dev) {
+	const struct net_proto *nproto;
+
+	skb = ip_rcv_l3(skb, dev);
+	if (skb == NULL) {
+		return 0;
+	}
+
+	nproto = net_proto_lookup(ETH_P_IP, ip_hdr(skb)->proto);
 	if (nproto != NULL) {
 		return nproto->handle(skb);
 	}
 
-	log_debug("ip_rcv: unknown protocol %d", iph->proto);
+	log_debug("ip_rcv: unknown protocol %d", ip_hdr(skb)->proto);
 	skb_free(skb);
 	return 0; /* error: nobody wants this packet */
 }
+
+struct ip_rcv_flow {
+	const struct net_proto *nproto;
+	struct net_device *dev;
+	in_addr_t saddr;
+	in_addr_t daddr;
+	uint32_t ports;
+	struct sk_buff_head skbs;
+};
+
+/* First 4 bytes of TCP and UDP header are source and destination ports */
+static uint32_t ip_rcv_flow_ports(const struct sk_buff *skb) {
+	uint32_t ports = 0;
+
+	if (ntohs(ip_hdr(skb)->tot_len) >= IP_HEADER_SIZE(ip_hdr(skb)) + sizeof ports) {
+		memcpy(&ports, skb->h.raw, sizeof ports);
+	}
+
+	return ports;
+}
+
+/**
+ * Packets of protocols which can handle lists are grouped by flow, so L4
+ * layer may demultiplex a flow once (e.g. find socket for UDP datagrams)
+ * instead of doing it for every packet.
+ */
+static int ip_rcv_list(struct sk_buff_head *list) {
+	struct ip_rcv_flow flows[IP_RCV_FLOWS];
+	struct ip_rcv_flow *flow;
+	const struct net_proto *nproto;
+	struct sk_buff *skb;
+	unsigned char proto;
+	uint32_t ports;
+	int i, n;
+
+	nproto = NULL;
+	proto = 0;
+	n = 0;
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		skb = ip_rcv_l3(skb, skb->dev);
+		if (skb == NULL) {
+			continue;
+		}
+
+		/* consecutive packets are likely of the same protocol */
+		if ((nproto == NULL) || (proto != ip_hdr(skb)->proto)) {
+			proto = ip_hdr(skb)->proto;
+			nproto = net_proto_lookup(ETH_P_IP, proto);
+		}
+
+		if (nproto == NULL) {
+			log_debug("ip_rcv: unknown protocol %d", proto);
+			skb_free(skb);
+			continue;
+		}
+
+		if (nproto->handle_list == NULL) {
+			nproto->handle(skb);
+			continue;
+		}
+
+		ports = ip_rcv_flow_ports(skb);
+		for (i = 0, flow = &flows[0]; i < n; ++i, ++flow) {
+			if ((flow->nproto == nproto) && (flow->dev == skb->dev)
+					&& (flow->saddr == ip_hdr(skb)->saddr)
+					&& (flow->daddr == ip_hdr(skb)->daddr)
+					&& (flow->ports == ports)) {
+				break;
+			}
+		}
+
+		if (i == n) {
+			if (n == IP_RCV_FLOWS) {
+				nproto->handle(skb);
+				continue;
+			}
+
+			flow->nproto = nproto;
+			flow->dev = skb->dev;
+			flow->saddr = ip_hdr(skb)->saddr;
+			flow->daddr = ip_hdr(skb)->daddr;
+			flow->ports = ports;
+			skb_queue_init(&flow->skbs);
+			++n;
+		}
+
+		__skb_queue_push(&flow->skbs, skb);
+	}
+
+	for (i = 0; i < n; ++i) {
+		flows[i].nproto->handle_list(&flows[i].skbs);
+	}
+
+	return 0;
+}
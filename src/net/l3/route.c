@@ -11,41 +11,72 @@
 #include <errno.h>
 #include <assert.h>
 #include <net/l3/route.h>
+#include <net/l3/route_trie.h>
 #include <linux/in.h>
 #include <mem/misc/pool.h>
 #include <net/inetdevice.h>
-#include <util/bit.h>
 #include <util/dlist.h>
 #include <util/member.h>
 #include <net/skbuff.h>
 #include <net/sock.h>
+#include <kernel/thread/sync/seqlock.h>
 
 #include <framework/mod/options.h>
 
 /**
  * NOTE: Linux route uses 3 structures for routing:
  *    + Forwarding Information Base (FIB)
- *    - routing cache (256 chains)
+ *    + routing cache (direct mapped, see rt_cache_lookup())
  *    + neighbour table (ARP cache)
  */
 
+#define RT_TABLE_SIZE OPTION_GET(NUMBER,route_table_size)
+#define RT_CACHE_SIZE OPTION_GET(NUMBER,route_cache_size)
+
 struct rt_entry_info {
 	struct dlist_head lnk;
+	struct rt_trie_leaf leaf;
 	struct rt_entry entry;
 };
 
-POOL_DEF(rt_entry_info_pool, struct rt_entry_info, OPTION_GET(NUMBER,route_table_size));
+POOL_DEF(rt_entry_info_pool, struct rt_entry_info, RT_TABLE_SIZE);
+POOL_DEF(rt_trie_node_pool, struct rt_trie_node, 2 * RT_TABLE_SIZE);
 static DLIST_DEFINE(rt_entry_info_list);
+static struct rt_trie rt_trie = RT_TRIE_INIT(&rt_trie_node_pool);
+
+/* Changes of routing table are serialized by the lock, and its sequence
+ * is the generation of the table. Lookups retry if the table was changed
+ * meanwhile, as they may be done from any context */
+static seqlock_t rt_seq = SEQLOCK_INIT;
+
+/* Cache of rt_fib_get_best() results. All entries become stale at once
+ * when routing table is changed. An entry is filled by one lookup at once,
+ * others leave it as is */
+struct rt_cache_entry {
+	seqcount_t seq;
+	in_addr_t dst;
+	struct net_device *out_dev;
+	struct rt_entry *rte;
+	unsigned int gen;
+};
 
-int rt_add_route(struct net_device *dev, in_addr_t dst,
+static struct rt_cache_entry rt_cache[RT_CACHE_SIZE ? RT_CACHE_SIZE : 1];
+
+static inline struct rt_cache_entry *rt_cache_slot(in_addr_t dst) {
+	return &rt_cache[(ntohl(dst) * 2654435761u) % RT_CACHE_SIZE];
+}
+
+static void rt_entry_info_free(struct rt_entry_info *rt_info) {
+	dlist_del_init_entry(rt_info, lnk);
+	rt_trie_remove(&rt_trie, &rt_info->leaf);
+	pool_free(&rt_entry_info_pool, rt_info);
+}
+
+static int rt_add_route_locked(struct net_device *dev, in_addr_t dst,
 		in_addr_t mask, in_addr_t gw, int flags) {
 	struct rt_entry_info *rt_info;
 	bool flag = true;
 
-	if (dev == NULL) {
-		return -EINVAL;
-	}
-
 	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
 		if ((rt_info->entry.rt_dst == dst) &&
                 ((rt_info->entry.rt_mask == mask) || (INADDR_ANY == mask)) &&
@@ -66,13 +97,35 @@ int rt_add_route(struct net_device *dev, in_addr_t dst,
 		rt_info->entry.rt_mask = mask;
 		rt_info->entry.rt_gateway = gw;
 		rt_info->entry.rt_flags = RTF_UP | flags;
+		if (0 != rt_trie_insert(&rt_trie, dst, mask, &rt_info->leaf)) {
+			pool_free(&rt_entry_info_pool, rt_info);
+			return -ENOMEM;
+		}
 		dlist_add_prev_entry(rt_info, &rt_entry_info_list, lnk);
 	}
 
 	return 0;
 }
 
-int rt_del_route(struct net_device *dev, in_addr_t dst,
+int rt_add_route(struct net_device *dev, in_addr_t dst,
+		in_addr_t mask, in_addr_t gw, int flags) {
+	ipl_t ipl;
+	int ret;
+
+	if (dev == NULL) {
+		return -EINVAL;
+	}
+
+	ipl = write_seqlock_ipl(&rt_seq);
+	{
+		ret = rt_add_route_locked(dev, dst, mask, gw, flags);
+	}
+	write_sequnlock_ipl(&rt_seq, ipl);
+
+	return ret;
+}
+
+static int rt_del_route_locked(struct net_device *dev, in_addr_t dst,
 		in_addr_t mask, in_addr_t gw) {
 	struct rt_entry_info *rt_info;
 
@@ -81,8 +134,7 @@ int rt_del_route(struct net_device *dev, in_addr_t dst,
                 ((rt_info->entry.rt_mask == mask) || (INADDR_ANY == mask)) &&
     			((rt_info->entry.rt_gateway == gw) || (INADDR_ANY == gw)) &&
     			((rt_info->entry.dev == dev) || (NULL == dev))) {
-			dlist_del_init_entry(rt_info, lnk);
-			pool_free(&rt_entry_info_pool, rt_info);
+			rt_entry_info_free(rt_info);
 			return 0;
 		}
 	}
@@ -90,17 +142,35 @@ int rt_del_route(struct net_device *dev, in_addr_t dst,
 	return -ENOENT;
 }
 
+int rt_del_route(struct net_device *dev, in_addr_t dst,
+		in_addr_t mask, in_addr_t gw) {
+	ipl_t ipl;
+	int ret;
+
+	ipl = write_seqlock_ipl(&rt_seq);
+	{
+		ret = rt_del_route_locked(dev, dst, mask, gw);
+	}
+	write_sequnlock_ipl(&rt_seq, ipl);
+
+	return ret;
+}
+
 int rt_del_route_if(struct net_device *dev) {
 	struct rt_entry_info *rt_info = NULL;
 	int ret = 0;
-
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		if (rt_info->entry.dev == dev) {
-			dlist_del_init_entry(rt_info, lnk);
-			pool_free(&rt_entry_info_pool, rt_info);
-			ret ++;
+	ipl_t ipl;
+
+	ipl = write_seqlock_ipl(&rt_seq);
+	{
+		dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
+			if (rt_info->entry.dev == dev) {
+				rt_entry_info_free(rt_info);
+				ret ++;
+			}
 		}
 	}
+	write_sequnlock_ipl(&rt_seq, ipl);
 
 	return ret ? 0 : -ENOENT;
 }
@@ -260,26 +330,68 @@ struct rt_entry * rt_fib_get_next(struct rt_entry *entry) {
 			struct rt_entry_info, lnk)->entry;
 }
 
-/* ToDo: It's too ugly to perform sorting for every packet.
- * Routes must be added into list with mask_len decrease.
- * In this case we'll simply take the first match
- */
+static int rt_fib_match(struct rt_trie_leaf *leaf, void *arg) {
+	struct rt_entry_info *rt_info;
+	struct net_device *out_dev = arg;
+
+	rt_info = member_cast_out(leaf, struct rt_entry_info, leaf);
+
+	return out_dev == NULL || out_dev == rt_info->entry.dev;
+}
+
+static int rt_cache_lookup(struct rt_cache_entry *ce, in_addr_t dst,
+		struct net_device *out_dev, unsigned int gen,
+		struct rt_entry **rte) {
+	unsigned int seq;
+	int found;
+
+	seq = raw_read_seqcount(&ce->seq);
+
+	found = ce->gen == gen && ce->dst == dst && ce->out_dev == out_dev;
+	*rte = ce->rte;
+
+	return found && !read_seqcount_retry(&ce->seq, seq);
+}
+
+static void rt_cache_fill(struct rt_cache_entry *ce, in_addr_t dst,
+		struct net_device *out_dev, unsigned int gen, struct rt_entry *rte) {
+	if (!write_seqcount_trybegin(&ce->seq)) {
+		return;
+	}
+
+	ce->dst = dst;
+	ce->out_dev = out_dev;
+	ce->rte = rte;
+	ce->gen = gen;
+
+	write_seqcount_end(&ce->seq);
+}
+
 struct rt_entry * rt_fib_get_best(in_addr_t dst, struct net_device *out_dev) {
-	struct rt_entry_info *rt_info = NULL;
-	int mask_len, best_mask_len;
+	struct rt_cache_entry *ce = NULL;
+	struct rt_trie_leaf *leaf;
 	struct rt_entry *best_rte;
+	unsigned int gen;
 
-	best_rte = NULL;
-	best_mask_len = -1;
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		mask_len = ~rt_info->entry.rt_mask
-			? bit_clz(ntohl(~rt_info->entry.rt_mask)) + 1 : 32;
-		if (((dst & rt_info->entry.rt_mask) == rt_info->entry.rt_dst)
-				&& (out_dev == NULL || out_dev == rt_info->entry.dev)
-				&& (mask_len > best_mask_len)) {
-			best_rte = &rt_info->entry;
-			best_mask_len = mask_len;
+	if (RT_CACHE_SIZE) {
+		ce = rt_cache_slot(dst);
+	}
+
+	do {
+		gen = read_seqbegin(&rt_seq);
+
+		if (ce && rt_cache_lookup(ce, dst, out_dev, gen, &best_rte)) {
+			return best_rte;
 		}
+
+		leaf = rt_trie_lookup(&rt_trie, dst, rt_fib_match, out_dev);
+		best_rte = leaf
+			? &member_cast_out(leaf, struct rt_entry_info, leaf)->entry
+			: NULL;
+	} while (read_seqretry(&rt_seq, gen));
+
+	if (ce) {
+		rt_cache_fill(ce, dst, out_dev, gen, best_rte);
 	}
 
 	return best_rte;
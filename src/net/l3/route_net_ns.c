@@ -11,10 +11,10 @@
 #include <errno.h>
 #include <assert.h>
 #include <net/l3/route.h>
+#include <net/l3/route_trie.h>
 #include <linux/in.h>
 #include <mem/misc/pool.h>
 #include <net/inetdevice.h>
-#include <util/bit.h>
 #include <util/dlist.h>
 #include <util/member.h>
 #include <net/skbuff.h>
@@ -25,17 +25,51 @@
 /**
  * NOTE: Linux route uses 3 structures for routing:
  *    + Forwarding Information Base (FIB)
- *    - routing cache (256 chains)
+ *    + routing cache (direct mapped, see rt_fib_lookup())
  *    + neighbour table (ARP cache)
  */
 
+#define RT_TABLE_SIZE OPTION_GET(NUMBER,route_table_size)
+#define RT_CACHE_SIZE OPTION_GET(NUMBER,route_cache_size)
+
 struct rt_entry_info {
 	struct dlist_head lnk;
+	struct rt_trie_leaf leaf;
 	struct rt_entry entry;
 };
 
-POOL_DEF(rt_entry_info_pool, struct rt_entry_info, OPTION_GET(NUMBER,route_table_size));
+POOL_DEF(rt_entry_info_pool, struct rt_entry_info, RT_TABLE_SIZE);
+POOL_DEF(rt_trie_node_pool, struct rt_trie_node, 2 * RT_TABLE_SIZE);
 static DLIST_DEFINE(rt_entry_info_list);
+static struct rt_trie rt_trie = RT_TRIE_INIT(&rt_trie_node_pool);
+
+/* Cache of rt_fib_get_best() results. All entries become stale at once
+ * when routing table is changed */
+struct rt_cache_entry {
+	in_addr_t dst;
+	struct net_device *out_dev;
+	net_namespace_p net_ns;
+	int any_ns;
+	struct rt_entry *rte;
+	unsigned int gen;
+};
+
+static struct rt_cache_entry rt_cache[RT_CACHE_SIZE ? RT_CACHE_SIZE : 1];
+static unsigned int rt_cache_gen = 1;
+
+static inline void rt_cache_flush(void) {
+	rt_cache_gen++;
+}
+
+static inline struct rt_cache_entry *rt_cache_slot(in_addr_t dst) {
+	return &rt_cache[(ntohl(dst) * 2654435761u) % RT_CACHE_SIZE];
+}
+
+static void rt_entry_info_free(struct rt_entry_info *rt_info) {
+	dlist_del_init_entry(rt_info, lnk);
+	rt_trie_remove(&rt_trie, &rt_info->leaf);
+	pool_free(&rt_entry_info_pool, rt_info);
+}
 
 int rt_add_route(struct net_device *dev, in_addr_t dst,
 		in_addr_t mask, in_addr_t gw, int flags) {
@@ -74,7 +108,12 @@ int rt_add_route_netns(struct net_device *dev, in_addr_t dst,
 		rt_info->entry.rt_gateway = gw;
 		rt_info->entry.rt_flags = RTF_UP | flags;
 		assign_net_ns(rt_info->entry.net_ns, net_ns);
+		if (0 != rt_trie_insert(&rt_trie, dst, mask, &rt_info->leaf)) {
+			pool_free(&rt_entry_info_pool, rt_info);
+			return -ENOMEM;
+		}
 		dlist_add_prev_entry(rt_info, &rt_entry_info_list, lnk);
+		rt_cache_flush();
 	}
 
 	return 0;
@@ -89,8 +128,8 @@ int rt_del_route(struct net_device *dev, in_addr_t dst,
                 ((rt_info->entry.rt_mask == mask) || (INADDR_ANY == mask)) &&
     			((rt_info->entry.rt_gateway == gw) || (INADDR_ANY == gw)) &&
     			((rt_info->entry.dev == dev) || (NULL == dev))) {
-			dlist_del_init_entry(rt_info, lnk);
-			pool_free(&rt_entry_info_pool, rt_info);
+			rt_entry_info_free(rt_info);
+			rt_cache_flush();
 			return 0;
 		}
 	}
@@ -104,11 +143,11 @@ int rt_del_route_if(struct net_device *dev) {
 
 	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
 		if (rt_info->entry.dev == dev) {
-			dlist_del_init_entry(rt_info, lnk);
-			pool_free(&rt_entry_info_pool, rt_info);
+			rt_entry_info_free(rt_info);
 			ret ++;
 		}
 	}
+	rt_cache_flush();
 
 	return ret ? 0 : -ENOENT;
 }
@@ -320,52 +359,65 @@ struct rt_entry * rt_fib_get_next(struct rt_entry *entry) {
 	return rt_fib_get_next_net_ns(entry, get_net_ns());
 }
 
-/* ToDo: It's too ugly to perform sorting for every packet.
- * Routes must be added into list with mask_len decrease.
- * In this case we'll simply take the first match
- */
-struct rt_entry * rt_fib_get_best(in_addr_t dst, struct net_device *out_dev) {
+struct rt_fib_match_arg {
+	struct net_device *out_dev;
+	net_namespace_p net_ns;
+	int any_ns;
+};
+
+static int rt_fib_match(struct rt_trie_leaf *leaf, void *arg) {
 	struct rt_entry_info *rt_info;
-	int mask_len, best_mask_len;
+	struct rt_fib_match_arg *m = arg;
+
+	rt_info = member_cast_out(leaf, struct rt_entry_info, leaf);
+
+	return (m->out_dev == NULL || m->out_dev == rt_info->entry.dev)
+		&& (m->any_ns || cmp_net_ns(rt_info->entry.net_ns, m->net_ns));
+}
+
+static struct rt_entry *rt_fib_lookup(in_addr_t dst,
+		struct rt_fib_match_arg *m) {
+	struct rt_cache_entry *ce = NULL;
+	struct rt_trie_leaf *leaf;
 	struct rt_entry *best_rte;
 
-	best_rte = NULL;
-	best_mask_len = -1;
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		mask_len = ~rt_info->entry.rt_mask
-			? bit_clz(ntohl(~rt_info->entry.rt_mask)) + 1 : 32;
-		if (((dst & rt_info->entry.rt_mask) == rt_info->entry.rt_dst)
-				&& (out_dev == NULL || out_dev == rt_info->entry.dev)
-				&& (mask_len > best_mask_len)) {
-			best_rte = &rt_info->entry;
-			best_mask_len = mask_len;
+	if (RT_CACHE_SIZE) {
+		ce = rt_cache_slot(dst);
+		if (ce->gen == rt_cache_gen && ce->dst == dst
+				&& ce->out_dev == m->out_dev && ce->any_ns == m->any_ns
+				&& (m->any_ns || cmp_net_ns(ce->net_ns, m->net_ns))) {
+			return ce->rte;
 		}
 	}
 
+	leaf = rt_trie_lookup(&rt_trie, dst, rt_fib_match, m);
+	best_rte = leaf ? &member_cast_out(leaf, struct rt_entry_info, leaf)->entry
+		: NULL;
+
+	if (ce) {
+		ce->dst = dst;
+		ce->out_dev = m->out_dev;
+		assign_net_ns(ce->net_ns, m->net_ns);
+		ce->any_ns = m->any_ns;
+		ce->rte = best_rte;
+		ce->gen = rt_cache_gen;
+	}
+
 	return best_rte;
 }
 
+struct rt_entry * rt_fib_get_best(in_addr_t dst, struct net_device *out_dev) {
+	struct rt_fib_match_arg m = { .out_dev = out_dev, .any_ns = 1 };
+
+	return rt_fib_lookup(dst, &m);
+}
+
 struct rt_entry * rt_fib_get_best_net_ns(in_addr_t dst,
 					 struct net_device *out_dev,
 					 net_namespace_p net_ns) {
-	struct rt_entry_info *rt_info;
-	int mask_len, best_mask_len;
-	struct rt_entry *best_rte;
+	struct rt_fib_match_arg m = { .out_dev = out_dev, .any_ns = 0 };
 
-	best_rte = NULL;
-	best_mask_len = -1;
-	dlist_foreach_entry(rt_info, &rt_entry_info_list, lnk) {
-		if (!cmp_net_ns(rt_info->entry.net_ns, net_ns))
-			continue;
-		mask_len = ~rt_info->entry.rt_mask
-			? bit_clz(ntohl(~rt_info->entry.rt_mask)) + 1 : 32;
-		if (((dst & rt_info->entry.rt_mask) == rt_info->entry.rt_dst)
-				&& (out_dev == NULL || out_dev == rt_info->entry.dev)
-				&& (mask_len > best_mask_len)) {
-			best_rte = &rt_info->entry;
-			best_mask_len = mask_len;
-		}
-	}
+	assign_net_ns(m.net_ns, net_ns);
 
-	return best_rte;
+	return rt_fib_lookup(dst, &m);
 }
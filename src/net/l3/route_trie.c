@@ -0,0 +1,191 @@
+/**
+ * @file
+ * @brief Path-compressed binary trie for longest prefix match of IPv4
+ *   addresses
+ *
+ * @date 18.10.2026
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+
+#include <arpa/inet.h>
+#include <mem/misc/pool.h>
+#include <net/l3/route_trie.h>
+#include <util/bit.h>
+#include <util/dlist.h>
+
+static inline uint32_t rt_trie_mask(int plen) {
+	return plen ? ~0u << (32 - plen) : 0;
+}
+
+static inline int rt_trie_bit(uint32_t key, int pos) {
+	assert(pos < 32);
+	return (key >> (31 - pos)) & 1;
+}
+
+/* Length of common prefix of @a a and @a b, but not greater than @a max */
+static inline int rt_trie_common(uint32_t a, uint32_t b, int max) {
+	int len;
+
+	len = (a ^ b) ? bit_clz(a ^ b) : 32;
+
+	return len < max ? len : max;
+}
+
+static struct rt_trie_node *rt_trie_node_alloc(struct rt_trie *trie,
+		uint32_t key, int plen) {
+	struct rt_trie_node *node;
+
+	node = pool_alloc(trie->node_pool);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	node->child[0] = node->child[1] = NULL;
+	node->parent = NULL;
+	node->key = key & rt_trie_mask(plen);
+	node->plen = plen;
+	dlist_init(&node->leaves);
+
+	return node;
+}
+
+static void rt_trie_leaf_attach(struct rt_trie_node *node,
+		struct rt_trie_leaf *leaf) {
+	dlist_head_init(&leaf->lnk);
+	dlist_add_prev(&leaf->lnk, &node->leaves);
+	leaf->node = node;
+}
+
+static inline struct rt_trie_node **rt_trie_slot(struct rt_trie *trie,
+		struct rt_trie_node *node) {
+	struct rt_trie_node *parent = node->parent;
+
+	return parent ? &parent->child[rt_trie_bit(node->key, parent->plen)]
+		: &trie->root;
+}
+
+int rt_trie_insert(struct rt_trie *trie, in_addr_t dst, in_addr_t mask,
+		struct rt_trie_leaf *leaf) {
+	struct rt_trie_node **slot, *node, *parent, *new, *split;
+	uint32_t key;
+	int plen, cpl;
+
+	plen = mask ? 32 - bit_ctz(ntohl(mask)) : 0;
+	key = ntohl(dst) & rt_trie_mask(plen);
+
+	parent = NULL;
+	slot = &trie->root;
+	while (NULL != (node = *slot)) {
+		cpl = rt_trie_common(node->key, key,
+				node->plen < plen ? node->plen : plen);
+
+		if (cpl == node->plen && node->plen == plen) {
+			rt_trie_leaf_attach(node, leaf);
+			return 0;
+		}
+
+		if (cpl < node->plen) {
+			break;
+		}
+
+		/* Node prefix covers the key, go deeper */
+		parent = node;
+		slot = &node->child[rt_trie_bit(key, node->plen)];
+	}
+
+	new = rt_trie_node_alloc(trie, key, plen);
+	if (new == NULL) {
+		return -ENOMEM;
+	}
+	rt_trie_leaf_attach(new, leaf);
+
+	if (node == NULL) {
+		new->parent = parent;
+		*slot = new;
+		return 0;
+	}
+
+	if (cpl == plen) {
+		/* New prefix covers the node, insert it above */
+		new->child[rt_trie_bit(node->key, plen)] = node;
+		new->parent = parent;
+		node->parent = new;
+		*slot = new;
+		return 0;
+	}
+
+	/* Prefixes diverge at bit @a cpl, add branching node */
+	split = rt_trie_node_alloc(trie, key, cpl);
+	if (split == NULL) {
+		dlist_del_init(&leaf->lnk);
+		pool_free(trie->node_pool, new);
+		return -ENOMEM;
+	}
+
+	split->child[rt_trie_bit(key, cpl)] = new;
+	split->child[rt_trie_bit(node->key, cpl)] = node;
+	split->parent = parent;
+	new->parent = split;
+	node->parent = split;
+	*slot = split;
+
+	return 0;
+}
+
+void rt_trie_remove(struct rt_trie *trie, struct rt_trie_leaf *leaf) {
+	struct rt_trie_node *node, *child, *parent;
+
+	node = leaf->node;
+	assert(node);
+
+	dlist_del_init(&leaf->lnk);
+	leaf->node = NULL;
+
+	/* Drop nodes which are neither routes nor branching points */
+	while (node && dlist_empty(&node->leaves)
+			&& !(node->child[0] && node->child[1])) {
+		child = node->child[0] ? node->child[0] : node->child[1];
+		parent = node->parent;
+
+		*rt_trie_slot(trie, node) = child;
+		if (child) {
+			child->parent = parent;
+		}
+		pool_free(trie->node_pool, node);
+
+		node = parent;
+	}
+}
+
+struct rt_trie_leaf *rt_trie_lookup(struct rt_trie *trie, in_addr_t addr,
+		int (*match)(struct rt_trie_leaf *leaf, void *arg), void *arg) {
+	struct rt_trie_node *node;
+	struct rt_trie_leaf *leaf, *best;
+	uint32_t key;
+
+	key = ntohl(addr);
+	best = NULL;
+
+	for (node = trie->root; node != NULL;
+			node = node->child[rt_trie_bit(key, node->plen)]) {
+		if ((key ^ node->key) & rt_trie_mask(node->plen)) {
+			break;
+		}
+
+		dlist_foreach_entry(leaf, &node->leaves, lnk) {
+			if (match == NULL || match(leaf, arg)) {
+				best = leaf;
+				break;
+			}
+		}
+
+		if (node->plen == 32) {
+			break;
+		}
+	}
+
+	return best;
+}
@@ -20,6 +20,7 @@
 #include <arpa/inet.h>
 
 #include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
 #include <net/skbuff.h>
 #include <net/sock.h>
 
@@ -35,8 +36,12 @@
 #include <net/lib/tcp.h>
 
 #include <kernel/time/timer.h>
+#include <kernel/time/time.h>
 #include <kernel/sched/sched_lock.h>
 #include <kernel/time/ktime.h>
+#include <hal/clock.h>
+
+#include <util/math.h>
 
 #include <kernel/task/resource/idesc.h>
 #include <kernel/task/resource/idesc_event.h>
@@ -50,6 +55,11 @@ EMBOX_NET_PROTO(ETH_P_IPV6, IPPROTO_TCP, tcp_rcv,
 		net_proto_handle_error_none);
 
 #define MODOPS_VERIFY_CHKSUM OPTION_GET(BOOLEAN, verify_chksum)
+#define MODOPS_CONGESTION    OPTION_STRING_GET(congestion)
+
+#define TCP_CWND_MAX (1U << 30) /* Maximum window with scaling (RFC 7323) */
+
+ARRAY_SPREAD_DEF(const struct tcp_cong_ops *const, __tcp_cong_registry);
 
 #if OPTION_GET(NUMBER, log_level) >= LOG_DEBUG
 #define TCP_DEBUG 1
@@ -81,6 +91,8 @@ enum tcp_ret_code {
 						 without outgoing queue using OLD skb*/
 	TCP_RET_SEND_ALLOC, /* send acknowledgment or other packet
 						  without outgoing queue using NEW skb */
+	TCP_RET_ACK,      /* same as TCP_RET_SEND_ALLOC, but acknowledgment
+						 may be delayed */
 	TCP_RET_RST,      /* reset (only for pre_process) */
 	TCP_RET_FREE      /* drop packet and free socket */
 };
@@ -90,14 +102,13 @@ typedef enum tcp_ret_code (*tcp_handler_t)(struct tcp_sock *tcp_sk,
 		const struct tcphdr *tcph, struct sk_buff *skb,
 		struct tcphdr *out_tcph);
 
-static struct sys_timer tcp_tmr_default; /* Timer structure for rexmitting or TIME-WAIT satate */
-
-static void tcp_timer_handler(struct sys_timer *timer, void *param);
-
 /* Prototypes */
 static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb, tcp_handler_t hnd);
 static const tcp_handler_t tcp_st_handler[];
-static void tcp_get_now(struct timeval *out_now);
+static void tcp_timer_arm(struct tcp_sock *tcp_sk);
+static void tcp_xmit_queue(struct tcp_sock *tcp_sk);
+static void process_syn_opt(struct tcp_sock *tcp_sk,
+		const struct tcphdr *tcph);
 
 /************************ Debug functions ******************************/
 #if !TCP_DEBUG
@@ -113,7 +124,7 @@ static inline void packet_print(const struct tcp_sock *tcp_sk,
 	struct timeval now;
 	char buff[INET6_ADDRSTRLEN];
 
-	tcp_get_now(&now);
+	ktime_get_timeval(&now);
 	log_debug("%ld.%ld %s:%d %s sk %p skb %p seq %u ack %u seq_len %u flags %s %s %s %s %s %s %s %s",
 			/* info */
 			now.tv_sec, now.tv_usec,
@@ -182,10 +193,10 @@ void tcp_sock_unlock(struct tcp_sock *tcp_sk, unsigned int obj) {
 
 void tcp_seq_state_set_wind_value(struct tcp_seq_state *tcp_seq_st,
 		uint16_t value) {
-	if (tcp_seq_st->wind.value != value) {
-		tcp_seq_st->wind.value = value;
-		tcp_seq_st->wind.size = value << tcp_seq_st->wind.factor;
-	}
+	/* Size is recomputed even if value is the same: the window of SYN
+	 * segment is never scaled */
+	tcp_seq_st->wind.value = value;
+	tcp_seq_st->wind.size = value << tcp_seq_st->wind.factor;
 }
 
 void tcp_seq_state_set_wind_factor(struct tcp_seq_state *tcp_seq_st,
@@ -196,6 +207,32 @@ void tcp_seq_state_set_wind_factor(struct tcp_seq_state *tcp_seq_st,
 	}
 }
 
+const struct tcp_cong_ops *tcp_cong_lookup(const char *name) {
+	const struct tcp_cong_ops *cong;
+
+	tcp_cong_foreach(cong) {
+		if (0 == strncmp(cong->name, name, TCP_CONG_NAME_MAX)) {
+			return cong;
+		}
+	}
+
+	return NULL;
+}
+
+const struct tcp_cong_ops *tcp_cong_default(void) {
+	const struct tcp_cong_ops *cong;
+
+	cong = tcp_cong_lookup(MODOPS_CONGESTION);
+	if (cong == NULL) {
+		tcp_cong_foreach(cong) {
+			break;
+		}
+	}
+	assert(cong != NULL);
+
+	return cong;
+}
+
 static void tcp_sock_rcv(struct tcp_sock *tcp_sk,
 		struct sk_buff *skb) {
 	size_t seq_off;
@@ -211,31 +248,6 @@ static void tcp_sock_rcv(struct tcp_sock *tcp_sk,
 			tcp_data_length(skb->h.th, skb->nh.raw) - seq_off);
 }
 
-static void tcp_timer_update(void) {
-	bool enable_tcp_timer = false;
-	struct sock *sk;
-	struct tcp_sock *tcp_sk;
-
-	sock_foreach(sk, tcp_sock_ops) {
-		tcp_sk = to_tcp_sock(sk);
-		if ((tcp_sock_get_status(tcp_sk) != TCP_ST_NOTEXIST)) {
-			enable_tcp_timer = true;
-			break;
-		}
-	}
-
-	if (enable_tcp_timer) {
-		if (!timer_is_started(&tcp_tmr_default)) {
-			timer_init_start_msec(&tcp_tmr_default, TIMER_PERIODIC,
-					TCP_TIMER_FREQUENCY, tcp_timer_handler, NULL);
-		}
-	} else {
-		if (timer_is_started(&tcp_tmr_default)) {
-			timer_stop(&tcp_tmr_default);
-		}
-	}
-}
-
 void tcp_sock_set_state(struct tcp_sock *tcp_sk,
 		enum tcp_sock_state new_state) {
 	const char *str_state[TCP_MAX_STATE] = {"TCP_CLOSED",
@@ -258,7 +270,7 @@ void tcp_sock_set_state(struct tcp_sock *tcp_sk,
 		break;
 	case TCP_SYN_SENT:
 	case TCP_SYN_RECV:
-		tcp_get_now(&tcp_sk->syn_time); /* set when SYN sent */
+		tcp_sk->syn_time = clock_sys_ticks(); /* set when SYN sent */
 		/* fallthrough */
 	case TCP_FINWAIT_1:
 	case TCP_LASTACK:
@@ -268,11 +280,11 @@ void tcp_sock_set_state(struct tcp_sock *tcp_sk,
 		break;
 	}
 
-	tcp_timer_update();
-
 	tcp_sk->state = new_state;
 	log_debug("sk %p set state %d-%s", sk, new_state, str_state[new_state]);
 
+	tcp_timer_arm(tcp_sk);
+
 	/* idesc manipulation */
 	switch (new_state) {
 	default:
@@ -332,19 +344,123 @@ int tcp_sock_get_status(struct tcp_sock *tcp_sk) {
 	}
 }
 
-static void tcp_get_now(struct timeval *out_now) {
-	ktime_get_timeval(out_now);
+/************************ Timers ***************************************/
+/**
+ * Every socket has the only one-shot timer for rexmitting, synchronization
+ * timeout and TIME-WAIT state. Events just update timestamps, and the timer
+ * is armed to the earliest deadline. When it fires too early (i.e. deadline
+ * was moved forward) it's re-armed to the new one.
+ */
+
+/* Returns time left (in jiffies) until @a since + @a delay_ms, or 0 */
+static clock_t tcp_time_left(clock_t since, uint32_t delay_ms, clock_t now) {
+	clock_t elapsed, delay;
+
+	elapsed = now - since;
+	delay = ms2jiffies(delay_ms);
+
+	return elapsed < delay ? delay - elapsed : 0;
+}
+
+static int tcp_rexmit_pending(struct tcp_sock *tcp_sk) {
+	return (tcp_sock_get_status(tcp_sk) != TCP_ST_NOTEXIST)
+			&& (tcp_sk->last_ack != tcp_sk->snd_nxt);
 }
 
-static int tcp_is_expired(struct timeval *since, useconds_t limit_msec) {
-	struct timeval now, delta, limit;
+static int tcp_delack_pending(struct tcp_sock *tcp_sk) {
+	return (tcp_sock_get_status(tcp_sk) == TCP_ST_SYNC)
+			&& (tcp_sk->ack_pending != 0);
+}
 
-	ktime_get_timeval(&now);
-	timersub(&now, since, &delta);
-	limit.tv_sec = limit_msec / MSEC_PER_SEC;
-	limit.tv_usec = (limit_msec % MSEC_PER_SEC) * USEC_PER_MSEC;
+static int tcp_sync_pending(struct tcp_sock *tcp_sk) {
+	return (tcp_sock_get_status(tcp_sk) == TCP_ST_NONSYNC)
+			&& !list_empty(&tcp_sk->conn_lnk);
+}
+
+static void tcp_timer_arm(struct tcp_sock *tcp_sk) {
+	clock_t now, left, tmp;
+	int armed;
+
+	now = clock_sys_ticks();
+	armed = 0;
+	left = 0;
+
+	if (tcp_sk->state == TCP_TIMEWAIT) {
+		left = tcp_time_left(tcp_sk->rcv_time, TCP_TIMEWAIT_DELAY, now);
+		armed = 1;
+	}
+	else {
+		if (tcp_sync_pending(tcp_sk)) {
+			left = tcp_time_left(tcp_sk->syn_time, TCP_SYNC_TIMEOUT, now);
+			armed = 1;
+		}
+		if (tcp_rexmit_pending(tcp_sk)) {
+			tmp = tcp_time_left(tcp_sk->ack_time, tcp_sk->rto, now);
+			left = armed && (left < tmp) ? left : tmp;
+			armed = 1;
+		}
+		if (tcp_delack_pending(tcp_sk)) {
+			tmp = tcp_time_left(tcp_sk->delack_time, TCP_DELACK_TIMEOUT, now);
+			left = armed && (left < tmp) ? left : tmp;
+			armed = 1;
+		}
+	}
+
+	if (!armed) {
+		timer_stop(&tcp_sk->timer);
+		return;
+	}
+
+	if (left == 0) {
+		left = 1; /* fire on the next tick */
+	}
 
-	return timercmp(&delta, &limit, >=);
+	/* Nothing to do if the timer fires earlier, it will re-arm itself */
+	if (timer_is_started(&tcp_sk->timer)
+			&& ((long)(tcp_sk->timer_expire - (now + left)) <= 0)) {
+		return;
+	}
+
+	tcp_sk->timer_expire = now + left;
+	timer_start(&tcp_sk->timer, left);
+}
+
+static void tcp_rtt_update(struct tcp_sock *tcp_sk, uint32_t rtt) {
+	int32_t delta;
+
+	if (rtt == 0) {
+		rtt = 1;
+	}
+
+	/* RFC 6298 2.2 and 2.3 with alpha = 1/8 and beta = 1/4 */
+	if (tcp_sk->srtt == 0) {
+		tcp_sk->srtt = rtt << 3;
+		tcp_sk->rttvar = rtt << 1;
+	}
+	else {
+		delta = rtt - (tcp_sk->srtt >> 3);
+		tcp_sk->srtt += delta;
+		if (delta < 0) {
+			delta = -delta;
+		}
+		tcp_sk->rttvar += delta - (tcp_sk->rttvar >> 2);
+	}
+
+	/* RTO = SRTT + 4 * RTTVAR */
+	tcp_sk->rto = (tcp_sk->srtt >> 3) + tcp_sk->rttvar;
+	if (tcp_sk->rto < TCP_RTO_MIN) {
+		tcp_sk->rto = TCP_RTO_MIN;
+	}
+	else if (tcp_sk->rto > TCP_RTO_MAX) {
+		tcp_sk->rto = TCP_RTO_MAX;
+	}
+}
+
+static void tcp_rto_backoff(struct tcp_sock *tcp_sk) {
+	/* Karn's algorithm: don't measure RTT by rexmitted segments */
+	tcp_sk->rtt_active = 0;
+	tcp_sk->rto = tcp_sk->rto < TCP_RTO_MAX / 2 ? tcp_sk->rto << 1
+			: TCP_RTO_MAX;
 }
 
 static void tcp_xmit(struct sk_buff *skb,
@@ -369,12 +485,51 @@ static void tcp_xmit(struct sk_buff *skb,
 	}
 }
 
+/* Checks whether the peer reported [seq, seq + len) as received */
+static int tcp_sacked(const struct tcp_sock *tcp_sk, uint32_t seq,
+		uint32_t len) {
+	const struct tcp_sack_block *blk;
+	unsigned int i;
+
+	for (i = 0; i < tcp_sk->sack_cnt; ++i) {
+		blk = &tcp_sk->sack[i];
+		if ((seq - blk->start <= blk->end - blk->start)
+				&& (seq + len - blk->start <= blk->end - blk->start)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Returns whether the segment was transmitted (i.e. it's below snd_nxt) */
+static int tcp_seg_sent(const struct tcp_sock *tcp_sk,
+		const struct sk_buff *skb) {
+	uint32_t seq_end;
+
+	seq_end = ntohl(skb->h.th->seq)
+			+ tcp_seq_length(skb->h.th, skb->nh.raw);
+	return seq_end - tcp_sk->last_ack <= tcp_sk->snd_nxt - tcp_sk->last_ack;
+}
+
+/**
+ * Rexmit the first sent segment which wasn't selectively acknowledged
+ */
 static void tcp_rexmit(struct tcp_sock *tcp_sk) {
+	struct sk_buff_head *queue;
 	struct sk_buff *skb, *skb_send;
 
 	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 	{
-		skb = skb_queue_front(&to_sock(tcp_sk)->tx_queue);
+		queue = &to_sock(tcp_sk)->tx_queue;
+		skb = skb_queue_front(queue);
+		while ((skb != NULL) && tcp_sacked(tcp_sk, ntohl(skb->h.th->seq),
+					tcp_seq_length(skb->h.th, skb->nh.raw))) {
+			skb = skb_queue_next(skb);
+			if (skb_queue_end(skb, queue) || !tcp_seg_sent(tcp_sk, skb)) {
+				skb = NULL;
+			}
+		}
 		if (skb == NULL) {
 			/**
 			 * TODO
@@ -446,41 +601,254 @@ static void send_rst_reply(struct sk_buff *skb) {
 static void send_nonseq_from_sock(struct tcp_sock *tcp_sk,
 		struct sk_buff *skb) {
 	log_debug("send %p", skb);
-	tcp_set_seq_field(skb->h.th, tcp_sk->self.seq);
+	tcp_set_seq_field(skb->h.th, tcp_sk->snd_nxt);
 	tcp_set_check_field(skb->h.th, skb->nh.raw);
+	if (skb->h.th->ack) {
+		tcp_sk->ack_pending = 0;
+	}
 	tcp_xmit(skb, tcp_sk, NULL);
 }
 
+/**
+ * Send pure acknowledgment of all received data
+ */
+static void tcp_send_ack(struct tcp_sock *tcp_sk) {
+	struct sk_buff *skb;
+
+	skb = NULL;
+	if (0 != alloc_prep_skb(tcp_sk, 0, NULL, &skb)) {
+		return; /* error: see ret */
+	}
+
+	tcp_build(skb->h.th, sock_inet_get_dst_port(to_sock(tcp_sk)),
+			sock_inet_get_src_port(to_sock(tcp_sk)), TCP_MIN_HEADER_SIZE,
+			tcp_sk->self.wind.value);
+	tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
+	send_nonseq_from_sock(tcp_sk, skb);
+}
+
+/**
+ * Decide whether acknowledgment of received data may be postponed
+ * (RFC 1122 4.2.3.2 and RFC 5681 4.2): at least every second full
+ * segment is acknowledged immediately, others wait for outgoing data
+ * or TCP_DELACK_TIMEOUT.
+ */
+static int tcp_ack_delay(struct tcp_sock *tcp_sk) {
+	if (tcp_sk->flags & TCP_F_QUICKACK) {
+		return 0;
+	}
+
+	if (++tcp_sk->ack_pending >= TCP_DELACK_SEGS) {
+		return 0;
+	}
+
+	tcp_sk->delack_time = clock_sys_ticks();
+	tcp_timer_arm(tcp_sk);
+
+	return 1;
+}
+
 /**
  * Send a data, only
  */
 void send_seq_from_sock(struct tcp_sock *tcp_sk, struct sk_buff *skb) {
-	struct sk_buff *skb_send;
-
 	assert(tcp_sk != NULL);
 	assert(skb != NULL);
 
-	skb_send = skb_clone(skb);
-
-	log_debug("send %p = %p", skb, skb_send);
+	log_debug("queue %p", skb);
 
 	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 	{
 		tcp_set_seq_field(skb->h.th, tcp_sk->self.seq);
-		tcp_set_check_field(skb->h.th, skb->nh.raw);
-		if (skb_send != NULL) {
-			/* set to cloned pkg */
-			memcpy(skb_send->h.th, skb->h.th, sizeof *skb->h.th);
-		}
 		assert(to_sock(tcp_sk) != NULL);
 		skb_queue_push(&to_sock(tcp_sk)->tx_queue, skb);
 		tcp_sk->self.seq += tcp_seq_length(skb->h.th, skb->nh.raw);
 	}
 	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 
-	if (skb_send != NULL) {
+	tcp_xmit_queue(tcp_sk);
+}
+
+/**
+ * Checks whether the segment may be sent now. The segment is held if it
+ * doesn't fit in the congestion or the receiver window, or if it's a small
+ * one at the end of the queue while there is unacknowledged data (Nagle
+ * algorithm, RFC 896). Something is always sent when nothing is in flight,
+ * so zero window is probed by rexmit timer.
+ */
+static int tcp_xmit_allowed(struct tcp_sock *tcp_sk, struct sk_buff *skb,
+		uint32_t in_flight, uint32_t seq_len) {
+	uint32_t wnd;
+
+	if (in_flight == 0) {
+		return 1;
+	}
+
+	wnd = min(tcp_sk->snd_cwnd, tcp_sk->rem.wind.size);
+	if (in_flight + seq_len > wnd) {
+		return 0;
+	}
+
+	if (!(tcp_sk->flags & TCP_F_NODELAY) && !skb->h.th->syn
+			&& !skb->h.th->fin && (seq_len < tcp_sk->mss)
+			&& skb_queue_end(skb_queue_next(skb),
+				&to_sock(tcp_sk)->tx_queue)) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Transmit queued segments starting from snd_nxt while the windows
+ * allow it
+ */
+static void tcp_xmit_queue(struct tcp_sock *tcp_sk) {
+	struct sk_buff_head *queue;
+	struct sk_buff *skb, *skb_send;
+	uint32_t in_flight, seq_len;
+	clock_t now;
+
+	queue = &to_sock(tcp_sk)->tx_queue;
+	now = clock_sys_ticks();
+
+	while (1) {
+		tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+		{
+			in_flight = tcp_sk->snd_nxt - tcp_sk->last_ack;
+			if (in_flight == tcp_sk->self.seq - tcp_sk->last_ack) {
+				tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+				break; /* everything is sent */
+			}
+
+			for (skb = skb_queue_front(queue); tcp_seg_sent(tcp_sk, skb);
+					skb = skb_queue_next(skb)) {
+				assert(!skb_queue_end(skb_queue_next(skb), queue));
+			}
+
+			seq_len = tcp_seq_length(skb->h.th, skb->nh.raw);
+			if (!tcp_xmit_allowed(tcp_sk, skb, in_flight, seq_len)) {
+				tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+				break;
+			}
+
+			/* Segment could stay in queue for a while, so refresh
+			 * acknowledgment and window. Data of segments which
+			 * were never sent is not shared with anyone */
+			if (!skb_data_cloned(skb->data)) {
+				if (skb->h.th->ack) {
+					tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
+				}
+				if (!skb->h.th->syn) {
+					skb->h.th->window = htons(tcp_sk->self.wind.value);
+				}
+				tcp_set_check_field(skb->h.th, skb->nh.raw);
+			}
+
+			skb_send = skb_clone(skb);
+			if (skb_send == NULL) {
+				tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+				break; /* rexmit timer sends it later */
+			}
+
+			if (in_flight == 0) {
+				/* rexmit timeout is counted from the first unacked segment */
+				tcp_sk->ack_time = now;
+			}
+			tcp_sk->snd_nxt = ntohl(skb->h.th->seq) + seq_len;
+			if (!tcp_sk->rtt_active && !tcp_sk->rexmit_mode) {
+				tcp_sk->rtt_seq = tcp_sk->snd_nxt;
+				tcp_sk->rtt_time = now;
+				tcp_sk->rtt_active = 1;
+			}
+			if (skb->h.th->ack) {
+				tcp_sk->ack_pending = 0;
+			}
+		}
+		tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+
+		log_debug("send %p = %p", skb, skb_send);
 		tcp_xmit(skb_send, tcp_sk, NULL);
 	}
+
+	tcp_timer_arm(tcp_sk);
+}
+
+void tcp_sock_xmit(struct tcp_sock *tcp_sk) {
+	tcp_xmit_queue(tcp_sk);
+}
+
+/**
+ * Remove the last segment from the write queue if it wasn't sent yet and
+ * may be extended with new data up to @a max_len bytes, so small writes are
+ * coalesced. Sequence space of the segment is returned to the socket.
+ */
+struct sk_buff *tcp_sock_unqueue_tail(struct tcp_sock *tcp_sk,
+		size_t max_len) {
+	struct sk_buff_head *queue;
+	struct sk_buff *skb;
+	size_t data_len;
+
+	queue = &to_sock(tcp_sk)->tx_queue;
+	skb = NULL;
+
+	tcp_sock_lock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+	{
+		if (!skb_queue_empty(queue)) {
+			skb = queue->prev;
+			data_len = tcp_data_length(skb->h.th, skb->nh.raw);
+			if (tcp_seg_sent(tcp_sk, skb) || skb->h.th->syn
+					|| skb->h.th->fin || (data_len >= max_len)
+					|| (TCP_HEADER_SIZE(skb->h.th) != TCP_MIN_HEADER_SIZE)) {
+				skb = NULL;
+			}
+			else {
+				list_del_init((struct list_head *)skb);
+				tcp_sk->self.seq -= data_len;
+			}
+		}
+	}
+	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
+
+	return skb;
+}
+
+/**
+ * Build options of SYN segment: MSS, and if they are enabled window scale
+ * and SACK permission. SYN-ACK contains the last two only if the peer sent
+ * them. Returns length of options (multiple of 4).
+ */
+size_t tcp_sock_syn_opts(struct tcp_sock *tcp_sk, void *opts) {
+	uint8_t *ptr;
+	int passive;
+
+	ptr = opts;
+	passive = (tcp_sk->state == TCP_SYN_RECV_PRE)
+			|| (tcp_sk->state == TCP_SYN_RECV);
+
+	*ptr++ = TCP_OPT_KIND_MSS;
+	*ptr++ = 4;
+	*ptr++ = TCP_MSS_ADVERTISED >> 8;
+	*ptr++ = TCP_MSS_ADVERTISED & 0xff;
+
+	if ((tcp_sk->flags & TCP_F_WSCALE)
+			&& (!passive || (tcp_sk->flags & TCP_F_REM_WSCALE))) {
+		*ptr++ = TCP_OPT_KIND_NOP;
+		*ptr++ = TCP_OPT_KIND_WS;
+		*ptr++ = 3;
+		*ptr++ = TCP_WINDOW_FACTOR_DEFAULT;
+	}
+
+	if ((tcp_sk->flags & TCP_F_SACK)
+			&& (!passive || (tcp_sk->flags & TCP_F_REM_SACK))) {
+		*ptr++ = TCP_OPT_KIND_NOP;
+		*ptr++ = TCP_OPT_KIND_NOP;
+		*ptr++ = TCP_OPT_KIND_SACK;
+		*ptr++ = 2;
+	}
+
+	assert(ptr - (uint8_t *)opts <= TCP_SYN_OPTS_MAX);
+	return ptr - (uint8_t *)opts;
 }
 
 void tcp_sock_release(struct tcp_sock *tcp_sk) {
@@ -491,12 +859,15 @@ void tcp_sock_release(struct tcp_sock *tcp_sk) {
 		{
 			list_for_each_entry(anticipant,
 					&tcp_sk->conn_wait, conn_lnk) {
+				timer_stop(&anticipant->timer);
 				sock_release(to_sock(anticipant));
 			}
 			list_for_each_entry(anticipant, &tcp_sk->conn_ready, conn_lnk) {
+				timer_stop(&anticipant->timer);
 				sock_release(to_sock(anticipant));
 			}
 			list_for_each_entry(anticipant, &tcp_sk->conn_free, conn_lnk) {
+				timer_stop(&anticipant->timer);
 				sock_release(to_sock(anticipant));
 			}
 		}
@@ -514,9 +885,8 @@ void tcp_sock_release(struct tcp_sock *tcp_sk) {
 		tcp_sock_unlock(tcp_sk->parent, TCP_SYNC_CONN_QUEUE);
 	}
 
+	timer_stop(&tcp_sk->timer);
 	sock_release(to_sock(tcp_sk));
-
-	tcp_timer_update();
 }
 
 
@@ -595,6 +965,11 @@ static enum tcp_ret_code tcp_st_listen(struct tcp_sock *tcp_sk,
 					&ip6_hdr(skb)->saddr,
 					sizeof newsk.in6->dst_in6.sin6_addr);
 		}
+		sock_rehash(to_sock(tcp_newsk));
+		/* Inherit options of listening socket */
+		tcp_newsk->flags = tcp_sk->flags & TCP_F_USER_MASK;
+		tcp_newsk->cong = tcp_sk->cong;
+		tcp_newsk->cong->init(tcp_newsk);
 		/* Save new socket to accept queue */
 		tcp_sock_lock(tcp_sk, TCP_SYNC_CONN_QUEUE);
 		{
@@ -624,8 +999,7 @@ static enum tcp_ret_code tcp_st_syn_sent(struct tcp_sock *tcp_sk,
 
 	if (tcph->syn) {
 		tcp_sk->rem.seq = ntohl(tcph->seq) + 1;
-		tcp_seq_state_set_wind_value(&tcp_sk->rem,
-				ntohs(tcph->window));
+		process_syn_opt(tcp_sk, tcph);
 		if (tcph->ack) {
 			tcp_sock_set_state(tcp_sk, TCP_ESTABIL);
 		} else {
@@ -646,10 +1020,11 @@ static enum tcp_ret_code tcp_st_syn_recv_pre(
 
 	if (tcph->syn) {
 		tcp_sk->rem.seq = ntohl(tcph->seq) + 1;
-		tcp_seq_state_set_wind_value(&tcp_sk->rem,
-				ntohs(tcph->window));
+		process_syn_opt(tcp_sk, tcph);
 		tcp_sock_set_state(tcp_sk, TCP_SYN_RECV);
 		out_tcph->syn = 1;
+		out_tcph->doff = (TCP_MIN_HEADER_SIZE
+				+ tcp_sock_syn_opts(tcp_sk, &out_tcph->options[0])) / 4;
 		tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
 		return TCP_RET_SEND_SEQ;
 	}
@@ -683,10 +1058,12 @@ static enum tcp_ret_code tcp_st_estabil(struct tcp_sock *tcp_sk,
 		log_debug("\t received %d", data_len);
 		tcp_sock_rcv(tcp_sk, skb);
 		tcp_sk->rem.seq += data_len;
-		if (tcph->fin) {
-			tcp_sk->rem.seq += 1;
-			tcp_sock_set_state(tcp_sk, TCP_CLOSEWAIT);
+		tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
+		if (!tcph->fin) {
+			return TCP_RET_ACK;
 		}
+		tcp_sk->rem.seq += 1;
+		tcp_sock_set_state(tcp_sk, TCP_CLOSEWAIT);
 		tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
 		return TCP_RET_SEND_ALLOC;
 	} else if (tcph->fin) {
@@ -878,8 +1255,88 @@ static void confirm_ack(struct tcp_sock *tcp_sk, uint32_t ack) {
 	tcp_sock_unlock(tcp_sk, TCP_SYNC_WRITE_QUEUE);
 }
 
+static void tcp_cwnd_ack(struct tcp_sock *tcp_sk, uint32_t acked) {
+	tcp_sk->cong->cong_avoid(tcp_sk, acked);
+	if (tcp_sk->snd_cwnd > TCP_CWND_MAX) {
+		tcp_sk->snd_cwnd = TCP_CWND_MAX;
+	}
+}
+
+static int tcp_recover_acked(struct tcp_sock *tcp_sk) {
+	return (int32_t)(tcp_sk->last_ack - tcp_sk->recover) >= 0;
+}
+
+/**
+ * Fast retransmit and fast recovery (RFC 5681 3.2, RFC 6582)
+ */
+static void tcp_dup_ack(struct tcp_sock *tcp_sk) {
+	switch (tcp_sk->rexmit_mode) {
+	case TCP_REXMIT_FAST:
+		/* Each duplicate means segment has left the network */
+		tcp_sk->snd_cwnd += tcp_sk->mss;
+		return;
+	case TCP_REXMIT_RTO:
+		return;
+	}
+
+	if (++tcp_sk->dup_ack != TCP_REXMIT_DUP_ACK) {
+		return;
+	}
+
+	/* Don't enter recovery twice for the same loss (RFC 6582 4.1) */
+	if (!tcp_recover_acked(tcp_sk)) {
+		return;
+	}
+
+	tcp_sk->snd_ssthresh = tcp_sk->cong->ssthresh(tcp_sk);
+	tcp_sk->snd_cwnd = tcp_sk->snd_ssthresh
+			+ TCP_REXMIT_DUP_ACK * tcp_sk->mss;
+	tcp_sk->recover = tcp_sk->snd_nxt;
+	tcp_sk->rexmit_mode = TCP_REXMIT_FAST;
+	tcp_sk->rtt_active = 0;
+	tcp_rexmit(tcp_sk);
+}
+
+static void tcp_new_ack(struct tcp_sock *tcp_sk, uint32_t acked) {
+	uint32_t flight;
+
+	switch (tcp_sk->rexmit_mode) {
+	case TCP_REXMIT_NONE:
+		tcp_sk->dup_ack = 0;
+		tcp_cwnd_ack(tcp_sk, acked);
+		break;
+	case TCP_REXMIT_FAST:
+		if (tcp_recover_acked(tcp_sk)) {
+			/* Full acknowledgment: deflate the window */
+			flight = tcp_sk->snd_nxt - tcp_sk->last_ack;
+			tcp_sk->snd_cwnd = min(tcp_sk->snd_ssthresh,
+					max(flight, tcp_sk->mss) + tcp_sk->mss);
+			tcp_sk->rexmit_mode = TCP_REXMIT_NONE;
+			tcp_sk->dup_ack = 0;
+		}
+		else {
+			/* Partial acknowledgment: the next segment is lost too */
+			tcp_rexmit(tcp_sk);
+			tcp_sk->snd_cwnd -= min(acked, tcp_sk->snd_cwnd);
+			if (acked >= tcp_sk->mss) {
+				tcp_sk->snd_cwnd += tcp_sk->mss;
+			}
+			tcp_sk->snd_cwnd = max(tcp_sk->snd_cwnd, tcp_sk->mss);
+		}
+		break;
+	case TCP_REXMIT_RTO:
+		/* Slow start while segments are rexmitted by go-back-N */
+		tcp_cwnd_ack(tcp_sk, acked);
+		if (tcp_recover_acked(tcp_sk)) {
+			tcp_sk->rexmit_mode = TCP_REXMIT_NONE;
+			tcp_sk->dup_ack = 0;
+		}
+		break;
+	}
+}
+
 static enum tcp_ret_code process_ack(struct tcp_sock *tcp_sk,
-		const struct tcphdr *tcph) {
+		const struct tcphdr *tcph, const struct sk_buff *skb) {
 	uint32_t ack, ack2last_ack, seq;
 
 	/* Resetting if recv ack in this state */
@@ -896,33 +1353,29 @@ static enum tcp_ret_code process_ack(struct tcp_sock *tcp_sk,
 	seq = tcp_sk->self.seq;
 
 	if (ack2last_ack == 0) {
-		/* no new acknowledgments */
-		if ((seq != ack) && !tcp_sk->rexmit_mode) {
-			++tcp_sk->dup_ack;
-			if (tcp_sk->dup_ack == TCP_REXMIT_DUP_ACK) {
-				tcp_sk->rexmit_mode = 1;
-				tcp_rexmit(tcp_sk);
-			}
+		/* no new acknowledgments, it's duplicate if it's pure
+		 * acknowledgment while some data is in flight */
+		if ((tcp_sk->snd_nxt != ack) && !tcph->syn && !tcph->fin
+				&& (tcp_data_length(tcph, skb->nh.raw) == 0)) {
+			tcp_dup_ack(tcp_sk);
 		}
 	}
 	else if (ack2last_ack <= seq - tcp_sk->last_ack) {
 		confirm_ack(tcp_sk, ack);
 		tcp_sk->last_ack = ack;
-		tcp_get_now(&tcp_sk->ack_time);
-		if (!tcp_sk->rexmit_mode) {
-			tcp_sk->dup_ack = 0;
-			sock_notify(to_sock(tcp_sk), POLLOUT);
+		if (tcp_sk->snd_nxt - ack > seq - ack) {
+			/* Segments rexmitted by go-back-N were received before */
+			tcp_sk->snd_nxt = ack;
 		}
-		else {
-			if (seq == ack) {
-				tcp_sk->rexmit_mode = 0;
-				tcp_sk->dup_ack = 0;
-				sock_notify(to_sock(tcp_sk), POLLOUT);
-			}
-			else {
-				tcp_rexmit(tcp_sk);
-			}
+		tcp_sk->ack_time = clock_sys_ticks();
+		if (tcp_sk->rtt_active && (ack - tcp_sk->rtt_seq
+					<= seq - tcp_sk->rtt_seq)) {
+			tcp_sk->rtt_active = 0;
+			tcp_rtt_update(tcp_sk, jiffies2ms(tcp_sk->ack_time
+						- tcp_sk->rtt_time));
 		}
+		tcp_new_ack(tcp_sk, ack2last_ack);
+		sock_notify(to_sock(tcp_sk), POLLOUT);
 	}
 	else if (ack - seq <= ack2last_ack) {
 		/* package with non-last acknowledgment */
@@ -986,37 +1439,127 @@ static inline int tcp_opt_process(struct tcphdr *tcph, struct tcphdr *otcph, str
 }
 #endif
 
-static enum tcp_ret_code process_opt(struct tcp_sock *tcp_sk,
-		const struct tcphdr *tcph) {
-	char *ptr = (char *)&tcph->options[0];
-	char *end = ptr + TCP_HEADER_SIZE(tcph) - TCP_MIN_HEADER_SIZE;
-	char *prev_ptr;
+/**
+ * Returns the next option of @a tcph after @a opt (the first one if
+ * @a opt is NULL) or NULL. NOP and malformed options are skipped.
+ */
+static const uint8_t *tcp_opt_next(const struct tcphdr *tcph,
+		const uint8_t *opt) {
+	const uint8_t *end;
 
-	do {
-		prev_ptr = ptr;
-		switch (*ptr) {
-		default:
-			ptr += *(ptr + 1);
+	end = (const uint8_t *)tcph + TCP_HEADER_SIZE(tcph);
+	opt = opt == NULL ? (const uint8_t *)&tcph->options[0] : opt + opt[1];
+
+	while (opt < end) {
+		if (opt[0] == TCP_OPT_KIND_EOL) {
 			break;
-		case TCP_OPT_KIND_NOP:
-			++ptr;
+		}
+		else if (opt[0] == TCP_OPT_KIND_NOP) {
+			++opt;
+		}
+		else if ((opt + 1 >= end) || (opt[1] < 2) || (opt + opt[1] > end)) {
+			break;
+		}
+		else {
+			return opt;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Process options of SYN segment and negotiate window scaling (RFC 7323)
+ * and SACK (RFC 2018). Window of SYN segment is never scaled.
+ */
+static void process_syn_opt(struct tcp_sock *tcp_sk,
+		const struct tcphdr *tcph) {
+	const uint8_t *opt;
+	uint8_t rem_factor;
+
+	tcp_sk->mss = TCP_MSS_DEFAULT;
+	tcp_sk->flags &= ~(TCP_F_REM_WSCALE | TCP_F_REM_SACK);
+	rem_factor = 0;
+
+	for (opt = tcp_opt_next(tcph, NULL); opt != NULL;
+			opt = tcp_opt_next(tcph, opt)) {
+		switch (opt[0]) {
+		case TCP_OPT_KIND_MSS:
+			if ((opt[1] == 4) && ((opt[2] << 8 | opt[3]) != 0)) {
+				tcp_sk->mss = opt[2] << 8 | opt[3];
+			}
 			break;
 		case TCP_OPT_KIND_WS:
-			if (*(ptr + 1) == 3) {
-				tcp_seq_state_set_wind_factor(&tcp_sk->rem,
-						*(ptr + 2));
+			if (opt[1] == 3) {
+				tcp_sk->flags |= TCP_F_REM_WSCALE;
+				rem_factor = min(opt[2], TCP_WINDOW_FACTOR_MAX);
+			}
+			break;
+		case TCP_OPT_KIND_SACK:
+			if (opt[1] == 2) {
+				tcp_sk->flags |= TCP_F_REM_SACK;
 			}
-			ptr += *(ptr + 1);
 			break;
 		}
-		// TODO this is hack to fix cycling when ptr does not change
-		if (prev_ptr == ptr) {
-			++ptr;
-		}
-	} while (ptr < end);
+	}
 
-	// TODO revert this comment
-	//assert(ptr == end);
+	if ((tcp_sk->flags & TCP_F_WSCALE)
+			&& (tcp_sk->flags & TCP_F_REM_WSCALE)) {
+		tcp_seq_state_set_wind_factor(&tcp_sk->self,
+				TCP_WINDOW_FACTOR_DEFAULT);
+	}
+	else {
+		tcp_seq_state_set_wind_factor(&tcp_sk->self, 0);
+		rem_factor = 0;
+	}
+	tcp_sk->rem.wind.factor = rem_factor;
+	tcp_sk->rem.wind.value = ntohs(tcph->window);
+	tcp_sk->rem.wind.size = tcp_sk->rem.wind.value;
+
+	/* Initial window (RFC 3390) */
+	tcp_sk->snd_cwnd = min(4 * tcp_sk->mss,
+			max(2 * tcp_sk->mss, 4380));
+	tcp_sk->snd_ssthresh = TCP_CWND_MAX;
+	tcp_sk->sack_cnt = 0;
+}
+
+/**
+ * Options of synchronized connection: only SACK blocks are used. Blocks
+ * below the cumulative acknowledgment are useless and skipped.
+ */
+static enum tcp_ret_code process_opt(struct tcp_sock *tcp_sk,
+		const struct tcphdr *tcph) {
+	const uint8_t *opt;
+	struct tcp_sack_block *blk;
+	uint32_t ack;
+	int i, n;
+
+	tcp_sk->sack_cnt = 0;
+	if (!(tcp_sk->flags & TCP_F_SACK)
+			|| !(tcp_sk->flags & TCP_F_REM_SACK) || !tcph->ack) {
+		return TCP_RET_OK;
+	}
+
+	ack = ntohl(tcph->ack_seq);
+	for (opt = tcp_opt_next(tcph, NULL); opt != NULL;
+			opt = tcp_opt_next(tcph, opt)) {
+		if (opt[0] != TCP_OPT_KIND_SACK_BLOCKS) {
+			continue;
+		}
+		n = (opt[1] - 2) / 8;
+		for (i = 0; (i < n) && (tcp_sk->sack_cnt < TCP_SACK_BLOCKS_MAX);
+				++i) {
+			blk = &tcp_sk->sack[tcp_sk->sack_cnt];
+			memcpy(&blk->start, opt + 2 + i * 8, sizeof blk->start);
+			memcpy(&blk->end, opt + 6 + i * 8, sizeof blk->end);
+			blk->start = ntohl(blk->start);
+			blk->end = ntohl(blk->end);
+			if ((blk->end - ack <= tcp_sk->snd_nxt - ack)
+					&& (blk->start - ack < blk->end - ack)) {
+				++tcp_sk->sack_cnt;
+			}
+		}
+	}
 
 	return TCP_RET_OK;
 }
@@ -1071,8 +1614,12 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 				 * correct sequence number), but some packages
 				 * was lost. We should save this skb, and wait
 				 * previous packages.
+				 * Until then send duplicate acknowledgment at once,
+				 * so the sender could rexmit lost one without
+				 * waiting for timeout (RFC 5681 4.2).
 				 */
-				return TCP_RET_DROP;
+				tcp_set_ack_field(out_tcph, tcp_sk->rem.seq);
+				return TCP_RET_SEND;
 			}
 		}
 		else if ((seq_last2rem_seq != 0)
@@ -1094,9 +1641,17 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 		break;
 	}
 
+	/* Process options (SYN options are processed by state handlers) */
+	if (!tcph->syn) {
+		ret = process_opt(tcp_sk, tcph);
+		if (ret != TCP_RET_OK) {
+			return ret;
+		}
+	}
+
 	/* Porcess ACK */
 	if (tcph->ack) {
-		ret = process_ack(tcp_sk, tcph);
+		ret = process_ack(tcp_sk, tcph, skb);
 		if (ret != TCP_RET_OK) {
 			return ret;
 		}
@@ -1109,17 +1664,11 @@ static enum tcp_ret_code pre_process(struct tcp_sock *tcp_sk,
 	case TCP_ST_SYNC:
 		tcp_seq_state_set_wind_value(&tcp_sk->rem,
 				ntohs(tcph->window));
+		/* Acknowledgment or window update may allow to send more */
+		tcp_xmit_queue(tcp_sk);
 		break;
 	}
 
-	/* Process options */
-	if (TCP_HEADER_SIZE(tcph) != TCP_MIN_HEADER_SIZE) {
-		ret = process_opt(tcp_sk, tcph);
-		if (ret != TCP_RET_OK) {
-			return ret;
-		}
-	}
-
 	return TCP_RET_OK;
 }
 
@@ -1144,10 +1693,13 @@ static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb,
 	/* If result is not TCP_RET_OK then further processing
 	 * can't be made */
 	enum tcp_ret_code ret;
-	struct tcphdr out_tcph;
+	union {
+		struct tcphdr th;
+		uint8_t raw[TCP_MIN_HEADER_SIZE + TCP_SYN_OPTS_MAX];
+	} out;
 	struct sk_buff *out_skb;
 
-	tcp_build(&out_tcph, skb->h.th->source, skb->h.th->dest,
+	tcp_build(&out.th, skb->h.th->source, skb->h.th->dest,
 			TCP_MIN_HEADER_SIZE, tcp_sk->self.wind.value);
 	out_skb = NULL;
 
@@ -1164,7 +1716,10 @@ static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb,
 
 	tcp_sock_lock(tcp_sk, TCP_SYNC_STATE);
 	{
-		ret = hnd(tcp_sk, skb->h.th, skb, &out_tcph);
+		ret = hnd(tcp_sk, skb->h.th, skb, &out.th);
+		if (ret == TCP_RET_ACK) {
+			ret = tcp_ack_delay(tcp_sk) ? TCP_RET_OK : TCP_RET_SEND_ALLOC;
+		}
 	}
 	tcp_sock_unlock(tcp_sk, TCP_SYNC_STATE);
 
@@ -1192,10 +1747,12 @@ static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb,
 		/* fallthrough */
 	case TCP_RET_SEND_ALLOC:
 		out_skb = ret != TCP_RET_SEND_ALLOC ? skb : NULL;
-		if (0 != alloc_prep_skb(tcp_sk, 0, NULL, &out_skb)) {
+		if (0 != alloc_prep_skb(tcp_sk,
+					TCP_HEADER_SIZE(&out.th) - TCP_MIN_HEADER_SIZE,
+					NULL, &out_skb)) {
 			return TCP_RET_DROP; /* error: see ret */
 		}
-		memcpy(out_skb->h.th, &out_tcph, sizeof out_tcph);
+		memcpy(out_skb->h.th, &out, TCP_HEADER_SIZE(&out.th));
 		if (ret == TCP_RET_SEND_SEQ) {
 			send_seq_from_sock(tcp_sk, out_skb);
 		}
@@ -1204,6 +1761,7 @@ static int tcp_handle(struct tcp_sock *tcp_sk, struct sk_buff *skb,
 		}
 		break;
 	case TCP_RET_RST: /* this processing in tcp_process */
+	case TCP_RET_ACK:
 	case TCP_RET_OK:
 		break;
 	}
@@ -1219,7 +1777,7 @@ static void tcp_process(struct tcp_sock *tcp_sk, struct sk_buff *skb) {
 	if (tcp_sk != NULL) {
 		enum tcp_ret_code ret;
 
-		tcp_get_now(&tcp_sk->rcv_time);
+		tcp_sk->rcv_time = clock_sys_ticks();
 
 		ret = tcp_handle(tcp_sk, skb, pre_process);
 		if (ret == TCP_RET_OK) {
@@ -1309,17 +1867,23 @@ static int tcp_rcv(struct sk_buff *skb) {
 	assert(ip_check_version(ip_hdr(skb))
 			|| ip6_check_version(ip6_hdr(skb)));
 
-	sk = sock_lookup(NULL, tcp_sock_ops,
-			ip_check_version(ip_hdr(skb))
-				? tcp4_rcv_tester_strict
-				: tcp6_rcv_tester_strict,
-			skb);
-	if (sk == NULL) {
-		sk = sock_lookup(NULL, tcp_sock_ops,
-				ip_check_version(ip_hdr(skb))
-					? tcp4_rcv_tester_soft
-					: tcp6_rcv_tester_soft,
-				skb);
+	if (ip_check_version(ip_hdr(skb))) {
+		sk = sock_lookup_established(tcp_sock_ops, tcp4_rcv_tester_strict,
+				skb, &ip_hdr(skb)->saddr, sizeof ip_hdr(skb)->saddr,
+				tcp_hdr(skb)->dest, tcp_hdr(skb)->source);
+		if (sk == NULL) {
+			sk = sock_lookup_listener(tcp_sock_ops, tcp4_rcv_tester_soft,
+					skb, tcp_hdr(skb)->dest);
+		}
+	}
+	else {
+		sk = sock_lookup_established(tcp_sock_ops, tcp6_rcv_tester_strict,
+				skb, &ip6_hdr(skb)->saddr, sizeof ip6_hdr(skb)->saddr,
+				tcp_hdr(skb)->dest, tcp_hdr(skb)->source);
+		if (sk == NULL) {
+			sk = sock_lookup_listener(tcp_sock_ops, tcp6_rcv_tester_soft,
+					skb, tcp_hdr(skb)->dest);
+		}
 	}
 
 	tcp_sk = sk != NULL ? to_tcp_sock(sk) : NULL;
@@ -1347,35 +1911,71 @@ static int tcp_rcv(struct sk_buff *skb) {
 }
 
 static void tcp_timer_handler(struct sys_timer *timer, void *param) {
-	struct sock *sk = NULL;
 	struct tcp_sock *tcp_sk;
+	clock_t now;
 
 	(void)timer;
-	(void)param;
 
-	sock_foreach(sk, tcp_sock_ops) {
-		tcp_sk = to_tcp_sock(sk);
-		if ((tcp_sk->state == TCP_TIMEWAIT)
-				&& tcp_is_expired(&tcp_sk->rcv_time, TCP_TIMEWAIT_DELAY)) {
+	tcp_sk = param;
+	assert(tcp_sk != NULL);
+
+	now = clock_sys_ticks();
 
+	if (tcp_sk->state == TCP_TIMEWAIT) {
+		if (0 == tcp_time_left(tcp_sk->rcv_time, TCP_TIMEWAIT_DELAY, now)) {
 			log_debug("release timewait sk %p", to_sock(tcp_sk));
 			tcp_sock_release(tcp_sk);
+			return;
 		}
-		else if ((tcp_sock_get_status(tcp_sk) == TCP_ST_NONSYNC)
-				&& !list_empty(&tcp_sk->conn_lnk)
-				&& tcp_is_expired(&tcp_sk->syn_time, TCP_SYNC_TIMEOUT)) {
-
-			assert(tcp_sk->parent != NULL);
-			log_debug("release nonsync sk %p", to_sock(tcp_sk));
-			tcp_sock_release(tcp_sk);
+	}
+	else if (tcp_sync_pending(tcp_sk)
+			&& (0 == tcp_time_left(tcp_sk->syn_time, TCP_SYNC_TIMEOUT, now))) {
+		assert(tcp_sk->parent != NULL);
+		log_debug("release nonsync sk %p", to_sock(tcp_sk));
+		tcp_sock_release(tcp_sk);
+		return;
+	}
+	else if (tcp_rexmit_pending(tcp_sk)
+			&& (0 == tcp_time_left(tcp_sk->ack_time, tcp_sk->rto, now))) {
+		log_debug("rexmit sk %p rto %u", to_sock(tcp_sk), tcp_sk->rto);
+		/* RFC 5681 3.1: ssthresh isn't reduced again when the same
+		 * segment is rexmitted several times */
+		if (tcp_sk->rexmit_mode != TCP_REXMIT_RTO) {
+			tcp_sk->snd_ssthresh = tcp_sk->cong->ssthresh(tcp_sk);
 		}
-		else if ((tcp_sock_get_status(tcp_sk) != TCP_ST_NOTEXIST)
-				&& tcp_is_expired(&tcp_sk->ack_time, TCP_REXMIT_DELAY)
-				&& (tcp_sk->last_ack != tcp_sk->self.seq)) {
-
-			log_debug("rexmit sk %p", to_sock(tcp_sk));
-			tcp_sk->rexmit_mode = 1;
-			tcp_rexmit(tcp_sk);
+		if ((tcp_sk->rexmit_mode != TCP_REXMIT_RTO)
+				|| ((int32_t)(tcp_sk->snd_nxt - tcp_sk->recover) > 0)) {
+			tcp_sk->recover = tcp_sk->snd_nxt;
 		}
+		tcp_sk->rexmit_mode = TCP_REXMIT_RTO;
+		tcp_sk->snd_cwnd = tcp_sk->mss;
+		tcp_sk->dup_ack = 0;
+		tcp_sk->sack_cnt = 0;
+		/* Go-back-N: everything after the lost segment is sent again */
+		tcp_sk->snd_nxt = tcp_sk->last_ack;
+		tcp_sk->ack_time = now;
+		tcp_rto_backoff(tcp_sk);
+		tcp_xmit_queue(tcp_sk);
 	}
+
+	if (tcp_delack_pending(tcp_sk)
+			&& (0 == tcp_time_left(tcp_sk->delack_time,
+					TCP_DELACK_TIMEOUT, now))) {
+		tcp_send_ack(tcp_sk);
+	}
+
+	tcp_timer_arm(tcp_sk);
+}
+
+void tcp_sock_timer_init(struct tcp_sock *tcp_sk) {
+	assert(tcp_sk != NULL);
+
+	timer_init(&tcp_sk->timer, TIMER_ONESHOT, tcp_timer_handler, tcp_sk);
+	tcp_sk->timer_expire = 0;
+	tcp_sk->syn_time = tcp_sk->ack_time = tcp_sk->rcv_time = 0;
+	tcp_sk->srtt = tcp_sk->rttvar = 0;
+	tcp_sk->rto = TCP_RTO_INITIAL;
+	tcp_sk->rtt_active = 0;
+	tcp_sk->ack_pending = 0;
+	tcp_sk->delack_time = 0;
 }
@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief NewReno congestion control (RFC 5681, RFC 6582).
+ *
+ * @date 18.10.2026
+ */
+
+#include <stdint.h>
+
+#include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
+
+/* Bytes acknowledged since the last congestion window increase */
+#define NEWRENO_ACKED(tcp_sk) ((tcp_sk)->cong_priv[0])
+
+static void newreno_init(struct tcp_sock *tcp_sk) {
+	NEWRENO_ACKED(tcp_sk) = 0;
+}
+
+static void newreno_cong_avoid(struct tcp_sock *tcp_sk, uint32_t acked) {
+	if (tcp_sk->snd_cwnd < tcp_sk->snd_ssthresh) {
+		/* Slow start with appropriate byte counting (RFC 3465, L = 2) */
+		tcp_sk->snd_cwnd += acked < 2 * tcp_sk->mss ? acked
+				: 2 * tcp_sk->mss;
+		return;
+	}
+
+	/* Congestion avoidance: one segment per window of acknowledged data */
+	NEWRENO_ACKED(tcp_sk) += acked;
+	if (NEWRENO_ACKED(tcp_sk) >= tcp_sk->snd_cwnd) {
+		NEWRENO_ACKED(tcp_sk) -= tcp_sk->snd_cwnd;
+		tcp_sk->snd_cwnd += tcp_sk->mss;
+	}
+}
+
+static uint32_t newreno_ssthresh(struct tcp_sock *tcp_sk) {
+	uint32_t flight;
+
+	NEWRENO_ACKED(tcp_sk) = 0;
+
+	/* RFC 5681 (4): ssthresh = max(FlightSize / 2, 2 * SMSS) */
+	flight = tcp_sk->snd_nxt - tcp_sk->last_ack;
+	return flight / 2 > 2 * tcp_sk->mss ? flight / 2 : 2 * tcp_sk->mss;
+}
+
+static const struct tcp_cong_ops tcp_newreno = {
+	.name       = "newreno",
+	.init       = newreno_init,
+	.cong_avoid = newreno_cong_avoid,
+	.ssthresh   = newreno_ssthresh,
+};
+
+TCP_CONG_OPS_DEF(tcp_newreno);
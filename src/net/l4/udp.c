@@ -23,6 +23,8 @@
 #include <net/socket/inet_sock.h>
 
 #include <net/netdevice.h>
+#include <net/util/checksum.h>
+#include <util/math.h>
 #include <framework/mod/options.h>
 
 #include <net/lib/ipv4.h>
@@ -30,7 +32,7 @@
 
 #define MODOPS_VERIFY_CHKSUM OPTION_GET(BOOLEAN, verify_chksum)
 
-EMBOX_NET_PROTO(ETH_P_IP, IPPROTO_UDP, udp_rcv, udp_err);
+EMBOX_NET_PROTO_LIST(ETH_P_IP, IPPROTO_UDP, udp_rcv, udp_rcv_list, udp_err);
 EMBOX_NET_PROTO(ETH_P_IPV6, IPPROTO_UDP, udp_rcv,
 		net_proto_handle_error_none);
 
@@ -78,6 +80,84 @@ static int udp6_accept_dst(const struct sock *sk,
 				|| (sk->opt.so_bindtodevice == NULL));
 }
 
+static struct sock * udp_lookup(const struct sk_buff *skb) {
+	struct sock *sk;
+
+	/* Connected sockets take precedence over bound-only ones */
+	if (ip_check_version(ip_hdr(skb))) {
+		sk = sock_lookup_established(udp_sock_ops, udp4_rcv_tester, skb,
+				&ip_hdr(skb)->saddr, sizeof ip_hdr(skb)->saddr,
+				udp_hdr(skb)->dest, udp_hdr(skb)->source);
+		if (sk == NULL) {
+			sk = sock_lookup_listener(udp_sock_ops, udp4_rcv_tester, skb,
+					udp_hdr(skb)->dest);
+		}
+	}
+	else {
+		sk = sock_lookup_established(udp_sock_ops, udp6_rcv_tester, skb,
+				&ip6_hdr(skb)->saddr, sizeof ip6_hdr(skb)->saddr,
+				udp_hdr(skb)->dest, udp_hdr(skb)->source);
+		if (sk == NULL) {
+			sk = sock_lookup_listener(udp_sock_ops, udp6_rcv_tester, skb,
+					udp_hdr(skb)->dest);
+		}
+	}
+
+	return sk;
+}
+
+/* Datagram was reassembled from IPv4 fragments, so it's summed piece by
+ * piece without gathering */
+static uint16_t udp4_chksum_nonlinear(struct sk_buff *skb) {
+	struct ip_pseudohdr ipph;
+	unsigned long sum, part;
+	unsigned char *ptr;
+	size_t off, end, len;
+	int odd;
+
+	ip_pseudo_build(ip_hdr(skb), &ipph);
+	sum = partial_sum(&ipph, sizeof ipph);
+
+	odd = 0;
+	off = skb->h.raw - skb->mac.raw;
+	end = min(off + ntohs(ipph.data_len), skb->len);
+	for (; off < end; off += len) {
+		ptr = skb_chunk(skb, off, &len);
+		len = min(len, end - off);
+
+		part = fold_short(partial_sum(ptr, len));
+		if (odd) {
+			/* Piece starts at odd position, so its bytes are swapped */
+			part = ((part & 0xFF) << 8) | (part >> 8);
+		}
+		sum += part;
+		odd ^= len & 1;
+	}
+
+	return ~fold_short(sum) & 0xFFFF;
+}
+
+static int udp_check_chksum(struct sk_buff *skb) {
+	uint16_t old_check;
+
+	if (!MODOPS_VERIFY_CHKSUM) {
+		return 1;
+	}
+
+	if (skb_is_nonlinear(skb)) {
+		old_check = skb->h.uh->check;
+		skb->h.uh->check = 0;
+		skb->h.uh->check = udp4_chksum_nonlinear(skb);
+
+		return old_check == skb->h.uh->check;
+	}
+
+	old_check = skb->h.uh->check;
+	udp_set_check_field(skb->h.uh, skb->nh.raw);
+
+	return old_check == skb->h.uh->check;
+}
+
 static int udp_rcv(struct sk_buff *skb) {
 	struct sock *sk;
 
@@ -86,19 +166,12 @@ static int udp_rcv(struct sk_buff *skb) {
 			|| ip6_check_version(ip6_hdr(skb)));
 
 	/* Check CRC */
-	if (MODOPS_VERIFY_CHKSUM) {
-		uint16_t old_check;
-		old_check = skb->h.uh->check;
-		udp_set_check_field(skb->h.uh, skb->nh.raw);
-		if (old_check != skb->h.uh->check) {
-			return 0; /* error: bad checksum */
-		}
+	if (!udp_check_chksum(skb)) {
+		skb_free(skb);
+		return 0; /* error: bad checksum */
 	}
 
-	sk = sock_lookup(NULL, udp_sock_ops,
-			ip_check_version(ip_hdr(skb))
-				? udp4_rcv_tester : udp6_rcv_tester,
-			skb);
+	sk = udp_lookup(skb);
 	if (sk != NULL) {
 		if (ip_check_version(ip_hdr(skb))
 				? udp4_accept_dst(sk, skb)
@@ -117,6 +190,43 @@ static int udp_rcv(struct sk_buff *skb) {
 	return 0;
 }
 
+/* All datagrams of the list belong to one IPv4 flow, so the socket is
+ * looked up only once */
+static int udp_rcv_list(struct sk_buff_head *list) {
+	struct sk_buff *skb;
+	struct sock *sk;
+	int looked_up, accepted;
+
+	looked_up = accepted = 0;
+	sk = NULL;
+
+	while ((skb = __skb_queue_pop(list)) != NULL) {
+		assert(ip_check_version(ip_hdr(skb)));
+
+		if (!udp_check_chksum(skb)) {
+			skb_free(skb);
+			continue; /* error: bad checksum */
+		}
+
+		if (!looked_up) {
+			sk = udp_lookup(skb);
+			accepted = (sk != NULL) && udp4_accept_dst(sk, skb);
+			looked_up = 1;
+		}
+
+		if (sk == NULL) {
+			icmp_discard(skb, ICMP_DEST_UNREACH, ICMP_PORT_UNREACH);
+		} else if (accepted) {
+			sock_rcv(sk, skb, skb->h.raw + UDP_HEADER_SIZE,
+					udp_data_length(udp_hdr(skb)));
+		} else {
+			skb_free(skb);
+		}
+	}
+
+	return 0;
+}
+
 static int udp_err_tester(const struct sock *sk,
 		const struct sk_buff *skb) {
 	const struct inet_sock *in_sk;
@@ -9,15 +9,19 @@
 #include <util/log.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 
 #include <util/dlist.h>
+#include <util/math.h>
 
-#include <kernel/time/ktime.h>
+#include <kernel/lthread/lthread.h>
+#include <kernel/spinlock.h>
 #include <kernel/time/timer.h>
 #include <kernel/sched/sched_lock.h>
+#include <linux/compiler.h>
 #include <mem/misc/pool.h>
 
 #include <net/l0/net_tx.h>
@@ -36,26 +40,59 @@
 #define MODOPS_NEIGHBOUR_TMR_FREQ OPTION_GET(NUMBER, neighbour_tmr_freq)
 #define MODOPS_NEIGHBOUR_RESEND   OPTION_GET(NUMBER, neighbour_resend)
 #define MODOPS_NEIGHBOUR_ATTEMPT  OPTION_GET(NUMBER, neighbour_attempt)
+#define MODOPS_NEIGHBOUR_HASH_SZ  OPTION_GET(NUMBER, hash_size)
+#define MODOPS_GC_PRIORITY        OPTION_GET(NUMBER, gc_priority)
+
+/* Milliseconds to ticks of aging timer */
+#define NBR_TICKS(ms) max(1, (ms) / MODOPS_NEIGHBOUR_TMR_FREQ)
+
+/* Number of requests the garbage collector sends per lock */
+#define NBR_GC_BATCH 8
+
+/*
+ * Lookups don't take nbr_lock. Readers only disable preemption and walk
+ * hash chains, while writers serialize on nbr_lock and publish entries
+ * with a barrier. Removed entry is unlinked from its chain but keeps its
+ * hnext, so a reader standing on it goes on, and it's returned to the
+ * pool by the garbage collector one tick later.
+ */
+#ifdef SMP
+#define nbr_read_barrier() __sync_synchronize()
+#else
+#define nbr_read_barrier() __barrier()
+#endif
 
 POOL_DEF(neighbour_pool, struct neighbour, MODOPS_NEIGHBOUR_AMOUNT);
-static DLIST_DEFINE(neighbour_list);
+static struct neighbour *neighbour_hash[MODOPS_NEIGHBOUR_HASH_SZ];
+static spinlock_t nbr_lock = SPIN_STATIC_UNLOCKED;
+
+/* Every list is sorted by deadline since one interval is used in it */
+static DLIST_DEFINE(nbr_pending); /* unresolved, deadline of next request */
+static DLIST_DEFINE(nbr_aging);   /* resolved, deadline of expiration */
+static DLIST_DEFINE(nbr_retired); /* unlinked, tick of unlinking */
+
 static struct sys_timer neighbour_tmr;
+static unsigned int nbr_now; /* ticks of aging timer */
 
-static void nbr_timer_handler(struct sys_timer *tmr, void *param);
+static int nbr_gc_action(struct lthread *self);
+static LTHREAD_DEF(nbr_gc_lt, nbr_gc_action, MODOPS_GC_PRIORITY);
 
-static void nbr_set_haddr(struct neighbour *nbr, const void *haddr) {
-	assert(nbr != NULL);
+/* Data to send request after nbr_lock is released */
+struct nbr_request {
+	unsigned short ptype;
+	unsigned char paddr[MAX_ADDR_LEN];
+	unsigned char plen;
+	struct net_device *dev;
+};
 
-	if (haddr != NULL) {
-		nbr->expire = MODOPS_NEIGHBOUR_EXPIRE;
-		memcpy(&nbr->haddr[0], haddr, nbr->hlen);
-	} else {
-		assert(nbr->is_incomplete == 1);
-	}
+static void nbr_timer_handler(struct sys_timer *tmr, void *param) {
+	++nbr_now;
+	lthread_launch(&nbr_gc_lt);
 }
 
 static void neighbour_timer_update(void) {
-	if (dlist_empty(&neighbour_list)) {
+	if (dlist_empty(&nbr_pending) && dlist_empty(&nbr_aging)
+			&& dlist_empty(&nbr_retired)) {
 		if (timer_is_started(&neighbour_tmr)) {
 			timer_stop(&neighbour_tmr);
 		}
@@ -67,10 +104,56 @@ static void neighbour_timer_update(void) {
 	}
 }
 
+static inline int nbr_deadline_reached(const struct neighbour *nbr) {
+	return (int)(nbr->deadline - nbr_now) <= 0;
+}
+
+static unsigned int nbr_hash(unsigned short ptype, const void *paddr,
+		const struct net_device *dev) {
+	const unsigned char *addr = paddr;
+	unsigned int hash, i, len;
+
+	len = ptype == ETH_P_IPV6 ? 16 : ptype == ETH_P_IP ? 4 : 0;
+
+	hash = ptype ^ dev->index;
+	for (i = 0; i < len; ++i) {
+		hash = hash * 31 + addr[i];
+	}
+
+	return hash % MODOPS_NEIGHBOUR_HASH_SZ;
+}
+
+/* Called with nbr_lock held */
+static void nbr_age(struct neighbour *nbr) {
+	dlist_del_init_entry(nbr, lnk);
+
+	if (nbr->is_incomplete) {
+		nbr->deadline = nbr_now + NBR_TICKS(MODOPS_NEIGHBOUR_RESEND);
+		dlist_add_prev_entry(nbr, &nbr_pending, lnk);
+	} else if (~nbr->flags & NEIGHBOUR_FLAG_PERMANENT) {
+		nbr->deadline = nbr_now + NBR_TICKS(MODOPS_NEIGHBOUR_EXPIRE);
+		dlist_add_prev_entry(nbr, &nbr_aging, lnk);
+	}
+
+	neighbour_timer_update();
+}
+
+static void nbr_set_haddr(struct neighbour *nbr, const void *haddr) {
+	assert(nbr != NULL);
+	assert(haddr != NULL);
+
+	memcpy(&nbr->haddr[0], haddr, nbr->hlen);
+	/* Readers check is_incomplete before they copy haddr */
+	__sync_synchronize();
+	nbr->is_incomplete = 0;
+}
+
+/* Called with nbr_lock held */
 static struct neighbour *nbr_create(unsigned short ptype, const void *paddr,
 		unsigned char plen, struct net_device *dev,
-		unsigned short htype, unsigned int flags ) {
+		unsigned short htype, unsigned int flags) {
 	struct neighbour *nbr;
+	unsigned int hash;
 
 	nbr = pool_alloc(&neighbour_pool);
 	if (nbr == NULL) {
@@ -79,28 +162,43 @@ static struct neighbour *nbr_create(unsigned short ptype, const void *paddr,
 	nbr->is_incomplete = 1;
 	skb_queue_init(&nbr->w_queue);
 	dlist_head_init(&nbr->lnk);
-	dlist_add_prev_entry(nbr, &neighbour_list, lnk);
 	nbr->ptype = ptype;
 	memcpy(nbr->paddr, paddr, plen);
 	nbr->plen = plen;
 	nbr->dev = dev;
 	nbr->htype = htype;
 	nbr->hlen = dev->addr_len;
-	nbr_set_haddr(nbr, NULL);
-	nbr->resend = MODOPS_NEIGHBOUR_RESEND;
+	nbr->flags = flags;
 	nbr->sent_times = 0;
+	nbr_age(nbr);
 
-	neighbour_timer_update();
+	hash = nbr_hash(ptype, paddr, dev);
+	nbr->hnext = neighbour_hash[hash];
+	/* Entry must be seen by readers only when it's filled */
+	__sync_synchronize();
+	neighbour_hash[hash] = nbr;
 
 	return nbr;
 }
 
-static void nbr_free(struct neighbour *nbr) {
+/* Called with nbr_lock held */
+static void nbr_retire(struct neighbour *nbr) {
+	struct neighbour **prev;
+
 	assert(nbr != NULL);
 
-	dlist_del_init_entry(nbr, lnk);
+	prev = &neighbour_hash[nbr_hash(nbr->ptype, nbr->paddr, nbr->dev)];
+	while (*prev != nbr) {
+		assert(*prev != NULL);
+		prev = &(*prev)->hnext;
+	}
+	*prev = nbr->hnext;
+
 	skb_queue_purge(&nbr->w_queue);
-	pool_free(&neighbour_pool, nbr);
+
+	dlist_del_init_entry(nbr, lnk);
+	nbr->deadline = nbr_now;
+	dlist_add_prev_entry(nbr, &nbr_retired, lnk);
 
 	neighbour_timer_update();
 }
@@ -112,7 +210,8 @@ static struct neighbour * nbr_lookup_by_paddr(unsigned short ptype,
 	assert(paddr != NULL);
 	assert(dev != NULL);
 
-	dlist_foreach_entry(nbr, &neighbour_list, lnk) {
+	for (nbr = neighbour_hash[nbr_hash(ptype, paddr, dev)]; nbr != NULL;
+			nbr = nbr->hnext) {
 		if ((nbr->ptype == ptype)
 				&& (0 == memcmp(&nbr->paddr[0], paddr, nbr->plen))
 				&& (nbr->dev == dev)) {
@@ -126,51 +225,64 @@ static struct neighbour * nbr_lookup_by_paddr(unsigned short ptype,
 static struct neighbour * nbr_lookup_by_haddr(unsigned short htype,
 		const void *haddr, struct net_device *dev) {
 	struct neighbour *nbr;
+	unsigned int i;
 
 	assert(haddr != NULL);
 	assert(dev != NULL);
 
-	dlist_foreach_entry(nbr, &neighbour_list, lnk) {
-		if ((nbr->htype == htype)
-				&& (0 == memcmp(&nbr->haddr[0], haddr, nbr->hlen))
-				&& (nbr->dev == dev)) {
-			return nbr;
+	/* Reverse lookup is rare (RARP), so all chains are walked */
+	for (i = 0; i < MODOPS_NEIGHBOUR_HASH_SZ; ++i) {
+		for (nbr = neighbour_hash[i]; nbr != NULL; nbr = nbr->hnext) {
+			if ((nbr->htype == htype)
+					&& !nbr->is_incomplete
+					&& (0 == memcmp(&nbr->haddr[0], haddr, nbr->hlen))
+					&& (nbr->dev == dev)) {
+				return nbr;
+			}
 		}
 	}
 
 	return NULL; /* error: no such entity */
 }
 
-static int nbr_send_request(struct neighbour *nbr) {
-	struct in_device *in_dev;
+static void nbr_request_fill(struct nbr_request *req,
+		const struct neighbour *nbr) {
+	req->ptype = nbr->ptype;
+	memcpy(&req->paddr[0], &nbr->paddr[0], nbr->plen);
+	req->plen = nbr->plen;
+	req->dev = nbr->dev;
+}
 
-	++nbr->sent_times;
+static int nbr_send_request(const struct nbr_request *req) {
+	struct in_device *in_dev;
 
-	if (nbr->ptype == ETH_P_IP) {
-		in_dev = inetdev_get_by_dev(nbr->dev);
+	if (req->ptype == ETH_P_IP) {
+		in_dev = inetdev_get_by_dev(req->dev);
 		assert(in_dev != NULL);
-		return arp_discover(nbr->dev, nbr->ptype, nbr->plen,
-				&in_dev->ifa_address, &nbr->paddr[0]);
+		return arp_discover(req->dev, req->ptype, req->plen,
+				&in_dev->ifa_address, &req->paddr[0]);
 	} else {
-		assert(nbr->ptype == ETH_P_IPV6);
-		return ndp_discover(nbr->dev, &nbr->paddr[0]);
+		assert(req->ptype == ETH_P_IPV6);
+		return ndp_discover(req->dev, &req->paddr[0]);
 	}
 }
 
-static int nbr_build_and_send_pkt(struct sk_buff *skb, struct neighbour *nbr) {
+static int nbr_build_and_send_pkt(struct sk_buff *skb, unsigned short ptype,
+		const void *haddr) {
 	int ret;
 	struct net_header_info hdr_info;
 
-	hdr_info.type = nbr->ptype;
-	hdr_info.src_hw = &nbr->dev->dev_addr[0];
-	hdr_info.dst_hw = &nbr->haddr[0];
-
 	assert(skb != NULL);
 
 	/* try to rebuild */
 	assert(skb->dev != NULL);
 	assert(skb->dev->ops != NULL);
 	assert(skb->dev->ops->build_hdr != NULL);
+
+	hdr_info.type = ptype;
+	hdr_info.src_hw = &skb->dev->dev_addr[0];
+	hdr_info.dst_hw = haddr;
+
 	ret = skb->dev->ops->build_hdr(skb, &hdr_info);
 	if (ret) {
 		skb_free(skb);
@@ -183,20 +295,15 @@ static int nbr_build_and_send_pkt(struct sk_buff *skb, struct neighbour *nbr) {
 	return ret;
 }
 
-static void nbr_flush_w_queue(struct neighbour *nbr) {
-	struct sk_buff *skb;
-
-	while ((skb = skb_queue_pop(&nbr->w_queue)) != NULL) {
-		(void)nbr_build_and_send_pkt(skb, nbr);
-	}
-}
-
 int neighbour_add(unsigned short ptype, const void *paddr,
 		unsigned char plen, struct net_device *dev,
 		unsigned short htype, const void *haddr, unsigned char hlen,
 		unsigned int flags) {
 	int ret;
-	struct neighbour *nbr;
+	struct neighbour *nbr, *old;
+	struct sk_buff_head w_queue;
+	struct sk_buff *skb;
+	unsigned char dst_haddr[MAX_ADDR_LEN];
 
 	if ((paddr == NULL) || (plen == 0) || (plen > sizeof(nbr->paddr))
 			|| (dev == NULL) || (haddr == NULL) || (hlen == 0)
@@ -204,28 +311,47 @@ int neighbour_add(unsigned short ptype, const void *paddr,
 		return -EINVAL;
 	}
 
+	skb_queue_init(&w_queue);
+
 	ret = 0;
-	sched_lock();
+	spin_lock(&nbr_lock);
 	{
 		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
-		if (nbr == NULL) {
+		if ((nbr != NULL) && !nbr->is_incomplete
+				&& (0 != memcmp(&nbr->haddr[0], haddr, nbr->hlen))) {
+			/* Readers copy haddr without lock, so it's never changed
+			 * in place. New entry replaces the old one */
+			old = nbr;
 			nbr = nbr_create(ptype, paddr, plen, dev, htype, flags);
 			if (nbr == NULL) {
-				ret = - ENOMEM;
+				ret = -ENOMEM;
+				goto exit;
+			}
+			nbr_retire(old);
+		} else if (nbr == NULL) {
+			nbr = nbr_create(ptype, paddr, plen, dev, htype, flags);
+			if (nbr == NULL) {
+				ret = -ENOMEM;
 				goto exit;
 			}
 		}
 
-		nbr_set_haddr(nbr, haddr);
-		nbr->flags = flags;
-
 		if (nbr->is_incomplete) {
-			nbr_flush_w_queue(nbr);
-			nbr->is_incomplete = 0;
+			nbr_set_haddr(nbr, haddr);
+			skb_queue_splice(&nbr->w_queue, &w_queue, INT_MAX);
 		}
+		nbr->flags = flags;
+		nbr_age(nbr);
+
+		memcpy(&dst_haddr[0], &nbr->haddr[0], nbr->hlen);
 	}
 exit:
-	sched_unlock();
+	spin_unlock(&nbr_lock);
+
+	/* Packets are sent without lock, they may come back to the stack */
+	while ((skb = __skb_queue_pop(&w_queue)) != NULL) {
+		(void)nbr_build_and_send_pkt(skb, ptype, &dst_haddr[0]);
+	}
 
 	return ret;
 }
@@ -234,65 +360,63 @@ int neighbour_get_haddr(unsigned short ptype,  const void *paddr,
 		struct net_device *dev, unsigned short htype,
 		unsigned char hlen_max, void *out_haddr) {
 	struct neighbour *nbr;
+	int ret;
 
 	if ((paddr == NULL) || (dev == NULL) || (out_haddr == NULL)) {
 		return -EINVAL;
 	}
 
+	ret = 0;
 	sched_lock();
 	{
 		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
 		if (nbr == NULL) {
-			sched_unlock();
-			return -ENOENT;
+			ret = -ENOENT;
 		} else if (nbr->htype != htype) {
-			sched_unlock();
-			return -ENOENT;
+			ret = -ENOENT;
 		} else if (nbr->is_incomplete) {
-			sched_unlock();
-			return -EINPROGRESS;
+			ret = -EINPROGRESS;
 		} else if (nbr->hlen > hlen_max) {
-			sched_unlock();
-			return -ENOMEM;
+			ret = -ENOMEM;
+		} else {
+			nbr_read_barrier();
+			memcpy(out_haddr, &nbr->haddr[0], nbr->hlen);
 		}
-
-		memcpy(out_haddr, &nbr->haddr[0], nbr->hlen);
 	}
 	sched_unlock();
 
-	return 0;
+	return ret;
 }
 
 int neighbour_get_paddr(unsigned short htype, const void *haddr,
 		struct net_device *dev, unsigned short ptype,
 		unsigned char plen_max, void *out_paddr) {
 	struct neighbour *nbr;
+	int ret;
 
 	if ((haddr == NULL) || (dev == NULL) || (out_paddr == NULL)) {
 		return -EINVAL;
 	}
 
+	ret = 0;
 	sched_lock();
 	{
 		nbr = nbr_lookup_by_haddr(htype, haddr, dev);
 		if (nbr == NULL) {
-			sched_unlock();
-			return -ENOENT;
+			ret = -ENOENT;
 		}
 		else if (nbr->ptype != ptype) {
-			sched_unlock();
-			return -ENOENT;
+			ret = -ENOENT;
 		}
 		else if (nbr->plen > plen_max) {
-			sched_unlock();
-			return -ENOMEM;
+			ret = -ENOMEM;
+		} else {
+			memcpy(out_paddr, &nbr->paddr[0], nbr->plen);
 		}
-
-		memcpy(out_paddr, &nbr->paddr[0], nbr->plen);
 	}
 	sched_unlock();
 
-	return 0;
+	return ret;
 }
 
 int neighbour_del(unsigned short ptype, const void *paddr,
@@ -304,69 +428,100 @@ int neighbour_del(unsigned short ptype, const void *paddr,
 		return -EINVAL;
 	}
 
-	sched_lock();
+	spin_lock(&nbr_lock);
 	{
 		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
 		if (nbr != NULL) {
-			nbr_free(nbr);
+			nbr_retire(nbr);
 			ret = 0;
 		} else {
 			ret = -ENOENT;
 		}
 	}
-	sched_unlock();
+	spin_unlock(&nbr_lock);
 
 	return ret;
 }
 
 int neighbour_clean(struct net_device *dev) {
-	struct neighbour *nbr = NULL;
+	struct neighbour *nbr, *next;
+	unsigned int i;
 
-	sched_lock();
+	spin_lock(&nbr_lock);
 	{
-		dlist_foreach_entry(nbr, &neighbour_list, lnk) {
-			if ((nbr->dev == dev) || (dev == NULL)) {
-				nbr_free(nbr);
+		for (i = 0; i < MODOPS_NEIGHBOUR_HASH_SZ; ++i) {
+			for (nbr = neighbour_hash[i]; nbr != NULL; nbr = next) {
+				next = nbr->hnext;
+				if ((nbr->dev == dev) || (dev == NULL)) {
+					nbr_retire(nbr);
+				}
 			}
 		}
 	}
-	sched_unlock();
+	spin_unlock(&nbr_lock);
 
 	return 0;
 }
 
-#if defined(NET_NAMESPACE_ENABLED) && (NET_NAMESPACE_ENABLED == 1)
-#include <net/net_namespace.h>
-
-int neighbour_foreach_net_ns(neighbour_foreach_ft func, void *args,
-			net_namespace_p net_ns) {
+/*
+ * Callback may sleep, so it gets a copy of entry made on the read side.
+ * Position is kept as chain and index in it, because the entry may be
+ * removed in the meantime.
+ */
+static int nbr_foreach(neighbour_foreach_ft func, void *args,
+		int (*filter)(const struct neighbour *nbr, void *data), void *data) {
+	struct neighbour copy, *nbr;
+	unsigned int i, j, pos;
 	int ret;
-	struct neighbour *nbr;
 
 	if (func == NULL) {
 		return -EINVAL;
 	}
 
-	sched_lock();
-	{
-		dlist_foreach_entry(nbr, &neighbour_list, lnk) {
-			if (!cmp_net_ns(nbr->dev->net_ns, net_ns))
-				continue;
+	for (i = 0; i < MODOPS_NEIGHBOUR_HASH_SZ; ++i) {
+		for (pos = 0; ; ++pos) {
+			sched_lock();
+			{
+				for (j = 0, nbr = neighbour_hash[i]; (nbr != NULL) && (j < pos);
+						++j, nbr = nbr->hnext) {
+				}
+				if (nbr != NULL) {
+					nbr_read_barrier();
+					memcpy(&copy, nbr, sizeof copy);
+				}
+			}
 			sched_unlock();
 
-			ret = (*func)(nbr, args);
+			if (nbr == NULL) {
+				break;
+			}
+
+			if ((filter != NULL) && !filter(&copy, data)) {
+				continue;
+			}
+
+			ret = (*func)(&copy, args);
 			if (ret != 0) {
 				return ret;
 			}
-
-			sched_lock();
 		}
 	}
-	sched_unlock();
 
 	return 0;
 }
 
+#if defined(NET_NAMESPACE_ENABLED) && (NET_NAMESPACE_ENABLED == 1)
+#include <net/net_namespace.h>
+
+static int nbr_net_ns_filter(const struct neighbour *nbr, void *data) {
+	return cmp_net_ns(nbr->dev->net_ns, *(net_namespace_p *) data);
+}
+
+int neighbour_foreach_net_ns(neighbour_foreach_ft func, void *args,
+			net_namespace_p net_ns) {
+	return nbr_foreach(func, args, nbr_net_ns_filter, &net_ns);
+}
+
 int neighbour_foreach(neighbour_foreach_ft func, void *args) {
 	return neighbour_foreach_net_ns(func, args, get_net_ns());
 }
@@ -374,29 +529,7 @@ int neighbour_foreach(neighbour_foreach_ft func, void *args) {
 #else
 
 int neighbour_foreach(neighbour_foreach_ft func, void *args) {
-	int ret;
-	struct neighbour *nbr = NULL;
-
-	if (func == NULL) {
-		return -EINVAL;
-	}
-
-	sched_lock();
-	{
-		dlist_foreach_entry(nbr, &neighbour_list, lnk) {
-			sched_unlock();
-
-			ret = (*func)(nbr, args);
-			if (ret != 0) {
-				return ret;
-			}
-
-			sched_lock();
-		}
-	}
-	sched_unlock();
-
-	return 0;
+	return nbr_foreach(func, args, NULL, NULL);
 }
 #endif
 
@@ -405,15 +538,30 @@ int neighbour_resolve(unsigned short ptype,
 		struct net_device *dev, struct sk_buff *skb,
 		unsigned char hlen_max, void *out_haddr) {
 	struct neighbour *nbr;
-	int ret;
+	struct nbr_request req;
+	int ret, send;
 
 	if (hlen_max < dev->addr_len) {
 		return -EINVAL;
 	}
 
+	/* Fast path: entry is resolved, it's read without nbr_lock */
+	sched_lock();
+	{
+		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
+		if ((nbr != NULL) && !nbr->is_incomplete) {
+			nbr_read_barrier();
+			memcpy(out_haddr, &nbr->haddr[0], nbr->hlen);
+			sched_unlock();
+			return 0;
+		}
+	}
+	sched_unlock();
+
 	ret = 0;
+	send = 0;
 
-	sched_lock();
+	spin_lock(&nbr_lock);
 	{
 		nbr = nbr_lookup_by_paddr(ptype, paddr, dev);
 		if (nbr == NULL) {
@@ -423,7 +571,9 @@ int neighbour_resolve(unsigned short ptype,
 				goto exit;
 			}
 
-			nbr_send_request(nbr);
+			nbr_request_fill(&req, nbr);
+			++nbr->sent_times;
+			send = 1;
 		}
 
 		if (nbr->is_incomplete) {
@@ -435,38 +585,65 @@ int neighbour_resolve(unsigned short ptype,
 		memcpy(out_haddr, &nbr->haddr[0], nbr->hlen);
 	}
 exit:
-	sched_unlock();
+	spin_unlock(&nbr_lock);
+
+	if (send) {
+		(void)nbr_send_request(&req);
+	}
 
 	return ret;
 }
 
-static void nbr_timer_handler(struct sys_timer *tmr, void *param) {
-	struct neighbour *nbr = NULL;
+/* Looks only at entries whose deadline is reached */
+static int nbr_gc_action(struct lthread *self) {
+	struct nbr_request reqs[NBR_GC_BATCH];
+	struct neighbour *nbr;
+	int i, n;
 
-	sched_lock();
-	{
-		dlist_foreach_entry(nbr, &neighbour_list, lnk) {
-			if (nbr->flags & NEIGHBOUR_FLAG_PERMANENT) {
-				continue;
+	do {
+		n = 0;
+
+		spin_lock(&nbr_lock);
+		{
+			dlist_foreach_entry(nbr, &nbr_retired, lnk) {
+				if (nbr->deadline == nbr_now) {
+					break; /* readers may still see it */
+				}
+				dlist_del_init_entry(nbr, lnk);
+				pool_free(&neighbour_pool, nbr);
 			}
 
-			if (nbr->is_incomplete) {
-				if (--nbr->expire <= 0) {
-					nbr_free(nbr);
+			dlist_foreach_entry(nbr, &nbr_aging, lnk) {
+				if (!nbr_deadline_reached(nbr)) {
+					break;
 				}
-			} else {
-				/* have not revolved yet */
-				if ( --nbr->resend <= 0) {
-					if (nbr->sent_times++ == MODOPS_NEIGHBOUR_ATTEMPT) {
-						nbr_free(nbr);
-						/* unreachable host */
-					} else {
-						(void)nbr_send_request(nbr);
-						nbr->resend = MODOPS_NEIGHBOUR_RESEND;
-					}
+				nbr_retire(nbr);
+			}
+
+			dlist_foreach_entry(nbr, &nbr_pending, lnk) {
+				if (!nbr_deadline_reached(nbr) || (n == NBR_GC_BATCH)) {
+					break;
+				}
+
+				if (nbr->sent_times >= MODOPS_NEIGHBOUR_ATTEMPT) {
+					/* unreachable host */
+					nbr_retire(nbr);
+					continue;
 				}
+
+				nbr_request_fill(&reqs[n++], nbr);
+				++nbr->sent_times;
+				nbr_age(nbr);
 			}
+
+			neighbour_timer_update();
 		}
-	}
-	sched_unlock();
+		spin_unlock(&nbr_lock);
+
+		for (i = 0; i < n; ++i) {
+			(void)nbr_send_request(&reqs[i]);
+		}
+	} while (n == NBR_GC_BATCH);
+
+	return 0;
 }
@@ -55,16 +55,27 @@ POOL_DEF(netdev_htitem_pool, struct hashtable_item, MODOPS_NETDEV_QUANTITY);
 
 static int netdev_init(struct net_device *dev, const char *name,
 		int (*setup)(struct net_device *), size_t priv_size) {
+	struct netdev_queue *q;
+
 	assert(dev != NULL);
 	assert(name != NULL);
 	assert(setup != NULL);
 
-	dlist_head_init(&dev->rx_lnk);
-	dlist_head_init(&dev->tx_lnk);
+	dlist_head_init(&dev->poll_lnk);
+	dev->poll_avg = dev->poll_idle = 0;
+	dev->features = 0;
 	strcpy(&dev->name[0], name);
 	memset(&dev->stats, 0, sizeof dev->stats);
-	skb_queue_init(&dev->dev_queue);
-	skb_queue_init(&dev->dev_queue_tx);
+
+	dev->num_tx_queues = 1;
+	for (q = &dev->queues[0]; q < &dev->queues[NETDEV_QUEUES_MAX]; ++q) {
+		q->dev = dev;
+		dlist_head_init(&q->rx_lnk);
+		dlist_head_init(&q->tx_lnk);
+		skb_queue_init(&q->rx);
+		skb_queue_init(&q->tx);
+		q->rx_packets = q->tx_packets = 0;
+	}
 
 	if (priv_size != 0) {
 		dev->priv = sysmalloc(priv_size);
@@ -114,12 +125,29 @@ struct net_device * netdev_alloc(const char *name,
 	return dev;
 }
 
+int netdev_set_num_tx_queues(struct net_device *dev, unsigned int num) {
+	assert(dev != NULL);
+
+	if ((num == 0) || (num > NETDEV_QUEUES_MAX)) {
+		return -EINVAL;
+	}
+
+	dev->num_tx_queues = num;
+
+	return 0;
+}
+
 void netdev_free(struct net_device *dev) {
+	struct netdev_queue *q;
+
 	if (dev != NULL) {
-		dlist_del_init(&dev->rx_lnk);
-		dlist_del_init(&dev->tx_lnk);
-		skb_queue_purge(&dev->dev_queue);
-		skb_queue_purge(&dev->dev_queue_tx);
+		dlist_del_init(&dev->poll_lnk);
+		for (q = &dev->queues[0]; q < &dev->queues[NETDEV_QUEUES_MAX]; ++q) {
+			dlist_del_init(&q->rx_lnk);
+			dlist_del_init(&q->tx_lnk);
+			skb_queue_purge(&q->rx);
+			skb_queue_purge(&q->tx);
+		}
 		if (dev->priv) {
 			sysfree(dev->priv);
 		}
@@ -15,17 +15,67 @@
 #include <net/l3/ipv4/ip.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include <hal/cpu.h>
+#include <kernel/sched/waitq.h>
+#include <kernel/thread/sync/brlock.h>
+#include <kernel/thread/sync/mutex.h>
+#include <kernel/thread/waitq.h>
 
 #include <net/l4/udp.h>
 #include <net/l4/tcp.h>
 
 #define MODOPS_NETFILTER_AMOUNT_RULES  OPTION_GET(NUMBER, amount_rules)
+#define MODOPS_NETFILTER_HASH_SZ       OPTION_GET(NUMBER, hash_size)
+
+#define NF_CHAIN_CNT 3
 
 /**
  * Storage of nf_rule structure
  */
 POOL_DEF(nf_rule_pool, struct nf_rule, MODOPS_NETFILTER_AMOUNT_RULES);
 
+/**
+ * Fields used to find rules without testing each of them
+ */
+enum {
+	NF_KEY_DADDR,
+	NF_KEY_SADDR,
+	NF_KEY_DPORT,
+	NF_KEY_SPORT,
+	NF_KEY_CNT
+};
+
+/**
+ * Compiled chain. Every rule is placed to one list: either to the hash chain
+ * of the first field it requires to be equal to some value, or to the list of
+ * rules without such field. Lists are linked through next[] and keep rules
+ * in their order, so the first matched rule is found by merging those lists
+ * which may contain rules for the packet. Numbers of rules are stored
+ * increased by one, zero is the end of the list.
+ */
+struct nf_ruleset {
+	struct brlock_cpu cpu[NCPU];
+	int draining;
+	size_t count;
+	struct nf_rule *rules[MODOPS_NETFILTER_AMOUNT_RULES];
+	uint16_t next[MODOPS_NETFILTER_AMOUNT_RULES];
+	uint16_t head[NF_KEY_CNT][MODOPS_NETFILTER_HASH_SZ];
+	uint16_t any;
+};
+
+/**
+ * The chain is rebuilt into the spare set, which replaces the active one
+ * when it's ready. Rules are freed only after readers leave the old set.
+ * Readers are counted per CPU and never wait, as packets are tested by
+ * lthreads, while writers sleep until readers leave.
+ */
+static struct nf_ruleset nf_rulesets[NF_CHAIN_CNT][2];
+static struct nf_ruleset *nf_active[NF_CHAIN_CNT];
+static struct mutex nf_lock = MUTEX_INIT_STATIC;
+static struct waitq nf_drain_wq = WAITQ_INIT(nf_drain_wq);
+
 /**
  * Default chains of rules
  */
@@ -46,6 +96,141 @@ static void free_rule(struct nf_rule *r) {
 	pool_free(&nf_rule_pool, r);
 }
 
+#define NF_EXACT_FIELD(r, field, len) \
+	(*(len) = sizeof (r)->field,             \
+		(r)->set_##field && !(r)->not_##field ? &(r)->field : NULL)
+
+/* Returns value which the field must be equal to, if there is one */
+static const void *nf_rule_key(const struct nf_rule *r, int key,
+		size_t *len) {
+	switch (key) {
+	default: return NULL;
+	case NF_KEY_DADDR: return NF_EXACT_FIELD(r, daddr, len);
+	case NF_KEY_SADDR: return NF_EXACT_FIELD(r, saddr, len);
+	case NF_KEY_DPORT: return NF_EXACT_FIELD(r, dport, len);
+	case NF_KEY_SPORT: return NF_EXACT_FIELD(r, sport, len);
+	}
+}
+
+static unsigned int nf_key_hash(const void *key, size_t len) {
+	const unsigned char *p;
+	uint32_t h;
+
+	/* FNV-1a */
+	for (h = 2166136261u, p = key; len > 0; ++p, --len) {
+		h = (h ^ *p) * 16777619u;
+	}
+
+	return h % MODOPS_NETFILTER_HASH_SZ;
+}
+
+static uint16_t *nf_ruleset_list(struct nf_ruleset *rs,
+		const struct nf_rule *r) {
+	const void *val;
+	size_t len;
+	int key;
+
+	for (key = 0; key < NF_KEY_CNT; ++key) {
+		val = nf_rule_key(r, key, &len);
+		if (val != NULL) {
+			return &rs->head[key][nf_key_hash(val, len)];
+		}
+	}
+
+	return &rs->any;
+}
+
+static void nf_ruleset_build(struct nf_ruleset *rs,
+		struct dlist_head *rules) {
+	struct nf_rule *r;
+	uint16_t *list;
+	size_t i;
+
+	memset(rs->head, 0, sizeof rs->head);
+	rs->any = 0;
+
+	i = 0;
+	dlist_foreach_entry(r, rules, lnk) {
+		rs->rules[i++] = r;
+	}
+	rs->count = i;
+
+	/* Add from the end to keep order of rules */
+	while (i-- > 0) {
+		list = nf_ruleset_list(rs, rs->rules[i]);
+		rs->next[i] = *list;
+		*list = i + 1;
+	}
+}
+
+static int nf_ruleset_readers(struct nf_ruleset *rs) {
+	int i, sum;
+
+	/* Readers may leave on another CPU, so only the sum is exact */
+	sum = 0;
+	for (i = 0; i < NCPU; i++) {
+		sum += *(volatile int *)&rs->cpu[i].readers;
+	}
+
+	return sum;
+}
+
+/* Must be called with nf_lock held. Rules which were removed from the chain
+ * may be freed after it returns */
+static void nf_chain_commit(int chain) {
+	struct nf_ruleset *old, *new;
+	int idx;
+
+	idx = chain - NF_CHAIN_INPUT;
+	old = nf_active[idx];
+	new = (old == &nf_rulesets[idx][0]) ? &nf_rulesets[idx][1]
+			: &nf_rulesets[idx][0];
+
+	nf_ruleset_build(new, nf_get_chain(chain));
+
+	__sync_synchronize();
+	nf_active[idx] = new;
+	__sync_synchronize();
+
+	if (old != NULL) {
+		old->draining = 1;
+		__sync_synchronize();
+		WAITQ_WAIT(&nf_drain_wq, nf_ruleset_readers(old) == 0);
+		old->draining = 0;
+	}
+}
+
+static void nf_ruleset_put(struct nf_ruleset *rs) {
+	if (rs == NULL) {
+		return;
+	}
+
+	__sync_fetch_and_sub(&rs->cpu[cpu_get_id()].readers, 1);
+	if (*(volatile int *)&rs->draining) {
+		waitq_wakeup_all(&nf_drain_wq);
+	}
+}
+
+static struct nf_ruleset *nf_ruleset_get(int chain) {
+	struct nf_ruleset *rs;
+	int idx;
+
+	idx = chain - NF_CHAIN_INPUT;
+
+	while (1) {
+		rs = *(struct nf_ruleset * volatile *)&nf_active[idx];
+		if (rs == NULL) {
+			return NULL;
+		}
+		__sync_fetch_and_add(&rs->cpu[cpu_get_id()].readers, 1);
+		if (rs == *(struct nf_ruleset * volatile *)&nf_active[idx]) {
+			return rs;
+		}
+		/* Replaced meanwhile, it may be rebuilt already */
+		nf_ruleset_put(rs);
+	}
+}
+
 int nf_chain_get_by_name(const char *chain_name) {
 	if (chain_name == NULL) {
 		return NF_CHAIN_UNKNOWN;
@@ -247,14 +432,17 @@ int nf_add_rule(int chain, const struct nf_rule *r) {
 	struct nf_rule *new_r;
 	int res;
 
-	res = nf_chain_rule_prepare(chain, r, &rules, &new_r);
-	if (res != 0) {
-		return res;
+	mutex_lock(&nf_lock);
+	{
+		res = nf_chain_rule_prepare(chain, r, &rules, &new_r);
+		if (res == 0) {
+			dlist_add_prev(&new_r->lnk, rules);
+			nf_chain_commit(chain);
+		}
 	}
+	mutex_unlock(&nf_lock);
 
-	dlist_add_prev(&new_r->lnk, rules);
-
-	return 0;
+	return res;
 }
 
 int nf_insert_rule(int chain, const struct nf_rule *r, size_t num) {
@@ -262,63 +450,91 @@ int nf_insert_rule(int chain, const struct nf_rule *r, size_t num) {
 	struct nf_rule *new_r, *old_r;
 	int res;
 
-	res = nf_chain_rule_prepare(chain, r, &rules, &new_r);
-	if (res != 0) {
-		return res;
-	}
-
-	old_r = nf_get_rule_by_num(chain, num);
-	if (!old_r) {
-		dlist_add_prev(&new_r->lnk, rules);
-	} else {
-		dlist_add_prev(&new_r->lnk, &old_r->lnk);
+	mutex_lock(&nf_lock);
+	{
+		res = nf_chain_rule_prepare(chain, r, &rules, &new_r);
+		if (res == 0) {
+			old_r = nf_get_rule_by_num(chain, num);
+			if (!old_r) {
+				dlist_add_prev(&new_r->lnk, rules);
+			} else {
+				dlist_add_prev(&new_r->lnk, &old_r->lnk);
+			}
+			nf_chain_commit(chain);
+		}
 	}
+	mutex_unlock(&nf_lock);
 
-	return 0;
+	return res;
 }
 
 int nf_set_rule(int chain, const struct nf_rule *r, size_t r_num) {
-	struct nf_rule *new_r;
+	struct dlist_head *rules;
+	struct nf_rule *new_r, *old_r;
+	int res;
 
-	if (r == NULL) {
-		return -EINVAL;
-	}
+	mutex_lock(&nf_lock);
+	{
+		old_r = nf_get_rule_by_num(chain, r_num);
+		if (old_r == NULL) {
+			res = r == NULL ? -EINVAL : -ENOENT;
+		} else {
+			/* Rule may be tested right now, so it's replaced by a new one */
+			res = nf_chain_rule_prepare(chain, r, &rules, &new_r);
+		}
 
-	new_r = nf_get_rule_by_num(chain, r_num);
-	if (new_r == NULL) {
-		return -ENOENT;
+		if (res == 0) {
+			dlist_add_prev(&new_r->lnk, &old_r->lnk);
+			dlist_del_init(&old_r->lnk);
+			nf_chain_commit(chain);
+			free_rule(old_r);
+		}
 	}
+	mutex_unlock(&nf_lock);
 
-	nf_rule_copy(new_r, r);
-
-	return 0;
+	return res;
 }
 
 int nf_del_rule(int chain, size_t r_num) {
 	struct nf_rule *r;
 
-	r = nf_get_rule_by_num(chain, r_num);
-	if (r == NULL) {
-		return -ENOENT;
+	mutex_lock(&nf_lock);
+	{
+		r = nf_get_rule_by_num(chain, r_num);
+		if (r != NULL) {
+			dlist_del_init(&r->lnk);
+			nf_chain_commit(chain);
+			free_rule(r);
+		}
 	}
+	mutex_unlock(&nf_lock);
 
-	free_rule(r);
-
-	return 0;
+	return r != NULL ? 0 : -ENOENT;
 }
 
 int nf_clear(int chain) {
 	struct dlist_head *rules;
 	struct nf_rule *r = NULL;
+	DLIST_DEFINE(removed);
 
 	rules = nf_get_chain(chain);
 	if (rules == NULL) {
 		return -EINVAL;
 	}
 
-	dlist_foreach_entry(r, rules, lnk) {
-		free_rule(r);
+	mutex_lock(&nf_lock);
+	{
+		dlist_foreach_entry(r, rules, lnk) {
+			dlist_del(&r->lnk);
+			dlist_add_prev(&r->lnk, &removed);
+		}
+		nf_chain_commit(chain);
+
+		dlist_foreach_entry(r, &removed, lnk) {
+			free_rule(r);
+		}
 	}
+	mutex_unlock(&nf_lock);
 
 	return 0;
 }
@@ -330,12 +546,69 @@ int nf_clear(int chain) {
 					sizeof test_r->field))          \
 				!= !!r->not_##field))
 
+static int nf_rule_match(const struct nf_rule *test_r,
+		const struct nf_rule *r) {
+	return (r->target != NF_TARGET_UNKNOWN)
+			&& NF_TEST_NOT_FIELD(test_r, r, hwaddr_src)
+			&& NF_TEST_NOT_FIELD(test_r, r, hwaddr_dst)
+			&& NF_TEST_NOT_FIELD(test_r, r, saddr)
+			&& NF_TEST_NOT_FIELD(test_r, r, daddr)
+			&& (((test_r->proto != NF_PROTO_ALL)
+					&& (r->proto != NF_PROTO_ALL)
+					&& NF_TEST_NOT_FIELD(test_r, r, proto))
+				|| ((test_r->proto == NF_PROTO_ALL) && !test_r->not_proto
+					&& (r->proto == NF_PROTO_ALL) && !r->not_proto)
+				|| ((test_r->proto != NF_PROTO_ALL)
+					&& ((r->proto == NF_PROTO_ALL) && !r->not_proto)))
+			&& NF_TEST_NOT_FIELD(test_r, r, sport)
+			&& NF_TEST_NOT_FIELD(test_r, r, dport)
+			&& (!r->test_hnd ? 1 : r->test_hnd(test_r, r->test_hnd_data));
+}
+
+/* Only lists where rules for this packet may be placed are looked through */
+static struct nf_rule *nf_ruleset_match(struct nf_ruleset *rs,
+		const struct nf_rule *test_r) {
+	uint16_t pos[NF_KEY_CNT + 1];
+	const void *val;
+	struct nf_rule *r;
+	size_t len;
+	int key, n, i, min;
+
+	n = 0;
+	for (key = 0; key < NF_KEY_CNT; ++key) {
+		val = nf_rule_key(test_r, key, &len);
+		if (val != NULL) {
+			pos[n++] = rs->head[key][nf_key_hash(val, len)];
+		}
+	}
+	pos[n++] = rs->any;
+
+	while (1) {
+		min = -1;
+		for (i = 0; i < n; ++i) {
+			if (pos[i] && ((min == -1) || (pos[i] < pos[min]))) {
+				min = i;
+			}
+		}
+		if (min == -1) {
+			return NULL;
+		}
+
+		r = rs->rules[pos[min] - 1];
+		pos[min] = rs->next[pos[min] - 1];
+
+		if (nf_rule_match(test_r, r)) {
+			return r;
+		}
+	}
+}
+
 int nf_test_rule(int chain, const struct nf_rule *test_r) {
-	struct dlist_head *rules;
+	struct nf_ruleset *rs;
 	struct nf_rule *r;
+	enum nf_target target;
 
-	rules = nf_get_chain(chain);
-	if (rules == NULL) {
+	if (nf_get_chain(chain) == NULL) {
 		return -EINVAL;
 	}
 
@@ -343,28 +616,19 @@ int nf_test_rule(int chain, const struct nf_rule *test_r) {
 		return -EINVAL;
 	}
 
-	dlist_foreach_entry(r, rules, lnk) {
-		if ((r->target != NF_TARGET_UNKNOWN)
-				&& NF_TEST_NOT_FIELD(test_r, r, hwaddr_src)
-				&& NF_TEST_NOT_FIELD(test_r, r, hwaddr_dst)
-				&& NF_TEST_NOT_FIELD(test_r, r, saddr)
-				&& NF_TEST_NOT_FIELD(test_r, r, daddr)
-				&& (((test_r->proto != NF_PROTO_ALL)
-						&& (r->proto != NF_PROTO_ALL)
-						&& NF_TEST_NOT_FIELD(test_r, r, proto))
-					|| ((test_r->proto == NF_PROTO_ALL) && !test_r->not_proto
-						&& (r->proto == NF_PROTO_ALL) && !r->not_proto)
-					|| ((test_r->proto != NF_PROTO_ALL)
-						&& ((r->proto == NF_PROTO_ALL) && !r->not_proto)))
-				&& NF_TEST_NOT_FIELD(test_r, r, sport)
-				&& NF_TEST_NOT_FIELD(test_r, r, dport)
-				&& (!r->test_hnd ? 1 : r->test_hnd(test_r, r->test_hnd_data))) {
-
-			return test_r->target != r->target;
+	rs = nf_ruleset_get(chain);
+	{
+		r = rs != NULL ? nf_ruleset_match(rs, test_r) : NULL;
+		if (r != NULL) {
+			__sync_fetch_and_add(&r->hits, 1);
+			target = r->target;
+		} else {
+			target = nf_get_chain_target(chain);
 		}
 	}
+	nf_ruleset_put(rs);
 
-	return test_r->target != nf_get_chain_target(chain);
+	return test_r->target != target;
 }
 
 int nf_test_skb(int chain, enum nf_target target,
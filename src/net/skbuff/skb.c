@@ -9,6 +9,7 @@
 */
 
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <stdint.h>
 #include <sys/uio.h>
@@ -37,7 +38,6 @@ struct sk_buff * skb_wrap(size_t size, struct sk_buff_data *skb_data) {
 
 struct sk_buff * skb_wrap_local(size_t size, struct sk_buff_data *skb_data,
 		struct pool *pl) {
-	ipl_t sp;
 	struct sk_buff *skb;
 
 	assert(pl != NULL);
@@ -50,11 +50,7 @@ struct sk_buff * skb_wrap_local(size_t size, struct sk_buff_data *skb_data,
 //		return NULL; /* error: invalid argument */
 //	}
 
-	sp = ipl_save();
-	{
-		skb = pool_alloc(pl);
-	}
-	ipl_restore(sp);
+	skb = pool_alloc(pl);
 
 	if (skb == NULL) {
 		log_error("skb_wrap: error: no memory\n");
@@ -65,12 +61,16 @@ struct sk_buff * skb_wrap_local(size_t size, struct sk_buff_data *skb_data,
 
 	INIT_LIST_HEAD((struct list_head * )skb);
 	skb->dev = NULL;
+	skb->queue_mapping = 0;
 	skb->len = size;
 	skb->nh.raw = skb->h.raw = NULL;
 	skb->data = skb_data;
 	skb->mac.raw = skb_get_data_pointner(skb_data);
 	skb->p_data = skb->p_data_end = NULL;
 	skb->pl = pl;
+	skb->data_len = 0;
+	skb->nr_frags = 0;
+	skb_queue_init(&skb->frag_list);
 
 	return skb;
 }
@@ -97,12 +97,21 @@ struct sk_buff * skb_alloc_local(size_t size, struct pool *pl) {
 	return skb;
 }
 
+static void skb_frags_release(struct sk_buff *skb) {
+	while (skb->nr_frags != 0) {
+		skb_data_free(skb->frags[--skb->nr_frags].data);
+	}
+	skb_queue_purge(&skb->frag_list);
+	skb->data_len = 0;
+}
+
 struct sk_buff * skb_realloc(size_t size, struct sk_buff *skb) {
 	if (skb == NULL) {
 		return skb_alloc(size);
 	}
 
 	list_del_init((struct list_head *) skb);
+	skb_frags_release(skb);
 	skb->dev = NULL;
 	skb->len = size;
 	skb->mac.raw = skb_get_data_pointner(skb->data);
@@ -119,14 +128,16 @@ void skb_free(struct sk_buff *skb) {
 	}
 
 	skb_data_free(skb->data);
+	skb_frags_release(skb);
 
 	sp = ipl_save();
 	{
 		assert((skb->lnk.prev != NULL) && (skb->lnk.next != NULL));
 		list_del((struct list_head *) skb);
-		pool_free(skb->pl, skb);
 	}
 	ipl_restore(sp);
+
+	pool_free(skb->pl, skb);
 }
 
 static void skb_copy_ref(struct sk_buff *to, const struct sk_buff *from) {
@@ -165,11 +176,29 @@ static void skb_shift_ref(struct sk_buff *skb, ptrdiff_t offset) {
 	skb->p_data = skb->p_data_end = NULL;
 }
 
+/* Size of the own buffer of skb which is in use */
+static size_t skb_linear_size(const struct sk_buff *skb) {
+	if (!skb_is_nonlinear(skb)) {
+		return skb->len;
+	}
+	return skb->mac.raw - (unsigned char *) skb_get_data_pointner(skb->data)
+			+ skb_headlen(skb);
+}
+
+/* Copies only the own buffer of skb, fragments are not touched */
 static void skb_copy_data(struct sk_buff_data *to_data,
 		const struct sk_buff *from) {
 	assert((to_data != NULL) && (from != NULL) && (from->data != NULL));
 	memcpy(skb_get_data_pointner(to_data), skb_get_data_pointner(from->data),
-			from->len);
+			skb_linear_size(from));
+}
+
+/* Copies fragments of skb right after its copied linear part */
+static void skb_copy_frags(struct sk_buff_data *to_data,
+		const struct sk_buff *from) {
+	skb_copy_bits(from, skb_headlen(from),
+			(unsigned char *) skb_get_data_pointner(to_data)
+				+ skb_linear_size(from), from->data_len);
 }
 
 struct sk_buff * skb_copy(const struct sk_buff *skb) {
@@ -177,17 +206,45 @@ struct sk_buff * skb_copy(const struct sk_buff *skb) {
 
 	assert(skb != NULL);
 
-	copied = skb_alloc(skb->len);
+	copied = skb_alloc(skb_linear_size(skb) + skb->data_len);
 	if (copied == NULL) {
 		return NULL; /* error: no memory */
 	}
 
 	skb_copy_ref(copied, skb);
 	skb_copy_data(copied->data, skb);
+	if (skb_is_nonlinear(skb)) {
+		skb_copy_frags(copied->data, skb);
+		copied->len = skb->len;
+	}
 
 	return copied;
 }
 
+static int skb_clone_frags(struct sk_buff *to, const struct sk_buff *from) {
+	struct sk_buff *frag, *cloned;
+	unsigned int i;
+
+	for (i = 0; i < from->nr_frags; i++) {
+		to->frags[i] = from->frags[i];
+		skb_data_clone(to->frags[i].data);
+	}
+	to->nr_frags = from->nr_frags;
+	to->data_len = from->data_len;
+
+	for (frag = from->frag_list.next;
+			!skb_queue_end(frag, (struct sk_buff_head *) &from->frag_list);
+			frag = skb_queue_next(frag)) {
+		cloned = skb_clone(frag);
+		if (cloned == NULL) {
+			return -ENOMEM;
+		}
+		skb_queue_push(&to->frag_list, cloned);
+	}
+
+	return 0;
+}
+
 struct sk_buff * skb_clone(const struct sk_buff *skb) {
 	struct sk_buff *cloned;
 	struct sk_buff_data *cloned_data;
@@ -207,6 +264,11 @@ struct sk_buff * skb_clone(const struct sk_buff *skb) {
 
 	skb_copy_ref(cloned, skb);
 
+	if (skb_is_nonlinear(skb) && (0 != skb_clone_frags(cloned, skb))) {
+		skb_free(cloned);
+		return NULL; /* error: no memory */
+	}
+
 	return cloned;
 }
 
@@ -223,16 +285,17 @@ struct sk_buff * skb_declone(struct sk_buff *skb) {
 			goto out;
 		}
 
-		decloned_data = skb_data_alloc(skb->len);
+		decloned_data = skb_data_alloc(skb_linear_size(skb));
 		if (decloned_data == NULL) {
 			skb = NULL;
 			goto out;
 		}
 
+		/* Size of data is found by references, copy before moving them */
+		skb_copy_data(decloned_data, skb);
 		skb_shift_ref(skb,
 				skb_get_data_pointner(decloned_data)
 				- skb_get_data_pointner(skb->data));
-		skb_copy_data(decloned_data, skb);
 
 		skb_data_free(skb->data);
 		skb->data = decloned_data;
@@ -243,6 +306,194 @@ out:
 	return skb;
 }
 
+struct sk_buff *skb_linearize(struct sk_buff *skb) {
+	struct sk_buff_data *lin_data;
+
+	assert(skb != NULL);
+
+	if (!skb_is_nonlinear(skb)) {
+		return skb;
+	}
+
+	lin_data = skb_data_alloc(skb_linear_size(skb) + skb->data_len);
+	if (lin_data == NULL) {
+		return NULL; /* error: no memory */
+	}
+
+	skb_copy_data(lin_data, skb);
+	skb_copy_frags(lin_data, skb);
+	skb_frags_release(skb);
+
+	skb_shift_ref(skb, skb_get_data_pointner(lin_data)
+			- skb_get_data_pointner(skb->data));
+	skb_data_free(skb->data);
+	skb->data = lin_data;
+
+	return skb;
+}
+
+int skb_add_frag(struct sk_buff *skb, struct sk_buff_data *skb_data,
+		unsigned char *ptr, size_t len) {
+	struct skb_frag *frag;
+
+	assert((skb != NULL) && (skb_data != NULL) && (ptr != NULL));
+
+	/* Fragments go before frag_list in content */
+	if ((skb->nr_frags == SKB_FRAGS_MAX) || !skb_queue_empty(&skb->frag_list)) {
+		return -ENOSPC;
+	}
+
+	frag = &skb->frags[skb->nr_frags++];
+	frag->data = skb_data_clone(skb_data);
+	frag->ptr = ptr;
+	frag->len = len;
+
+	skb->len += len;
+	skb->data_len += len;
+
+	return 0;
+}
+
+/* Calls @a fn for each piece of content with the buffer it lives in */
+static int skb_for_each_chunk(const struct sk_buff *skb, size_t offset,
+		size_t len, int (*fn)(void *arg, struct sk_buff_data *data,
+			unsigned char *ptr, size_t len), void *arg) {
+	struct sk_buff *frag;
+	struct sk_buff_data *data;
+	unsigned char *ptr;
+	size_t chunk;
+	unsigned int i;
+	int ret;
+
+	i = 0;
+	frag = skb->frag_list.next;
+	data = skb->data;
+	ptr = skb->mac.raw;
+	chunk = skb_headlen(skb);
+
+	while (len != 0) {
+		if (offset < chunk) {
+			chunk = min(chunk - offset, len);
+			ret = fn(arg, data, ptr + offset, chunk);
+			if (ret != 0) {
+				return ret;
+			}
+			len -= chunk;
+			offset = 0;
+		} else {
+			offset -= chunk;
+		}
+
+		if (i < skb->nr_frags) {
+			data = skb->frags[i].data;
+			ptr = skb->frags[i].ptr;
+			chunk = skb->frags[i].len;
+			i++;
+		} else if (!skb_queue_end(frag, (struct sk_buff_head *) &skb->frag_list)) {
+			data = frag->data;
+			ptr = frag->mac.raw;
+			chunk = frag->len;
+			frag = skb_queue_next(frag);
+		} else {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int skb_count_chunk(void *arg, struct sk_buff_data *data,
+		unsigned char *ptr, size_t len) {
+	++*(unsigned int *) arg;
+	return 0;
+}
+
+static int skb_add_frag_chunk(void *arg, struct sk_buff_data *data,
+		unsigned char *ptr, size_t len) {
+	return skb_add_frag(arg, data, ptr, len);
+}
+
+int skb_add_frag_range(struct sk_buff *to, const struct sk_buff *from,
+		size_t offset, size_t len) {
+	unsigned int nr_chunks;
+
+	assert((to != NULL) && (from != NULL));
+	assert(offset + len <= from->len);
+
+	nr_chunks = 0;
+	skb_for_each_chunk(from, offset, len, skb_count_chunk, &nr_chunks);
+	if ((to->nr_frags + nr_chunks > SKB_FRAGS_MAX)
+			|| !skb_queue_empty(&to->frag_list)) {
+		return -ENOSPC;
+	}
+
+	return skb_for_each_chunk(from, offset, len, skb_add_frag_chunk, to);
+}
+
+void skb_frag_list_add(struct sk_buff *skb, struct sk_buff *frag) {
+	assert((skb != NULL) && (frag != NULL));
+	assert(!skb_is_nonlinear(frag));
+
+	skb_queue_push(&skb->frag_list, frag);
+	skb->len += frag->len;
+	skb->data_len += frag->len;
+}
+
+struct skb_chunk_arg {
+	unsigned char *ptr;
+	size_t len;
+};
+
+static int skb_find_chunk(void *arg, struct sk_buff_data *data,
+		unsigned char *ptr, size_t len) {
+	struct skb_chunk_arg *chunk = arg;
+
+	chunk->ptr = ptr;
+	chunk->len = len;
+	return 1; /* stop on the first one */
+}
+
+unsigned char *skb_chunk(const struct sk_buff *skb, size_t offset,
+		size_t *len) {
+	struct skb_chunk_arg chunk = { NULL, 0 };
+
+	assert((skb != NULL) && (len != NULL));
+
+	if (offset < skb->len) {
+		skb_for_each_chunk(skb, offset, skb->len - offset,
+				skb_find_chunk, &chunk);
+	}
+
+	*len = chunk.len;
+	return chunk.ptr;
+}
+
+static int skb_copy_chunk(void *arg, struct sk_buff_data *data,
+		unsigned char *ptr, size_t len) {
+	unsigned char **to = arg;
+
+	memcpy(*to, ptr, len);
+	*to += len;
+	return 0;
+}
+
+size_t skb_copy_bits(const struct sk_buff *skb, size_t offset,
+		void *to, size_t len) {
+	unsigned char *end;
+
+	assert(skb != NULL);
+
+	if (offset >= skb->len) {
+		return 0;
+	}
+	len = min(len, skb->len - offset);
+
+	end = to;
+	skb_for_each_chunk(skb, offset, len, skb_copy_chunk, &end);
+
+	return end - (unsigned char *) to;
+}
+
 void skb_rshift(struct sk_buff *skb, size_t count) {
 	assert(skb != NULL);
 	assert(skb->data != NULL);
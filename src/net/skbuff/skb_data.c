@@ -88,17 +88,18 @@ struct sk_buff_data * skb_data_alloc(size_t size) {
 	struct sk_buff_data_fixed *skb_data;
 	int alloc_type = -1;
 
-	sp = ipl_save();
-	{
-		if (!skb_data_is_huge(size)) {
-			skb_data = pool_alloc(&skb_data_pool);
-			alloc_type = ALLOCATED_POOL;
-		} else {
+	if (!skb_data_is_huge(size)) {
+		/* Pool is safe to use from any context by itself */
+		skb_data = pool_alloc(&skb_data_pool);
+		alloc_type = ALLOCATED_POOL;
+	} else {
+		sp = ipl_save();
+		{
 			skb_data = sysmalloc(SKB_DATA_SIZE(size));
-			alloc_type = ALLOCATED_MALLOC;
 		}
+		ipl_restore(sp);
+		alloc_type = ALLOCATED_MALLOC;
 	}
-	ipl_restore(sp);
 
 	if (skb_data == NULL) {
 		log_error("no memory skb_size = %d", size);
@@ -134,27 +135,34 @@ int skb_data_cloned(const struct sk_buff_data *data) {
 void skb_data_free(struct sk_buff_data *data) {
 	struct sk_buff_data_fixed *skb_data = (void *)data;
 	ipl_t sp;
+	int links;
 
 	assert(skb_data != NULL);
 
 	sp = ipl_save();
 	{
-		skb_data->links--;
-		assert(skb_data->links >= 0);
-
-		if (skb_data->links == 0) {
-			switch (skb_data->alloc_type) {
-			case ALLOCATED_POOL:
-				pool_free(&skb_data_pool, skb_data);
-				break;
-			case ALLOCATED_MALLOC:
-				sysfree(skb_data);
-				break;
-			default:
-				log_error("Wrong skb->alloc_type = %d", skb_data->alloc_type);
-				break;
-			}
-		}
+		links = --skb_data->links;
+		assert(links >= 0);
 	}
 	ipl_restore(sp);
+
+	if (links != 0) {
+		return;
+	}
+
+	switch (skb_data->alloc_type) {
+	case ALLOCATED_POOL:
+		pool_free(&skb_data_pool, skb_data);
+		break;
+	case ALLOCATED_MALLOC:
+		sp = ipl_save();
+		{
+			sysfree(skb_data);
+		}
+		ipl_restore(sp);
+		break;
+	default:
+		log_error("Wrong skb->alloc_type = %d", skb_data->alloc_type);
+		break;
+	}
 }
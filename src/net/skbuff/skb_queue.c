@@ -29,6 +29,13 @@ void skb_queue_purge(struct sk_buff_head *queue) {
 	}
 }
 
+void __skb_queue_push(struct sk_buff_head *queue, struct sk_buff *skb) {
+	assert(queue != NULL);
+	assert(skb != NULL);
+
+	list_move_tail((struct list_head *)skb, (struct list_head *)queue);
+}
+
 void skb_queue_push(struct sk_buff_head *queue, struct sk_buff *skb) {
 	ipl_t sp;
 
@@ -38,7 +45,7 @@ void skb_queue_push(struct sk_buff_head *queue, struct sk_buff *skb) {
 
 	sp = ipl_save();
 	{
-		list_move_tail((struct list_head *)skb, (struct list_head *)queue);
+		__skb_queue_push(queue, skb);
 	}
 	ipl_restore(sp);
 }
@@ -60,6 +67,17 @@ struct sk_buff * skb_queue_front(struct sk_buff_head *queue) {
 	return skb;
 }
 
+struct sk_buff * __skb_queue_pop(struct sk_buff_head *queue) {
+	struct sk_buff *skb;
+
+	skb = skb_queue_front(queue);
+	if (skb != NULL) {
+		list_del_init((struct list_head *)skb);
+	}
+
+	return skb;
+}
+
 struct sk_buff * skb_queue_pop(struct sk_buff_head *queue) {
 	ipl_t sp;
 	struct sk_buff *skb;
@@ -70,16 +88,37 @@ struct sk_buff * skb_queue_pop(struct sk_buff_head *queue) {
 
 	sp = ipl_save();
 	{
-		skb = skb_queue_front(queue);
-		if (skb != NULL) {
-			list_del_init((struct list_head *)skb);
-		}
+		skb = __skb_queue_pop(queue);
 	}
 	ipl_restore(sp);
 
 	return skb;
 }
 
+int skb_queue_splice(struct sk_buff_head *queue, struct sk_buff_head *list,
+		int max) {
+	ipl_t sp;
+	struct sk_buff *skb;
+	int n;
+
+	assert(queue != NULL);
+	assert(list != NULL);
+
+	sp = ipl_save();
+	{
+		for (n = 0; n < max; ++n) {
+			skb = __skb_queue_pop(queue);
+			if (skb == NULL) {
+				break;
+			}
+			__skb_queue_push(list, skb);
+		}
+	}
+	ipl_restore(sp);
+
+	return n;
+}
+
 int skb_queue_count(struct sk_buff_head *queue) {
 	int n = 0;
 	struct sk_buff *skb = queue->next;
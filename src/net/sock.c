@@ -9,6 +9,7 @@
 #include <poll.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include <util/math.h>
 
@@ -100,6 +101,23 @@ static struct sk_buff *sock_get_skb(struct sock *sk, unsigned long timeout, int
 	return skb;
 }
 
+/* Same as skb_iovec_buf() but for data scattered over fragments */
+static int sock_iovec_skb(const struct iovec *iov, int iovlen,
+		const struct sk_buff *skb) {
+	size_t off, end;
+	int i_io;
+
+	off = skb->p_data - skb->mac.raw;
+	end = skb->p_data_end - skb->mac.raw;
+
+	for (i_io = 0; (off < end) && (i_io < iovlen); ++i_io) {
+		off += skb_copy_bits(skb, off, iov[i_io].iov_base,
+				min(iov[i_io].iov_len, end - off));
+	}
+
+	return off - (skb->p_data - skb->mac.raw);
+}
+
 int sock_dgram_recvmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	const unsigned long timeout = sock_calc_timeout(sk);
 	struct sk_buff *skb;
@@ -114,8 +132,12 @@ int sock_dgram_recvmsg(struct sock *sk, struct msghdr *msg, int flags) {
 		return err;
 	}
 
-	nrecv = skb_iovec_buf(msg->msg_iov, msg->msg_iovlen,
-			skb->p_data, skb->p_data_end - skb->p_data);
+	if (skb_is_nonlinear(skb)) {
+		nrecv = sock_iovec_skb(msg->msg_iov, msg->msg_iovlen, skb);
+	} else {
+		nrecv = skb_iovec_buf(msg->msg_iov, msg->msg_iovlen,
+				skb->p_data, skb->p_data_end - skb->p_data);
+	}
 
 	sk->rx_data_len -= skb->p_data_end - skb->p_data;
 
@@ -81,6 +81,7 @@ static void __inet_bind(struct inet_sock *in_sk,
 	assert(addr_in != NULL);
 	assert(addr_in->sin_family == AF_INET);
 	memcpy(&in_sk->src_in, addr_in, sizeof *addr_in);
+	sock_rehash(&in_sk->sk);
 }
 
 static int inet_addr_tester(const struct sockaddr *lhs_sa,
@@ -236,6 +237,7 @@ static int __inet_connect(struct inet_sock *in_sk,
 	in_sk->src_in.sin_addr.s_addr = src_ip;
 
 	memcpy(&in_sk->dst_in, addr_in, sizeof *addr_in);
+	sock_rehash(&in_sk->sk);
 
 	return 0;
 }
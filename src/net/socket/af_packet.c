@@ -215,7 +215,12 @@ static int packet_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	skb = skb_alloc(msg->msg_iov[0].iov_len);
 	memcpy(skb->mac.raw, msg->msg_iov[0].iov_base, msg->msg_iov[0].iov_len);
 	if (dev->drv_ops && dev->drv_ops->xmit) {
-		dev->drv_ops->xmit(dev, skb);
+		/* Driver keeps skb only if it accepted it */
+		if (dev->drv_ops->xmit(dev, skb) != 0) {
+			skb_free(skb);
+		}
+	} else {
+		skb_free(skb);
 	}
 	return 0;
 }
@@ -252,7 +257,9 @@ void sock_packet_add(struct sk_buff *skb, unsigned short protocol) {
 				|| psk->sll.sll_ifindex == skb->dev->index);
 
 		if (proto_check && iface_check) {
-			skb_queue_push(&psk->rx_q, skb_clone(skb));
+			/* Readers expect flat data */
+			skb_queue_push(&psk->rx_q, skb_is_nonlinear(skb)
+					? skb_copy(skb) : skb_clone(skb));
 			sock_notify(&psk->sk, POLLIN | POLLERR);
 		}
 	}
@@ -1,81 +1,1014 @@
 /**
  * @file
  *
- * @brief PF_UNIX protocol family socket handler
+ * @brief AF_UNIX protocol family socket handler
+ *
+ * @details Names are kept in a hash table of this module instead of file
+ *   system nodes. Data is copied once into sk_buff which is queued straight
+ *   to the receive queue of the peer socket, so neither IP stack nor loopback
+ *   device are involved. Descriptors passed with SCM_RIGHTS are referenced
+ *   while they are in flight and are installed into the receiver's table by
+ *   recvmsg().
  *
  * @date 31.01.2012
  * @author Anton Bondarev
  */
+#include <assert.h>
 #include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include <util/dlist.h>
+#include <util/math.h>
+#include <util/err.h>
+
+#include <mem/misc/pool.h>
+#include <kernel/sched.h>
+#include <kernel/sched/sched_lock.h>
+#include <kernel/task.h>
+#include <kernel/task/resource/idesc.h>
+#include <kernel/task/resource/idesc_event.h>
+#include <kernel/task/resource/idesc_table.h>
+#include <kernel/time/time.h>
 
 #include <net/sock.h>
+#include <net/sock_wait.h>
+#include <net/skbuff.h>
 
 #include "family.h"
+#include "net_sock.h"
+
+#include <framework/mod/options.h>
+#include <embox/unit.h>
+
+EMBOX_UNIT_INIT(af_unix_init);
 
-EMBOX_NET_FAMILY(AF_UNIX, unix_create);
+#define MAX_SOCKS      OPTION_GET(NUMBER, max_socks)
+#define NAME_HASH_SIZE OPTION_GET(NUMBER, name_hash_size)
+#define MAX_SCM        OPTION_GET(NUMBER, max_scm)
+#define SCM_MAX_FD     OPTION_GET(NUMBER, scm_max_fd)
 
-/* Prototypes */
-static const struct family_ops unix_dgram_ops;
-static const struct family_ops unix_stream_ops;
-static const struct family_ops unix_seqpacket_ops;
-static const struct proto unix_proto;
+/* Length of the unnamed address, i.e. only sun_family */
+#define UNIX_ADDR_MIN  offsetof(struct sockaddr_un, sun_path)
+
+/* Descriptors which are in flight */
+struct unix_scm {
+	int nfds;
+	struct idesc *fds[SCM_MAX_FD];
+};
+
+/* Stored in skb->cb. The sender address is placed just before data */
+struct unix_skb_parms {
+	struct unix_scm *scm;
+	socklen_t addr_len;
+};
+
+#define UNIX_SKB_PARMS(skb) ((struct unix_skb_parms *)(skb)->cb)
 
 struct unix_sock {
 	/* sk has to be the first member */
 	struct sock sk;
+
+	struct sockaddr_un addr;      /* Bound name */
+	socklen_t addr_len;           /* UNIX_ADDR_MIN for unnamed socket */
+	struct sockaddr_un peer_addr;
+	socklen_t peer_addr_len;
+	struct dlist_head name_lnk;
+
+	struct unix_sock *peer;       /* Where data is sent by default */
+	int peer_closed;              /* Peer was closed after connection */
+	int peer_shut;                /* Peer will send nothing more */
+
+	/* Connected but not accepted yet sockets of a listening socket */
+	struct dlist_head accept_q;
+	struct dlist_head accept_lnk;
+	int backlog;
+	int accept_len;
+
+	int writers;                  /* Senders waiting for our rx_queue */
+	struct unix_sock *wait_for;   /* Receiver we are waiting for */
 };
 
-static int supported_sock_type(struct socket *sock) {
-	switch (sock->type) {
-	default:
-		return -ESOCKTNOSUPPORT;
-	case SOCK_STREAM:
-		sock->ops = &unix_stream_ops;
-		break;
-	case SOCK_RAW:
-		sock->type = SOCK_DGRAM;
-	case SOCK_DGRAM:
-		sock->ops = &unix_dgram_ops;
-		break;
-	case SOCK_SEQPACKET:
-		sock->ops = &unix_seqpacket_ops;
-		break;
+POOL_DEF(unix_sock_pool, struct unix_sock, MAX_SOCKS);
+POOL_DEF(unix_scm_pool, struct unix_scm, MAX_SCM);
+
+static struct dlist_head unix_name_ht[NAME_HASH_SIZE];
+
+static inline struct unix_sock *to_unix_sock(struct sock *sk) {
+	return (struct unix_sock *)sk;
+}
+
+static inline int unix_connection_mode(const struct sock *sk) {
+	return sk->opt.so_type != SOCK_DGRAM;
+}
+
+/******************** names *******************/
+static uint32_t unix_name_hash(const struct sockaddr_un *addr,
+		socklen_t addr_len) {
+	const unsigned char *ptr = (const unsigned char *)addr->sun_path;
+	uint32_t hash = 2166136261u;
+
+	for (addr_len -= UNIX_ADDR_MIN; addr_len > 0; addr_len--) {
+		hash ^= *ptr++;
+		hash *= 16777619u;
 	}
 
-	return ENOERR;
+	return hash;
 }
 
-static int unix_create(struct socket *sock, int type, int protocol) {
-	int res;
+static inline struct dlist_head *unix_name_bucket(
+		const struct sockaddr_un *addr, socklen_t addr_len) {
+	return &unix_name_ht[unix_name_hash(addr, addr_len) % NAME_HASH_SIZE];
+}
+
+/**
+ * @brief Check the address and calculate its significant length
+ *
+ * @details Pathnames are compared up to the terminating zero, abstract
+ *   names (the ones which start from zero byte) are compared as is.
+ */
+static int unix_addr_check(const struct sockaddr *addr, socklen_t addrlen,
+		socklen_t *out_len) {
+	const struct sockaddr_un *sun = (const struct sockaddr_un *)addr;
+	size_t path_len;
+
+	if ((addrlen <= UNIX_ADDR_MIN) || (addrlen > sizeof *sun)
+			|| (addr->sa_family != AF_UNIX)) {
+		return -EINVAL;
+	}
+
+	path_len = addrlen - UNIX_ADDR_MIN;
+	if (sun->sun_path[0] != '\0') {
+		path_len = min(strnlen(sun->sun_path, path_len) + 1,
+				sizeof sun->sun_path);
+	}
+
+	*out_len = UNIX_ADDR_MIN + path_len;
+
+	return 0;
+}
+
+static struct unix_sock *unix_find(const struct sockaddr_un *addr,
+		socklen_t addr_len) {
+	struct unix_sock *u;
+
+	dlist_foreach_entry(u, unix_name_bucket(addr, addr_len), name_lnk) {
+		if ((u->addr_len == addr_len) && !memcmp(u->addr.sun_path,
+					addr->sun_path, addr_len - UNIX_ADDR_MIN)) {
+			return u;
+		}
+	}
+
+	return NULL;
+}
+
+static void unix_fill_addr(struct sockaddr *addr, socklen_t *addrlen,
+		const struct sockaddr_un *src, socklen_t src_len) {
+	if ((addr == NULL) || (addrlen == NULL)) {
+		return;
+	}
+
+	memcpy(addr, src, min(*addrlen, src_len));
+	*addrlen = src_len;
+}
+
+/******************** iovec *******************/
+struct unix_iov_iter {
+	const struct iovec *iov;
+	int cnt;
+	size_t off;
+};
+
+static void unix_iov_iter_init(struct unix_iov_iter *it,
+		const struct msghdr *msg) {
+	it->iov = msg->msg_iov;
+	it->cnt = msg->msg_iovlen;
+	it->off = 0;
+}
+
+static size_t unix_iov_copy(struct unix_iov_iter *it, void *buf,
+		size_t len, int to_iov) {
+	size_t done, chunk;
+
+	for (done = 0; (done < len) && (it->cnt > 0); done += chunk) {
+		chunk = min(len - done, it->iov->iov_len - it->off);
+		if (to_iov) {
+			memcpy(it->iov->iov_base + it->off, buf + done, chunk);
+		} else {
+			memcpy(buf + done, it->iov->iov_base + it->off, chunk);
+		}
+
+		it->off += chunk;
+		if (it->off == it->iov->iov_len) {
+			it->iov++;
+			it->cnt--;
+			it->off = 0;
+		}
+	}
+
+	return done;
+}
+
+static size_t unix_iov_len(const struct msghdr *msg) {
+	size_t len;
+	int i;
+
+	for (len = 0, i = 0; i < msg->msg_iovlen; i++) {
+		len += msg->msg_iov[i].iov_len;
+	}
+
+	return len;
+}
+
+/******************** SCM_RIGHTS *******************/
+static void unix_scm_put(struct unix_scm *scm) {
+	struct idesc *idesc;
+	int i;
+
+	for (i = 0; i < scm->nfds; i++) {
+		idesc = scm->fds[i];
+		if (!(--idesc->idesc_count)) {
+			idesc_watch_release(idesc);
+			idesc->idesc_ops->close(idesc);
+		}
+	}
+
+	pool_free(&unix_scm_pool, scm);
+}
+
+static int unix_scm_get(const struct msghdr *msg, struct unix_scm **out) {
+	struct idesc_table *it;
+	struct cmsghdr *cmsg;
+	struct unix_scm *scm;
+	struct idesc *idesc;
+	int i, nfds, fd, ret;
+
+	*out = NULL;
+	if ((msg->msg_control == NULL) || (msg->msg_controllen == 0)) {
+		return 0;
+	}
+
+	it = task_resource_idesc_table(task_self());
+	assert(it);
+
+	scm = NULL;
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+			cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if ((cmsg->cmsg_len < CMSG_LEN(0))
+				|| (cmsg->cmsg_level != SOL_SOCKET)
+				|| (cmsg->cmsg_type != SCM_RIGHTS)) {
+			ret = -EINVAL;
+			goto out_err;
+		}
+
+		if (scm == NULL) {
+			scm = pool_alloc(&unix_scm_pool);
+			if (scm == NULL) {
+				return -ENOBUFS;
+			}
+			scm->nfds = 0;
+		}
+
+		nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		if (scm->nfds + nfds > SCM_MAX_FD) {
+			ret = -ETOOMANYREFS;
+			goto out_err;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			memcpy(&fd, (int *)CMSG_DATA(cmsg) + i, sizeof fd);
+			if (!idesc_index_valid(fd)
+					|| (NULL == (idesc = idesc_table_get(it, fd)))) {
+				ret = -EBADF;
+				goto out_err;
+			}
+
+			idesc->idesc_count++;
+			scm->fds[scm->nfds++] = idesc;
+		}
+	}
+
+	*out = scm;
+	return 0;
+
+out_err:
+	if (scm != NULL) {
+		unix_scm_put(scm);
+	}
+	return ret;
+}
+
+static void unix_scm_recv(struct msghdr *msg, struct unix_scm *scm,
+		size_t control_len) {
+	struct idesc_table *it;
+	struct cmsghdr *cmsg;
+	int i, n, max, fd;
+
+	it = task_resource_idesc_table(task_self());
+	assert(it);
+
+	max = 0;
+	if ((msg->msg_control != NULL) && (control_len >= CMSG_LEN(sizeof fd))) {
+		max = (control_len - CMSG_LEN(0)) / sizeof fd;
+	}
+
+	cmsg = msg->msg_control;
+	for (i = 0, n = 0; i < scm->nfds; i++) {
+		if ((n == max) || (0 > (fd = idesc_table_add(it, scm->fds[i], 0)))) {
+			msg->msg_flags |= MSG_CTRUNC;
+			continue;
+		}
+		memcpy((int *)CMSG_DATA(cmsg) + n++, &fd, sizeof fd);
+	}
+
+	if (n != 0) {
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(n * sizeof fd);
+		msg->msg_controllen = min(control_len, CMSG_SPACE(n * sizeof fd));
+	}
+
+	/* Installed descriptors are referenced by the table now */
+	unix_scm_put(scm);
+}
+
+/******************** data path *******************/
+/* Wake up senders blocked by full receive queue of @a u */
+static void unix_wake_writers(struct unix_sock *u) {
 	struct sock *sk;
 
-	res = supported_sock_type(sock);
-	if (res < 0) {
-		return res;
+	if (u->writers == 0) {
+		return;
+	}
+
+	sock_foreach(sk, u->sk.p_ops) {
+		if (to_unix_sock(sk)->wait_for == u) {
+			sock_notify(sk, POLLOUT);
+		}
+	}
+}
+
+/* Scheduler has to be locked */
+static int unix_wait_space(struct unix_sock *u, struct unix_sock *target,
+		size_t len) {
+	struct sock *tsk = &target->sk;
+	int ret;
+
+	/* Empty queue accepts a message of any allowed size */
+	while ((tsk->rx_data_len != 0)
+			&& (tsk->rx_data_len + len > tsk->opt.so_rcvbuf)) {
+		if (tsk->shutdown_flag & (SHUT_RD + 1)) {
+			return -EPIPE;
+		}
+
+		u->wait_for = target;
+		target->writers++;
+
+		ret = sock_wait(&u->sk, POLLOUT | POLLERR,
+				timeval_to_ms(&u->sk.opt.so_sndtimeo));
+
+		if (u->wait_for == NULL) {
+			return -EPIPE; /* receiver was closed meanwhile */
+		}
+		u->wait_for = NULL;
+		target->writers--;
+
+		if (ret != 0) {
+			return ret;
+		}
 	}
 
-	sk = sk_alloc(/*net,*/PF_UNIX, (struct proto *)&unix_proto);
-	if (sk == NULL) {
-		return -ENOMEM;
+	return 0;
+}
+
+/* Scheduler has to be locked */
+static int unix_get_target(struct unix_sock *u, const struct msghdr *msg,
+		struct unix_sock **target) {
+	struct unix_sock *t;
+	socklen_t addr_len;
+	int ret;
+
+	if (msg->msg_name != NULL) {
+		ret = unix_addr_check(msg->msg_name, msg->msg_namelen, &addr_len);
+		if (ret != 0) {
+			return ret;
+		}
+
+		t = unix_find(msg->msg_name, addr_len);
+		if (t == NULL) {
+			return -ECONNREFUSED;
+		}
+		if (t->sk.opt.so_type != u->sk.opt.so_type) {
+			return -EPROTOTYPE;
+		}
+	} else {
+		t = u->peer;
+		if (t == NULL) {
+			if (!u->peer_closed) {
+				return -ENOTCONN;
+			}
+			return unix_connection_mode(&u->sk) ? -EPIPE : -ECONNREFUSED;
+		}
+	}
+
+	if (t->sk.shutdown_flag & (SHUT_RD + 1)) {
+		return -EPIPE;
+	}
+
+	*target = t;
+
+	return 0;
+}
+
+static int unix_stream_send(struct unix_sock *u, struct msghdr *msg,
+		size_t len, struct unix_scm **scm) {
+	struct unix_iov_iter it;
+	struct unix_sock *target;
+	struct sk_buff *skb;
+	size_t sent, chunk;
+	int ret;
+
+	unix_iov_iter_init(&it, msg);
+
+	ret = 0;
+	for (sent = 0; sent < len; sent += chunk) {
+		chunk = min(len - sent, skb_max_size());
+
+		ret = unix_get_target(u, msg, &target);
+		if (ret != 0) {
+			break;
+		}
+
+		ret = unix_wait_space(u, target, chunk);
+		if (ret != 0) {
+			break;
+		}
+		/* Peer could be closed while we slept */
+		ret = unix_get_target(u, msg, &target);
+		if (ret != 0) {
+			break;
+		}
+
+		skb = skb_alloc(chunk);
+		if (skb == NULL) {
+			ret = -ENOBUFS;
+			break;
+		}
+
+		unix_iov_copy(&it, skb->mac.raw, chunk, 0);
+		UNIX_SKB_PARMS(skb)->scm = *scm;
+		UNIX_SKB_PARMS(skb)->addr_len = 0;
+		*scm = NULL;
+
+		sock_rcv(&target->sk, skb, skb->mac.raw, chunk);
+	}
+
+	return sent != 0 ? sent : ret;
+}
+
+static int unix_dgram_send(struct unix_sock *u, struct msghdr *msg,
+		size_t len, struct unix_scm **scm) {
+	struct unix_iov_iter it;
+	struct unix_sock *target;
+	struct sk_buff *skb;
+	int ret;
+
+	if (len > u->sk.opt.so_sndbuf) {
+		return -EMSGSIZE;
+	}
+
+	ret = unix_get_target(u, msg, &target);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = unix_wait_space(u, target, len);
+	if (ret != 0) {
+		return ret;
+	}
+	ret = unix_get_target(u, msg, &target);
+	if (ret != 0) {
+		return ret;
 	}
 
-	return ENOERR;
+	skb = skb_alloc(u->addr_len + len);
+	if (skb == NULL) {
+		return -ENOBUFS;
+	}
+
+	memcpy(skb->mac.raw, &u->addr, u->addr_len);
+	unix_iov_iter_init(&it, msg);
+	unix_iov_copy(&it, skb->mac.raw + u->addr_len, len, 0);
+	UNIX_SKB_PARMS(skb)->scm = *scm;
+	UNIX_SKB_PARMS(skb)->addr_len = u->addr_len;
+	*scm = NULL;
+
+	sock_rcv(&target->sk, skb, skb->mac.raw + u->addr_len, len);
+
+	return len;
 }
 
-static const struct family_ops unix_dgram_ops = {
-		.family =	PF_UNIX,
+/* Scheduler has to be locked. Returns 1 if there is data, 0 on EOF */
+static int unix_wait_data(struct unix_sock *u) {
+	struct sock *sk = &u->sk;
+	int ret;
+
+	while (skb_queue_front(&sk->rx_queue) == NULL) {
+		if (unix_connection_mode(sk) && ((u->peer == NULL) || u->peer_shut)) {
+			return 0;
+		}
+
+		ret = sock_wait(sk, POLLIN | POLLERR,
+				timeval_to_ms(&sk->opt.so_rcvtimeo));
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	return 1;
+}
+
+static int unix_stream_recv(struct unix_sock *u, struct msghdr *msg,
+		struct unix_scm **scm) {
+	struct sock *sk = &u->sk;
+	struct unix_iov_iter it;
+	struct sk_buff *skb;
+	size_t total, len;
+
+	unix_iov_iter_init(&it, msg);
+
+	total = 0;
+	while ((it.cnt > 0) && (NULL != (skb = skb_queue_front(&sk->rx_queue)))) {
+		if (UNIX_SKB_PARMS(skb)->scm != NULL) {
+			if ((total != 0) || (*scm != NULL)) {
+				break; /* descriptors are delivered with their own data */
+			}
+			*scm = UNIX_SKB_PARMS(skb)->scm;
+			UNIX_SKB_PARMS(skb)->scm = NULL;
+		}
+
+		len = unix_iov_copy(&it, skb->p_data, skb->p_data_end - skb->p_data, 1);
+		skb->p_data += len;
+		sk->rx_data_len -= len;
+		total += len;
+
+		if (skb->p_data == skb->p_data_end) {
+			skb_free(skb);
+		}
+	}
+
+	return total;
+}
+
+static int unix_dgram_recv(struct unix_sock *u, struct msghdr *msg,
+		struct unix_scm **scm) {
+	struct sock *sk = &u->sk;
+	struct unix_iov_iter it;
+	struct sk_buff *skb;
+	size_t len, copied;
+	socklen_t addr_len;
+
+	skb = skb_queue_front(&sk->rx_queue);
+	assert(skb != NULL);
+
+	len = skb->p_data_end - skb->p_data;
+	unix_iov_iter_init(&it, msg);
+	copied = unix_iov_copy(&it, skb->p_data, len, 1);
+	if (copied < len) {
+		msg->msg_flags |= MSG_TRUNC;
+	}
+
+	if (msg->msg_name != NULL) {
+		addr_len = UNIX_SKB_PARMS(skb)->addr_len;
+		memcpy(msg->msg_name, skb->mac.raw, min(msg->msg_namelen, addr_len));
+		msg->msg_namelen = addr_len;
+	}
+
+	*scm = UNIX_SKB_PARMS(skb)->scm;
+	sk->rx_data_len -= len;
+	skb_free(skb);
+
+	return copied;
+}
+
+/******************** socket operations *******************/
+static int unix_sock_init(struct sock *sk) {
+	struct unix_sock *u = to_unix_sock(sk);
+
+	memset(&u->addr, 0, sizeof u->addr);
+	u->addr.sun_family = AF_UNIX;
+	u->addr_len = UNIX_ADDR_MIN;
+	memcpy(&u->peer_addr, &u->addr, sizeof u->peer_addr);
+	u->peer_addr_len = UNIX_ADDR_MIN;
+	dlist_head_init(&u->name_lnk);
+
+	u->peer = NULL;
+	u->peer_closed = 0;
+	u->peer_shut = 0;
+
+	dlist_init(&u->accept_q);
+	dlist_head_init(&u->accept_lnk);
+	u->backlog = 0;
+	u->accept_len = 0;
+
+	u->writers = 0;
+	u->wait_for = NULL;
+
+	sk->src_addr = (struct sockaddr *)&u->addr;
+	sk->dst_addr = (struct sockaddr *)&u->peer_addr;
+	sk->addr_len = sizeof u->addr;
+
+	return 0;
+}
+
+static int unix_sock_close(struct sock *sk) {
+	struct unix_sock *u = to_unix_sock(sk);
+	struct unix_sock *embryo;
+	struct sk_buff *skb;
+	struct sock *other;
+
+	sched_lock();
+	{
+		if (!dlist_empty(&u->name_lnk)) {
+			dlist_del_init(&u->name_lnk);
+		}
+
+		/* Nobody is able to reach us after that */
+		sock_foreach(other, sk->p_ops) {
+			struct unix_sock *uo = to_unix_sock(other);
+
+			if (uo->peer == u) {
+				uo->peer = NULL;
+				uo->peer_closed = 1;
+				sock_notify(other, POLLIN | POLLOUT | POLLERR);
+			}
+			if (uo->wait_for == u) {
+				uo->wait_for = NULL;
+				u->writers--;
+				sock_notify(other, POLLOUT | POLLERR);
+			}
+		}
+		assert(u->writers == 0);
+	}
+	sched_unlock();
+
+	/* Close connections which were not accepted */
+	while (1) {
+		sched_lock();
+		{
+			if (dlist_empty(&u->accept_q)) {
+				sched_unlock();
+				break;
+			}
+			embryo = dlist_first_entry(&u->accept_q, struct unix_sock,
+					accept_lnk);
+			dlist_del_init(&embryo->accept_lnk);
+		}
+		sched_unlock();
+
+		sock_close(&embryo->sk);
+	}
+
+	/* Drop descriptors which are still in flight */
+	while (NULL != (skb = skb_queue_pop(&sk->rx_queue))) {
+		if (UNIX_SKB_PARMS(skb)->scm != NULL) {
+			unix_scm_put(UNIX_SKB_PARMS(skb)->scm);
+		}
+		skb_free(skb);
+	}
+
+	sock_release(sk);
+
+	return 0;
+}
+
+static int unix_sock_bind(struct sock *sk, const struct sockaddr *addr,
+		socklen_t addrlen) {
+	struct unix_sock *u = to_unix_sock(sk);
+	socklen_t addr_len;
+	int ret;
+
+	ret = unix_addr_check(addr, addrlen, &addr_len);
+	if (ret != 0) {
+		return ret;
+	}
+
+	sched_lock();
+	{
+		if (u->addr_len != UNIX_ADDR_MIN) {
+			ret = -EINVAL; /* already has a name */
+		} else if (unix_find((const struct sockaddr_un *)addr, addr_len)) {
+			ret = -EADDRINUSE;
+		} else {
+			memcpy(&u->addr, addr, addr_len);
+			u->addr_len = addr_len;
+			dlist_add_prev(&u->name_lnk,
+					unix_name_bucket(&u->addr, addr_len));
+		}
+	}
+	sched_unlock();
+
+	return ret;
+}
+
+static int unix_sock_bind_local(struct sock *sk) {
+	/* Socket stays unnamed */
+	return 0;
+}
+
+static int unix_sock_connect(struct sock *sk, const struct sockaddr *addr,
+		socklen_t addrlen, int flags) {
+	struct unix_sock *u = to_unix_sock(sk);
+	struct unix_sock *target, *embryo;
+	struct sock *new_sk;
+	socklen_t addr_len;
+	int ret;
+
+	ret = unix_addr_check(addr, addrlen, &addr_len);
+	if (ret != 0) {
+		return ret;
+	}
+
+	new_sk = NULL;
+	if (unix_connection_mode(sk)) {
+		/* Accepted socket is created here, so client may send data
+		 * right after connect() returns */
+		new_sk = sock_create(AF_UNIX, sk->opt.so_type, sk->opt.so_protocol);
+		if (err(new_sk)) {
+			return err(new_sk);
+		}
+	}
+
+	sched_lock();
+	{
+		if (u->peer != NULL && new_sk != NULL) {
+			ret = -EISCONN;
+			goto out;
+		}
+
+		target = unix_find((const struct sockaddr_un *)addr, addr_len);
+		if (target == NULL) {
+			ret = -ECONNREFUSED;
+			goto out;
+		}
+		if (target->sk.opt.so_type != sk->opt.so_type) {
+			ret = -EPROTOTYPE;
+			goto out;
+		}
+
+		if (new_sk == NULL) {
+			u->peer = target;
+			u->peer_closed = 0;
+			memcpy(&u->peer_addr, &target->addr, target->addr_len);
+			u->peer_addr_len = target->addr_len;
+			goto out;
+		}
+
+		if (!sock_state_listening(&target->sk)
+				|| (target->accept_len >= target->backlog)) {
+			/* Don't wait for the backlog to drain */
+			ret = -ECONNREFUSED;
+			goto out;
+		}
+
+		embryo = to_unix_sock(new_sk);
+		memcpy(&embryo->addr, &target->addr, target->addr_len);
+		embryo->addr_len = target->addr_len;
+		memcpy(&embryo->peer_addr, &u->addr, u->addr_len);
+		embryo->peer_addr_len = u->addr_len;
+		embryo->peer = u;
+		sock_set_state(new_sk, SS_CONNECTED);
+
+		memcpy(&u->peer_addr, &target->addr, target->addr_len);
+		u->peer_addr_len = target->addr_len;
+		u->peer = embryo;
+		new_sk = NULL;
+
+		dlist_add_prev(&embryo->accept_lnk, &target->accept_q);
+		target->accept_len++;
+		/* Listening socket is readable while it has connections */
+		target->sk.rx_data_len++;
+		sock_notify(&target->sk, POLLIN);
+	}
+out:
+	sched_unlock();
+
+	if (new_sk != NULL) {
+		sock_close(new_sk);
+	}
+
+	return ret;
+}
+
+static int unix_sock_listen(struct sock *sk, int backlog) {
+	to_unix_sock(sk)->backlog = backlog;
+	return 0;
+}
+
+static int unix_sock_accept(struct sock *sk, struct sockaddr *addr,
+		socklen_t *addrlen, int flags, struct sock **out_sk) {
+	struct unix_sock *u = to_unix_sock(sk);
+	struct unix_sock *embryo;
+	int ret;
+
+	sched_lock();
+	{
+		ret = 0;
+		while (dlist_empty(&u->accept_q)) {
+			ret = sock_wait(sk, POLLIN | POLLERR, SCHED_TIMEOUT_INFINITE);
+			if (ret != 0) {
+				sched_unlock();
+				return ret;
+			}
+		}
+
+		embryo = dlist_first_entry(&u->accept_q, struct unix_sock, accept_lnk);
+		dlist_del_init(&embryo->accept_lnk);
+		u->accept_len--;
+		sk->rx_data_len--;
+	}
+	sched_unlock();
+
+	unix_fill_addr(addr, addrlen, &embryo->peer_addr, embryo->peer_addr_len);
+	*out_sk = &embryo->sk;
+
+	return 0;
+}
+
+static int unix_sock_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
+	struct unix_sock *u = to_unix_sock(sk);
+	struct unix_scm *scm;
+	size_t len;
+	int ret;
+
+	if (unix_connection_mode(sk) && (msg->msg_name != NULL)) {
+		return -EISCONN;
+	}
+
+	len = unix_iov_len(msg);
+	if ((len == 0) && (sk->opt.so_type == SOCK_STREAM)) {
+		return 0;
+	}
+
+	ret = unix_scm_get(msg, &scm);
+	if (ret != 0) {
+		return ret;
+	}
+
+	sched_lock();
+	{
+		if (sk->opt.so_type == SOCK_STREAM) {
+			ret = unix_stream_send(u, msg, len, &scm);
+		} else {
+			ret = unix_dgram_send(u, msg, len, &scm);
+		}
+	}
+	sched_unlock();
+
+	if (scm != NULL) {
+		unix_scm_put(scm); /* was not attached to data */
+	}
+
+	return ret;
+}
+
+static int unix_sock_recvmsg(struct sock *sk, struct msghdr *msg, int flags) {
+	struct unix_sock *u = to_unix_sock(sk);
+	struct unix_scm *scm;
+	size_t control_len;
+	int ret;
+
+	control_len = msg->msg_controllen;
+	msg->msg_controllen = 0;
+	scm = NULL;
+
+	sched_lock();
+	{
+		ret = unix_wait_data(u);
+		if (ret > 0) {
+			if (sk->opt.so_type == SOCK_STREAM) {
+				ret = unix_stream_recv(u, msg, &scm);
+			} else {
+				ret = unix_dgram_recv(u, msg, &scm);
+			}
+			unix_wake_writers(u);
+		}
+	}
+	sched_unlock();
+
+	if (scm != NULL) {
+		unix_scm_recv(msg, scm, control_len);
+	}
+
+	return ret;
+}
+
+static int unix_sock_getsockname(struct sock *sk, struct sockaddr *addr,
+		socklen_t *addrlen) {
+	struct unix_sock *u = to_unix_sock(sk);
+
+	unix_fill_addr(addr, addrlen, &u->addr, u->addr_len);
+
+	return 0;
+}
+
+static int unix_sock_getpeername(struct sock *sk, struct sockaddr *addr,
+		socklen_t *addrlen) {
+	struct unix_sock *u = to_unix_sock(sk);
+
+	unix_fill_addr(addr, addrlen, &u->peer_addr, u->peer_addr_len);
+
+	return 0;
+}
+
+static int unix_sock_shutdown(struct sock *sk, int how) {
+	struct unix_sock *u = to_unix_sock(sk);
+
+	sched_lock();
+	{
+		if (((how + 1) & (SHUT_WR + 1)) && (u->peer != NULL)) {
+			u->peer->peer_shut = 1;
+			sock_notify(&u->peer->sk, POLLIN);
+		}
+		if ((how + 1) & (SHUT_RD + 1)) {
+			unix_wake_writers(u);
+		}
+	}
+	sched_unlock();
+
+	return 0;
+}
+
+static int unix_sock_socketpair(struct sock *sk1, struct sock *sk2) {
+	sched_lock();
+	{
+		to_unix_sock(sk1)->peer = to_unix_sock(sk2);
+		to_unix_sock(sk2)->peer = to_unix_sock(sk1);
+	}
+	sched_unlock();
+
+	return 0;
+}
+
+static const struct sock_family_ops unix_ops = {
+	.init        = unix_sock_init,
+	.close       = unix_sock_close,
+	.bind        = unix_sock_bind,
+	.bind_local  = unix_sock_bind_local,
+	.connect     = unix_sock_connect,
+	.listen      = unix_sock_listen,
+	.accept      = unix_sock_accept,
+	.sendmsg     = unix_sock_sendmsg,
+	.recvmsg     = unix_sock_recvmsg,
+	.getsockname = unix_sock_getsockname,
+	.getpeername = unix_sock_getpeername,
+	.shutdown    = unix_sock_shutdown,
+	.socketpair  = unix_sock_socketpair,
+	.sock_pool   = &unix_sock_pool
+};
+
+static const struct net_family_type unix_types[] = {
+	{ SOCK_STREAM, &unix_ops },
+	{ SOCK_DGRAM, &unix_ops },
+	{ SOCK_SEQPACKET, &unix_ops }
 };
 
-static const struct family_ops unix_stream_ops = {
-		.family =	PF_UNIX,
+struct net_pack_out_ops;
+static const struct net_pack_out_ops *out_ops_struct;
+
+EMBOX_NET_FAMILY(AF_UNIX, unix_types, out_ops_struct);
+
+static DLIST_DEFINE(unix_stream_sock_list);
+static DLIST_DEFINE(unix_dgram_sock_list);
+static DLIST_DEFINE(unix_seqpacket_sock_list);
+
+static const struct sock_proto_ops unix_stream_sock_ops = {
+	.sock_list = &unix_stream_sock_list
 };
 
-static const struct family_ops unix_seqpacket_ops = {
-		.family =	PF_UNIX,
+static const struct sock_proto_ops unix_dgram_sock_ops = {
+	.sock_list = &unix_dgram_sock_list
 };
 
-static const struct proto unix_proto = {
-		.name = "UNIX",
-		.obj_size = sizeof(struct unix_sock),
+static const struct sock_proto_ops unix_seqpacket_sock_ops = {
+	.sock_list = &unix_seqpacket_sock_list
 };
+
+EMBOX_NET_SOCK(AF_UNIX, SOCK_STREAM, 0, 1, unix_stream_sock_ops);
+EMBOX_NET_SOCK(AF_UNIX, SOCK_DGRAM, 0, 1, unix_dgram_sock_ops);
+EMBOX_NET_SOCK(AF_UNIX, SOCK_SEQPACKET, 0, 1, unix_seqpacket_sock_ops);
+
+static int af_unix_init(void) {
+	int i;
+
+	for (i = 0; i < NAME_HASH_SIZE; i++) {
+		dlist_init(&unix_name_ht[i]);
+	}
+
+	return 0;
+}
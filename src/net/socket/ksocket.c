@@ -28,6 +28,11 @@
 
 #define MODOPS_CONNECT_TIMEOUT OPTION_GET(NUMBER, connect_timeout)
 
+static inline int sock_type_connection(const struct sock *sk) {
+	return (sk->opt.so_type == SOCK_STREAM)
+			|| (sk->opt.so_type == SOCK_SEQPACKET);
+}
+
 struct sock *ksocket(int family, int type, int protocol) {
 	struct sock *new_sk;
 
@@ -41,6 +46,46 @@ struct sock *ksocket(int family, int type, int protocol) {
 	return new_sk;
 }
 
+int ksocketpair(int family, int type, int protocol, struct sock *sv[2]) {
+	struct sock *sk1, *sk2;
+	int ret;
+
+	sk1 = ksocket(family, type, protocol);
+	if (0 != err(sk1)) {
+		return err(sk1);
+	}
+
+	sk2 = ksocket(family, type, protocol);
+	if (0 != err(sk2)) {
+		ksocket_close(sk1);
+		return err(sk2);
+	}
+
+	assert(sk1->f_ops != NULL);
+	if (sk1->f_ops->socketpair == NULL) {
+		ret = -EOPNOTSUPP;
+		goto out_close;
+	}
+
+	ret = sk1->f_ops->socketpair(sk1, sk2);
+	if (ret != 0) {
+		goto out_close;
+	}
+
+	sock_set_state(sk1, SS_CONNECTED);
+	sock_set_state(sk2, SS_CONNECTED);
+
+	sv[0] = sk1;
+	sv[1] = sk2;
+
+	return 0;
+
+out_close:
+	ksocket_close(sk2);
+	ksocket_close(sk1);
+	return ret;
+}
+
 void ksocket_close(struct sock *sk) {
 	assert(sk);
 
@@ -96,7 +141,7 @@ int kconnect(struct sock *sk, const struct sockaddr *addr,
 		return -EAFNOSUPPORT;
 	}
 
-	if ((sk->opt.so_type == SOCK_STREAM) && sock_state_connected(sk)) {
+	if (sock_type_connection(sk) && sock_state_connected(sk)) {
 		return -EISCONN;
 	}
 
@@ -155,7 +200,7 @@ int klisten(struct sock *sk, int backlog) {
 
 	backlog = backlog > 0 ? backlog : 1;
 
-	if (sk->opt.so_type != SOCK_STREAM) {
+	if (!sock_type_connection(sk)) {
 		return -EOPNOTSUPP;
 	}
 
@@ -203,7 +248,7 @@ int kaccept(struct sock *sk, struct sockaddr *addr,
 	assert(!addr || addrlen);
 	assert(!addrlen || (*addrlen > 0));
 
-	if (sk->opt.so_type != SOCK_STREAM) {
+	if (!sock_type_connection(sk)) {
 		return -EOPNOTSUPP;
 	}
 
@@ -265,6 +310,7 @@ int ksendmsg(struct sock *sk, struct msghdr *msg, int flags) {
 		}
 		break;
 	case SOCK_STREAM:
+	case SOCK_SEQPACKET:
 		if (!sock_state_connected(sk)) {
 			return -ENOTCONN;
 		}
@@ -281,6 +327,25 @@ int ksendmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	return sk->f_ops->sendmsg(sk, msg, flags);
 }
 
+ssize_t ksplice_write(struct sock *sk, struct idesc *in, size_t len) {
+	assert(sk);
+	assert(in);
+
+	if (!sock_type_connection(sk)) {
+		return -EOPNOTSUPP;
+	}
+	if (!sock_state_connected(sk)) {
+		return -ENOTCONN;
+	}
+
+	assert(sk->p_ops != NULL);
+	if (sk->p_ops->splice_write == NULL) {
+		return -EOPNOTSUPP;
+	}
+
+	return sk->p_ops->splice_write(sk, in, len);
+}
+
 int krecvmsg(struct sock *sk, struct msghdr *msg, int flags) {
 	assert(sk);
 	assert(msg);
@@ -290,7 +355,7 @@ int krecvmsg(struct sock *sk, struct msghdr *msg, int flags) {
 //		return 0;
 //	}
 
-	if ((sk->opt.so_type == SOCK_STREAM) && !sock_state_connected(sk)) {
+	if (sock_type_connection(sk) && !sock_state_connected(sk)) {
 		return -ENOTCONN;
 	}
 
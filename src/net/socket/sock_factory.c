@@ -119,6 +119,7 @@ static void sock_init(struct sock *sk, int family, int type,
 	assert(p_ops != NULL);
 
 	dlist_head_init(&sk->lnk);
+	dlist_head_init(&sk->hash_lnk);
 	sock_opt_init(&sk->opt, family, type, protocol);
 	skb_queue_init(&sk->rx_queue);
 	skb_queue_init(&sk->tx_queue);
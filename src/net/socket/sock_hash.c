@@ -4,10 +4,104 @@
  * @date Nov 7, 2013
  * @author: Anton Bondarev
  */
+#include <stdint.h>
+#include <string.h>
+
 #include <net/sock.h>
+#include <net/socket/inet_sock.h>
+#include <net/socket/inet6_sock.h>
 #include <util/dlist.h>
 #include <hal/ipl.h>
 
+#include <framework/mod/options.h>
+#include <embox/unit.h>
+
+EMBOX_UNIT_INIT(sock_hash_init);
+
+#define SOCK_HASH_SIZE OPTION_GET(NUMBER, hash_size)
+
+/* Sockets which know both endpoints. They are keyed by
+ * (protocol, local port, remote address, remote port). Local address is
+ * not a part of the key because it may be INADDR_ANY */
+static struct dlist_head sock_ehash[SOCK_HASH_SIZE];
+
+/* Sockets bound only to a local port (listening TCP, unconnected UDP).
+ * They are keyed by (protocol, local port) */
+static struct dlist_head sock_lhash[SOCK_HASH_SIZE];
+
+static inline uint32_t sock_hash_mix(uint32_t hash, uint32_t val) {
+	hash ^= val;
+	hash *= 0x9e3779b1;
+	return hash ^ (hash >> 16);
+}
+
+static unsigned int sock_lhashfn(const struct sock_proto_ops *p_ops,
+		in_port_t lport) {
+	return sock_hash_mix((uint32_t)(uintptr_t)p_ops, lport)
+			% SOCK_HASH_SIZE;
+}
+
+static unsigned int sock_ehashfn(const struct sock_proto_ops *p_ops,
+		in_port_t lport, const void *raddr, size_t raddr_len,
+		in_port_t rport) {
+	uint32_t hash, word;
+	const char *ptr;
+
+	hash = sock_hash_mix((uint32_t)(uintptr_t)p_ops, lport);
+	hash = sock_hash_mix(hash, rport);
+
+	for (ptr = raddr; raddr_len >= sizeof word;
+			ptr += sizeof word, raddr_len -= sizeof word) {
+		memcpy(&word, ptr, sizeof word);
+		hash = sock_hash_mix(hash, word);
+	}
+
+	return hash % SOCK_HASH_SIZE;
+}
+
+static struct dlist_head * sock_hash_bucket(const struct sock *sk) {
+	in_port_t lport, rport;
+	const void *raddr;
+	size_t raddr_len;
+
+	switch (sk->opt.so_domain) {
+	case AF_INET:
+		lport = to_const_inet_sock(sk)->src_in.sin_port;
+		rport = to_const_inet_sock(sk)->dst_in.sin_port;
+		raddr = &to_const_inet_sock(sk)->dst_in.sin_addr;
+		raddr_len = sizeof to_const_inet_sock(sk)->dst_in.sin_addr;
+		break;
+	case AF_INET6:
+		lport = to_const_inet6_sock(sk)->src_in6.sin6_port;
+		rport = to_const_inet6_sock(sk)->dst_in6.sin6_port;
+		raddr = &to_const_inet6_sock(sk)->dst_in6.sin6_addr;
+		raddr_len = sizeof to_const_inet6_sock(sk)->dst_in6.sin6_addr;
+		break;
+	default:
+		return NULL; /* not an inet socket */
+	}
+
+	if (lport == 0) {
+		return NULL; /* not bound yet */
+	}
+
+	if (rport == 0) {
+		return &sock_lhash[sock_lhashfn(sk->p_ops, lport)];
+	}
+
+	return &sock_ehash[sock_ehashfn(sk->p_ops, lport, raddr, raddr_len,
+				rport)];
+}
+
+static void __sock_hash_add(struct sock *sk) {
+	struct dlist_head *bucket;
+
+	bucket = sock_hash_bucket(sk);
+	if (bucket != NULL) {
+		dlist_add_prev_entry(sk, bucket, hash_lnk);
+	}
+}
+
 void sock_hash(struct sock *sk) {
 	ipl_t ipl;
 
@@ -17,7 +111,10 @@ void sock_hash(struct sock *sk) {
 
 	/* TODO Probably, it's better to use spinlock here */
 	ipl = ipl_save();
-	dlist_add_prev_entry(sk, sk->p_ops->sock_list, lnk);
+	{
+		dlist_add_prev_entry(sk, sk->p_ops->sock_list, lnk);
+		__sock_hash_add(sk);
+	}
 	ipl_restore(ipl);
 }
 
@@ -28,6 +125,84 @@ void sock_unhash(struct sock *sk) {
 	assert(!dlist_empty_entry(sk, lnk));
 
 	ipl = ipl_save();
-	dlist_del_init_entry(sk, lnk);
+	{
+		dlist_del_init_entry(sk, lnk);
+		if (!dlist_empty_entry(sk, hash_lnk)) {
+			dlist_del_init_entry(sk, hash_lnk);
+		}
+	}
+	ipl_restore(ipl);
+}
+
+void sock_rehash(struct sock *sk) {
+	ipl_t ipl;
+
+	assert(sk != NULL);
+
+	if (dlist_empty_entry(sk, lnk)) {
+		return; /* not hashed yet, sock_hash() will do it */
+	}
+
+	ipl = ipl_save();
+	{
+		if (!dlist_empty_entry(sk, hash_lnk)) {
+			dlist_del_init_entry(sk, hash_lnk);
+		}
+		__sock_hash_add(sk);
+	}
 	ipl_restore(ipl);
 }
+
+static struct sock * sock_hash_bucket_lookup(struct dlist_head *bucket,
+		const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb) {
+	struct sock *sk;
+	ipl_t ipl;
+
+	ipl = ipl_save();
+	{
+		dlist_foreach_entry(sk, bucket, hash_lnk) {
+			if ((sk->p_ops == p_ops) && tester(sk, skb)) {
+				ipl_restore(ipl);
+				return sk;
+			}
+		}
+	}
+	ipl_restore(ipl);
+
+	return NULL; /* error: no such entity */
+}
+
+struct sock * sock_lookup_established(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		const void *raddr, size_t raddr_len, in_port_t lport,
+		in_port_t rport) {
+	if ((p_ops == NULL) || (tester == NULL) || (raddr == NULL)) {
+		return NULL; /* error: invalid arguments */
+	}
+
+	return sock_hash_bucket_lookup(&sock_ehash[sock_ehashfn(p_ops, lport,
+				raddr, raddr_len, rport)], p_ops, tester, skb);
+}
+
+struct sock * sock_lookup_listener(const struct sock_proto_ops *p_ops,
+		sock_lookup_tester_ft tester, const struct sk_buff *skb,
+		in_port_t lport) {
+	if ((p_ops == NULL) || (tester == NULL)) {
+		return NULL; /* error: invalid arguments */
+	}
+
+	return sock_hash_bucket_lookup(&sock_lhash[sock_lhashfn(p_ops, lport)],
+			p_ops, tester, skb);
+}
+
+static int sock_hash_init(void) {
+	int i;
+
+	for (i = 0; i < SOCK_HASH_SIZE; i++) {
+		dlist_init(&sock_ehash[i]);
+		dlist_init(&sock_lhash[i]);
+	}
+
+	return 0;
+}
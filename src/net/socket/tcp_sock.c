@@ -11,12 +11,16 @@
 #include <string.h>
 #include <poll.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include <util/math.h>
 
 #include <net/l4/tcp.h>
+#include <net/l4/tcp_cong.h>
 #include <net/lib/tcp.h>
 #include <net/l3/ipv4/ip.h>
+#include <net/l3/ipv6.h>
+#include <net/lib/ipv4.h>
 #include <net/l2/ethernet.h>
 #include <net/sock.h>
 
@@ -42,6 +46,13 @@
 	OPTION_MODULE_GET(embox__net__socket, NUMBER, connect_timeout)
 
 #define MAX_SIMULTANEOUS_TX_PACK OPTION_GET(NUMBER, max_simultaneous_tx_pack)
+
+#define MODOPS_FLAGS \
+	((OPTION_GET(BOOLEAN, nodelay) ? TCP_F_NODELAY : 0) \
+		| (OPTION_GET(BOOLEAN, quickack) ? TCP_F_QUICKACK : 0) \
+		| (OPTION_GET(BOOLEAN, window_scaling) ? TCP_F_WSCALE : 0) \
+		| (OPTION_GET(BOOLEAN, sack) ? TCP_F_SACK : 0))
+
 static const struct sock_proto_ops tcp_sock_ops_struct;
 const struct sock_proto_ops *const tcp_sock_ops
 		= &tcp_sock_ops_struct;
@@ -57,10 +68,11 @@ EMBOX_NET_SOCK(AF_INET6, SOCK_STREAM, IPPROTO_TCP, 1,
 
 /************************ Socket's functions ***************************/
 static int tcp_init(struct sock *sk) {
+	/* Window is scaled only if both sides agree on it in SYN segments */
 	static const struct tcp_wind self_wind_default = {
 		.value = TCP_WINDOW_VALUE_DEFAULT,
-		.factor = TCP_WINDOW_FACTOR_DEFAULT,
-		.size = TCP_WINDOW_VALUE_DEFAULT << TCP_WINDOW_FACTOR_DEFAULT
+		.factor = 0,
+		.size = TCP_WINDOW_VALUE_DEFAULT
 	};
 	struct tcp_sock *tcp_sk;
 
@@ -80,11 +92,17 @@ static int tcp_init(struct sock *sk) {
 	INIT_LIST_HEAD(&tcp_sk->conn_free);
 	tcp_sk->free_wait_queue_len = tcp_sk->free_wait_queue_max = 0;
 	tcp_sk->lock = 0;
-	/* timerclear(&sock.tcp_sk->syn_time); */
-	timerclear(&tcp_sk->ack_time);
-	timerclear(&tcp_sk->rcv_time);
+	tcp_sock_timer_init(tcp_sk);
 	tcp_sk->dup_ack = 0;
-	tcp_sk->rexmit_mode = 0;
+	tcp_sk->rexmit_mode = TCP_REXMIT_NONE;
+	tcp_sk->flags = MODOPS_FLAGS;
+	tcp_sk->mss = TCP_MSS_DEFAULT;
+	tcp_sk->snd_nxt = tcp_sk->recover = tcp_sk->self.seq;
+	tcp_sk->snd_cwnd = TCP_MSS_DEFAULT; /* set on synchronization */
+	tcp_sk->snd_ssthresh = 0;
+	tcp_sk->sack_cnt = 0;
+	tcp_sk->cong = tcp_cong_default();
+	tcp_sk->cong->init(tcp_sk);
 
 	return 0;
 }
@@ -161,13 +179,8 @@ static int tcp_connect(struct sock *sk,
 	struct tcphdr *tcph;
 	struct tcp_sock *tcp_sk;
 	int ret;
-	static const uint8_t magic_opts[] = {
-		TCP_OPT_KIND_MSS, 0x04,     /* Maximum segment size: */
-		0x40, 0x0C,                 /* 16396 bytes           */
-		TCP_OPT_KIND_NOP,           /* No-Operation          */
-		TCP_OPT_KIND_WS, 0x03,      /* Window scale:         */
-		TCP_WINDOW_FACTOR_DEFAULT   /* 7 (multiply by 128)   */
-	};
+	uint8_t opts[TCP_SYN_OPTS_MAX];
+	size_t opts_len;
 
 	(void)addr;
 	(void)addr_len;
@@ -191,8 +204,9 @@ static int tcp_connect(struct sock *sk,
 			in_port_t src_port;
 
 			/* make skb with options */
+			opts_len = tcp_sock_syn_opts(tcp_sk, &opts[0]);
 			skb = NULL; /* alloc new pkg */
-			ret = alloc_prep_skb(tcp_sk, sizeof magic_opts, NULL, &skb);
+			ret = alloc_prep_skb(tcp_sk, opts_len, NULL, &skb);
 			if (ret != 0) {
 				break;
 			}
@@ -201,10 +215,10 @@ static int tcp_connect(struct sock *sk,
 			dst_port = sock_inet_get_dst_port(to_sock(tcp_sk));
 			src_port = sock_inet_get_src_port(to_sock(tcp_sk));
 			tcp_build(tcph, dst_port, src_port,
-					TCP_MIN_HEADER_SIZE + sizeof(magic_opts),
+					TCP_MIN_HEADER_SIZE + opts_len,
 					tcp_sk->self.wind.value);
 			tcph->syn = 1;
-			memcpy(&tcph->options, &magic_opts[0], sizeof magic_opts);
+			memcpy(&tcph->options, &opts[0], opts_len);
 			send_seq_from_sock(tcp_sk, skb);
 
 			//FIXME hack use common lock/unlock systems for socket
@@ -391,71 +405,131 @@ static int tcp_accept(struct sock *sk, struct sockaddr *addr,
 	return 0;
 }
 
-static int tcp_write(struct tcp_sock *tcp_sk, struct msghdr * msg) {
-	size_t iov_len;
-	int full_len;
-	void *pb;
-	struct sk_buff *skb;
-	int ret;
-	size_t skb_len;
-	int tran_len;
-	int cp_len;
-	int cp_off = 0;
-	int i;
+/* Data written to the stream: user buffers or a descriptor
+ * which is read straight into the segments */
+struct tcp_src {
+	const struct iovec *iov;
+	int iovlen;
+	size_t iov_off;
+	struct idesc *idesc;
+};
 
-	full_len = 0;
-	tran_len = 0;
-	for (i = 0; i < msg->msg_iovlen; i ++) {
-		full_len += msg->msg_iov[i].iov_len;
+static ssize_t tcp_src_copy(struct tcp_src *src, void *dst, size_t len) {
+	struct iovec iov;
+	ssize_t ret;
+	size_t done, cp_len;
+
+	if (src->idesc != NULL) {
+		/* Take what is available, the segment is cut if it's less */
+		iov.iov_base = dst;
+		iov.iov_len = len;
+		ret = src->idesc->idesc_ops->id_readv(src->idesc, &iov, 1);
+		return ret;
 	}
 
-	iov_len = 0;
-	skb_len = 0;
-
-	for (i = 0; tran_len < full_len; ) {
-		if (0 == iov_len) {
-			pb = msg->msg_iov[i].iov_base;
-			iov_len = msg->msg_iov[i].iov_len;
-			i++;
+	done = 0;
+
+	while ((done < len) && (src->iovlen > 0)) {
+		cp_len = min(len - done, src->iov->iov_len - src->iov_off);
+		memcpy(dst + done, src->iov->iov_base + src->iov_off, cp_len);
+		done += cp_len;
+		src->iov_off += cp_len;
+		if (src->iov_off == src->iov->iov_len) {
+			src->iov++;
+			src->iovlen--;
+			src->iov_off = 0;
 		}
+	}
 
-		if (0 == skb_len) {
-			in_port_t src_port, dst_port;
+	return done;
+}
 
-			cp_off = 0;
-			skb_len = min((full_len - tran_len), IP_MAX_PACKET_LEN - MAX_HEADER_SIZE);
-			skb = NULL; /* alloc new pkg */
+/* Cut the payload of the segment which wasn't queued yet */
+static void tcp_seg_trim(struct sk_buff *skb, size_t data_len) {
+	size_t cut;
+
+	cut = tcp_data_length(skb->h.th, skb->nh.raw) - data_len;
+	if (ip_check_version(skb->nh.iph)) {
+		skb->nh.iph->tot_len = htons(ntohs(skb->nh.iph->tot_len) - cut);
+	} else {
+		skb->nh.ip6h->payload_len =
+				htons(ntohs(skb->nh.ip6h->payload_len) - cut);
+	}
+	skb->len -= cut;
+}
+
+static ssize_t tcp_write(struct tcp_sock *tcp_sk, struct tcp_src *src,
+		size_t full_len) {
+	struct sk_buff *skb, *tail;
+	in_port_t src_port, dst_port;
+	size_t tran_len, data_len, seg_max, tail_len;
+	ssize_t cp_len;
+	int ret;
+
+	dst_port = sock_inet_get_dst_port(to_sock(tcp_sk));
+	src_port = sock_inet_get_src_port(to_sock(tcp_sk));
 
-			ret = alloc_prep_skb(tcp_sk, 0, &skb_len, &skb);
+	ret = 0;
+	tran_len = 0;
+	while (tran_len < full_len) {
+		seg_max = min(tcp_sk->mss, IP_MAX_PACKET_LEN - MAX_HEADER_SIZE);
+
+		/* Small segment which is still waiting in the queue
+		 * is extended with new data. Not for descriptors: reading
+		 * may block and the segment would be held back meanwhile */
+		tail = src->idesc == NULL
+				? tcp_sock_unqueue_tail(tcp_sk, seg_max) : NULL;
+		tail_len = tail != NULL
+				? tcp_data_length(tail->h.th, tail->nh.raw) : 0;
+
+		data_len = min((full_len - tran_len) + tail_len, seg_max);
+		skb = NULL; /* alloc new pkg */
+
+		ret = alloc_prep_skb(tcp_sk, 0, &data_len, &skb);
+		if ((ret != 0) || (data_len <= tail_len)) {
+			if (tail != NULL) {
+				send_seq_from_sock(tcp_sk, tail);
+			}
 			if (ret != 0) {
 				break;
 			}
-
-			dst_port = sock_inet_get_dst_port(to_sock(tcp_sk));
-			src_port = sock_inet_get_src_port(to_sock(tcp_sk));
-			tcp_build(skb->h.th, dst_port, src_port, TCP_MIN_HEADER_SIZE,
-					tcp_sk->self.wind.value);
+			tail = NULL;
+			tail_len = 0;
 		}
 
-		cp_len = min(iov_len, skb_len);
+		tcp_build(skb->h.th, dst_port, src_port, TCP_MIN_HEADER_SIZE,
+				tcp_sk->self.wind.value);
 
-		memcpy(((void *)(skb->h.th + 1) + cp_off), pb, cp_len);
-		iov_len -= cp_len;
-		pb += cp_len;
-		skb_len -= cp_len;
+		if (tail != NULL) {
+			memcpy(skb->h.th + 1, tail->h.th + 1, tail_len);
+			skb_free(tail);
+		}
+
+		cp_len = tcp_src_copy(src, (void *)(skb->h.th + 1) + tail_len,
+				data_len - tail_len);
+		if (cp_len < 0) {
+			ret = cp_len;
+			cp_len = 0;
+		}
 		tran_len += cp_len;
-		cp_off += cp_len;
 
-		if (0 == skb_len) {
-			/* Fill TCP header */
-			skb->h.th->psh = (iov_len == 0);
-			tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
-			send_seq_from_sock(tcp_sk, skb);
-			cp_off = 0;
+		if (tail_len + cp_len < data_len) {
+			/* Source is exhausted */
+			if (tail_len + cp_len == 0) {
+				skb_free(skb);
+				break;
+			}
+			tcp_seg_trim(skb, tail_len + cp_len);
+			full_len = tran_len;
 		}
+
+		/* Fill TCP header */
+		skb->h.th->psh = (tran_len == full_len);
+		tcp_set_ack_field(skb->h.th, tcp_sk->rem.seq);
+		send_seq_from_sock(tcp_sk, skb);
 	}
 
-	return tran_len;
+	return tran_len ? tran_len : ret;
 }
 
 #if MAX_SIMULTANEOUS_TX_PACK > 0
@@ -482,15 +556,22 @@ static inline int tcp_wait_tx_ready(struct sock *sk, int timeout) {
 #endif
 
 #define REM_WIND_MAX_SIZE (1460 * 100) /* FIXME use txqueuelen for netdev */
-static int tcp_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
-	struct tcp_sock *tcp_sk;
-	size_t len;
-	int ret, timeout;
+static inline size_t tcp_snd_room(struct tcp_sock *tcp_sk) {
+	size_t wind, flight;
 
-	(void)flags;
+	wind = min(tcp_sk->rem.wind.size, REM_WIND_MAX_SIZE);
+	flight = tcp_sk->self.seq - tcp_sk->last_ack;
 
-	assert(sk);
-	assert(msg);
+	return wind > flight ? wind - flight : 0;
+}
+
+/* If @a partial is set no more than the peer is able to accept right now
+ * is sent, otherwise all @a len bytes are queued */
+static ssize_t tcp_send(struct sock *sk, struct tcp_src *src, size_t len,
+		int partial) {
+	struct tcp_sock *tcp_sk;
+	ssize_t ret, sent;
+	int timeout;
 
 	timeout = timeval_to_ms(&sk->opt.so_sndtimeo);
 	if (timeout == 0) {
@@ -520,24 +601,25 @@ sendmsg_again:
 	case TCP_CLOSEWAIT:
 		sched_lock();
 		{
-			while ((min(tcp_sk->rem.wind.size, REM_WIND_MAX_SIZE)
-						<= tcp_sk->self.seq - tcp_sk->last_ack)
-					|| tcp_sk->rexmit_mode) {
+			while (tcp_snd_room(tcp_sk) == 0) {
 				ret = sock_wait(sk, POLLOUT | POLLERR, timeout);
 				if (ret != 0) {
 					sched_unlock();
 					return ret;
 				}
 			}
+			if (partial) {
+				len = min(len, tcp_snd_room(tcp_sk));
+			}
 		}
 		sched_unlock();
 
-		len = tcp_write(tcp_sk, msg);
+		sent = tcp_write(tcp_sk, src, len);
 		ret = tcp_wait_tx_ready(sk, timeout);
 		if (0 > ret) {
 			return ret;
 		}
-		return len;
+		return sent;
 	case TCP_FINWAIT_1:
 	case TCP_FINWAIT_2:
 	case TCP_CLOSING:
@@ -547,6 +629,42 @@ sendmsg_again:
 	}
 }
 
+static int tcp_sendmsg(struct sock *sk, struct msghdr *msg, int flags) {
+	struct tcp_src src;
+	size_t len;
+	int i;
+
+	(void)flags;
+
+	assert(sk);
+	assert(msg);
+
+	len = 0;
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		len += msg->msg_iov[i].iov_len;
+	}
+
+	memset(&src, 0, sizeof src);
+	src.iov = msg->msg_iov;
+	src.iovlen = msg->msg_iovlen;
+
+	return tcp_send(sk, &src, len, 0);
+}
+
+static ssize_t tcp_splice_write(struct sock *sk, struct idesc *in,
+		size_t len) {
+	struct tcp_src src;
+
+	assert(sk);
+	assert(in);
+	assert(in->idesc_ops->id_readv);
+
+	memset(&src, 0, sizeof src);
+	src.idesc = in;
+
+	return tcp_send(sk, &src, len, 1);
+}
+
 static int tcp_recvmsg(struct sock *sk, struct msghdr *msg,
 		int flags) {
 	struct tcp_sock *tcp_sk;
@@ -591,16 +709,106 @@ static int tcp_shutdown(struct sock *sk, int how) {
 	return 0;
 }
 
-static int tcp_setsockopt(struct sock *sk, int level, int optname,
-			const void *optval, socklen_t optlen) {
-
+static unsigned int tcp_sockopt_flag(int optname) {
 	switch (optname) {
 	case TCP_NODELAY:
-		/* TODO just ignoring for now... */
-		break;
+		return TCP_F_NODELAY;
+	case TCP_QUICKACK:
+		return TCP_F_QUICKACK;
+	case TCP_WINDOW_SCALING:
+		return TCP_F_WSCALE;
+	case TCP_SACK:
+		return TCP_F_SACK;
 	default:
+		return 0;
+	}
+}
+
+static int tcp_setsockopt(struct sock *sk, int level, int optname,
+			const void *optval, socklen_t optlen) {
+	struct tcp_sock *tcp_sk;
+	const struct tcp_cong_ops *cong;
+	char name[TCP_CA_NAME_MAX];
+	unsigned int flag;
+	int val;
+
+	if (level != IPPROTO_TCP) {
+		return -ENOPROTOOPT;
+	}
+
+	tcp_sk = to_tcp_sock(sk);
+
+	if (optname == TCP_CONGESTION) {
+		memset(name, 0, sizeof name);
+		memcpy(name, optval, min(optlen, sizeof name - 1));
+		cong = tcp_cong_lookup(name);
+		if (cong == NULL) {
+			return -ENOENT;
+		}
+		tcp_sock_lock(tcp_sk, TCP_SYNC_STATE);
+		{
+			tcp_sk->cong = cong;
+			cong->init(tcp_sk);
+		}
+		tcp_sock_unlock(tcp_sk, TCP_SYNC_STATE);
+		return 0;
+	}
+
+	flag = tcp_sockopt_flag(optname);
+	if (flag == 0) {
 		return -ENOPROTOOPT;
 	}
+	if (optlen != sizeof val) {
+		return -EINVAL;
+	}
+	memcpy(&val, optval, sizeof val);
+
+	tcp_sock_lock(tcp_sk, TCP_SYNC_STATE);
+	{
+		if (val) {
+			tcp_sk->flags |= flag;
+		}
+		else {
+			tcp_sk->flags &= ~flag;
+		}
+	}
+	tcp_sock_unlock(tcp_sk, TCP_SYNC_STATE);
+
+	if ((flag == TCP_F_NODELAY) && val
+			&& (tcp_sock_get_status(tcp_sk) == TCP_ST_SYNC)) {
+		/* Send segment held by Nagle algorithm */
+		tcp_sock_xmit(tcp_sk);
+	}
+
+	return 0;
+}
+
+static int tcp_getsockopt(struct sock *sk, int level, int optname,
+			void *optval, socklen_t *optlen) {
+	struct tcp_sock *tcp_sk;
+	unsigned int flag;
+	int val;
+
+	if (level != IPPROTO_TCP) {
+		return -ENOPROTOOPT;
+	}
+
+	tcp_sk = to_tcp_sock(sk);
+
+	if (optname == TCP_CONGESTION) {
+		*optlen = min(*optlen, strlen(tcp_sk->cong->name) + 1);
+		memcpy(optval, tcp_sk->cong->name, *optlen);
+		return 0;
+	}
+
+	flag = tcp_sockopt_flag(optname);
+	if (flag == 0) {
+		return -ENOPROTOOPT;
+	}
+
+	val = !!(tcp_sk->flags & flag);
+	*optlen = min(*optlen, sizeof val);
+	memcpy(optval, &val, *optlen);
 
 	return 0;
 }
@@ -616,8 +824,10 @@ static const struct sock_proto_ops tcp_sock_ops_struct = {
 	.accept     = tcp_accept,
 	.sendmsg    = tcp_sendmsg,
 	.recvmsg    = tcp_recvmsg,
+	.getsockopt = tcp_getsockopt,
 	.setsockopt = tcp_setsockopt,
 	.shutdown   = tcp_shutdown,
+	.splice_write = tcp_splice_write,
 	.sock_pool  = &tcp_sock_pool,
 	.sock_list  = &tcp_sock_list
 };
@@ -0,0 +1,131 @@
+/**
+ * @file
+ * @brief Tests merging and completion of block device requests
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <drivers/block_dev.h>
+#include <drivers/block_dev/ramdisk/ramdisk.h>
+#include <embox/test.h>
+#include <mem/page.h>
+
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("block device request queue test");
+
+TEST_SETUP_SUITE(setup_suite);
+TEST_TEARDOWN_SUITE(teardown_suite);
+
+#define BDQ_DEV     "/dev/bdq_ram"
+#define BDQ_BLOCKS  4
+
+static struct block_dev *bdev;
+static char wbuf[BDQ_BLOCKS * PAGE_SIZE()];
+static char rbuf[BDQ_BLOCKS * PAGE_SIZE()];
+static int ended;
+
+static void count_end_io(struct bio *bio) {
+	if (bio->error == 0) {
+		ended++;
+	}
+}
+
+static void pattern_fill(char *buf, size_t len, char seed) {
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = seed + i;
+	}
+}
+
+TEST_CASE("Data written with block_dev_rw is read back") {
+	size_t len = BDQ_BLOCKS * bdev->block_size;
+
+	pattern_fill(wbuf, len, 1);
+	test_assert_equal(len, block_dev_rw(bdev, BIO_WRITE, wbuf, len, 0));
+
+	memset(rbuf, 0, len);
+	test_assert_equal(len, block_dev_rw(bdev, BIO_READ, rbuf, len, 0));
+	test_assert_mem_equal(wbuf, rbuf, len);
+}
+
+TEST_CASE("Adjacent bios of a plugged queue are merged") {
+	struct block_dev_queue_stats before, after;
+	struct bio bios[BDQ_BLOCKS];
+	/* both back and front merges are exercised */
+	const int order[BDQ_BLOCKS] = { 1, 2, 0, 3 };
+	size_t len = BDQ_BLOCKS * bdev->block_size;
+	int i, blk;
+
+	pattern_fill(wbuf, len, 7);
+	block_dev_queue_get_stats(bdev, &before);
+	ended = 0;
+
+	block_dev_plug(bdev);
+	for (i = 0; i < BDQ_BLOCKS; i++) {
+		blk = order[i];
+		bios[i] = (struct bio) {
+			.bdev = bdev,
+			.dir = BIO_WRITE,
+			.blkno = blk,
+			.buf = wbuf + blk * bdev->block_size,
+			.count = bdev->block_size,
+			.end_io = count_end_io,
+		};
+		test_assert_zero(block_dev_submit_bio(&bios[i]));
+	}
+	test_assert_zero(ended);
+	block_dev_unplug(bdev);
+
+	test_assert_equal(BDQ_BLOCKS, ended);
+
+	block_dev_queue_get_stats(bdev, &after);
+	test_assert_equal(BDQ_BLOCKS, after.bios - before.bios);
+	test_assert_equal(BDQ_BLOCKS - 1, after.merges - before.merges);
+	test_assert_equal(1, after.dispatched - before.dispatched);
+
+	memset(rbuf, 0, len);
+	test_assert_equal(len, block_dev_rw(bdev, BIO_READ, rbuf, len, 0));
+	test_assert_mem_equal(wbuf, rbuf, len);
+}
+
+TEST_CASE("Bios out of the device or not multiple of block are rejected") {
+	struct bio bio = {
+		.bdev = bdev,
+		.dir = BIO_READ,
+		.blkno = 0,
+		.buf = rbuf,
+		.count = bdev->block_size / 2,
+	};
+
+	test_assert_equal(-EINVAL, block_dev_submit_bio(&bio));
+
+	bio.blkno = bdev->size / bdev->block_size;
+	bio.count = bdev->block_size;
+	test_assert_equal(-EINVAL, block_dev_submit_bio(&bio));
+}
+
+static int setup_suite(void) {
+	struct ramdisk *ramdisk;
+
+	ramdisk = ramdisk_create(BDQ_DEV, BDQ_BLOCKS * PAGE_SIZE());
+	if (err(ramdisk)) {
+		return err(ramdisk);
+	}
+	bdev = ramdisk->bdev;
+
+	if (BDQ_BLOCKS * bdev->block_size > sizeof(wbuf)) {
+		ramdisk_delete(BDQ_DEV);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int teardown_suite(void) {
+	return ramdisk_delete(BDQ_DEV);
+}
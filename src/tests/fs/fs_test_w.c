@@ -57,3 +57,64 @@ TEST_CASE("Test mkdir operation on fs") {
 		fs_test_write_file(fs_test_wr_dir_files[i], O_WRONLY | O_CREAT | O_EXCL, "");
 	}
 }
+
+#define FS_TEST_BIG_CHUNK 8192
+#define FS_TEST_BIG_SIZE  (8 * FS_TEST_BIG_CHUNK + 100)
+static const char fs_test_wr_file_big[] = FS_TEST_MOUNTPOINT "/wr_fbig";
+static char fs_test_big_buf[FS_TEST_BIG_CHUNK];
+
+static void fs_test_big_fill(char *buf, size_t len, off_t off) {
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = (char) ((off + i) * 7 + (off + i) / 256);
+	}
+}
+
+static int fs_test_big_check(const char *buf, size_t len, off_t off) {
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] != (char) ((off + i) * 7 + (off + i) / 256)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+TEST_CASE("Test multi-block file read back on fs") {
+	int fd;
+	off_t off;
+	size_t len;
+
+	test_assert(0 <= (fd = open(fs_test_wr_file_big, O_WRONLY | O_CREAT | O_EXCL,
+					FS_TEST_CREAT_MODE)));
+	for (off = 0; off < FS_TEST_BIG_SIZE; off += len) {
+		len = FS_TEST_BIG_SIZE - off;
+		if (len > FS_TEST_BIG_CHUNK) {
+			len = FS_TEST_BIG_CHUNK;
+		}
+		fs_test_big_fill(fs_test_big_buf, len, off);
+		test_assert_equal(len, write(fd, fs_test_big_buf, len));
+	}
+	close(fd);
+
+	/* Sequential reads of whole blocks */
+	test_assert(0 <= (fd = open(fs_test_wr_file_big, O_RDONLY)));
+	for (off = 0; off < FS_TEST_BIG_SIZE; off += len) {
+		len = FS_TEST_BIG_SIZE - off;
+		if (len > FS_TEST_BIG_CHUNK) {
+			len = FS_TEST_BIG_CHUNK;
+		}
+		test_assert_equal(len, read(fd, fs_test_big_buf, FS_TEST_BIG_CHUNK));
+		test_assert_zero(fs_test_big_check(fs_test_big_buf, len, off));
+	}
+	test_assert_zero(read(fd, fs_test_big_buf, FS_TEST_BIG_CHUNK));
+
+	/* Read starting and ending in the middle of blocks */
+	off = 1000;
+	test_assert_equal(off, lseek(fd, off, SEEK_SET));
+	test_assert_equal(3 * 1024 + 1, read(fd, fs_test_big_buf, 3 * 1024 + 1));
+	test_assert_zero(fs_test_big_check(fs_test_big_buf, 3 * 1024 + 1, off));
+	close(fd);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief Tests formatting of messages deferred by the kernel log
+ *
+ * @date 18.10.2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <embox/test.h>
+#include <kernel/klog.h>
+#include <util/logging.h>
+
+EMBOX_TEST_SUITE("Deferred kernel log test");
+
+static struct logging klog_test_logging = { .level = LOG_DEBUG };
+
+static char expected[128];
+static char got[128];
+
+/* Reads messages logged since the previous call */
+static size_t klog_test_read(char *buf, size_t len) {
+	static unsigned long pos;
+	size_t n, cnt;
+
+	klog_flush();
+
+	cnt = 0;
+	while (0 != (n = klog_read(buf + cnt, len - 1 - cnt, &pos))) {
+		cnt += n;
+	}
+	buf[cnt] = '\0';
+
+	return cnt;
+}
+
+TEST_SETUP(case_setup);
+
+TEST_CASE("Integer, string and character conversions are printed") {
+	logging_raw(&klog_test_logging, LOG_INFO,
+			"klog %d %u %lx %lld %s %c|%5s|%-3d|%%\n",
+			-5, 7u, 0xabcL, -9LL, "str", 'z', "ab", 4);
+	snprintf(expected, sizeof expected,
+			"klog %d %u %lx %lld %s %c|%5s|%-3d|%%\n",
+			-5, 7u, 0xabcL, -9LL, "str", 'z', "ab", 4);
+
+	klog_test_read(got, sizeof got);
+	test_assert_zero(strcmp(got, expected));
+}
+
+TEST_CASE("Width and precision given as arguments are printed") {
+	logging_raw(&klog_test_logging, LOG_INFO, "%*d|%.*s\n", 4, 12, 2, "abcdef");
+
+	klog_test_read(got, sizeof got);
+	test_assert_zero(strcmp(got, "  12|ab\n"));
+}
+
+TEST_CASE("String arguments are copied when the message is logged") {
+	char str[] = "before";
+
+	logging_raw(&klog_test_logging, LOG_INFO, "%s\n", str);
+	strcpy(str, "after");
+
+	klog_test_read(got, sizeof got);
+	test_assert_zero(strcmp(got, "before\n"));
+}
+
+TEST_CASE("Messages above the logging level are not logged") {
+	struct logging quiet = { .level = LOG_ERROR };
+
+	logging_raw(&quiet, LOG_DEBUG, "debug\n");
+
+	test_assert_zero(klog_test_read(got, sizeof got));
+}
+
+static int case_setup(void) {
+	/* Skip messages logged by others */
+	while (klog_test_read(got, sizeof got) != 0) {
+	}
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Tests order of schedees in the priority bitmap run queue
+ *
+ * @date 18.10.2026
+ */
+
+#include <embox/test.h>
+#include <hal/cpu.h>
+#include <kernel/sched.h>
+#include <kernel/sched/affinity.h>
+#include <kernel/sched/runq.h>
+#include <kernel/sched/sched_lock.h>
+
+EMBOX_TEST_SUITE("Priority bitmap run queue test");
+
+TEST_SETUP(setup);
+
+static runq_t q;
+static struct schedee any, restricted;
+
+static void schedee_setup(struct schedee *s, int prio) {
+	runq_item_init(&s->runq_link);
+	sched_affinity_init(&s->affinity);
+	schedee_priority_init(s, prio);
+}
+
+TEST_CASE("Restricted schedee isn't starved by unrestricted one of the "
+		"same priority") {
+	sched_lock();
+	{
+		/* The current CPU must not change while the queue is used */
+		sched_affinity_set(&restricted.affinity, 1 << cpu_get_id());
+
+		runq_insert(&q, &any);
+		runq_insert(&q, &restricted);
+
+		test_assert_equal(runq_extract(&q), &any);
+		runq_insert(&q, &any);
+		test_assert_equal(runq_extract(&q), &restricted);
+		runq_insert(&q, &restricted);
+		test_assert_equal(runq_extract(&q), &any);
+		test_assert_equal(runq_extract(&q), &restricted);
+		test_assert_null(runq_extract(&q));
+	}
+	sched_unlock();
+}
+
+TEST_CASE("Restricted schedee of higher priority goes first") {
+	sched_lock();
+	{
+		schedee_priority_init(&restricted, SCHED_PRIORITY_NORMAL + 1);
+		sched_affinity_set(&restricted.affinity, 1 << cpu_get_id());
+
+		runq_insert(&q, &any);
+		runq_insert(&q, &restricted);
+
+		test_assert_equal(runq_extract(&q), &restricted);
+		test_assert_equal(runq_extract(&q), &any);
+	}
+	sched_unlock();
+}
+
+static int setup(void) {
+	runq_init(&q);
+	schedee_setup(&any, SCHED_PRIORITY_NORMAL);
+	schedee_setup(&restricted, SCHED_PRIORITY_NORMAL);
+	return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file
+ * @brief Tests read-write lock with per-CPU reader counters
+ *
+ * @date 18.10.2026
+ */
+
+#include <embox/test.h>
+#include <kernel/thread/sync/brlock.h>
+#include <kernel/thread.h>
+#include <util/err.h>
+
+static struct thread *low, *mid, *high;
+static brlock_t b;
+
+EMBOX_TEST_SUITE("Per-CPU read-write lock test");
+
+TEST_SETUP(setup);
+
+static void threads_create(void);
+
+static void *reader_run(void *arg) {
+	brlock_read_lock(&b);
+	test_emit('b');
+	brlock_read_unlock(&b);
+	return NULL;
+}
+
+TEST_CASE("Readers share the lock") {
+	struct thread *t;
+
+	brlock_read_lock(&b);
+	test_emit('a');
+
+	t = thread_create(0, reader_run, NULL);
+	test_assert_zero(err(t));
+	test_assert_zero(thread_join(t, NULL));
+
+	brlock_read_unlock(&b);
+
+	brlock_write_lock(&b);
+	test_emit('c');
+	brlock_write_unlock(&b);
+
+	test_assert_emitted("abc");
+}
+
+TEST_CASE("Writer is preferred over new readers, which enter before next "
+		"writer") {
+	threads_create();
+
+	test_assert_zero(thread_launch(low));
+	test_assert_zero(thread_join(low, NULL));
+	test_assert_zero(thread_join(mid, NULL));
+	test_assert_zero(thread_join(high, NULL));
+	test_assert_emitted("abcdefghij");
+}
+
+static void *low_run(void *arg) {
+	brlock_read_lock(&b);
+	test_emit('a');
+	test_assert_zero(thread_launch(mid));
+	test_emit('c');
+	test_assert_zero(thread_launch(high));
+	test_emit('e');
+	brlock_read_unlock(&b);
+	test_emit('j');
+	return NULL;
+}
+
+static void *mid_run(void *arg) {
+	test_emit('b');
+	brlock_write_lock(&b);
+	test_emit('f');
+	brlock_write_unlock(&b);
+	test_emit('i');
+	return NULL;
+}
+
+static void *high_run(void *arg) {
+	test_emit('d');
+	brlock_read_lock(&b);
+	test_emit('g');
+	brlock_read_unlock(&b);
+	test_emit('h');
+	return NULL;
+}
+
+static void threads_create(void) {
+	int l = 200, m = 210, h = 220;
+
+	low = thread_create(THREAD_FLAG_SUSPENDED, low_run, NULL);
+	test_assert_zero(err(low));
+
+	mid = thread_create(THREAD_FLAG_SUSPENDED, mid_run, NULL);
+	test_assert_zero(err(mid));
+
+	high = thread_create(THREAD_FLAG_SUSPENDED, high_run, NULL);
+	test_assert_zero(err(high));
+
+	test_assert_zero(schedee_priority_set(&low->schedee, l));
+	test_assert_zero(schedee_priority_set(&mid->schedee, m));
+	test_assert_zero(schedee_priority_set(&high->schedee, h));
+}
+
+static int setup(void) {
+	brlock_init(&b);
+	return 0;
+}
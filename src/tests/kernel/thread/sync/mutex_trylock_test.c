@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @brief Tests lock, trylock and unlock of mutexes of different types
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+
+#include <embox/test.h>
+#include <kernel/thread/sync/mutex.h>
+#include <kernel/thread.h>
+#include <util/err.h>
+
+EMBOX_TEST_SUITE("Mutex trylock test");
+
+static struct mutex m;
+
+static void *trylock_run(void *arg) {
+	int ret;
+
+	ret = mutex_trylock(&m);
+	if (ret == 0) {
+		mutex_unlock(&m);
+	}
+
+	return (void *)(intptr_t)ret;
+}
+
+static int trylock_other(void) {
+	struct thread *t;
+	void *ret;
+
+	t = thread_create(0, trylock_run, NULL);
+	test_assert_zero(err(t));
+	test_assert_zero(thread_join(t, &ret));
+
+	return (int)(intptr_t)ret;
+}
+
+TEST_CASE("Held default mutex is busy for other threads") {
+	struct mutexattr attr;
+
+	mutexattr_init(&attr);
+	mutex_init_default(&m, &attr);
+
+	test_assert_zero(mutex_lock(&m));
+	test_assert_equal(-EBUSY, trylock_other());
+	test_assert_zero(mutex_unlock(&m));
+	test_assert_zero(trylock_other());
+}
+
+TEST_CASE("Recursive mutex is released after the last unlock") {
+	mutex_init(&m);
+
+	test_assert_zero(mutex_lock(&m));
+	test_assert_zero(mutex_trylock(&m));
+	test_assert_zero(mutex_unlock(&m));
+	test_assert_equal(-EBUSY, trylock_other());
+	test_assert_zero(mutex_unlock(&m));
+	test_assert_zero(trylock_other());
+	test_assert_equal(-EPERM, mutex_unlock(&m));
+}
+
+TEST_CASE("Error checking mutex reports relock and foreign unlock") {
+	struct mutexattr attr;
+
+	mutexattr_init(&attr);
+	mutexattr_settype(&attr, MUTEX_ERRORCHECK);
+	mutex_init_default(&m, &attr);
+
+	test_assert_zero(mutex_lock(&m));
+	test_assert_equal(-EDEADLK, mutex_lock(&m));
+	test_assert_equal(-EDEADLK, mutex_trylock(&m));
+	test_assert_zero(mutex_unlock(&m));
+	test_assert_equal(-EPERM, mutex_unlock(&m));
+}
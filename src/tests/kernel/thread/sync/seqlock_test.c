@@ -0,0 +1,50 @@
+/**
+ * @file
+ * @brief Tests sequence counters and locks
+ *
+ * @date 18.10.2026
+ */
+
+#include <embox/test.h>
+#include <kernel/thread/sync/seqlock.h>
+
+EMBOX_TEST_SUITE("Sequence lock test");
+
+static seqlock_t sl = SEQLOCK_INIT;
+
+TEST_CASE("Read is valid if there was no write") {
+	unsigned int seq;
+
+	seq = read_seqbegin(&sl);
+	test_assert_zero(read_seqretry(&sl, seq));
+}
+
+TEST_CASE("Read is retried after a write") {
+	unsigned int seq;
+
+	seq = read_seqbegin(&sl);
+
+	write_seqlock(&sl);
+	write_sequnlock(&sl);
+
+	test_assert_not_zero(read_seqretry(&sl, seq));
+
+	seq = read_seqbegin(&sl);
+	test_assert_zero(read_seqretry(&sl, seq));
+}
+
+TEST_CASE("Read is invalid while a write is in progress") {
+	seqcount_t s = SEQCOUNT_INIT;
+	unsigned int seq;
+
+	test_assert_not_zero(write_seqcount_trybegin(&s));
+	test_assert_zero(write_seqcount_trybegin(&s));
+
+	seq = raw_read_seqcount(&s);
+	test_assert_not_zero(read_seqcount_retry(&s, seq));
+
+	write_seqcount_end(&s);
+
+	seq = raw_read_seqcount(&s);
+	test_assert_zero(read_seqcount_retry(&s, seq));
+}
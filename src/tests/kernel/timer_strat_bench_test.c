@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief Timer strategy microbenchmark
+ *
+ * @details Measures timer start, restart and stop with 10, 1k and 10k
+ *   timers armed. Strategy is chosen at build time, so strategies are
+ *   compared by running this test in images with different
+ *   embox.kernel.timer.strategy.api implementations.
+ *
+ * @date 18.10.2026
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <embox/test.h>
+#include <util/array.h>
+#include <kernel/time/timer.h>
+#include <kernel/time/time.h>
+#include <kernel/time/ktime.h>
+
+#include <framework/mod/options.h>
+
+EMBOX_TEST_SUITE("timer strategy benchmark");
+
+#define TIMERS_MAX    OPTION_GET(NUMBER, timers_max)
+#define FAR_DELAY     10000 /* milliseconds, timers must not fire */
+#define SHORT_DELAY   20    /* milliseconds */
+
+static struct sys_timer bench_timers[TIMERS_MAX];
+static volatile int bench_fired;
+
+static void bench_handler_fail(struct sys_timer *tmr, void *param) {
+	test_fail("benchmark timer should not fire");
+}
+
+static void bench_handler_count(struct sys_timer *tmr, void *param) {
+	bench_fired++;
+}
+
+static clock_t bench_load(int i, clock_t base) {
+	/* pseudo-random spread, so strategies do not get sorted input */
+	return base + (((uint32_t) i * 2654435761u) >> 16) % 1024;
+}
+
+static void bench_run(int count) {
+	uint64_t t_start, t_restart, t_stop;
+	clock_t base;
+	int i;
+
+	base = ms2jiffies(FAR_DELAY);
+
+	for (i = 0; i < count; i++) {
+		timer_init(&bench_timers[i], TIMER_ONESHOT, bench_handler_fail, NULL);
+	}
+
+	t_start = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		timer_start(&bench_timers[i], bench_load(i, base));
+	}
+	t_start = ktime_get_ns() - t_start;
+
+	t_restart = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		timer_start(&bench_timers[i], bench_load(i + count, base));
+	}
+	t_restart = ktime_get_ns() - t_restart;
+
+	t_stop = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		timer_stop(&bench_timers[i]);
+	}
+	t_stop = ktime_get_ns() - t_stop;
+
+	printf("%6d timers: start %8llu ns, restart %8llu ns, stop %8llu ns\n",
+			count,
+			(unsigned long long) (t_start / count),
+			(unsigned long long) (t_restart / count),
+			(unsigned long long) (t_stop / count));
+}
+
+TEST_CASE("measure timer start/restart/stop") {
+	static const int counts[] = { 10, 1000, 10000 };
+	int i;
+
+	printf("\n");
+	for (i = 0; i < ARRAY_SIZE(counts); i++) {
+		if (counts[i] > TIMERS_MAX) {
+			break;
+		}
+		bench_run(counts[i]);
+	}
+}
+
+TEST_CASE("all armed timers fire") {
+	int i;
+
+	bench_fired = 0;
+
+	for (i = 0; i < TIMERS_MAX; i++) {
+		timer_init(&bench_timers[i], TIMER_ONESHOT, bench_handler_count, NULL);
+		timer_start(&bench_timers[i], 1 + i % ms2jiffies(SHORT_DELAY));
+	}
+
+	usleep(4 * SHORT_DELAY * 1000);
+
+	for (i = 0; i < TIMERS_MAX; i++) {
+		timer_stop(&bench_timers[i]);
+	}
+
+	test_assert_equal(TIMERS_MAX, bench_fired);
+}
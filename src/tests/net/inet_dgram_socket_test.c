@@ -132,6 +132,24 @@ TEST_CASE("recv() works on connected socket") {
 	test_assert_equal('c', buf[0]);
 }
 
+TEST_CASE("recv() works on socket connected several times in a row") {
+	struct sockaddr_in tmp;
+	in_port_t port;
+	test_assert_zero(connect(c, to_sa(&addr), addrlen));
+	test_assert_zero(getsockname(c, to_sa(&tmp), &addrlen));
+
+	port = tmp.sin_port;
+	tmp.sin_port = htons(BAD_PORT);
+	test_assert_zero(connect(b, to_sa(&tmp), addrlen));
+	tmp.sin_port = port;
+	test_assert_zero(connect(b, to_sa(&tmp), addrlen));
+
+	test_assert_equal(1, send(c, "a", 1, 0));
+
+	test_assert_equal(1, recv(b, buf, 2, 0));
+	test_assert_equal('a', buf[0]);
+}
+
 #if 0
 TEST_CASE("recvfrom() and recvmsg() works on disconnected"
 		" socket") {
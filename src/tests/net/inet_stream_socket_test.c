@@ -12,6 +12,7 @@
 #include <fcntl.h>
 #include <framework/mod/options.h>
 #include <netinet/in.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -174,6 +175,45 @@ TEST_CASE("getpeername() returns address of peer") {
 	test_assert_mem_equal(&addr, &tmp, addrlen);
 }
 
+TEST_CASE("sendfile() and splice() pass data between pipe and socket") {
+	static char out[1000], in[sizeof out];
+	int p[2];
+	size_t i, got;
+	ssize_t ret;
+
+	for (i = 0; i < sizeof out; i++) {
+		out[i] = i * 3;
+	}
+
+	test_assert_zero(pipe(p));
+	test_assert_zero(connect(c, to_sa(&addr), addrlen));
+	a = accept(l, to_sa(&addr), &addrlen);
+	test_assert(0 <= a);
+
+	/* Pipe data is read right into the TCP segments */
+	test_assert_equal(sizeof out, write(p[1], out, sizeof out));
+	test_assert_equal(sizeof out, sendfile(c, p[0], NULL, sizeof out));
+	for (got = 0; got < sizeof in; got += ret) {
+		ret = recv(a, in + got, sizeof in - got, 0);
+		test_assert(ret > 0);
+	}
+	test_assert_mem_equal(out, in, sizeof in);
+
+	/* Socket data is received right into the pipe buffer */
+	test_assert_equal(sizeof out, send(a, out, sizeof out, 0));
+	for (got = 0; got < sizeof in; got += ret) {
+		ret = splice(c, NULL, p[1], NULL, sizeof in - got, 0);
+		test_assert(ret > 0);
+	}
+	memset(in, 0, sizeof in);
+	test_assert_equal(sizeof in, read(p[0], in, sizeof in));
+	test_assert_mem_equal(out, in, sizeof in);
+
+	close(p[0]);
+	close(p[1]);
+	test_assert_zero(close(a));
+}
+
 static int suite_setup(void) {
 	int ret;
 	struct in_device *in_dev;
@@ -0,0 +1,111 @@
+/**
+ * @file
+ * @brief
+ *
+ * @date 18.10.2026
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+#include <net/skbuff.h>
+#include <net/l2/ethernet.h>
+#include <net/l3/ipv4/ip.h>
+#include <net/l3/ipv4/ip_fragment.h>
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("IPv4 reassembly");
+
+TEST_SETUP_SUITE(suite_setup);
+
+#define FRAG_HDR_LEN (ETH_HEADER_SIZE + IP_MIN_HEADER_SIZE)
+
+static char payload[64];
+
+static struct sk_buff *frag_make(uint16_t id, int offset, int len, int mf) {
+	struct sk_buff *skb;
+	struct iphdr *iph;
+
+	skb = skb_alloc(FRAG_HDR_LEN + len);
+	if (skb == NULL) {
+		return NULL;
+	}
+
+	skb->nh.raw = skb->mac.raw + ETH_HEADER_SIZE;
+	skb->h.raw = skb->nh.raw + IP_MIN_HEADER_SIZE;
+
+	iph = ip_hdr(skb);
+	memset(iph, 0, IP_MIN_HEADER_SIZE);
+	iph->version = 4;
+	iph->ihl = IP_MIN_HEADER_SIZE >> 2;
+	iph->tot_len = htons(IP_MIN_HEADER_SIZE + len);
+	iph->id = htons(id);
+	iph->frag_off = htons((offset >> 3) | (mf ? IP_MF : 0));
+	iph->ttl = 64;
+	iph->proto = IPPROTO_UDP;
+	iph->saddr = htonl(0x0a000001);
+	iph->daddr = htonl(0x0a000002);
+
+	memcpy(skb->h.raw, payload + offset, len);
+
+	return skb;
+}
+
+TEST_CASE("fragments received out of order are reassembled") {
+	struct ip_frag_stats st;
+	struct sk_buff *skb;
+	char buf[sizeof payload];
+	unsigned long oks;
+
+	ip_frag_get_stats(&st);
+	oks = st.reasm_oks;
+
+	test_assert_null(ip_defrag(frag_make(1, 48, 16, 0)));
+	test_assert_null(ip_defrag(frag_make(1, 0, 16, 1)));
+	test_assert_null(ip_defrag(frag_make(1, 32, 16, 1)));
+	skb = ip_defrag(frag_make(1, 16, 16, 1));
+	test_assert_not_null(skb);
+
+	test_assert_equal(sizeof payload, ntohs(ip_hdr(skb)->tot_len)
+			- IP_MIN_HEADER_SIZE);
+	test_assert_zero(ntohs(ip_hdr(skb)->frag_off));
+	test_assert_equal(FRAG_HDR_LEN + sizeof payload, skb->len);
+	skb_copy_bits(skb, FRAG_HDR_LEN, buf, sizeof buf);
+	test_assert_mem_equal(payload, buf, sizeof buf);
+	skb_free(skb);
+
+	ip_frag_get_stats(&st);
+	test_assert_equal(oks + 1, st.reasm_oks);
+	test_assert_zero(st.queues);
+	test_assert_zero(st.mem);
+}
+
+TEST_CASE("duplicate fragment is ignored") {
+	struct sk_buff *skb;
+
+	test_assert_null(ip_defrag(frag_make(2, 0, 32, 1)));
+	test_assert_null(ip_defrag(frag_make(2, 0, 32, 1)));
+	skb = ip_defrag(frag_make(2, 32, 32, 0));
+	test_assert_not_null(skb);
+	test_assert_equal(FRAG_HDR_LEN + sizeof payload, skb->len);
+	skb_free(skb);
+}
+
+TEST_CASE("overlapping fragment drops the whole datagram") {
+	struct ip_frag_stats st;
+
+	test_assert_null(ip_defrag(frag_make(3, 0, 32, 1)));
+	test_assert_null(ip_defrag(frag_make(3, 24, 40, 0)));
+
+	ip_frag_get_stats(&st);
+	test_assert_zero(st.queues);
+}
+
+static int suite_setup(void) {
+	int i;
+
+	for (i = 0; i < sizeof payload; i++) {
+		payload[i] = i * 3 + 1;
+	}
+
+	return 0;
+}
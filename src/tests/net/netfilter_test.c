@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief
+ *
+ * @date 18.10.2026
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+#include <net/netfilter.h>
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("netfilter rules matching");
+
+TEST_TEARDOWN(case_teardown);
+
+static void test_rule_fill(struct nf_rule *r, const char *saddr,
+		unsigned short dport) {
+	struct in_addr addr;
+
+	nf_rule_init(r);
+	r->target = NF_TARGET_ACCEPT;
+	inet_aton(saddr, &addr);
+	NF_SET_NOT_FIELD(r, saddr, 0, addr);
+	NF_SET_NOT_FIELD(r, proto, 0, NF_PROTO_TCP);
+	NF_SET_NOT_FIELD(r, dport, 0, htons(dport));
+}
+
+TEST_CASE("the first matched rule wins whatever fields it uses") {
+	struct nf_rule r, pkt;
+
+	/* 1: by port, 2: by address, 3: without exact fields */
+	nf_rule_init(&r);
+	r.target = NF_TARGET_ACCEPT;
+	NF_SET_NOT_FIELD(&r, proto, 0, NF_PROTO_TCP);
+	NF_SET_NOT_FIELD(&r, dport, 0, htons(22));
+	test_assert_zero(nf_add_rule(NF_CHAIN_INPUT, &r));
+
+	test_rule_fill(&r, "10.0.0.1", 0);
+	r.set_dport = 0;
+	r.target = NF_TARGET_DROP;
+	test_assert_zero(nf_add_rule(NF_CHAIN_INPUT, &r));
+
+	nf_rule_init(&r);
+	r.target = NF_TARGET_ACCEPT;
+	test_assert_zero(nf_add_rule(NF_CHAIN_INPUT, &r));
+
+	test_rule_fill(&pkt, "10.0.0.1", 22);
+	test_assert_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+
+	test_rule_fill(&pkt, "10.0.0.1", 80);
+	test_assert_not_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+
+	test_rule_fill(&pkt, "10.0.0.2", 80);
+	test_assert_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+
+	test_assert_equal(1, nf_get_rule_by_num(NF_CHAIN_INPUT, 0)->hits);
+	test_assert_equal(1, nf_get_rule_by_num(NF_CHAIN_INPUT, 1)->hits);
+	test_assert_equal(1, nf_get_rule_by_num(NF_CHAIN_INPUT, 2)->hits);
+}
+
+TEST_CASE("negated field doesn't prevent rule from matching") {
+	struct nf_rule r, pkt;
+	struct in_addr addr;
+
+	nf_rule_init(&r);
+	r.target = NF_TARGET_DROP;
+	inet_aton("10.0.0.1", &addr);
+	NF_SET_NOT_FIELD(&r, saddr, 1, addr);
+	test_assert_zero(nf_add_rule(NF_CHAIN_INPUT, &r));
+
+	test_rule_fill(&pkt, "10.0.0.2", 80);
+	test_assert_not_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+
+	test_rule_fill(&pkt, "10.0.0.1", 80);
+	test_assert_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+}
+
+TEST_CASE("changes of the chain are seen by the next test") {
+	struct nf_rule r, pkt;
+
+	test_rule_fill(&r, "10.0.0.1", 80);
+	r.target = NF_TARGET_DROP;
+	test_assert_zero(nf_add_rule(NF_CHAIN_INPUT, &r));
+
+	test_rule_fill(&pkt, "10.0.0.1", 80);
+	test_assert_not_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+
+	test_rule_fill(&r, "10.0.0.1", 81);
+	r.target = NF_TARGET_DROP;
+	test_assert_zero(nf_set_rule(NF_CHAIN_INPUT, &r, 0));
+	test_assert_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+
+	test_assert_zero(nf_del_rule(NF_CHAIN_INPUT, 0));
+	test_rule_fill(&pkt, "10.0.0.1", 81);
+	test_assert_zero(nf_test_rule(NF_CHAIN_INPUT, &pkt));
+}
+
+static int case_teardown(void) {
+	return nf_clear(NF_CHAIN_INPUT);
+}
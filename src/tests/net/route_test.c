@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief Tests for longest prefix match in routing table
+ *
+ * @date 18.10.2026
+ */
+
+#include <embox/test.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <net/inetdevice.h>
+#include <net/l3/route.h>
+#include <util/array.h>
+
+EMBOX_TEST_SUITE("routing table longest prefix match");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN(case_teardown);
+
+static struct net_device *dev;
+
+static in_addr_t ip(const char *str) {
+	return inet_addr(str);
+}
+
+static struct rt_entry *best(const char *dst) {
+	return rt_fib_get_best(ip(dst), NULL);
+}
+
+TEST_CASE("The most specific route is chosen") {
+	test_assert_zero(rt_add_route(dev, ip("10.0.0.0"), ip("255.0.0.0"),
+				0, 0));
+	test_assert_zero(rt_add_route(dev, ip("10.1.2.0"), ip("255.255.255.0"),
+				0, 0));
+	test_assert_zero(rt_add_route(dev, ip("10.1.0.0"), ip("255.255.0.0"),
+				0, 0));
+
+	test_assert_equal(ip("255.255.255.0"), best("10.1.2.3")->rt_mask);
+	test_assert_equal(ip("255.255.0.0"), best("10.1.3.3")->rt_mask);
+	test_assert_equal(ip("255.0.0.0"), best("10.2.2.3")->rt_mask);
+	test_assert_null(best("11.1.2.3"));
+}
+
+TEST_CASE("Default route matches everything") {
+	test_assert_zero(rt_add_route(dev, 0, 0, ip("192.168.1.1"), RTF_GATEWAY));
+	test_assert_zero(rt_add_route(dev, ip("192.168.1.0"),
+				ip("255.255.255.0"), 0, 0));
+
+	test_assert_equal(ip("192.168.1.1"), best("8.8.8.8")->rt_gateway);
+	test_assert_equal(0, best("192.168.1.7")->rt_gateway);
+}
+
+TEST_CASE("Deleted route is not returned from cache") {
+	test_assert_zero(rt_add_route(dev, ip("172.16.0.0"), ip("255.240.0.0"),
+				0, 0));
+	test_assert_zero(rt_add_route(dev, ip("172.16.5.0"), ip("255.255.255.0"),
+				0, 0));
+
+	test_assert_equal(ip("255.255.255.0"), best("172.16.5.1")->rt_mask);
+	test_assert_zero(rt_del_route(dev, ip("172.16.5.0"),
+				ip("255.255.255.0"), 0));
+	test_assert_equal(ip("255.240.0.0"), best("172.16.5.1")->rt_mask);
+}
+
+static int suite_setup(void) {
+	struct in_device *in_dev;
+
+	in_dev = inetdev_get_loopback_dev();
+	if (in_dev == NULL) {
+		return -ENODEV;
+	}
+	dev = in_dev->dev;
+
+	return 0;
+}
+
+static int case_teardown(void) {
+	static const char *const routes[][2] = {
+		{ "10.0.0.0", "255.0.0.0" },
+		{ "10.1.0.0", "255.255.0.0" },
+		{ "10.1.2.0", "255.255.255.0" },
+		{ "0.0.0.0", "0.0.0.0" },
+		{ "192.168.1.0", "255.255.255.0" },
+		{ "172.16.0.0", "255.240.0.0" },
+		{ "172.16.5.0", "255.255.255.0" },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(routes); i++) {
+		rt_del_route(dev, ip(routes[i][0]), ip(routes[i][1]), 0);
+	}
+
+	return 0;
+}
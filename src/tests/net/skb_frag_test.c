@@ -0,0 +1,98 @@
+/**
+ * @file
+ * @brief
+ *
+ * @date 18.10.2026
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <net/skbuff.h>
+#include <embox/test.h>
+
+EMBOX_TEST_SUITE("skbuff fragments");
+
+static struct sk_buff *skb_fill(const char *str) {
+	struct sk_buff *skb;
+
+	skb = skb_alloc(strlen(str));
+	if (skb != NULL) {
+		memcpy(skb->mac.raw, str, strlen(str));
+	}
+
+	return skb;
+}
+
+TEST_CASE("content of fragments follows linear part") {
+	struct sk_buff *skb, *src;
+	char buf[16];
+	size_t len;
+
+	skb = skb_fill("abc");
+	test_assert_not_null(skb);
+	src = skb_fill("xdefx");
+	test_assert_not_null(src);
+
+	test_assert_zero(skb_add_frag_range(skb, src, 1, 3));
+	/* Fragment holds the buffer */
+	skb_free(src);
+
+	test_assert_equal(6, skb->len);
+	test_assert_equal(3, skb_headlen(skb));
+	test_assert(skb_is_nonlinear(skb));
+
+	test_assert_not_null(skb_chunk(skb, 4, &len));
+	test_assert_equal(2, len);
+	test_assert_null(skb_chunk(skb, 6, &len));
+
+	memset(buf, 0, sizeof buf);
+	test_assert_equal(4, skb_copy_bits(skb, 2, buf, sizeof buf));
+	test_assert_str_equal("cdef", buf);
+
+	skb_free(skb);
+}
+
+TEST_CASE("clone shares fragments and frag_list") {
+	struct sk_buff *skb, *clone, *frag;
+	char buf[16];
+
+	skb = skb_fill("ab");
+	test_assert_not_null(skb);
+	frag = skb_fill("cd");
+	test_assert_not_null(frag);
+	test_assert_zero(skb_add_frag(skb, frag->data, frag->mac.raw, 2));
+	skb_free(frag);
+
+	frag = skb_fill("ef");
+	test_assert_not_null(frag);
+	skb_frag_list_add(skb, frag);
+	/* Fragments can't go after frag_list */
+	test_assert_equal(-ENOSPC, skb_add_frag(skb, skb->data, skb->mac.raw, 1));
+
+	clone = skb_clone(skb);
+	test_assert_not_null(clone);
+	skb_free(skb);
+
+	memset(buf, 0, sizeof buf);
+	test_assert_equal(6, skb_copy_bits(clone, 0, buf, sizeof buf));
+	test_assert_str_equal("abcdef", buf);
+
+	skb_free(clone);
+}
+
+TEST_CASE("linearize gathers all content into own buffer") {
+	struct sk_buff *skb, *frag;
+
+	skb = skb_fill("12");
+	test_assert_not_null(skb);
+	frag = skb_fill("345");
+	test_assert_not_null(frag);
+	skb_frag_list_add(skb, frag);
+
+	test_assert_equal(skb, skb_linearize(skb));
+	test_assert(!skb_is_nonlinear(skb));
+	test_assert_equal(5, skb->len);
+	test_assert_zero(memcmp("12345", skb->mac.raw, 5));
+
+	skb_free(skb);
+}
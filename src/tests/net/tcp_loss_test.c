@@ -0,0 +1,246 @@
+/**
+ * @file
+ * @brief Tests TCP congestion control and loss recovery over loopback
+ *
+ * @date 18.10.2026
+ */
+
+#include <arpa/inet.h>
+#include <embox/test.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <drivers/net/loopback.h>
+#include <net/inetdevice.h>
+#include <net/netdevice.h>
+#include <net/l3/route.h>
+
+EMBOX_TEST_SUITE("TCP loss recovery test");
+
+TEST_SETUP_SUITE(suite_setup);
+TEST_TEARDOWN_SUITE(suite_teardown);
+
+TEST_SETUP(case_setup);
+TEST_TEARDOWN(case_teardown);
+
+#define LOSS_PERIOD  7
+#define BULK_SIZE    (64 * 1024)
+#define SMALL_WRITES 100
+#define RECV_TIMEOUT 10 /* seconds */
+
+static int l, c, a;
+
+static int tcp_connect_pair(void) {
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	struct timeval tv;
+
+	addrlen = sizeof addr;
+	if (-1 == getsockname(l, (struct sockaddr *)&addr, &addrlen)) {
+		return -errno;
+	}
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (-1 == connect(c, (struct sockaddr *)&addr, addrlen)) {
+		return -errno;
+	}
+	a = accept(l, (struct sockaddr *)&addr, &addrlen);
+	if (a == -1) {
+		return -errno;
+	}
+
+	tv.tv_sec = RECV_TIMEOUT;
+	tv.tv_usec = 0;
+	if ((-1 == setsockopt(a, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv))
+			|| (-1 == setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv,
+					sizeof tv))) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int recv_all(int fd, char *buf, size_t len) {
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = recv(fd, buf, len, 0);
+		if (ret <= 0) {
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static unsigned long lo_packets(void) {
+	return inetdev_get_loopback_dev()->dev->stats.rx_packets;
+}
+
+TEST_CASE("TCP_CONGESTION selects congestion control algorithm") {
+	char name[TCP_CA_NAME_MAX];
+	socklen_t len;
+
+	len = sizeof name;
+	test_assert_zero(getsockopt(c, IPPROTO_TCP, TCP_CONGESTION, name, &len));
+	test_assert_str_equal("newreno", name);
+
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_CONGESTION, "newreno",
+				strlen("newreno")));
+	test_assert_equal(-1, setsockopt(c, IPPROTO_TCP, TCP_CONGESTION,
+				"nonexistent", strlen("nonexistent")));
+	test_assert_equal(ENOENT, errno);
+}
+
+TEST_CASE("TCP_NODELAY and TCP_QUICKACK may be toggled") {
+	socklen_t len;
+	int val;
+
+	val = 1;
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &val,
+				sizeof val));
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_QUICKACK, &val,
+				sizeof val));
+
+	val = 0;
+	len = sizeof val;
+	test_assert_zero(getsockopt(c, IPPROTO_TCP, TCP_NODELAY, &val, &len));
+	test_assert_equal(1, val);
+	test_assert_zero(getsockopt(c, IPPROTO_TCP, TCP_QUICKACK, &val, &len));
+	test_assert_equal(1, val);
+
+	val = 0;
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &val,
+				sizeof val));
+	test_assert_zero(getsockopt(c, IPPROTO_TCP, TCP_NODELAY, &val, &len));
+	test_assert_zero(val);
+}
+
+TEST_CASE("small writes are coalesced unless TCP_NODELAY is set") {
+	static char in[SMALL_WRITES];
+	unsigned long packets;
+	int i, val;
+
+	test_assert_zero(tcp_connect_pair());
+
+	packets = lo_packets();
+	for (i = 0; i < SMALL_WRITES; i++) {
+		test_assert_equal(1, send(c, "x", 1, 0));
+	}
+	test_assert_zero(recv_all(a, in, sizeof in));
+	test_assert(lo_packets() - packets < SMALL_WRITES / 5);
+
+	val = 1;
+	test_assert_zero(setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &val,
+				sizeof val));
+
+	packets = lo_packets();
+	for (i = 0; i < SMALL_WRITES; i++) {
+		test_assert_equal(1, send(c, "y", 1, 0));
+	}
+	test_assert_zero(recv_all(a, in, sizeof in));
+	test_assert(lo_packets() - packets >= SMALL_WRITES);
+}
+
+TEST_CASE("stream is delivered intact when loopback drops packets") {
+	static char out[BULK_SIZE], in[BULK_SIZE];
+	size_t i;
+
+	for (i = 0; i < sizeof out; i++) {
+		out[i] = i * 13 + (i >> 8);
+	}
+
+	loopback_set_loss(LOSS_PERIOD);
+
+	test_assert_zero(tcp_connect_pair());
+	test_assert_equal(sizeof out, send(c, out, sizeof out, 0));
+	test_assert_zero(recv_all(a, in, sizeof in));
+	test_assert_mem_equal(out, in, sizeof in);
+
+	/* And in the opposite direction */
+	memset(in, 0, sizeof in);
+	test_assert_equal(sizeof out, send(a, out, sizeof out, 0));
+	test_assert_zero(recv_all(c, in, sizeof in));
+	test_assert_mem_equal(out, in, sizeof in);
+
+	loopback_set_loss(0);
+}
+
+static int suite_setup(void) {
+	int ret;
+	struct in_device *in_dev;
+
+	in_dev = inetdev_get_loopback_dev();
+	if (in_dev == NULL) {
+		return -ENODEV;
+	}
+
+	ret = inetdev_set_addr(in_dev, htonl(INADDR_LOOPBACK));
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = netdev_flag_up(in_dev->dev, IFF_UP);
+	if (ret != 0) {
+		return ret;
+	}
+
+	return rt_add_route(in_dev->dev, ntohl(INADDR_LOOPBACK & ~1),
+			htonl(0xFF000000), 0, RTF_UP);
+}
+
+static int suite_teardown(void) {
+	int ret;
+	struct in_device *in_dev;
+
+	in_dev = inetdev_get_loopback_dev();
+	if (in_dev == NULL) {
+		return -ENODEV;
+	}
+
+	ret = netdev_flag_down(in_dev->dev, IFF_UP);
+	if (ret != 0) {
+		return ret;
+	}
+
+	return rt_del_route(in_dev->dev, ntohl(INADDR_LOOPBACK & ~1),
+			htonl(0xFF000000), 0);
+}
+
+static int case_setup(void) {
+	a = -1;
+
+	l = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (l == -1) {
+		return -errno;
+	}
+
+	if (-1 == listen(l, 1)) {
+		return -errno;
+	}
+
+	c = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (c == -1) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int case_teardown(void) {
+	loopback_set_loss(0);
+
+	if (a != -1) {
+		close(a);
+	}
+	close(c);
+	close(l);
+
+	return 0;
+}
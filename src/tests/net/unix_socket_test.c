@@ -0,0 +1,256 @@
+/**
+ * @file
+ * @brief
+ *
+ * @date 18.10.2026
+ */
+
+#include <embox/test.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+EMBOX_TEST_SUITE("AF_UNIX socket test");
+
+TEST_SETUP(case_setup);
+
+#define SRV_PATH "/tmp/unix_test_srv"
+#define CLI_PATH "/tmp/unix_test_cli"
+
+static struct sockaddr_un srv_addr, cli_addr;
+
+static inline struct sockaddr *to_sa(struct sockaddr_un *sa_un) {
+	return (struct sockaddr *)sa_un;
+}
+
+static void fill_addr(struct sockaddr_un *addr, const char *path) {
+	memset(addr, 0, sizeof *addr);
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+}
+
+TEST_CASE("socketpair() creates connected stream sockets") {
+	int sv[2];
+	char buf[4];
+
+	test_assert_zero(socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+	test_assert_equal(3, send(sv[0], "abc", 3, 0));
+	test_assert_equal(2, send(sv[1], "xy", 2, 0));
+
+	test_assert_equal(3, recv(sv[1], buf, sizeof buf, 0));
+	test_assert_mem_equal("abc", buf, 3);
+	test_assert_equal(2, recv(sv[0], buf, sizeof buf, 0));
+	test_assert_mem_equal("xy", buf, 2);
+
+	test_assert_zero(close(sv[0]));
+	test_assert_zero(close(sv[1]));
+}
+
+TEST_CASE("stream data larger than a single buffer is received in order") {
+	static char out[4000], in[sizeof out];
+	int sv[2];
+	size_t i, got;
+	ssize_t ret;
+
+	for (i = 0; i < sizeof out; i++) {
+		out[i] = i * 7;
+	}
+
+	test_assert_zero(socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+	test_assert_equal(sizeof out, send(sv[0], out, sizeof out, 0));
+
+	for (got = 0; got < sizeof in; got += ret) {
+		ret = recv(sv[1], in + got, sizeof in - got, 0);
+		test_assert(ret > 0);
+	}
+	test_assert_mem_equal(out, in, sizeof in);
+
+	test_assert_zero(close(sv[0]));
+	test_assert_zero(close(sv[1]));
+}
+
+TEST_CASE("recv() returns 0 and send() fails after peer is closed") {
+	int sv[2];
+	char buf[2];
+
+	test_assert_zero(socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+	test_assert_equal(1, send(sv[0], "a", 1, 0));
+	test_assert_zero(close(sv[0]));
+
+	test_assert_equal(1, recv(sv[1], buf, sizeof buf, 0));
+	test_assert_zero(recv(sv[1], buf, sizeof buf, 0));
+
+	test_assert_equal(-1, send(sv[1], "b", 1, 0));
+	test_assert_equal(EPIPE, errno);
+
+	test_assert_zero(close(sv[1]));
+}
+
+TEST_CASE("bind(), listen(), connect() and accept() work on named socket") {
+	struct sockaddr_un tmp;
+	socklen_t addrlen;
+	int l, c, a;
+	char buf[4];
+
+	l = socket(AF_UNIX, SOCK_STREAM, 0);
+	test_assert(l >= 0);
+	c = socket(AF_UNIX, SOCK_STREAM, 0);
+	test_assert(c >= 0);
+
+	test_assert_zero(bind(l, to_sa(&srv_addr), sizeof srv_addr));
+	test_assert_zero(listen(l, 1));
+	test_assert_zero(bind(c, to_sa(&cli_addr), sizeof cli_addr));
+	test_assert_zero(connect(c, to_sa(&srv_addr), sizeof srv_addr));
+
+	/* Data may be sent before the connection is accepted */
+	test_assert_equal(3, send(c, "abc", 3, 0));
+
+	addrlen = sizeof tmp;
+	a = accept(l, to_sa(&tmp), &addrlen);
+	test_assert(a >= 0);
+	test_assert_str_equal(CLI_PATH, tmp.sun_path);
+
+	addrlen = sizeof tmp;
+	test_assert_zero(getsockname(a, to_sa(&tmp), &addrlen));
+	test_assert_str_equal(SRV_PATH, tmp.sun_path);
+	addrlen = sizeof tmp;
+	test_assert_zero(getpeername(c, to_sa(&tmp), &addrlen));
+	test_assert_str_equal(SRV_PATH, tmp.sun_path);
+
+	test_assert_equal(3, recv(a, buf, sizeof buf, 0));
+	test_assert_mem_equal("abc", buf, 3);
+
+	test_assert_zero(close(a));
+	test_assert_zero(close(c));
+	test_assert_zero(close(l));
+}
+
+TEST_CASE("bind() fails on busy name and connect() on unknown one") {
+	int s1, s2;
+
+	s1 = socket(AF_UNIX, SOCK_STREAM, 0);
+	test_assert(s1 >= 0);
+	s2 = socket(AF_UNIX, SOCK_STREAM, 0);
+	test_assert(s2 >= 0);
+
+	test_assert_zero(bind(s1, to_sa(&srv_addr), sizeof srv_addr));
+	test_assert_equal(-1, bind(s2, to_sa(&srv_addr), sizeof srv_addr));
+	test_assert_equal(EADDRINUSE, errno);
+
+	test_assert_equal(-1, connect(s2, to_sa(&cli_addr), sizeof cli_addr));
+	test_assert_equal(ECONNREFUSED, errno);
+
+	test_assert_zero(close(s1));
+	test_assert_zero(close(s2));
+}
+
+TEST_CASE("datagrams keep boundaries and sender address") {
+	struct sockaddr_un tmp;
+	socklen_t addrlen;
+	int s, r;
+	char buf[4];
+
+	r = socket(AF_UNIX, SOCK_DGRAM, 0);
+	test_assert(r >= 0);
+	s = socket(AF_UNIX, SOCK_DGRAM, 0);
+	test_assert(s >= 0);
+
+	test_assert_zero(bind(r, to_sa(&srv_addr), sizeof srv_addr));
+	test_assert_zero(bind(s, to_sa(&cli_addr), sizeof cli_addr));
+
+	test_assert_equal(2, sendto(s, "ab", 2, 0, to_sa(&srv_addr),
+				sizeof srv_addr));
+	test_assert_equal(6, sendto(s, "cdefgh", 6, 0, to_sa(&srv_addr),
+				sizeof srv_addr));
+
+	addrlen = sizeof tmp;
+	test_assert_equal(2, recvfrom(r, buf, sizeof buf, 0, to_sa(&tmp),
+				&addrlen));
+	test_assert_mem_equal("ab", buf, 2);
+	test_assert_str_equal(CLI_PATH, tmp.sun_path);
+
+	/* The rest of truncated datagram is discarded */
+	test_assert_equal(sizeof buf, recv(r, buf, sizeof buf, 0));
+	test_assert_mem_equal("cdef", buf, sizeof buf);
+
+	test_assert_zero(close(s));
+	test_assert_zero(close(r));
+}
+
+TEST_CASE("seqpacket sockets keep message boundaries") {
+	int sv[2];
+	char buf[8];
+
+	test_assert_zero(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+
+	test_assert_equal(2, send(sv[0], "ab", 2, 0));
+	test_assert_equal(3, send(sv[0], "cde", 3, 0));
+
+	test_assert_equal(2, recv(sv[1], buf, sizeof buf, 0));
+	test_assert_equal(3, recv(sv[1], buf, sizeof buf, 0));
+	test_assert_mem_equal("cde", buf, 3);
+
+	test_assert_zero(close(sv[0]));
+	test_assert_zero(close(sv[1]));
+}
+
+TEST_CASE("SCM_RIGHTS passes descriptor to the peer") {
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	int sv[2], pfd[2], fd;
+	char c;
+
+	test_assert_zero(socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+	test_assert_zero(pipe(pfd));
+
+	memset(&msg, 0, sizeof msg);
+	iov.iov_base = "x";
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof cbuf;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &pfd[1], sizeof(int));
+
+	test_assert_equal(1, sendmsg(sv[0], &msg, 0));
+	/* Descriptor stays alive while it's in flight */
+	test_assert_zero(close(pfd[1]));
+
+	memset(cbuf, 0, sizeof cbuf);
+	iov.iov_base = &c;
+	msg.msg_controllen = sizeof cbuf;
+	test_assert_equal(1, recvmsg(sv[1], &msg, 0));
+	test_assert_equal('x', c);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	test_assert_not_null(cmsg);
+	test_assert_equal(SCM_RIGHTS, cmsg->cmsg_type);
+	test_assert_equal(CMSG_LEN(sizeof(int)), cmsg->cmsg_len);
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof fd);
+
+	test_assert_equal(1, write(fd, "y", 1));
+	test_assert_equal(1, read(pfd[0], &c, 1));
+	test_assert_equal('y', c);
+
+	test_assert_zero(close(fd));
+	test_assert_zero(close(pfd[0]));
+	test_assert_zero(close(sv[0]));
+	test_assert_zero(close(sv[1]));
+}
+
+static int case_setup(void) {
+	fill_addr(&srv_addr, SRV_PATH);
+	fill_addr(&cli_addr, CLI_PATH);
+	return 0;
+}
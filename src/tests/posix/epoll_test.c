@@ -0,0 +1,180 @@
+/**
+ * @file
+ * @brief
+ *
+ * @date 18.10.2026
+ */
+
+#include <embox/test.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+EMBOX_TEST_SUITE("epoll tests");
+
+TEST_SETUP(case_setup);
+TEST_TEARDOWN(case_teardown);
+
+#define TIMEOUT 11
+
+static int epfd;
+static int fildes[2];
+
+static int epoll_add(int fd, uint32_t events) {
+	struct epoll_event ev;
+
+	ev.events = events;
+	ev.data.fd = fd;
+
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+TEST_CASE("epoll_wait() returns 0 if no events occurred") {
+	struct epoll_event ev;
+
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, TIMEOUT));
+}
+
+TEST_CASE("epoll_ctl() fails on duplicate and unknown descriptor") {
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN));
+	test_assert_equal(-1, epoll_add(fildes[0], EPOLLIN));
+	test_assert_equal(EEXIST, errno);
+
+	test_assert_equal(-1, epoll_ctl(epfd, EPOLL_CTL_DEL, fildes[1], NULL));
+	test_assert_equal(ENOENT, errno);
+
+	test_assert_equal(-1, epoll_add(epfd, EPOLLIN));
+	test_assert_equal(EINVAL, errno);
+}
+
+TEST_CASE("epoll_wait() catches EPOLLIN in level-triggered mode") {
+	struct epoll_event ev;
+	char c;
+
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, TIMEOUT));
+	test_assert_equal(EPOLLIN, ev.events);
+	test_assert_equal(fildes[0], ev.data.fd);
+
+	/* Still ready until data is read */
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+
+	test_assert_equal(1, read(fildes[0], &c, 1));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+}
+
+TEST_CASE("epoll_wait() reports edge-triggered event once") {
+	struct epoll_event ev;
+
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN | EPOLLET));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	test_assert_equal(1, write(fildes[1], "a", 1));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+}
+
+TEST_CASE("epoll_wait() disables EPOLLONESHOT item until it's modified") {
+	struct epoll_event ev;
+
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN | EPOLLONESHOT));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = fildes[0];
+	test_assert_zero(epoll_ctl(epfd, EPOLL_CTL_MOD, fildes[0], &ev));
+	test_assert_equal(1, epoll_wait(epfd, &ev, 1, 0));
+}
+
+TEST_CASE("epoll_wait() returns at most maxevents events") {
+	struct epoll_event ev[2];
+
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN));
+	test_assert_zero(epoll_add(fildes[1], EPOLLOUT));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+
+	test_assert_equal(1, epoll_wait(epfd, ev, 1, 0));
+	test_assert_equal(2, epoll_wait(epfd, ev, 2, 0));
+}
+
+TEST_CASE("Removed descriptor doesn't generate events") {
+	struct epoll_event ev;
+
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN));
+	test_assert_zero(epoll_ctl(epfd, EPOLL_CTL_DEL, fildes[0], NULL));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+
+	test_assert_zero(epoll_wait(epfd, &ev, 1, 0));
+}
+
+TEST_CASE("Nested epoll is notified about events of inner one") {
+	struct epoll_event ev;
+	int outer;
+
+	outer = epoll_create1(0);
+	test_assert(outer != -1);
+
+	ev.events = EPOLLIN;
+	ev.data.fd = epfd;
+	test_assert_zero(epoll_ctl(outer, EPOLL_CTL_ADD, epfd, &ev));
+	test_assert_zero(epoll_add(fildes[0], EPOLLIN));
+	test_assert_equal(1, write(fildes[1], "a", 1));
+
+	test_assert_equal(1, epoll_wait(outer, &ev, 1, TIMEOUT));
+	test_assert_equal(epfd, ev.data.fd);
+
+	test_assert_zero(close(outer));
+}
+
+TEST_CASE("epoll_ctl() refuses to make a loop of epoll descriptors") {
+	struct epoll_event ev;
+	int outer;
+
+	outer = epoll_create1(0);
+	test_assert(outer != -1);
+
+	ev.events = EPOLLIN;
+	ev.data.fd = epfd;
+	test_assert_zero(epoll_ctl(outer, EPOLL_CTL_ADD, epfd, &ev));
+
+	test_assert_equal(-1, epoll_add(outer, EPOLLIN));
+	test_assert_equal(ELOOP, errno);
+
+	test_assert_zero(close(outer));
+}
+
+static int case_setup(void) {
+	if (-1 == pipe(fildes)) {
+		return -errno;
+	}
+
+	epfd = epoll_create(1);
+	if (epfd == -1) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int case_teardown(void) {
+	if (-1 == close(epfd)) {
+		return -errno;
+	}
+	if (-1 == close(fildes[0])) {
+		return -errno;
+	}
+	if (-1 == close(fildes[1])) {
+		return -errno;
+	}
+	return 0;
+}
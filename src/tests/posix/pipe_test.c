@@ -6,8 +6,11 @@
  * @date    19.11.2013
  */
 
+#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sys/uio.h>
 
 #include <embox/test.h>
 
@@ -98,3 +101,56 @@ TEST_CASE("read should block until data avaible") {
 
 	test_assert_emitted("abc");
 }
+
+TEST_CASE("writev() and readv() should use all buffers") {
+	struct iovec iov[3];
+	char a[2], b[3], c[4];
+
+	iov[0].iov_base = "ab";
+	iov[0].iov_len = 2;
+	iov[1].iov_base = NULL;
+	iov[1].iov_len = 0;
+	iov[2].iov_base = "cdefg";
+	iov[2].iov_len = 5;
+	test_assert_equal(7, writev(pipe_testfd[1], iov, 3));
+
+	iov[0].iov_base = a;
+	iov[0].iov_len = sizeof a;
+	iov[1].iov_base = b;
+	iov[1].iov_len = sizeof b;
+	iov[2].iov_base = c;
+	iov[2].iov_len = sizeof c;
+	test_assert_equal(7, readv(pipe_testfd[0], iov, 3));
+
+	test_assert_mem_equal("ab", a, 2);
+	test_assert_mem_equal("cde", b, 3);
+	test_assert_mem_equal("fg", c, 2);
+}
+
+TEST_CASE("splice() should move data between pipes") {
+	static char out[700], in[sizeof out];
+	int other[2];
+	size_t i;
+
+	for (i = 0; i < sizeof out; i++) {
+		out[i] = i;
+	}
+
+	test_assert_zero(pipe(other));
+
+	/* Data wraps around the end of the pipe buffer and is longer than
+	 * one chunk splice() moves at once */
+	test_assert_equal(sizeof out, write(pipe_testfd[1], out, sizeof out));
+	test_assert_equal(sizeof in, read(pipe_testfd[0], in, sizeof in));
+	test_assert_equal(sizeof out, write(pipe_testfd[1], out, sizeof out));
+
+	test_assert_equal(sizeof out, splice(pipe_testfd[0], NULL, other[1],
+				NULL, sizeof out, 0));
+
+	memset(in, 0, sizeof in);
+	test_assert_equal(sizeof in, read(other[0], in, sizeof in));
+	test_assert_mem_equal(out, in, sizeof in);
+
+	close(other[0]);
+	close(other[1]);
+}
@@ -9,7 +9,6 @@
 #include <assert.h>
 #include <stdarg.h>
 
-#include <kernel/printk.h>
 #include <util/logging.h>
 
 char *log_levels[LOG_DEBUG] = {
@@ -26,7 +25,7 @@ void logging_raw(struct logging *logging, int level, const char* fmt, ...) {
 		va_list args;
 
 		va_start(args, fmt);
-		vprintk(fmt, args);
+		logging_vprint(level, fmt, args);
 		va_end(args);
 	}
 }
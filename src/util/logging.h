@@ -32,6 +32,7 @@ struct logging {
  */
 extern char *log_levels[];
 
+#include <stdarg.h>
 #include <sys/cdefs.h>
 
 __BEGIN_DECLS
@@ -46,6 +47,16 @@ __BEGIN_DECLS
 extern void logging_raw(struct logging *logging, int level,
 	const char* fmt, ...);
 
+/**
+ * Outputs a message which passed the level filter. Implemented by
+ * a logging_output module: either prints it right away or defers it.
+ *
+ * @param level   Level of the message
+ * @param fmt     printf-like format of the message
+ * @param args    Arguments of the format
+ */
+extern void logging_vprint(int level, const char *fmt, va_list args);
+
 __END_DECLS
 
 #endif /* UTIL_LOGGING_H_ */
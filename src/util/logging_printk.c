@@ -0,0 +1,15 @@
+/**
+ * @file
+ * @brief Prints log messages synchronously with printk
+ *
+ * @date 18.10.2026
+ */
+
+#include <stdarg.h>
+
+#include <kernel/printk.h>
+#include <util/logging.h>
+
+void logging_vprint(int level, const char *fmt, va_list args) {
+	vprintk(fmt, args);
+}